@@ -0,0 +1,88 @@
+# CMAKE generated file: DO NOT EDIT!
+# Generated by "Unix Makefiles" Generator, CMake Version 3.25
+
+# The generator used is:
+set(CMAKE_DEPENDS_GENERATOR "Unix Makefiles")
+
+# The top level Makefile was generated from the following files:
+set(CMAKE_MAKEFILE_DEPENDS
+  "CMakeCache.txt"
+  "/root/repo/CMakeLists.txt"
+  "CMakeFiles/3.25.1/CMakeCCompiler.cmake"
+  "CMakeFiles/3.25.1/CMakeCXXCompiler.cmake"
+  "CMakeFiles/3.25.1/CMakeSystem.cmake"
+  "/root/repo/libipt/CMakeLists.txt"
+  "/root/repo/ptunit/CMakeLists.txt"
+  "/usr/share/cmake-3.25/Modules/CMakeCInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCXXInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCommonLanguageInclude.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeGenericSystem.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeInitializeConfigs.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeLanguageInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInitialize.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckCSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckIncludeFile.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckLibraryExists.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/CMakeCommonCompilerMacros.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU-C.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageHandleStandardArgs.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageMessage.cmake"
+  "/usr/share/cmake-3.25/Modules/FindThreads.cmake"
+  "/usr/share/cmake-3.25/Modules/Internal/CheckSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU-C.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/UnixPaths.cmake"
+  )
+
+# The corresponding makefile is:
+set(CMAKE_MAKEFILE_OUTPUTS
+  "Makefile"
+  "CMakeFiles/cmake.check_cache"
+  )
+
+# Byproducts of CMake generate step:
+set(CMAKE_MAKEFILE_PRODUCTS
+  "CMakeFiles/CMakeDirectoryInformation.cmake"
+  "libipt/CMakeFiles/CMakeDirectoryInformation.cmake"
+  "ptunit/CMakeFiles/CMakeDirectoryInformation.cmake"
+  )
+
+# Dependency information for all targets:
+set(CMAKE_DEPEND_INFO_FILES
+  "libipt/CMakeFiles/libipt.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-last_ip.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-tnt_cache.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-query.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-cpp.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-retstack.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-section_file.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-image.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-elf.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-maps.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-manifest.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-insn.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-flow.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-insn_merge.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-profile.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-block_profile.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-block_sample.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-tip_histogram.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-segment_cache.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-read_cache.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-ild.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-cpu.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-time.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-mapped_section.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-asid.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-event_queue.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-packet.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-sync.dir/DependInfo.cmake"
+  "libipt/CMakeFiles/ptunit-fetch.dir/DependInfo.cmake"
+  "ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  "ptunit/CMakeFiles/ptunit-selftest.dir/DependInfo.cmake"
+  )
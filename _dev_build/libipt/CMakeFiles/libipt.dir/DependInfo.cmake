@@ -0,0 +1,52 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/posix/init.c" "libipt/CMakeFiles/libipt.dir/src/posix/init.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/posix/init.c.o.d"
+  "/root/repo/libipt/src/posix/pt_cpuid.c" "libipt/CMakeFiles/libipt.dir/src/posix/pt_cpuid.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/posix/pt_cpuid.c.o.d"
+  "/root/repo/libipt/src/posix/pt_thread.c" "libipt/CMakeFiles/libipt.dir/src/posix/pt_thread.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/posix/pt_thread.c.o.d"
+  "/root/repo/libipt/src/pt_asid.c" "libipt/CMakeFiles/libipt.dir/src/pt_asid.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_asid.c.o.d"
+  "/root/repo/libipt/src/pt_block_profile.c" "libipt/CMakeFiles/libipt.dir/src/pt_block_profile.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_block_profile.c.o.d"
+  "/root/repo/libipt/src/pt_block_sample.c" "libipt/CMakeFiles/libipt.dir/src/pt_block_sample.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_block_sample.c.o.d"
+  "/root/repo/libipt/src/pt_config.c" "libipt/CMakeFiles/libipt.dir/src/pt_config.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_config.c.o.d"
+  "/root/repo/libipt/src/pt_decoder_function.c" "libipt/CMakeFiles/libipt.dir/src/pt_decoder_function.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_decoder_function.c.o.d"
+  "/root/repo/libipt/src/pt_elf.c" "libipt/CMakeFiles/libipt.dir/src/pt_elf.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_elf.c.o.d"
+  "/root/repo/libipt/src/pt_encoder.c" "libipt/CMakeFiles/libipt.dir/src/pt_encoder.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_encoder.c.o.d"
+  "/root/repo/libipt/src/pt_error.c" "libipt/CMakeFiles/libipt.dir/src/pt_error.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_error.c.o.d"
+  "/root/repo/libipt/src/pt_event_queue.c" "libipt/CMakeFiles/libipt.dir/src/pt_event_queue.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_event_queue.c.o.d"
+  "/root/repo/libipt/src/pt_flow.c" "libipt/CMakeFiles/libipt.dir/src/pt_flow.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_flow.c.o.d"
+  "/root/repo/libipt/src/pt_ild.c" "libipt/CMakeFiles/libipt.dir/src/pt_ild.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_ild.c.o.d"
+  "/root/repo/libipt/src/pt_image.c" "libipt/CMakeFiles/libipt.dir/src/pt_image.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_image.c.o.d"
+  "/root/repo/libipt/src/pt_insn_decoder.c" "libipt/CMakeFiles/libipt.dir/src/pt_insn_decoder.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_insn_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_insn_merge.c" "libipt/CMakeFiles/libipt.dir/src/pt_insn_merge.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_insn_merge.c.o.d"
+  "/root/repo/libipt/src/pt_last_ip.c" "libipt/CMakeFiles/libipt.dir/src/pt_last_ip.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_last_ip.c.o.d"
+  "/root/repo/libipt/src/pt_manifest.c" "libipt/CMakeFiles/libipt.dir/src/pt_manifest.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_manifest.c.o.d"
+  "/root/repo/libipt/src/pt_mapped_section.c" "libipt/CMakeFiles/libipt.dir/src/pt_mapped_section.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_mapped_section.c.o.d"
+  "/root/repo/libipt/src/pt_maps.c" "libipt/CMakeFiles/libipt.dir/src/pt_maps.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_maps.c.o.d"
+  "/root/repo/libipt/src/pt_packet.c" "libipt/CMakeFiles/libipt.dir/src/pt_packet.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_packet.c.o.d"
+  "/root/repo/libipt/src/pt_packet_decoder.c" "libipt/CMakeFiles/libipt.dir/src/pt_packet_decoder.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_packet_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_profile.c" "libipt/CMakeFiles/libipt.dir/src/pt_profile.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_profile.c.o.d"
+  "/root/repo/libipt/src/pt_query_decoder.c" "libipt/CMakeFiles/libipt.dir/src/pt_query_decoder.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_query_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_read_cache.c" "libipt/CMakeFiles/libipt.dir/src/pt_read_cache.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_read_cache.c.o.d"
+  "/root/repo/libipt/src/pt_retstack.c" "libipt/CMakeFiles/libipt.dir/src/pt_retstack.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_retstack.c.o.d"
+  "/root/repo/libipt/src/pt_section_file.c" "libipt/CMakeFiles/libipt.dir/src/pt_section_file.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_section_file.c.o.d"
+  "/root/repo/libipt/src/pt_segment_cache.c" "libipt/CMakeFiles/libipt.dir/src/pt_segment_cache.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_segment_cache.c.o.d"
+  "/root/repo/libipt/src/pt_sync.c" "libipt/CMakeFiles/libipt.dir/src/pt_sync.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_sync.c.o.d"
+  "/root/repo/libipt/src/pt_time.c" "libipt/CMakeFiles/libipt.dir/src/pt_time.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_time.c.o.d"
+  "/root/repo/libipt/src/pt_tip_histogram.c" "libipt/CMakeFiles/libipt.dir/src/pt_tip_histogram.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_tip_histogram.c.o.d"
+  "/root/repo/libipt/src/pt_tnt_cache.c" "libipt/CMakeFiles/libipt.dir/src/pt_tnt_cache.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_tnt_cache.c.o.d"
+  "/root/repo/libipt/src/pt_version.c" "libipt/CMakeFiles/libipt.dir/src/pt_version.c.o" "gcc" "libipt/CMakeFiles/libipt.dir/src/pt_version.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
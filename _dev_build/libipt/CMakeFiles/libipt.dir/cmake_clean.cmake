@@ -0,0 +1,77 @@
+file(REMOVE_RECURSE
+  "../lib/libipt.pdb"
+  "../lib/libipt.so"
+  "CMakeFiles/libipt.dir/src/posix/init.c.o"
+  "CMakeFiles/libipt.dir/src/posix/init.c.o.d"
+  "CMakeFiles/libipt.dir/src/posix/pt_cpuid.c.o"
+  "CMakeFiles/libipt.dir/src/posix/pt_cpuid.c.o.d"
+  "CMakeFiles/libipt.dir/src/posix/pt_thread.c.o"
+  "CMakeFiles/libipt.dir/src/posix/pt_thread.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_asid.c.o"
+  "CMakeFiles/libipt.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_block_profile.c.o"
+  "CMakeFiles/libipt.dir/src/pt_block_profile.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_block_sample.c.o"
+  "CMakeFiles/libipt.dir/src/pt_block_sample.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_config.c.o"
+  "CMakeFiles/libipt.dir/src/pt_config.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_decoder_function.c.o"
+  "CMakeFiles/libipt.dir/src/pt_decoder_function.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_elf.c.o"
+  "CMakeFiles/libipt.dir/src/pt_elf.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_encoder.c.o"
+  "CMakeFiles/libipt.dir/src/pt_encoder.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_error.c.o"
+  "CMakeFiles/libipt.dir/src/pt_error.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_event_queue.c.o"
+  "CMakeFiles/libipt.dir/src/pt_event_queue.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_flow.c.o"
+  "CMakeFiles/libipt.dir/src/pt_flow.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_ild.c.o"
+  "CMakeFiles/libipt.dir/src/pt_ild.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_image.c.o"
+  "CMakeFiles/libipt.dir/src/pt_image.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_insn_decoder.c.o"
+  "CMakeFiles/libipt.dir/src/pt_insn_decoder.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_insn_merge.c.o"
+  "CMakeFiles/libipt.dir/src/pt_insn_merge.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_last_ip.c.o"
+  "CMakeFiles/libipt.dir/src/pt_last_ip.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_manifest.c.o"
+  "CMakeFiles/libipt.dir/src/pt_manifest.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_mapped_section.c.o"
+  "CMakeFiles/libipt.dir/src/pt_mapped_section.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_maps.c.o"
+  "CMakeFiles/libipt.dir/src/pt_maps.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_packet.c.o"
+  "CMakeFiles/libipt.dir/src/pt_packet.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_packet_decoder.c.o"
+  "CMakeFiles/libipt.dir/src/pt_packet_decoder.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_profile.c.o"
+  "CMakeFiles/libipt.dir/src/pt_profile.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_query_decoder.c.o"
+  "CMakeFiles/libipt.dir/src/pt_query_decoder.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_read_cache.c.o"
+  "CMakeFiles/libipt.dir/src/pt_read_cache.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_retstack.c.o"
+  "CMakeFiles/libipt.dir/src/pt_retstack.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_section_file.c.o"
+  "CMakeFiles/libipt.dir/src/pt_section_file.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_segment_cache.c.o"
+  "CMakeFiles/libipt.dir/src/pt_segment_cache.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_sync.c.o"
+  "CMakeFiles/libipt.dir/src/pt_sync.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_time.c.o"
+  "CMakeFiles/libipt.dir/src/pt_time.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_tip_histogram.c.o"
+  "CMakeFiles/libipt.dir/src/pt_tip_histogram.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_tnt_cache.c.o"
+  "CMakeFiles/libipt.dir/src/pt_tnt_cache.c.o.d"
+  "CMakeFiles/libipt.dir/src/pt_version.c.o"
+  "CMakeFiles/libipt.dir/src/pt_version.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/libipt.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-asid"
+  "../bin/ptunit-asid.pdb"
+  "CMakeFiles/ptunit-asid.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-asid.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-asid.dir/test/src/ptunit-asid.c.o"
+  "CMakeFiles/ptunit-asid.dir/test/src/ptunit-asid.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-asid.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
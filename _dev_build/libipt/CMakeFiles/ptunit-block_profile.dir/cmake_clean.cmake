@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-block_profile"
+  "../bin/ptunit-block_profile.pdb"
+  "CMakeFiles/ptunit-block_profile.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-block_profile.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-block_profile.dir/src/pt_block_profile.c.o"
+  "CMakeFiles/ptunit-block_profile.dir/src/pt_block_profile.c.o.d"
+  "CMakeFiles/ptunit-block_profile.dir/test/src/ptunit-block_profile.c.o"
+  "CMakeFiles/ptunit-block_profile.dir/test/src/ptunit-block_profile.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-block_profile.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
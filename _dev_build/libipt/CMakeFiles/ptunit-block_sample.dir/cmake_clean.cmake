@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-block_sample"
+  "../bin/ptunit-block_sample.pdb"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_block_profile.c.o"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_block_profile.c.o.d"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_block_sample.c.o"
+  "CMakeFiles/ptunit-block_sample.dir/src/pt_block_sample.c.o.d"
+  "CMakeFiles/ptunit-block_sample.dir/test/src/ptunit-block_sample.c.o"
+  "CMakeFiles/ptunit-block_sample.dir/test/src/ptunit-block_sample.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-block_sample.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
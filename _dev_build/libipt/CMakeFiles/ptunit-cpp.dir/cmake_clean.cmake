@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-cpp"
+  "../bin/ptunit-cpp.pdb"
+  "CMakeFiles/ptunit-cpp.dir/test/src/ptunit-cpp.cpp.o"
+  "CMakeFiles/ptunit-cpp.dir/test/src/ptunit-cpp.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/ptunit-cpp.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
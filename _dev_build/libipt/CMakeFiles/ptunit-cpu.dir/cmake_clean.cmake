@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-cpu"
+  "../bin/ptunit-cpu.pdb"
+  "CMakeFiles/ptunit-cpu.dir/src/pt_cpu.c.o"
+  "CMakeFiles/ptunit-cpu.dir/src/pt_cpu.c.o.d"
+  "CMakeFiles/ptunit-cpu.dir/test/src/ptunit-cpu.c.o"
+  "CMakeFiles/ptunit-cpu.dir/test/src/ptunit-cpu.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-cpu.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,25 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-elf"
+  "../bin/ptunit-elf.pdb"
+  "CMakeFiles/ptunit-elf.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_elf.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_elf.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_image.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_image.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_manifest.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_manifest.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_mapped_section.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_mapped_section.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_maps.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_maps.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/src/pt_read_cache.c.o"
+  "CMakeFiles/ptunit-elf.dir/src/pt_read_cache.c.o.d"
+  "CMakeFiles/ptunit-elf.dir/test/src/ptunit-elf.c.o"
+  "CMakeFiles/ptunit-elf.dir/test/src/ptunit-elf.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-elf.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-event_queue"
+  "../bin/ptunit-event_queue.pdb"
+  "CMakeFiles/ptunit-event_queue.dir/src/pt_event_queue.c.o"
+  "CMakeFiles/ptunit-event_queue.dir/src/pt_event_queue.c.o.d"
+  "CMakeFiles/ptunit-event_queue.dir/test/src/ptunit-event_queue.c.o"
+  "CMakeFiles/ptunit-event_queue.dir/test/src/ptunit-event_queue.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-event_queue.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-fetch"
+  "../bin/ptunit-fetch.pdb"
+  "CMakeFiles/ptunit-fetch.dir/src/pt_decoder_function.c.o"
+  "CMakeFiles/ptunit-fetch.dir/src/pt_decoder_function.c.o.d"
+  "CMakeFiles/ptunit-fetch.dir/src/pt_encoder.c.o"
+  "CMakeFiles/ptunit-fetch.dir/src/pt_encoder.c.o.d"
+  "CMakeFiles/ptunit-fetch.dir/test/src/ptunit-fetch.c.o"
+  "CMakeFiles/ptunit-fetch.dir/test/src/ptunit-fetch.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-fetch.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-ild"
+  "../bin/ptunit-ild.pdb"
+  "CMakeFiles/ptunit-ild.dir/src/pt_ild.c.o"
+  "CMakeFiles/ptunit-ild.dir/src/pt_ild.c.o.d"
+  "CMakeFiles/ptunit-ild.dir/test/src/ptunit-ild.c.o"
+  "CMakeFiles/ptunit-ild.dir/test/src/ptunit-ild.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-ild.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,79 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-insn_merge"
+  "../bin/ptunit-insn_merge.pdb"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/init.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/init.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/pt_cpuid.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/pt_cpuid.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/pt_thread.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/posix/pt_thread.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_block_profile.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_block_profile.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_block_sample.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_block_sample.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_config.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_config.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_decoder_function.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_decoder_function.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_elf.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_elf.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_encoder.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_encoder.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_error.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_error.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_event_queue.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_event_queue.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_flow.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_flow.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_ild.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_ild.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_image.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_image.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_insn_decoder.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_insn_decoder.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_insn_merge.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_insn_merge.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_last_ip.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_last_ip.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_manifest.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_manifest.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_mapped_section.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_mapped_section.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_maps.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_maps.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_packet.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_packet.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_packet_decoder.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_packet_decoder.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_profile.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_profile.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_query_decoder.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_query_decoder.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_read_cache.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_read_cache.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_retstack.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_retstack.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_section_file.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_section_file.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_segment_cache.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_segment_cache.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_sync.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_sync.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_time.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_time.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_tip_histogram.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_tip_histogram.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_tnt_cache.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_tnt_cache.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_version.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/src/pt_version.c.o.d"
+  "CMakeFiles/ptunit-insn_merge.dir/test/src/ptunit-insn_merge.c.o"
+  "CMakeFiles/ptunit-insn_merge.dir/test/src/ptunit-insn_merge.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-insn_merge.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-last_ip"
+  "../bin/ptunit-last_ip.pdb"
+  "CMakeFiles/ptunit-last_ip.dir/src/pt_last_ip.c.o"
+  "CMakeFiles/ptunit-last_ip.dir/src/pt_last_ip.c.o.d"
+  "CMakeFiles/ptunit-last_ip.dir/test/src/ptunit-last_ip.c.o"
+  "CMakeFiles/ptunit-last_ip.dir/test/src/ptunit-last_ip.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-last_ip.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-manifest"
+  "../bin/ptunit-manifest.pdb"
+  "CMakeFiles/ptunit-manifest.dir/src/pt_manifest.c.o"
+  "CMakeFiles/ptunit-manifest.dir/src/pt_manifest.c.o.d"
+  "CMakeFiles/ptunit-manifest.dir/test/src/ptunit-manifest.c.o"
+  "CMakeFiles/ptunit-manifest.dir/test/src/ptunit-manifest.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-manifest.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-mapped_section"
+  "../bin/ptunit-mapped_section.pdb"
+  "CMakeFiles/ptunit-mapped_section.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-mapped_section.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-mapped_section.dir/src/pt_mapped_section.c.o"
+  "CMakeFiles/ptunit-mapped_section.dir/src/pt_mapped_section.c.o.d"
+  "CMakeFiles/ptunit-mapped_section.dir/test/src/ptunit-mapped_section.c.o"
+  "CMakeFiles/ptunit-mapped_section.dir/test/src/ptunit-mapped_section.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-mapped_section.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
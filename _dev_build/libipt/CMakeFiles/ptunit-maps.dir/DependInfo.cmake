@@ -0,0 +1,27 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/pt_asid.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_asid.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_asid.c.o.d"
+  "/root/repo/libipt/src/pt_elf.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_elf.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_elf.c.o.d"
+  "/root/repo/libipt/src/pt_image.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_image.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_image.c.o.d"
+  "/root/repo/libipt/src/pt_manifest.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_manifest.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_manifest.c.o.d"
+  "/root/repo/libipt/src/pt_mapped_section.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_mapped_section.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_mapped_section.c.o.d"
+  "/root/repo/libipt/src/pt_maps.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_maps.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_maps.c.o.d"
+  "/root/repo/libipt/src/pt_read_cache.c" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_read_cache.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/src/pt_read_cache.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-maps.c" "libipt/CMakeFiles/ptunit-maps.dir/test/src/ptunit-maps.c.o" "gcc" "libipt/CMakeFiles/ptunit-maps.dir/test/src/ptunit-maps.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
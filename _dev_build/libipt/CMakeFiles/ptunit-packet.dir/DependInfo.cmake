@@ -0,0 +1,25 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/pt_decoder_function.c" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_decoder_function.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_decoder_function.c.o.d"
+  "/root/repo/libipt/src/pt_encoder.c" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_encoder.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_encoder.c.o.d"
+  "/root/repo/libipt/src/pt_packet.c" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_packet.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_packet.c.o.d"
+  "/root/repo/libipt/src/pt_packet_decoder.c" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_packet_decoder.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_packet_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_sync.c" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_sync.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/src/pt_sync.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-packet.c" "libipt/CMakeFiles/ptunit-packet.dir/test/src/ptunit-packet.c.o" "gcc" "libipt/CMakeFiles/ptunit-packet.dir/test/src/ptunit-packet.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
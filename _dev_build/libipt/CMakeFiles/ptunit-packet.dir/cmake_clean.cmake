@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-packet"
+  "../bin/ptunit-packet.pdb"
+  "CMakeFiles/ptunit-packet.dir/src/pt_decoder_function.c.o"
+  "CMakeFiles/ptunit-packet.dir/src/pt_decoder_function.c.o.d"
+  "CMakeFiles/ptunit-packet.dir/src/pt_encoder.c.o"
+  "CMakeFiles/ptunit-packet.dir/src/pt_encoder.c.o.d"
+  "CMakeFiles/ptunit-packet.dir/src/pt_packet.c.o"
+  "CMakeFiles/ptunit-packet.dir/src/pt_packet.c.o.d"
+  "CMakeFiles/ptunit-packet.dir/src/pt_packet_decoder.c.o"
+  "CMakeFiles/ptunit-packet.dir/src/pt_packet_decoder.c.o.d"
+  "CMakeFiles/ptunit-packet.dir/src/pt_sync.c.o"
+  "CMakeFiles/ptunit-packet.dir/src/pt_sync.c.o.d"
+  "CMakeFiles/ptunit-packet.dir/test/src/ptunit-packet.c.o"
+  "CMakeFiles/ptunit-packet.dir/test/src/ptunit-packet.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-packet.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/pt_profile.c" "libipt/CMakeFiles/ptunit-profile.dir/src/pt_profile.c.o" "gcc" "libipt/CMakeFiles/ptunit-profile.dir/src/pt_profile.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-profile.c" "libipt/CMakeFiles/ptunit-profile.dir/test/src/ptunit-profile.c.o" "gcc" "libipt/CMakeFiles/ptunit-profile.dir/test/src/ptunit-profile.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
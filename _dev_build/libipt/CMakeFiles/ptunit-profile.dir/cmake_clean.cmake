@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-profile"
+  "../bin/ptunit-profile.pdb"
+  "CMakeFiles/ptunit-profile.dir/src/pt_profile.c.o"
+  "CMakeFiles/ptunit-profile.dir/src/pt_profile.c.o.d"
+  "CMakeFiles/ptunit-profile.dir/test/src/ptunit-profile.c.o"
+  "CMakeFiles/ptunit-profile.dir/test/src/ptunit-profile.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-profile.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,22 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/pt_asid.c" "libipt/CMakeFiles/ptunit-read_cache.dir/src/pt_asid.c.o" "gcc" "libipt/CMakeFiles/ptunit-read_cache.dir/src/pt_asid.c.o.d"
+  "/root/repo/libipt/src/pt_read_cache.c" "libipt/CMakeFiles/ptunit-read_cache.dir/src/pt_read_cache.c.o" "gcc" "libipt/CMakeFiles/ptunit-read_cache.dir/src/pt_read_cache.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-read_cache.c" "libipt/CMakeFiles/ptunit-read_cache.dir/test/src/ptunit-read_cache.c.o" "gcc" "libipt/CMakeFiles/ptunit-read_cache.dir/test/src/ptunit-read_cache.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
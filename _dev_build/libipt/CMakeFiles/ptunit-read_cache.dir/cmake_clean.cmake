@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-read_cache"
+  "../bin/ptunit-read_cache.pdb"
+  "CMakeFiles/ptunit-read_cache.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-read_cache.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-read_cache.dir/src/pt_read_cache.c.o"
+  "CMakeFiles/ptunit-read_cache.dir/src/pt_read_cache.c.o.d"
+  "CMakeFiles/ptunit-read_cache.dir/test/src/ptunit-read_cache.c.o"
+  "CMakeFiles/ptunit-read_cache.dir/test/src/ptunit-read_cache.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-read_cache.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-retstack"
+  "../bin/ptunit-retstack.pdb"
+  "CMakeFiles/ptunit-retstack.dir/src/pt_retstack.c.o"
+  "CMakeFiles/ptunit-retstack.dir/src/pt_retstack.c.o.d"
+  "CMakeFiles/ptunit-retstack.dir/test/src/ptunit-retstack.c.o"
+  "CMakeFiles/ptunit-retstack.dir/test/src/ptunit-retstack.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-retstack.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/pt_section_file.c" "libipt/CMakeFiles/ptunit-section_file.dir/src/pt_section_file.c.o" "gcc" "libipt/CMakeFiles/ptunit-section_file.dir/src/pt_section_file.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-section.c" "libipt/CMakeFiles/ptunit-section_file.dir/test/src/ptunit-section.c.o" "gcc" "libipt/CMakeFiles/ptunit-section_file.dir/test/src/ptunit-section.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-section_file"
+  "../bin/ptunit-section_file.pdb"
+  "CMakeFiles/ptunit-section_file.dir/src/pt_section_file.c.o"
+  "CMakeFiles/ptunit-section_file.dir/src/pt_section_file.c.o.d"
+  "CMakeFiles/ptunit-section_file.dir/test/src/ptunit-section.c.o"
+  "CMakeFiles/ptunit-section_file.dir/test/src/ptunit-section.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-section_file.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
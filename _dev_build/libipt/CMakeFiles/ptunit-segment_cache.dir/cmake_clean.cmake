@@ -0,0 +1,41 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-segment_cache"
+  "../bin/ptunit-segment_cache.pdb"
+  "CMakeFiles/ptunit-segment_cache.dir/src/posix/pt_cpuid.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/posix/pt_cpuid.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_asid.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_asid.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_block_profile.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_block_profile.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_config.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_config.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_decoder_function.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_decoder_function.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_encoder.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_encoder.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_event_queue.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_event_queue.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_last_ip.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_last_ip.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_packet.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_packet.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_packet_decoder.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_packet_decoder.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_query_decoder.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_query_decoder.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_segment_cache.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_segment_cache.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_sync.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_sync.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_time.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_time.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_tnt_cache.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/src/pt_tnt_cache.c.o.d"
+  "CMakeFiles/ptunit-segment_cache.dir/test/src/ptunit-segment_cache.c.o"
+  "CMakeFiles/ptunit-segment_cache.dir/test/src/ptunit-segment_cache.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-segment_cache.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-sync"
+  "../bin/ptunit-sync.pdb"
+  "CMakeFiles/ptunit-sync.dir/src/pt_packet.c.o"
+  "CMakeFiles/ptunit-sync.dir/src/pt_packet.c.o.d"
+  "CMakeFiles/ptunit-sync.dir/src/pt_sync.c.o"
+  "CMakeFiles/ptunit-sync.dir/src/pt_sync.c.o.d"
+  "CMakeFiles/ptunit-sync.dir/test/src/ptunit-sync.c.o"
+  "CMakeFiles/ptunit-sync.dir/test/src/ptunit-sync.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-sync.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
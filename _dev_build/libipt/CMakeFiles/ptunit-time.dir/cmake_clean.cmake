@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-time"
+  "../bin/ptunit-time.pdb"
+  "CMakeFiles/ptunit-time.dir/src/pt_time.c.o"
+  "CMakeFiles/ptunit-time.dir/src/pt_time.c.o.d"
+  "CMakeFiles/ptunit-time.dir/test/src/ptunit-time.c.o"
+  "CMakeFiles/ptunit-time.dir/test/src/ptunit-time.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-time.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
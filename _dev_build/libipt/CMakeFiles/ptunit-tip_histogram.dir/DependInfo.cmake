@@ -0,0 +1,34 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libipt/src/posix/pt_cpuid.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/posix/pt_cpuid.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/posix/pt_cpuid.c.o.d"
+  "/root/repo/libipt/src/pt_asid.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_asid.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_asid.c.o.d"
+  "/root/repo/libipt/src/pt_config.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_config.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_config.c.o.d"
+  "/root/repo/libipt/src/pt_decoder_function.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_decoder_function.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_decoder_function.c.o.d"
+  "/root/repo/libipt/src/pt_encoder.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_encoder.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_encoder.c.o.d"
+  "/root/repo/libipt/src/pt_event_queue.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_event_queue.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_event_queue.c.o.d"
+  "/root/repo/libipt/src/pt_last_ip.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_last_ip.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_last_ip.c.o.d"
+  "/root/repo/libipt/src/pt_packet.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_packet.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_packet.c.o.d"
+  "/root/repo/libipt/src/pt_packet_decoder.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_packet_decoder.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_packet_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_query_decoder.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_query_decoder.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_query_decoder.c.o.d"
+  "/root/repo/libipt/src/pt_sync.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_sync.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_sync.c.o.d"
+  "/root/repo/libipt/src/pt_time.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_time.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_time.c.o.d"
+  "/root/repo/libipt/src/pt_tip_histogram.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_tip_histogram.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_tip_histogram.c.o.d"
+  "/root/repo/libipt/src/pt_tnt_cache.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_tnt_cache.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/src/pt_tnt_cache.c.o.d"
+  "/root/repo/libipt/test/src/ptunit-tip_histogram.c" "libipt/CMakeFiles/ptunit-tip_histogram.dir/test/src/ptunit-tip_histogram.c.o" "gcc" "libipt/CMakeFiles/ptunit-tip_histogram.dir/test/src/ptunit-tip_histogram.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_dev_build/ptunit/CMakeFiles/ptunit.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-tnt_cache"
+  "../bin/ptunit-tnt_cache.pdb"
+  "CMakeFiles/ptunit-tnt_cache.dir/src/pt_tnt_cache.c.o"
+  "CMakeFiles/ptunit-tnt_cache.dir/src/pt_tnt_cache.c.o.d"
+  "CMakeFiles/ptunit-tnt_cache.dir/test/src/ptunit-tnt_cache.c.o"
+  "CMakeFiles/ptunit-tnt_cache.dir/test/src/ptunit-tnt_cache.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-tnt_cache.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../bin/ptunit-selftest"
+  "../bin/ptunit-selftest.pdb"
+  "CMakeFiles/ptunit-selftest.dir/src/ptunit-selftest.c.o"
+  "CMakeFiles/ptunit-selftest.dir/src/ptunit-selftest.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit-selftest.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/ptunit/src/posix/ptunit_mktempname.c" "ptunit/CMakeFiles/ptunit.dir/src/posix/ptunit_mktempname.c.o" "gcc" "ptunit/CMakeFiles/ptunit.dir/src/posix/ptunit_mktempname.c.o.d"
+  "/root/repo/ptunit/src/posix/ptunit_threads.c" "ptunit/CMakeFiles/ptunit.dir/src/posix/ptunit_threads.c.o" "gcc" "ptunit/CMakeFiles/ptunit.dir/src/posix/ptunit_threads.c.o.d"
+  "/root/repo/ptunit/src/ptunit.c" "ptunit/CMakeFiles/ptunit.dir/src/ptunit.c.o" "gcc" "ptunit/CMakeFiles/ptunit.dir/src/ptunit.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "../lib/libptunit.a"
+  "../lib/libptunit.pdb"
+  "CMakeFiles/ptunit.dir/src/posix/ptunit_mktempname.c.o"
+  "CMakeFiles/ptunit.dir/src/posix/ptunit_mktempname.c.o.d"
+  "CMakeFiles/ptunit.dir/src/posix/ptunit_threads.c.o"
+  "CMakeFiles/ptunit.dir/src/posix/ptunit_threads.c.o.d"
+  "CMakeFiles/ptunit.dir/src/ptunit.c.o"
+  "CMakeFiles/ptunit.dir/src/ptunit.c.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/ptunit.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
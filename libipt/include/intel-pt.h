@@ -45,6 +45,11 @@
  * - Query decoder
  * - Traced image
  * - Instruction flow decoder
+ * - Flow export
+ * - Call profiles
+ * - Block profiles
+ * - Indirect branch target histograms
+ * - Multi-processor merge
  */
 
 
@@ -53,6 +58,11 @@ struct pt_encoder;
 struct pt_packet_decoder;
 struct pt_query_decoder;
 struct pt_insn_decoder;
+struct pt_block_profile;
+struct pt_block_sample;
+struct pt_segment_cache;
+struct pt_tip_histogram;
+struct pt_insn_merge;
 
 
 
@@ -1183,6 +1193,59 @@ extern pt_export int pt_qry_time(struct pt_query_decoder *decoder,
 extern pt_export int pt_qry_core_bus_ratio(struct pt_query_decoder *decoder,
 					   uint32_t *cbr);
 
+/** Statistics about trace skipped by the address space filter. */
+struct pt_skip_stats {
+	/** The number of skipped trace bytes. */
+	uint64_t bytes;
+
+	/** The number of skipped packets. */
+	uint64_t packets;
+};
+
+/** Set the address space filter.
+ *
+ * While \@ncr3 is not zero, trace for address spaces whose cr3 is not one
+ * of the \@ncr3 values in \@cr3 is skipped.  The values need not be sorted
+ * and they are copied.  Set \@ncr3 to zero to decode all trace.
+ *
+ * Trace is skipped from a PIP packet that changes cr3 to a filtered value
+ * or from a PSB whose PSB+ header shows a filtered cr3.  It is skipped at
+ * the packet level until the next PSB whose PSB+ header shows an unfiltered
+ * cr3, the next TIP.PGE while the cr3 is not filtered, or the next TIP
+ * following a PIP that changes cr3 to an unfiltered value.
+ *
+ * A PIP that changes cr3 to a filtered value results in a disabled event
+ * with suppressed IP if tracing had been enabled.  The end of the skipped
+ * trace results in an enabled event followed by a paging event for the new
+ * cr3 if tracing is enabled at that point.
+ *
+ * A PIP that binds to an asynchronous branch is not filtered.
+ *
+ * The filter should be set before \@decoder is synchronized.  Setting the
+ * filter resets the skip statistics.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder is NULL.
+ * Returns -pte_invalid if \@cr3 is NULL and \@ncr3 is not zero.
+ * Returns -pte_nomem if the values could not be copied.
+ */
+extern pt_export int pt_qry_set_asid_filter(struct pt_query_decoder *decoder,
+					    const uint64_t *cr3,
+					    uint32_t ncr3);
+
+/** Get statistics about the trace skipped by the address space filter.
+ *
+ * Provides the number of trace bytes and packets skipped since the filter
+ * was set in \@stats.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder or \@stats is NULL.
+ */
+extern pt_export int pt_qry_get_skip_stats(struct pt_query_decoder *decoder,
+					   struct pt_skip_stats *stats);
+
 
 
 /* Traced image. */
@@ -1200,20 +1263,32 @@ struct pt_asid {
 
 	/** The CR3 value. */
 	uint64_t cr3;
+
+	/** The VMCS Base address. */
+	uint64_t vmcs;
 };
 
 /** An unknown CR3 value to be used for pt_asid objects. */
 static const uint64_t pt_asid_no_cr3 = 0xffffffffffffffffull;
 
+/** An unknown VMCS Base value to be used for pt_asid objects. */
+static const uint64_t pt_asid_no_vmcs = 0xffffffffffffffffull;
+
 /** Initialize an address space identifier. */
 static inline void pt_asid_init(struct pt_asid *asid)
 {
 	asid->size = sizeof(*asid);
 	asid->cr3 = pt_asid_no_cr3;
+	asid->vmcs = pt_asid_no_vmcs;
 }
 
 
-/** The traced memory image. */
+/** The traced memory image.
+ *
+ * Sections may be added to or removed from an image while decoders that use
+ * the image are running.  Functions that modify an image must not be called
+ * concurrently with each other on the same image.
+ */
 struct pt_image;
 
 
@@ -1232,6 +1307,25 @@ extern pt_export struct pt_image *pt_image_alloc(const char *name);
  */
 extern pt_export void pt_image_free(struct pt_image *image);
 
+/** Copy a traced memory image.
+ *
+ * Allocates a new traced memory image that contains the same sections and the
+ * same read memory callback as \@src.  An optional \@name may be given to the
+ * copy.  The name string is copied.
+ *
+ * The copy is cheap.  Both images share their sections until one of them is
+ * modified.  A modification only affects the modified image.
+ *
+ * Copies of the same image may be modified and freed on different threads.
+ * The \@src image must not be modified while it is being copied.
+ *
+ * The copy must be freed with pt_image_free().
+ *
+ * Returns a new traced memory image on success, NULL otherwise.
+ */
+extern pt_export struct pt_image *pt_image_copy(const struct pt_image *src,
+						const char *name);
+
 /** Get the image name.
  *
  * Returns a pointer to \@image's name or NULL if there is no name.
@@ -1261,6 +1355,141 @@ extern pt_export int pt_image_add_file(struct pt_image *image,
 				       const struct pt_asid *asid,
 				       uint64_t vaddr);
 
+/** Add the executable segments of an ELF file to the traced memory image.
+ *
+ * Parses the program headers of the ELF32 or ELF64 file \@filename and adds
+ * the file-backed part of each executable PT_LOAD segment.  Each segment is
+ * loaded at its virtual address plus \@load_bias in the address space \@asid.
+ *
+ * Use \@load_bias to relocate position-independent executables and shared
+ * libraries; it is the difference between the address at which the object
+ * was actually loaded and its link-time address.  Use zero for non-relocated
+ * executables.
+ *
+ * All segments share a single mapping of \@filename.  They can be removed
+ * with pt_image_remove_by_filename().
+ *
+ * The \@asid may be NULL or (partially) invalid.  In that case only the valid
+ * fields are considered when comparing with other address-spaces.
+ *
+ * If any segment cannot be added, \@image is not modified.
+ *
+ * Returns the number of added segments on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_bad_image if sections would overlap.
+ * Returns -pte_invalid if \@image or \@filename is NULL.
+ * Returns -pte_invalid if \@filename is not a little-endian ELF file.
+ */
+extern pt_export int pt_image_add_elf(struct pt_image *image,
+				      const char *filename,
+				      const struct pt_asid *asid,
+				      uint64_t load_bias);
+
+/** Add the memory contained in an ELF core file to the traced memory image.
+ *
+ * Parses the program headers of the ELF32 or ELF64 core file \@filename and
+ * adds each PT_LOAD segment that is contained completely in the core file.
+ * Each segment is loaded at its virtual address in the address space \@asid.
+ *
+ * File-backed mappings are typically not contained, or only partially
+ * contained, in a core file.  They are not added.  Use pt_image_add_elf() or
+ * pt_image_add_file() or a read memory callback to provide them.
+ *
+ * All segments share a single mapping of \@filename.  They can be removed
+ * with pt_image_remove_by_filename().
+ *
+ * The \@asid may be NULL or (partially) invalid.  In that case only the valid
+ * fields are considered when comparing with other address-spaces.
+ *
+ * If any segment cannot be added, \@image is not modified.
+ *
+ * Returns the number of added segments on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_bad_image if sections would overlap.
+ * Returns -pte_invalid if \@image or \@filename is NULL.
+ * Returns -pte_invalid if \@filename is not a little-endian ELF core file.
+ */
+extern pt_export int pt_image_add_core(struct pt_image *image,
+				       const char *filename,
+				       const struct pt_asid *asid);
+
+/** Add the executable file mappings of a process to the traced memory image.
+ *
+ * Parses \@maps, a snapshot of a process' memory mappings in the format of
+ * /proc/<pid>/maps, and adds each executable mapping of a file.  Each mapping
+ * is loaded at its virtual address in the address space \@asid.  It is
+ * truncated to the size of the mapped file.
+ *
+ * Mappings of pseudo-files like [vdso], of files that cannot be opened, and
+ * mappings that lie beyond the end of their file are skipped.  Use a read
+ * memory callback or pt_image_add_buffer() to provide their memory.
+ *
+ * Each file is opened only once and shared by all its mappings.  All mappings
+ * are added in one batch.  This is considerably faster than adding each
+ * mapping with pt_image_add_file() for processes with many mappings.
+ *
+ * The \@asid may be NULL or (partially) invalid.  In that case only the valid
+ * fields are considered when comparing with other address-spaces.
+ *
+ * If any mapping cannot be added, \@image is not modified.
+ *
+ * Returns the number of added mappings on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_bad_image if sections would overlap.
+ * Returns -pte_invalid if \@image or \@maps is NULL.
+ * Returns -pte_invalid if \@maps is not in the expected format.
+ */
+extern pt_export int pt_image_add_maps(struct pt_image *image,
+				       const char *maps,
+				       const struct pt_asid *asid);
+
+/** A release memory callback function.
+ *
+ * It is called with the \@buffer and \@size of a buffer section and with the
+ * \@context given to pt_image_add_buffer() once the section is no longer used.
+ */
+typedef void (release_memory_callback_t)(const uint8_t *buffer, uint64_t size,
+					 void *context);
+
+/** Add a memory buffer section to the traced memory image.
+ *
+ * Adds \@size bytes of memory starting at \@buffer.  The section is loaded at
+ * the virtual address \@vaddr in the address space \@asid.
+ *
+ * Use this for code that is not available in a file, e.g. for JIT-compiled
+ * code or for code that was extracted from a process.
+ *
+ * The memory is not copied.  It must remain valid until \@release is called
+ * with \@buffer, \@size, and \@context.  This happens once neither \@image
+ * nor any copy of it uses the section anymore.  If \@release is NULL, the
+ * memory must remain valid until \@image and all its copies have been freed.
+ * If the section cannot be added, \@release is not called and \@image is not
+ * modified.
+ *
+ * Use \@generation to replace code.  Buffer sections in \@asid that overlap
+ * with the new section are replaced if their generation is smaller than
+ * \@generation.  Any other overlap is an error.
+ *
+ * The \@asid may be NULL or (partially) invalid.  In that case only the valid
+ * fields are considered when comparing with other address-spaces.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_bad_image if sections would overlap.
+ * Returns -pte_invalid if \@image or \@buffer is NULL.
+ * Returns -pte_invalid if \@size is zero or if the section would wrap around.
+ * Returns -pte_nomem if the section could not be allocated.
+ */
+extern pt_export int pt_image_add_buffer(struct pt_image *image,
+					 const uint8_t *buffer, uint64_t size,
+					 const struct pt_asid *asid,
+					 uint64_t vaddr, uint32_t generation,
+					 release_memory_callback_t *release,
+					 void *context);
+
 /** Remove all sections loaded from a file.
  *
  * Removes all sections loaded from \@filename from the address space \@asid.
@@ -1288,6 +1517,122 @@ extern pt_export int pt_image_remove_by_filename(struct pt_image *image,
 extern pt_export int pt_image_remove_by_asid(struct pt_image *image,
 					     const struct pt_asid *asid);
 
+/** The type of a traced memory image sideband record. */
+enum pt_image_record_type {
+	/** Memory from a file is mapped.
+	 *
+	 * This replaces any previous mapping of the same memory region.
+	 */
+	ptir_add,
+
+	/** A memory region is unmapped. */
+	ptir_remove
+};
+
+/** A traced memory image sideband record.
+ *
+ * Describes a change to the traced memory image, e.g. as a result of an mmap()
+ * or munmap() system call, and the time at which the change took effect.
+ */
+struct pt_image_record {
+	/** The time stamp count at which the change took effect. */
+	uint64_t tsc;
+
+	/** The address space in which the change took effect.
+	 *
+	 * This may be NULL or (partially) invalid.  In that case only the
+	 * valid fields are considered.
+	 */
+	const struct pt_asid *asid;
+
+	/** The type of change. */
+	enum pt_image_record_type type;
+
+	/** The file that is mapped - ignored for ptir_remove. */
+	const char *filename;
+
+	/** The offset into \@filename - ignored for ptir_remove. */
+	uint64_t offset;
+
+	/** The size of the memory region in bytes. */
+	uint64_t size;
+
+	/** The virtual address of the memory region. */
+	uint64_t vaddr;
+};
+
+/** Apply a sideband record to the traced memory image.
+ *
+ * Changes the memory region of \@record->size bytes starting at
+ * \@record->vaddr in \@record->asid at time \@record->tsc.
+ *
+ * For ptir_add, \@record->size bytes starting at \@record->offset in
+ * \@record->filename are mapped into the region.  For ptir_remove, the region
+ * is unmapped.  In both cases, sections overlapping with the region are
+ * removed or trimmed.
+ *
+ * The image keeps all earlier versions.  The instruction flow decoder reads
+ * memory from the version that was valid at the time of the decoded
+ * instruction.  Earlier versions share unchanged sections with later ones.
+ *
+ * Records must be applied in the order of their time stamps.  Other functions
+ * that modify \@image only affect the latest version.
+ *
+ * On errors, \@image is not modified.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@image or \@record is NULL.
+ * Returns -pte_invalid if \@record is older than a previously applied record.
+ * Returns -pte_invalid if \@record->filename can not be mapped.
+ * Returns -pte_nomem if the new version could not be allocated.
+ */
+extern pt_export int pt_image_apply(struct pt_image *image,
+				    const struct pt_image_record *record);
+
+/** Save the traced memory image.
+ *
+ * Writes a compact binary manifest of the current sections of \@image into
+ * \@filename.  For each section, it records the name of the file the section
+ * was loaded from, its offset and size in that file, a hash of its content,
+ * its virtual address, and its address space.
+ *
+ * Sections that were added with pt_image_add_buffer(), older versions created
+ * by pt_image_apply(), and the read memory callback are not saved.
+ *
+ * Returns the number of saved sections on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_invalid if \@image or \@filename is NULL.
+ * Returns -pte_invalid if \@filename could not be written.
+ */
+extern pt_export int pt_image_save(const struct pt_image *image,
+				   const char *filename);
+
+/** Load a traced memory image.
+ *
+ * Reads a manifest written by pt_image_save() from \@filename and adds the
+ * sections it describes to \@image, which must be empty.
+ *
+ * Each file is mapped only once and shared by all its sections.  Sections are
+ * not checked for overlaps again.  If the size and modification time of a
+ * file match the ones recorded in the manifest, its sections are used as-is.
+ * Otherwise, the content of each of its sections is compared against the hash
+ * recorded in the manifest.
+ *
+ * If any section cannot be loaded, \@image is not modified.
+ *
+ * Returns the number of loaded sections on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_bad_image if a file is missing or has changed.
+ * Returns -pte_invalid if \@image or \@filename is NULL.
+ * Returns -pte_invalid if \@image is not empty.
+ * Returns -pte_invalid if \@filename does not contain a valid manifest.
+ */
+extern pt_export int pt_image_load(struct pt_image *image,
+				   const char *filename);
+
 /** A read memory callback function.
  *
  * It shall read \@size bytes of memory from address space \@asid starting
@@ -1309,12 +1654,61 @@ typedef int (read_memory_callback_t)(uint8_t *buffer, size_t size,
  * There can only be one callback at any time.  A subsequent call will replace
  * the previous callback.  If \@callback is NULL, the callback is removed.
  *
+ * Setting a callback discards all memory cached for the previous callback.
+ *
  * Returns -pte_invalid if \@image is NULL.
  */
 extern pt_export int pt_image_set_callback(struct pt_image *image,
 					   read_memory_callback_t *callback,
 					   void *context);
 
+/** Configure caching of memory read via the read memory callback.
+ *
+ * By default, the read memory callback is asked for exactly the memory the
+ * decoder needs for decoding an instruction.  With caching enabled, the
+ * callback is asked for the entire \@page_size aligned window of \@page_size
+ * bytes containing the requested memory instead.  Up to \@nr_pages windows from
+ * any address space are kept per image and used for subsequent reads.
+ *
+ * The callback may provide less than \@page_size bytes.  The memory it does
+ * provide is assumed to start at the beginning of the window.  If the callback
+ * fails to read the window, it is asked for the requested memory, instead.
+ *
+ * Use pt_image_invalidate() when memory read via the callback changes.
+ *
+ * Reconfiguring discards all cached memory.  If \@page_size or \@nr_pages is
+ * zero, caching is disabled.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@image is NULL.
+ * Returns -pte_invalid if \@page_size is not a power of two.
+ * Returns -pte_invalid if \@page_size is smaller than pt_max_insn_size.
+ * Returns -pte_nomem if the cache could not be allocated.
+ */
+extern pt_export int pt_image_set_callback_cache(struct pt_image *image,
+						 uint32_t page_size,
+						 uint32_t nr_pages);
+
+/** Invalidate cached memory.
+ *
+ * Discards memory read via the read memory callback that overlaps with
+ * \@size bytes starting at \@vaddr in the address space \@asid.
+ *
+ * The \@asid may be NULL or (partially) invalid.  In that case only the valid
+ * fields are considered.  Use this for invalidating memory in all address
+ * spaces.
+ *
+ * Use this for self-modifying or JIT code that is read via the callback.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@image is NULL.
+ */
+extern pt_export int pt_image_invalidate(struct pt_image *image,
+					 const struct pt_asid *asid,
+					 uint64_t vaddr, uint64_t size);
+
 
 
 /* Instruction flow decoder. */
@@ -1366,6 +1760,30 @@ enum {
 	pt_max_insn_size	= 15
 };
 
+/** How the instruction flow decoder provides an instruction's bytes.
+ *
+ * See pt_insn_set_bytes_mode().
+ */
+enum pt_insn_bytes_mode {
+	/** Copy the bytes into the instruction's raw field.
+	 *
+	 * This is the default.
+	 */
+	ptib_copy,
+
+	/** Point to the bytes in the traced image, if possible.
+	 *
+	 * If the bytes can not be accessed in place, they are copied as with
+	 * ptib_copy.  This is the case for sections that are not mapped into
+	 * memory, for memory provided by the read memory callback, and for
+	 * instructions that may straddle sections.
+	 */
+	ptib_ref,
+
+	/** Do not provide the bytes. */
+	ptib_none
+};
+
 /** A single traced instruction. */
 struct pt_insn {
 	/** The virtual address in its process. */
@@ -1377,7 +1795,11 @@ struct pt_insn {
 	/** The execution mode. */
 	enum pt_exec_mode mode;
 
-	/** The raw bytes. */
+	/** The raw bytes.
+	 *
+	 * Only the first \@size bytes are valid.  They are not provided if
+	 * \@bytes is not NULL or if the decoder does not provide bytes.
+	 */
 	uint8_t raw[pt_max_insn_size];
 
 	/** The size in bytes. */
@@ -1413,6 +1835,161 @@ struct pt_insn {
 
 	/** - tracing resumed at this instruction after an overflow. */
 	uint32_t resynced:1;
+
+	/** - trace was skipped before this instruction.
+	 *
+	 *    The decoder encountered an error in resilient mode and resumed
+	 *    decoding at the next synchronization point.  See
+	 *    pt_insn_get_gap().
+	 */
+	uint32_t gap:1;
+
+	/** The bytes in the traced image or NULL.
+	 *
+	 * If the decoder's bytes mode is ptib_ref, this may point to the
+	 * \@size bytes of the instruction in the traced image.  The memory
+	 * remains valid as long as its section is in the image.
+	 *
+	 * If this is NULL, the bytes are in \@raw.
+	 */
+	const uint8_t *bytes;
+};
+
+/** Instruction flags in a batch of instructions.
+ *
+ * The flags correspond to the flags in struct pt_insn.  The execution mode
+ * is stored in the flags, as well.  Use pt_insn_flags_mode() to extract it.
+ */
+enum pt_insn_flags {
+	ptif_speculative	= 1 << 0,
+	ptif_aborted		= 1 << 1,
+	ptif_committed		= 1 << 2,
+	ptif_disabled		= 1 << 3,
+	ptif_enabled		= 1 << 4,
+	ptif_resumed		= 1 << 5,
+	ptif_interrupted	= 1 << 6,
+	ptif_resynced		= 1 << 7,
+	ptif_gap		= 1 << 10,
+
+	/* The flags that indicate events. */
+	ptif_events		= ptif_aborted | ptif_committed |
+				  ptif_disabled | ptif_enabled |
+				  ptif_resumed | ptif_interrupted |
+				  ptif_resynced | ptif_gap,
+
+	/* The execution mode. */
+	ptif_mode_shift		= 8,
+	ptif_mode_mask		= 0x3 << ptif_mode_shift
+};
+
+/** Return the execution mode stored in instruction flags. */
+static inline enum pt_exec_mode pt_insn_flags_mode(uint16_t flags)
+{
+	return (enum pt_exec_mode) ((flags & ptif_mode_mask) >>
+				    ptif_mode_shift);
+}
+
+/** Instruction filter bits - see pt_insn_set_filter(). */
+enum pt_insn_filter {
+	/** Instructions of the corresponding class. */
+	ptfm_error		= 1 << ptic_error,
+	ptfm_other		= 1 << ptic_other,
+	ptfm_call		= 1 << ptic_call,
+	ptfm_return		= 1 << ptic_return,
+	ptfm_jump		= 1 << ptic_jump,
+	ptfm_cond_jump		= 1 << ptic_cond_jump,
+	ptfm_far_call		= 1 << ptic_far_call,
+	ptfm_far_return		= 1 << ptic_far_return,
+	ptfm_far_jump		= 1 << ptic_far_jump,
+
+	/** Instructions with events - see ptif_events. */
+	ptfm_events		= 1 << 16,
+
+	/** All instructions that transfer control. */
+	ptfm_branches		= ptfm_call | ptfm_return | ptfm_jump |
+				  ptfm_cond_jump | ptfm_far_call |
+				  ptfm_far_return | ptfm_far_jump
+};
+
+/** An event in a batch of instructions. */
+struct pt_insn_batch_event {
+	/** The row of the instruction at which the event occurred. */
+	uint32_t row;
+
+	/** The event flags of that instruction - see ptif_events. */
+	uint16_t flags;
+};
+
+/** A batch of traced instructions in columns.
+ *
+ * Each column is an array of at least \@nrows elements provided by the user.
+ * Row i of all columns describes the i-th instruction of the batch.
+ */
+struct pt_insn_batch {
+	/** The number of rows in each column. */
+	uint32_t nrows;
+
+	/** The virtual addresses. */
+	uint64_t *ip;
+
+	/** The sizes in bytes. */
+	uint8_t *size;
+
+	/** The classifications - see enum pt_insn_class. */
+	uint8_t *iclass;
+
+	/** The flags and execution modes - see enum pt_insn_flags. */
+	uint16_t *flags;
+
+	/** An optional column of raw bytes.
+	 *
+	 * If not NULL, the first size bytes of each row hold the raw bytes
+	 * of the instruction.
+	 */
+	uint8_t (*raw)[pt_max_insn_size];
+
+	/** An optional array of up to \@max_events events. */
+	struct pt_insn_batch_event *events;
+	uint32_t max_events;
+};
+
+/** A gap in the trace.
+ *
+ * In resilient mode, the instruction flow decoder skips trace it can't decode
+ * and resumes at the next synchronization point.  Consecutive errors without
+ * an instruction in between are combined into a single gap.
+ */
+struct pt_insn_gap {
+	/** The offset of the first skipped byte in the trace buffer. */
+	uint64_t begin;
+
+	/** The offset after the last skipped byte in the trace buffer.
+	 *
+	 * This is the offset of the synchronization point at which decoding
+	 * resumed or the size of the trace buffer if there was none.
+	 */
+	uint64_t end;
+
+	/** The IP of the last instruction before the gap or zero. */
+	uint64_t ip;
+
+	/** The time lost in the gap or zero if it is not known. */
+	uint64_t time;
+
+	/** The error that caused the gap. */
+	int errcode;
+};
+
+/** Statistics about trace skipped in resilient mode. */
+struct pt_insn_gap_stats {
+	/** The number of gaps. */
+	uint64_t ngaps;
+
+	/** The number of skipped trace bytes. */
+	uint64_t bytes;
+
+	/** The time lost in gaps for which the time is known. */
+	uint64_t time;
 };
 
 
@@ -1501,61 +2078,1277 @@ pt_insn_get_image(struct pt_insn_decoder *decoder);
  *
  * Only one image can be active at any time.
  *
+ * This clears the block cache used by pt_insn_coverage() and
+ * pt_insn_next_breakpoint().
+ *
  * Returns zero on success, a negative error code otherwise.
  * Return -pte_invalid if \@decoder is NULL.
  */
 extern pt_export int pt_insn_set_image(struct pt_insn_decoder *decoder,
 				       struct pt_image *image);
 
-/** Return the current time.
+/** Set how instruction bytes are provided.
  *
- * On success, provides the time at \@decoder's current position in \@time.
- * Since \@decoder is reading ahead until the next indirect branch or event,
- * the value matches the time for that branch or event.
+ * By default, \@decoder copies the bytes of each instruction into the raw
+ * field of struct pt_insn.  Most users never look at the bytes.  They may
+ * set \@mode to ptib_ref or ptib_none to avoid copying them.
  *
- * The time is similar to what an rdtsc instruction would return. Beware that
- * the time is not fully accurate. It should be good enough for a course
- * correlation with other time stamped data such as side-band information.
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder is NULL or if \@mode is not valid.
+ */
+extern pt_export int pt_insn_set_bytes_mode(struct pt_insn_decoder *decoder,
+					    enum pt_insn_bytes_mode mode);
+
+/** Enable or disable resilient mode.
+ *
+ * By default, decoding errors are terminal.  The user needs to synchronize
+ * \@decoder again in order to continue decoding.
+ *
+ * In resilient mode, pt_insn_next() instead resynchronizes \@decoder at the
+ * next synchronization point after errors such as -pte_nosync, -pte_nomap,
+ * or -pte_bad_insn and continues decoding from there.  The first instruction
+ * after the skipped trace has the gap flag set.  Decoding ends with -pte_eos
+ * if there is no further synchronization point.
  *
  * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder is NULL.
+ */
+extern pt_export int pt_insn_set_resilient(struct pt_insn_decoder *decoder,
+					   int enable);
+
+/** Set the block profile.
  *
- * Returns -pte_invalid if \@decoder or \@time is NULL.
+ * While \@profile is set, pt_insn_next() counts the blocks and edges it
+ * decodes in \@profile.  Set \@profile to NULL to stop counting.
+ *
+ * The profile must not be used by any other decoder at the same time.  Use
+ * pt_block_profile_merge() to combine the profiles of several decoders.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder is NULL.
  */
-extern pt_export int pt_insn_time(struct pt_insn_decoder *decoder,
-				  uint64_t *time);
+extern pt_export int
+pt_insn_set_block_profile(struct pt_insn_decoder *decoder,
+			  struct pt_block_profile *profile);
 
-/** Return the current core bus ratio.
+/** Set the instruction filter.
  *
- * On success, provides the core:bus ratio at \@decoder's current position
- * in \@cbr.
- * Since \@decoder is reading ahead until the next indirect branch or event,
- * the value matches the core:bus ratio for that branch or event.
+ * While \@filter is not zero, pt_insn_next() only provides instructions
+ * that match \@filter and skips all others.  An instruction matches if the
+ * bit for its class is set or if it has an event and ptfm_events is set.
+ * The flags of skipped instructions are lost.  Set \@filter to zero to
+ * provide all instructions.
  *
- * The ratio is defined as core cycles per bus clock cycle.
+ * If ptfm_other is not set, blocks of sequential instructions are skipped
+ * without decoding each instruction using the same cache as
+ * pt_insn_coverage() while no block profile is set.
+ *
+ * Setting the filter resets the number of skipped instructions.
  *
  * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder is NULL.
+ * Returns -pte_nomem if the block cache could not be allocated.
+ */
+extern pt_export int pt_insn_set_filter(struct pt_insn_decoder *decoder,
+					uint32_t filter);
+
+/** Get the number of instructions skipped by the instruction filter.
  *
- * Returns -pte_invalid if \@decoder or \@cbr is NULL.
+ * Provides the number of instructions skipped since the filter was set in
+ * \@skipped.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder or \@skipped is NULL.
  */
-extern pt_export int pt_insn_core_bus_ratio(struct pt_insn_decoder *decoder,
-					    uint32_t *cbr);
+extern pt_export int pt_insn_get_filtered(struct pt_insn_decoder *decoder,
+					  uint64_t *skipped);
 
-/** Determine the next instruction.
+/** Set the address space filter.
  *
- * On success, provides the next instruction in execution order in \@insn.
+ * Trace for address spaces whose cr3 is not one of the \@ncr3 values in
+ * \@cr3 is skipped without reading memory or decoding instructions.  The
+ * first instruction after skipped trace has the enabled flag set.
  *
- * Returns zero or a positive value on success, a negative error code otherwise.
+ * See pt_qry_set_asid_filter() for details.
  *
- * Returns -pte_bad_context if the decoder encountered an unexpected packet.
- * Returns -pte_bad_opc if the decoder encountered unknown packets.
- * Returns -pte_bad_packet if the decoder encountered unknown packet payloads.
- * Returns -pte_bad_query if the decoder got out of sync.
- * Returns -pte_eos if decoding reached the end of the Intel PT buffer.
- * Returns -pte_invalid if \@decoder or \@insn is NULL.
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder is NULL.
+ * Returns -pte_invalid if \@cr3 is NULL and \@ncr3 is not zero.
+ * Returns -pte_nomem if the values could not be copied.
+ */
+extern pt_export int pt_insn_set_asid_filter(struct pt_insn_decoder *decoder,
+					     const uint64_t *cr3,
+					     uint32_t ncr3);
+
+/** Get statistics about the trace skipped by the address space filter.
+ *
+ * Provides the number of trace bytes and packets skipped since the filter
+ * was set in \@stats.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder or \@stats is NULL.
+ */
+extern pt_export int pt_insn_get_skip_stats(struct pt_insn_decoder *decoder,
+					    struct pt_skip_stats *stats);
+
+/** Get the last gap in the trace.
+ *
+ * Provides information about the trace that was skipped before the last
+ * instruction with the gap flag set in \@gap.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder or \@gap is NULL.
+ * Returns -pte_nosync if there was no gap.
+ */
+extern pt_export int pt_insn_get_gap(struct pt_insn_decoder *decoder,
+				     struct pt_insn_gap *gap);
+
+/** Get statistics about the skipped trace.
+ *
+ * Provides the number of gaps and the trace bytes and time lost in them
+ * since \@decoder was allocated in \@stats.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder or \@stats is NULL.
+ */
+extern pt_export int
+pt_insn_get_gap_stats(struct pt_insn_decoder *decoder,
+		      struct pt_insn_gap_stats *stats);
+
+/** Return the current time.
+ *
+ * On success, provides the time at \@decoder's current position in \@time.
+ * Since \@decoder is reading ahead until the next indirect branch or event,
+ * the value matches the time for that branch or event.
+ *
+ * The time is similar to what an rdtsc instruction would return. Beware that
+ * the time is not fully accurate. It should be good enough for a course
+ * correlation with other time stamped data such as side-band information.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder or \@time is NULL.
+ */
+extern pt_export int pt_insn_time(struct pt_insn_decoder *decoder,
+				  uint64_t *time);
+
+/** Return the current core bus ratio.
+ *
+ * On success, provides the core:bus ratio at \@decoder's current position
+ * in \@cbr.
+ * Since \@decoder is reading ahead until the next indirect branch or event,
+ * the value matches the core:bus ratio for that branch or event.
+ *
+ * The ratio is defined as core cycles per bus clock cycle.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder or \@cbr is NULL.
+ */
+extern pt_export int pt_insn_core_bus_ratio(struct pt_insn_decoder *decoder,
+					    uint32_t *cbr);
+
+/** Determine the next instruction.
+ *
+ * On success, provides the next instruction in execution order in \@insn.
+ *
+ * The \@size argument must be set to sizeof(struct pt_insn).  If \@size does
+ * not cover \@insn->bytes, the bytes are always provided in \@insn->raw.
+ *
+ * In resilient mode, errors that can be skipped are not reported.  See
+ * pt_insn_set_resilient().
+ *
+ * Returns zero or a positive value on success, a negative error code otherwise.
+ *
+ * Returns -pte_bad_context if the decoder encountered an unexpected packet.
+ * Returns -pte_bad_opc if the decoder encountered unknown packets.
+ * Returns -pte_bad_packet if the decoder encountered unknown packet payloads.
+ * Returns -pte_bad_query if the decoder got out of sync.
+ * Returns -pte_eos if decoding reached the end of the Intel PT buffer.
+ * Returns -pte_invalid if \@decoder or \@insn is NULL.
+ * Returns -pte_invalid if \@size is too small.
  * Returns -pte_nomap if the memory at the instruction address can't be read.
  * Returns -pte_nosync if \@decoder is out of sync.
  */
 extern pt_export int pt_insn_next(struct pt_insn_decoder *decoder,
-				  struct pt_insn *insn);
+				  struct pt_insn *insn, size_t size);
+
+/** Determine the next instructions.
+ *
+ * On success, provides up to \@batch->nrows next instructions in execution
+ * order in \@batch's columns.
+ *
+ * Instructions with events are reported in \@batch->events together with the
+ * row at which they occurred.  The events are also indicated in the flags
+ * column.  When there is no room for further events, the batch ends after the
+ * instruction with the last event.  If \@batch->max_events is zero, the batch
+ * ends after the first instruction with an event.
+ *
+ * If decoding fails after the first instruction, the batch ends before the
+ * failing instruction.  The error is reported on the next call.
+ *
+ * Returns the number of instructions in \@batch on success, a negative error
+ * code otherwise.  On success, provides the number of events in \@nevents.
+ *
+ * Returns -pte_invalid if \@decoder, \@batch, or \@nevents is NULL.
+ * Returns -pte_invalid if any of \@batch's mandatory columns is NULL.
+ * Returns -pte_invalid if \@batch->events is NULL and \@batch->max_events is
+ * not zero.
+ *
+ * Otherwise, returns the same errors as pt_insn_next().
+ */
+extern pt_export int pt_insn_next_batch(struct pt_insn_decoder *decoder,
+					struct pt_insn_batch *batch,
+					uint32_t *nevents);
+
+/** Collect edge coverage.
+ *
+ * Decodes the trace from the current position to its end without
+ * providing instructions.  Counts each transition from one block of
+ * sequential instructions to the next in \@bitmap of \@size bytes in the
+ * same way as the American Fuzzy Lop fuzzer: the location of a block is
+ * derived from the address of its first instruction and the counter at the
+ * location of the next block xor'ed with half the location of the previous
+ * block is incremented.  Counters saturate at 255.  The location of the
+ * previous block is zero where tracing begins and after a gap.
+ *
+ * Blocks are cached when they are first executed without an event pending
+ * and are followed without decoding their instructions afterwards.  The
+ * cache is allocated on the first call and is kept with \@decoder so that
+ * later calls do not allocate memory.  It is cleared when the traced
+ * memory changes.  Blocks are not cached while the traced image has older
+ * versions created by pt_image_apply() since a block may differ over time.
+ *
+ * In resilient mode, errors are skipped as in pt_insn_next().
+ *
+ * Returns zero at the end of the trace, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder or \@bitmap is NULL.
+ * Returns -pte_invalid if \@size is not a power of two.
+ * Returns -pte_nomem if the block cache could not be allocated.
+ *
+ * Otherwise, returns the same errors as pt_insn_next().
+ */
+extern pt_export int pt_insn_coverage(struct pt_insn_decoder *decoder,
+				      uint8_t *bitmap, uint32_t size);
+
+/** Set the breakpoints.
+ *
+ * Sets the addresses at which pt_insn_next_breakpoint() stops to the
+ * \@nips addresses in \@ips.  They need not be sorted.  Duplicates are
+ * ignored.  The addresses are copied.
+ *
+ * Set \@nips to zero to remove all breakpoints.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder is NULL.
+ * Returns -pte_invalid if \@ips is NULL and \@nips is not zero.
+ * Returns -pte_nomem if the addresses could not be copied.
+ */
+extern pt_export int pt_insn_set_breakpoints(struct pt_insn_decoder *decoder,
+					     const uint64_t *ips,
+					     uint32_t nips);
+
+/** Decode until a breakpoint is reached.
+ *
+ * Decodes the trace without providing instructions until an instruction at
+ * one of the addresses given to pt_insn_set_breakpoints() has been
+ * executed.  Provides its address in \@ip and the current time in \@tsc.
+ * The time is zero if there is no timing information.
+ *
+ * Blocks of sequential instructions that do not contain a breakpoint are
+ * followed using the same cache as pt_insn_coverage().
+ *
+ * In resilient mode, errors are skipped as in pt_insn_next().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder, \@ip, or \@tsc is NULL.
+ * Returns -pte_eos if the end of the trace was reached.
+ * Returns -pte_nomem if the block cache could not be allocated.
+ *
+ * Otherwise, returns the same errors as pt_insn_next().
+ */
+extern pt_export int pt_insn_next_breakpoint(struct pt_insn_decoder *decoder,
+					     uint64_t *ip, uint64_t *tsc);
+
+/** The configuration of a sampled block profile. */
+struct pt_sample_config {
+	/** The size of this object - set to sizeof(struct pt_sample_config). */
+	size_t size;
+
+	/** Decode one in \@stride PSB segments.
+	 *
+	 * Zero and one decode every segment.
+	 */
+	uint32_t stride;
+
+	/** The seed for selecting segments.
+	 *
+	 * If zero, every \@stride-th segment is decoded beginning with the
+	 * first.  Otherwise, each segment is decoded with a probability of
+	 * one in \@stride using a pseudo-random sequence seeded with \@seed.
+	 */
+	uint32_t seed;
+
+	/** The processor time budget in microseconds.
+	 *
+	 * Decoding stops when the processor time spent by the calling thread
+	 * exceeds the budget.  Samplers running on other threads do not use
+	 * up the budget.  Zero means no limit.
+	 */
+	uint64_t budget;
+};
+
+/** Sample the trace into a block profile.
+ *
+ * Decodes a subset of the PSB segments in \@decoder's trace buffer as
+ * selected by \@config and counts their blocks and edges in \@sample.
+ * Each segment is decoded on its own.  It ends at the next PSB packet.
+ *
+ * Segments are selected until the time budget is exhausted.  The segment
+ * that exhausts the budget is dropped.  The remaining segments are still
+ * counted in the total so estimates are extrapolated to the entire trace.
+ *
+ * Errors end the current segment.  They are counted in \@sample's
+ * statistics.
+ *
+ * This does not use and does not change \@decoder's block profile.
+ * Synchronize \@decoder again before using it for other decoding.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@decoder, \@sample, or \@config is NULL.
+ * Returns -pte_nomem if \@sample could not be extended.
+ */
+extern pt_export int pt_insn_sample(struct pt_insn_decoder *decoder,
+				    struct pt_block_sample *sample,
+				    const struct pt_sample_config *config);
+
+/** A PSB segment cache.
+ *
+ * It remembers the block and edge counts of decoded PSB segments by a hash
+ * of their packets.  Timing packets are ignored.  The execution state at
+ * the beginning of a segment is given in its PSB+ header and thus part of
+ * the hash.
+ *
+ * Repeated segments are not decoded again by pt_insn_sample().  Their
+ * counts are taken from the cache instead.
+ *
+ * The cache is not used for images with more than one version.  See
+ * pt_image_apply().  The same segment may execute different code depending
+ * on its time.
+ */
+struct pt_segment_cache;
+
+/** Statistics about a PSB segment cache. */
+struct pt_segment_cache_stats {
+	/** The number of lookups. */
+	uint64_t lookups;
+
+	/** The number of lookups that found a segment. */
+	uint64_t hits;
+
+	/** The number of cached segments. */
+	uint64_t segments;
+
+	/** The memory used by the cache in bytes. */
+	uint64_t memory;
+
+	/** The number of times the cache was cleared.
+	 *
+	 * The cache is cleared when it is full or when the traced image
+	 * changed.
+	 */
+	uint64_t flushes;
+};
+
+/** Allocate a PSB segment cache.
+ *
+ * The cache uses at most \@limit bytes of memory.
+ *
+ * Returns a new, empty cache on success, NULL otherwise.
+ */
+extern pt_export struct pt_segment_cache *
+pt_segment_cache_alloc(uint64_t limit);
+
+/** Free a PSB segment cache.
+ *
+ * The \@cache must not be used after a successful return.  It must not be
+ * used by an instruction flow decoder.
+ */
+extern pt_export void pt_segment_cache_free(struct pt_segment_cache *cache);
+
+/** Get statistics about a PSB segment cache.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@cache or \@stats is NULL.
+ */
+extern pt_export int
+pt_segment_cache_get_stats(const struct pt_segment_cache *cache,
+			   struct pt_segment_cache_stats *stats);
+
+/** Set the PSB segment cache.
+ *
+ * While \@cache is set, pt_insn_sample() looks up each selected segment in
+ * \@cache before decoding it and adds decoded segments to \@cache.  Set
+ * \@cache to NULL to stop using a cache.
+ *
+ * The cache must not be used by any other decoder at the same time.  It is
+ * cleared when \@decoder's traced image or its address space filter is
+ * changed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if \@decoder is NULL.
+ */
+extern pt_export int
+pt_insn_set_segment_cache(struct pt_insn_decoder *decoder,
+			  struct pt_segment_cache *cache);
+
+
+
+/* Flow export. */
+
+
+
+/** A block of sequential instructions in an exported execution flow.
+ *
+ * A block ends with a control transfer, an event, or a change of the
+ * execution mode or of speculative execution.
+ */
+struct pt_flow_block {
+	/** The virtual address of the first instruction. */
+	uint64_t ip;
+
+	/** The virtual address of the last instruction. */
+	uint64_t end_ip;
+
+	/** The time of the block.
+	 *
+	 * This is the last time given before the block was written.
+	 */
+	uint64_t tsc;
+
+	/** The number of instructions. */
+	uint32_t ninsn;
+
+	/** The flags and the execution mode - see enum pt_insn_flags.
+	 *
+	 * The event flags are the union of the event flags of the block's
+	 * instructions.
+	 */
+	uint16_t flags;
+};
+
+/** An execution flow writer.
+ *
+ * It writes blocks of instructions in a compact binary format to a file.
+ */
+struct pt_flow_writer;
+
+/** An execution flow reader.
+ *
+ * It reads blocks of instructions from a file written by a flow writer.
+ */
+struct pt_flow_reader;
+
+
+/** Allocate an execution flow writer.
+ *
+ * Creates \@filename or truncates it if it exists.
+ *
+ * The file is not complete until pt_flow_finish() has been called.
+ *
+ * Returns a new flow writer on success, NULL otherwise.
+ */
+extern pt_export struct pt_flow_writer *
+pt_flow_alloc_writer(const char *filename);
+
+/** Free an execution flow writer.
+ *
+ * Closes \@writer's file.  Blocks that have not been finished are lost.
+ *
+ * The \@writer must not be used after a successful return.
+ */
+extern pt_export void pt_flow_free_writer(struct pt_flow_writer *writer);
+
+/** Write an instruction.
+ *
+ * Adds \@insn to the current block.  The block is written when it ends.
+ *
+ * This may be used with instructions from pt_insn_next().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@writer or \@insn is NULL.
+ * Returns -pte_invalid if \@writer has already been finished.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int pt_flow_write_insn(struct pt_flow_writer *writer,
+					const struct pt_insn *insn);
+
+/** Write a block.
+ *
+ * Ends the current block and writes \@block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@writer or \@block is NULL.
+ * Returns -pte_invalid if \@writer has already been finished.
+ * Returns -pte_invalid if \@block is empty or ends before it begins.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int pt_flow_write_block(struct pt_flow_writer *writer,
+					 const struct pt_flow_block *block);
+
+/** Set the time.
+ *
+ * Sets the time of blocks written by pt_flow_write_insn() to \@tsc.  This
+ * also applies to the current block.
+ *
+ * This may be used with the time from pt_insn_time().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@writer is NULL.
+ */
+extern pt_export int pt_flow_write_time(struct pt_flow_writer *writer,
+					uint64_t tsc);
+
+/** Finish an execution flow.
+ *
+ * Ends the current block and writes the index that allows readers to seek.
+ *
+ * No further blocks may be written after a successful return.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@writer is NULL.
+ * Returns -pte_invalid if \@writer has already been finished.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int pt_flow_finish(struct pt_flow_writer *writer);
+
+/** Allocate an execution flow reader.
+ *
+ * Reads the execution flow in \@filename.  The file must have been written
+ * by a flow writer and finished with pt_flow_finish().
+ *
+ * Returns a new flow reader on success, NULL otherwise.
+ */
+extern pt_export struct pt_flow_reader *
+pt_flow_alloc_reader(const char *filename);
+
+/** Free an execution flow reader.
+ *
+ * The \@reader must not be used after a successful return.
+ */
+extern pt_export void pt_flow_free_reader(struct pt_flow_reader *reader);
+
+/** Seek to a time.
+ *
+ * Positions \@reader at the last anchor at or before \@tsc.  Anchors are
+ * written periodically.  The blocks following the new position may thus
+ * still have a smaller time than \@tsc.
+ *
+ * If there is no such anchor, positions \@reader at the beginning.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@reader is NULL.
+ */
+extern pt_export int pt_flow_seek(struct pt_flow_reader *reader, uint64_t tsc);
+
+/** Read the next block.
+ *
+ * On success, provides the next block in \@block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_bad_opc if an unknown record is encountered.
+ * Returns -pte_bad_packet if a record is corrupt.
+ * Returns -pte_eos if there are no further blocks.
+ * Returns -pte_invalid if \@reader or \@block is NULL.
+ */
+extern pt_export int pt_flow_next(struct pt_flow_reader *reader,
+				  struct pt_flow_block *block);
+
+
+
+/* Call profiles. */
+
+
+
+/** A call-tree profile.
+ *
+ * It attributes instructions to the call stack at which they were executed.
+ */
+struct pt_profile;
+
+/** A node in a call-tree profile.
+ *
+ * Each node represents a function at a unique call stack.
+ */
+struct pt_profile_node {
+	/** The address of the function or zero if it is not known.
+	 *
+	 * This is the target of the call that entered the function.
+	 */
+	uint64_t entry;
+
+	/** The index of the calling node.
+	 *
+	 * The outermost node at index zero is its own parent.
+	 */
+	uint32_t parent;
+
+	/** The number of calls between the outermost node and this node. */
+	uint32_t depth;
+
+	/** The number of instructions executed in the function itself. */
+	uint64_t self;
+
+	/** The number of instructions executed in the function including
+	 * the functions it called.
+	 */
+	uint64_t total;
+};
+
+
+/** Allocate a call-tree profile.
+ *
+ * The profile consists of the outermost node, which represents the function
+ * in which tracing began.
+ *
+ * Returns a new profile on success, NULL otherwise.
+ */
+extern pt_export struct pt_profile *pt_profile_alloc(void);
+
+/** Free a call-tree profile.
+ *
+ * The \@profile must not be used after a successful return.
+ */
+extern pt_export void pt_profile_free(struct pt_profile *profile);
+
+/** Add an instruction.
+ *
+ * Attributes \@insn to the current call stack and updates the call stack
+ * based on \@insn's class and flags.
+ *
+ * This may be used with instructions from pt_insn_next().  The instructions
+ * must be added in execution order.
+ *
+ * Calls push a frame onto the call stack.  Returns pop all frames up to and
+ * including the frame whose return address matches the return target.  If
+ * there is no such frame, they pop the top frame.  A jump out of a function,
+ * like a longjmp(), is corrected at the next return.  Interrupts are treated
+ * like calls.
+ *
+ * When tracing is enabled without resuming, after an overflow, or after a
+ * gap, the call stack is not known and starts again at the outermost node.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@insn is NULL.
+ * Returns -pte_nomem if the profile could not be extended.
+ */
+extern pt_export int pt_profile_add_insn(struct pt_profile *profile,
+					 const struct pt_insn *insn);
+
+/** Get a node.
+ *
+ * On success, provides the node at \@index in \@node.  Nodes are numbered
+ * consecutively starting at zero.  Callers have smaller indices than their
+ * callees.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_eos if \@index is beyond the last node.
+ * Returns -pte_invalid if \@profile or \@node is NULL.
+ */
+extern pt_export int pt_profile_get_node(struct pt_profile *profile,
+					 uint32_t index,
+					 struct pt_profile_node *node);
+
+/** Write the profile as folded stacks.
+ *
+ * Creates \@filename or truncates it if it exists and writes one line per
+ * node that executed instructions itself.  Each line lists the functions on
+ * the node's call stack from the outermost to the innermost separated by
+ * semicolons followed by a space and the node's self count.
+ *
+ * Functions are given by their address in hexadecimal.  The outermost
+ * function is given as [unknown] if its address is not known.
+ *
+ * This is the input format of common flame graph tools.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@filename is NULL.
+ * Returns -pte_invalid if the file could not be written.
+ * Returns -pte_nomem if there is not enough memory.
+ */
+extern pt_export int pt_profile_write_folded(struct pt_profile *profile,
+					     const char *filename);
+
+
+
+/* Block profiles. */
+
+
+
+/** A block profile.
+ *
+ * It counts how often blocks of sequential instructions were executed and
+ * how often control was transferred from one block to another.
+ *
+ * A block begins at the target of a control transfer or where tracing
+ * begins.  It ends with an instruction that may transfer control or at an
+ * interrupt.  Blocks are identified by their address space and their first
+ * instruction's address.  Edges are identified by their address space, the
+ * address of the last instruction of the source block, and the address of
+ * the first instruction of the target block.
+ */
+struct pt_block_profile;
+
+
+/** Allocate a block profile.
+ *
+ * Returns a new, empty block profile on success, NULL otherwise.
+ */
+extern pt_export struct pt_block_profile *pt_block_profile_alloc(void);
+
+/** Free a block profile.
+ *
+ * The \@profile must not be used after a successful return.  It must not be
+ * used by an instruction flow decoder.
+ */
+extern pt_export void pt_block_profile_free(struct pt_block_profile *profile);
+
+/** Merge two block profiles.
+ *
+ * Adds the counts in \@other to \@profile.
+ *
+ * This may be used to combine the profiles of several instruction flow
+ * decoders working in parallel.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@other is NULL.
+ * Returns -pte_nomem if \@profile could not be extended.
+ */
+extern pt_export int
+pt_block_profile_merge(struct pt_block_profile *profile,
+		       const struct pt_block_profile *other);
+
+/** Get the execution count of a block.
+ *
+ * Provides the number of times the block at \@ip in \@asid was executed in
+ * \@count.  If \@asid is NULL, it is the block at \@ip in an unknown address
+ * space.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@count is NULL.
+ */
+extern pt_export int
+pt_block_profile_block(const struct pt_block_profile *profile,
+		       const struct pt_asid *asid, uint64_t ip,
+		       uint64_t *count);
+
+/** Get the execution count of an edge.
+ *
+ * Provides the number of times control went from the block ending at \@from
+ * to the block beginning at \@to in \@asid in \@count.  If \@asid is NULL,
+ * the blocks are in an unknown address space.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@count is NULL.
+ */
+extern pt_export int
+pt_block_profile_edge(const struct pt_block_profile *profile,
+		      const struct pt_asid *asid, uint64_t from, uint64_t to,
+		      uint64_t *count);
+
+/** Write a block profile in CSV format.
+ *
+ * Creates \@filename or truncates it if it exists.
+ *
+ * The first line names the columns: type, cr3, from, to, count.  It is
+ * followed by one line per block and one line per edge.  The type column
+ * holds block or edge, respectively.  Blocks give their address in the from
+ * column and leave the to column empty.  Addresses are hexadecimal.  An
+ * unknown cr3 is left empty.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@profile or \@filename is NULL.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int
+pt_block_profile_write_csv(const struct pt_block_profile *profile,
+			   const char *filename);
+
+/** A sampled block profile.
+ *
+ * It holds the block and edge counts of a sample of PSB segments collected
+ * via pt_insn_sample() and estimates the counts for the entire trace.
+ */
+struct pt_block_sample;
+
+/** Statistics about a sampled block profile. */
+struct pt_sample_stats {
+	/** The number of PSB segments in the trace. */
+	uint64_t segments;
+
+	/** The number of decoded PSB segments. */
+	uint64_t sampled;
+
+	/** The number of decode errors. */
+	uint64_t errors;
+
+	/** The processor time spent decoding in microseconds. */
+	uint64_t time;
+
+	/** The number of times the time budget was exhausted. */
+	uint64_t exhausted;
+};
+
+/** An estimated count. */
+struct pt_estimate {
+	/** The estimated count for the entire trace. */
+	uint64_t count;
+
+	/** The half-width of an approximate 95% confidence interval.
+	 *
+	 * This is UINT64_MAX if fewer than two segments were sampled and the
+	 * sample does not cover the entire trace.
+	 */
+	uint64_t error;
+};
+
+
+/** Allocate a sampled block profile.
+ *
+ * Returns a new, empty sampled block profile on success, NULL otherwise.
+ */
+extern pt_export struct pt_block_sample *pt_block_sample_alloc(void);
+
+/** Free a sampled block profile.
+ *
+ * The \@sample must not be used after a successful return.
+ */
+extern pt_export void pt_block_sample_free(struct pt_block_sample *sample);
+
+/** Merge two sampled block profiles.
+ *
+ * Adds the counts and statistics in \@other to \@sample.
+ *
+ * This may be used to combine samples of different traces or of different
+ * parts of a trace that have been collected in parallel.  The estimates are
+ * only meaningful if both have been sampled using the same stride.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@sample or \@other is NULL.
+ * Returns -pte_nomem if \@sample could not be extended.
+ */
+extern pt_export int pt_block_sample_merge(struct pt_block_sample *sample,
+					   const struct pt_block_sample *other);
+
+/** Estimate the execution count of a block.
+ *
+ * Provides the estimated number of times the block at \@ip in \@asid was
+ * executed in the entire trace in \@estimate.  If \@asid is NULL, it is the
+ * block at \@ip in an unknown address space.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@sample or \@estimate is NULL.
+ */
+extern pt_export int
+pt_block_sample_block(const struct pt_block_sample *sample,
+		      const struct pt_asid *asid, uint64_t ip,
+		      struct pt_estimate *estimate);
+
+/** Estimate the execution count of an edge.
+ *
+ * Provides the estimated number of times control went from the block ending
+ * at \@from to the block beginning at \@to in \@asid in the entire trace
+ * in \@estimate.  If \@asid is NULL, the blocks are in an unknown address
+ * space.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@sample or \@estimate is NULL.
+ */
+extern pt_export int
+pt_block_sample_edge(const struct pt_block_sample *sample,
+		     const struct pt_asid *asid, uint64_t from, uint64_t to,
+		     struct pt_estimate *estimate);
+
+/** Get statistics about a sampled block profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@sample or \@stats is NULL.
+ */
+extern pt_export int
+pt_block_sample_get_stats(const struct pt_block_sample *sample,
+			  struct pt_sample_stats *stats);
+
+/** Write a sampled block profile in CSV format.
+ *
+ * Creates \@filename or truncates it if it exists.
+ *
+ * The format is the same as for pt_block_profile_write_csv() with an
+ * additional error column.  The count and error columns hold the estimates.
+ * An unknown error is left empty.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@sample or \@filename is NULL.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int
+pt_block_sample_write_csv(const struct pt_block_sample *sample,
+			  const char *filename);
+
+
+
+/* Indirect branch target histograms. */
+
+
+
+/** An indirect branch target histogram.
+ *
+ * It counts how often indirect branches, far branches, and asynchronous
+ * events transferred control to a given address.  The targets are
+ * reconstructed from TIP packets alone without decoding instructions or
+ * accessing the traced memory image.
+ *
+ * Depending on the histogram's context, targets are further distinguished
+ * by the address space in which they were reached and by the source address
+ * given in a preceding FUP packet.
+ */
+struct pt_tip_histogram;
+
+/** The context in which branch targets are counted.
+ *
+ * This is a bit-vector.
+ */
+enum pt_tip_context {
+	/** Distinguish targets by the source address of the branch.
+	 *
+	 * The source is only known for asynchronous events that give it in a
+	 * FUP packet preceding the TIP packet.
+	 */
+	pttc_fup	= 1 << 0,
+
+	/** Distinguish targets by the CR3 value given in PIP packets. */
+	pttc_cr3	= 1 << 1
+};
+
+/** The count of an indirect branch target. */
+struct pt_tip_count {
+	/** The CR3 value or pt_asid_no_cr3 if it is not known. */
+	uint64_t cr3;
+
+	/** The source address or zero if it is not known. */
+	uint64_t from;
+
+	/** The target address. */
+	uint64_t to;
+
+	/** The number of branches. */
+	uint64_t count;
+};
+
+/** Statistics about the trace added to a histogram. */
+struct pt_tip_histogram_stats {
+	/** The number of PSB segments. */
+	uint64_t segments;
+
+	/** The number of counted TIP packets. */
+	uint64_t tips;
+
+	/** The number of TIP packets with suppressed IP. */
+	uint64_t suppressed;
+
+	/** The number of decode errors.
+	 *
+	 * The trace is skipped until the next PSB packet on each error.
+	 */
+	uint64_t errors;
+};
+
+
+/** Allocate an indirect branch target histogram.
+ *
+ * Targets are distinguished by \@context, a bit-vector of enum
+ * pt_tip_context.
+ *
+ * Returns a new, empty histogram on success, NULL otherwise.
+ */
+extern pt_export struct pt_tip_histogram *
+pt_tip_histogram_alloc(uint32_t context);
+
+/** Free an indirect branch target histogram.
+ *
+ * The \@hist must not be used after a successful return.
+ */
+extern pt_export void pt_tip_histogram_free(struct pt_tip_histogram *hist);
+
+/** Add the TIP packets in a part of the trace to a histogram.
+ *
+ * Decodes the PSB segments in the trace buffer described by \@config that
+ * begin at or after offset \@begin and before offset \@end.  The last such
+ * segment is decoded to its end even if that lies beyond \@end.
+ *
+ * Each PSB segment is decoded independently.  Adjacent ranges thus partition
+ * the trace.  Several threads may each add a range of the trace to their own
+ * histogram and combine them using pt_tip_histogram_merge().  The result is
+ * the same as adding the entire trace to a single histogram.
+ *
+ * Decode errors do not stop the analysis.  They are counted in the
+ * histogram's statistics.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_bad_config if \@config is not valid.
+ * Returns -pte_invalid if \@hist or \@config is NULL.
+ * Returns -pte_invalid if \@begin lies beyond the end of the trace.
+ * Returns -pte_nomem if \@hist could not be extended.
+ */
+extern pt_export int pt_tip_histogram_decode(struct pt_tip_histogram *hist,
+					     const struct pt_config *config,
+					     uint64_t begin, uint64_t end);
+
+/** Merge two indirect branch target histograms.
+ *
+ * Adds the counts and statistics in \@other to \@hist.  Counts are added
+ * as given independent of \@hist's context.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@hist or \@other is NULL.
+ * Returns -pte_nomem if \@hist could not be extended.
+ */
+extern pt_export int
+pt_tip_histogram_merge(struct pt_tip_histogram *hist,
+		       const struct pt_tip_histogram *other);
+
+/** Get the count of an indirect branch target.
+ *
+ * Provides the number of branches from \@from to \@to in \@asid in
+ * \@count.  If \@asid is NULL, the address space is not known.  The
+ * \@from and \@asid arguments must match the histogram's context; use zero
+ * and NULL, respectively, for a context that is not tracked.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@hist or \@count is NULL.
+ */
+extern pt_export int
+pt_tip_histogram_count(const struct pt_tip_histogram *hist,
+		       const struct pt_asid *asid, uint64_t from, uint64_t to,
+		       uint64_t *count);
+
+/** Get the most frequent indirect branch targets.
+ *
+ * Provides up to \@size targets in \@top ordered by descending count.
+ *
+ * Returns the number of provided targets on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_invalid if \@hist is NULL.
+ * Returns -pte_invalid if \@top is NULL and \@size is not zero.
+ * Returns -pte_nomem if there is not enough memory.
+ */
+extern pt_export int pt_tip_histogram_top(const struct pt_tip_histogram *hist,
+					  struct pt_tip_count *top,
+					  uint32_t size);
+
+/** Get statistics about the trace added to a histogram.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@hist or \@stats is NULL.
+ */
+extern pt_export int
+pt_tip_histogram_get_stats(const struct pt_tip_histogram *hist,
+			   struct pt_tip_histogram_stats *stats);
+
+/** Write an indirect branch target histogram in CSV format.
+ *
+ * Creates \@filename or truncates it if it exists.
+ *
+ * The first line names the columns: cr3, from, to, count.  It is followed
+ * by one line per target.  Addresses are hexadecimal.  An unknown cr3 or
+ * source address is left empty.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@hist or \@filename is NULL.
+ * Returns -pte_invalid if the file could not be written.
+ */
+extern pt_export int
+pt_tip_histogram_write_csv(const struct pt_tip_histogram *hist,
+			   const char *filename);
+
+
+
+/* Multi-processor merge. */
+
+
+
+/** A merge of the instruction flows of several processors.
+ *
+ * It holds one instruction flow decoder per processor trace and provides
+ * the instructions of all traces in the order of their time stamps.
+ * Instructions of the same processor stay in execution order.  Instructions
+ * with the same time are ordered by the order in which their processors
+ * were added.
+ *
+ * Each decoder decodes ahead by a bounded number of instructions into one
+ * of two buffers while the merge reads from the other.  The memory used by
+ * a merge is thus proportional to the number of processors and the
+ * lookahead and does not depend on the size of the traces.
+ */
+struct pt_insn_merge;
+
+/** An instruction in a merged instruction flow. */
+struct pt_merge_insn {
+	/** The time of the instruction - see pt_insn_time().
+	 *
+	 * This is zero if the trace did not provide a time, yet.
+	 */
+	uint64_t tsc;
+
+	/** The processor given to pt_insn_merge_add(). */
+	uint32_t cpu;
+
+	/** The instruction. */
+	struct pt_insn insn;
+};
+
+/** Statistics about a merge. */
+struct pt_merge_stats {
+	/** The number of merged instructions. */
+	uint64_t insns;
+
+	/** The number of buffers decoded. */
+	uint64_t fills;
+
+	/** The number of buffers pt_insn_merge_next() had to decode or to
+	 * wait for because they had not been decoded in advance.
+	 */
+	uint64_t stalls;
+
+	/** The number of decode errors.
+	 *
+	 * After an error, the decoder resumes at the next synchronization
+	 * point.
+	 */
+	uint64_t errors;
+};
+
+/** Allocate a merge.
+ *
+ * Each processor's decoder decodes ahead by at most \@lookahead
+ * instructions.  If \@lookahead is zero, a default is used.
+ *
+ * Returns a new, empty merge on success, NULL otherwise.
+ */
+extern pt_export struct pt_insn_merge *pt_insn_merge_alloc(uint32_t lookahead);
+
+/** Free a merge.
+ *
+ * Also frees the decoders of all processors.  The \@merge must not be used
+ * after a successful return.
+ */
+extern pt_export void pt_insn_merge_free(struct pt_insn_merge *merge);
+
+/** Add a processor trace.
+ *
+ * Allocates an instruction flow decoder for the trace in \@config.  The
+ * decoder uses \@image or its own default image if \@image is NULL.  The
+ * same \@image may be used for all processors.
+ *
+ * Instructions of the trace are marked with \@cpu.
+ *
+ * Processors must be added before the first call to pt_insn_merge_next().
+ *
+ * Returns the index of the processor on success, a negative error code
+ * otherwise.
+ *
+ * Returns -pte_invalid if \@merge or \@config is NULL.
+ * Returns -pte_invalid if merging has already started.
+ * Returns -pte_nomem if the decoder or its buffers could not be allocated.
+ */
+extern pt_export int pt_insn_merge_add(struct pt_insn_merge *merge,
+				       const struct pt_config *config,
+				       struct pt_image *image, uint32_t cpu);
+
+/** Get the decoder of a processor.
+ *
+ * The decoder may be configured before the first call to
+ * pt_insn_merge_next().  It must not be freed or used for decoding.
+ *
+ * Returns the decoder of the processor at \@index on success, NULL
+ * otherwise.
+ */
+extern pt_export struct pt_insn_decoder *
+pt_insn_merge_decoder(struct pt_insn_merge *merge, uint32_t index);
+
+/** Decode ahead for a processor.
+ *
+ * Decodes the next instructions of the processor at \@index into its free
+ * buffer so pt_insn_merge_next() does not need to decode them.
+ *
+ * This function may be called for different processors on different
+ * threads at the same time and while another thread calls
+ * pt_insn_merge_next().  Calls for the same processor must not overlap.
+ * If pt_insn_merge_next() needs the buffer that is being decoded, it waits.
+ * While waiting, it decodes other processors' free buffers or yields.
+ *
+ * Returns the number of decoded instructions on success, a negative error
+ * code otherwise.  Returns zero if the free buffer has already been decoded
+ * or if the trace has ended.
+ *
+ * Returns -pte_invalid if \@merge is NULL or if there is no processor at
+ * \@index.
+ */
+extern pt_export int pt_insn_merge_fill(struct pt_insn_merge *merge,
+					uint32_t index);
+
+/** Determine the next instruction.
+ *
+ * On success, provides the next instruction of all processors in the order
+ * of their time stamps in \@insn.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_eos if all traces have ended.
+ * Returns -pte_invalid if \@merge or \@insn is NULL.
+ */
+extern pt_export int pt_insn_merge_next(struct pt_insn_merge *merge,
+					struct pt_merge_insn *insn);
+
+/** Get statistics about a merge.
+ *
+ * This must not be called while pt_insn_merge_fill() is running.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ *
+ * Returns -pte_invalid if \@merge or \@stats is NULL.
+ */
+extern pt_export int pt_insn_merge_get_stats(const struct pt_insn_merge *merge,
+					     struct pt_merge_stats *stats);
 
 #endif /* __INTEL_PT_H__ */
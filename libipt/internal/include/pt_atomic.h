@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __PT_ATOMIC_H__
+#define __PT_ATOMIC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* Sequentially consistent atomic operations on pointers and on 32-bit
+ * unsigned integers.
+ *
+ * The pointer operations work on any pointer object.  The integer operations
+ * work on uint32_t objects.  Increment and decrement return the new value.
+ * Compare-and-swap stores @value if the object holds @expected and returns
+ * non-zero if it did.
+ */
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define pt_atomic_load_ptr(ptr)						\
+	_InterlockedCompareExchangePointer((void * volatile *) (ptr),	\
+					   NULL, NULL)
+
+#define pt_atomic_store_ptr(ptr, value)					\
+	((void) _InterlockedExchangePointer((void * volatile *) (ptr),	\
+					    (void *) (value)))
+
+#define pt_atomic_cas_ptr(ptr, expected, value)				\
+	(_InterlockedCompareExchangePointer((void * volatile *) (ptr),	\
+					    (void *) (value),		\
+					    (void *) (expected)) ==	\
+	 (void *) (expected))
+
+#define pt_atomic_load32(ptr)						\
+	((uint32_t) _InterlockedCompareExchange((volatile long *) (ptr),	\
+						0, 0))
+
+#define pt_atomic_store32(ptr, value)					\
+	((void) _InterlockedExchange((volatile long *) (ptr),		\
+				     (long) (value)))
+
+#define pt_atomic_cas32(ptr, expected, value)				\
+	((uint32_t) _InterlockedCompareExchange((volatile long *) (ptr),	\
+						(long) (value),		\
+						(long) (expected)) ==	\
+	 (uint32_t) (expected))
+
+#define pt_atomic_inc32(ptr)						\
+	((uint32_t) _InterlockedIncrement((volatile long *) (ptr)))
+
+#define pt_atomic_dec32(ptr)						\
+	((uint32_t) _InterlockedDecrement((volatile long *) (ptr)))
+
+#else /* defined(_MSC_VER) */
+
+#define pt_atomic_load_ptr(ptr)						\
+	__atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+
+#define pt_atomic_store_ptr(ptr, value)					\
+	__atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+
+#define pt_atomic_cas_ptr(ptr, expected, value)				\
+	__extension__ ({						\
+		__typeof__(*(ptr)) __pt_expected = (expected);		\
+									\
+		__atomic_compare_exchange_n((ptr), &__pt_expected,	\
+					    (value), 0,			\
+					    __ATOMIC_SEQ_CST,		\
+					    __ATOMIC_SEQ_CST);		\
+	})
+
+#define pt_atomic_load32(ptr)						\
+	__atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+
+#define pt_atomic_store32(ptr, value)					\
+	__atomic_store_n((ptr), (value), __ATOMIC_SEQ_CST)
+
+#define pt_atomic_cas32(ptr, expected, value)				\
+	__extension__ ({						\
+		uint32_t __pt_expected = (expected);			\
+									\
+		__atomic_compare_exchange_n((ptr), &__pt_expected,	\
+					    (value), 0,			\
+					    __ATOMIC_SEQ_CST,		\
+					    __ATOMIC_SEQ_CST);		\
+	})
+
+#define pt_atomic_inc32(ptr)						\
+	__atomic_add_fetch((ptr), 1, __ATOMIC_SEQ_CST)
+
+#define pt_atomic_dec32(ptr)						\
+	__atomic_sub_fetch((ptr), 1, __ATOMIC_SEQ_CST)
+
+#endif /* defined(_MSC_VER) */
+
+#endif /* __PT_ATOMIC_H__ */
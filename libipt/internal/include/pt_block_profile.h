@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_BLOCK_PROFILE_H__
+#define __PT_BLOCK_PROFILE_H__
+
+#include <stdint.h>
+
+
+/* The execution count of a block. */
+struct pt_block_count {
+	/* The CR3 value of the block's address space. */
+	uint64_t cr3;
+
+	/* The address of the block's first instruction. */
+	uint64_t ip;
+
+	/* The execution count or zero if the entry is empty. */
+	uint64_t count;
+};
+
+/* The execution count of an edge. */
+struct pt_edge_count {
+	/* The CR3 value of the blocks' address space. */
+	uint64_t cr3;
+
+	/* The address of the source block's last instruction. */
+	uint64_t from;
+
+	/* The address of the target block's first instruction. */
+	uint64_t to;
+
+	/* The execution count or zero if the entry is empty. */
+	uint64_t count;
+};
+
+/* A block profile.
+ *
+ * Blocks and edges are kept in separate open addressing hash tables.  Their
+ * sizes are powers of two.  They are kept at most half full.
+ */
+struct pt_block_profile {
+	/* The blocks. */
+	struct pt_block_count *blocks;
+
+	/* The number of blocks and the size of the @blocks table. */
+	uint32_t nblocks;
+	uint32_t blocks_size;
+
+	/* The edges. */
+	struct pt_edge_count *edges;
+
+	/* The number of edges and the size of the @edges table. */
+	uint32_t nedges;
+	uint32_t edges_size;
+};
+
+
+/* Initialize a block profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_nomem if the initial tables could not be allocated.
+ */
+extern int pt_block_profile_init(struct pt_block_profile *profile);
+
+/* Finalize a block profile. */
+extern void pt_block_profile_fini(struct pt_block_profile *profile);
+
+/* Remove all blocks and edges from a block profile.
+ *
+ * The tables keep their size.
+ */
+extern void pt_block_profile_clear(struct pt_block_profile *profile);
+
+/* Add @count executions of the block at @ip in @cr3.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_nomem if @profile could not be extended.
+ */
+extern int pt_block_profile_add_block(struct pt_block_profile *profile,
+				      uint64_t cr3, uint64_t ip,
+				      uint64_t count);
+
+/* Add @count executions of the edge from @from to @to in @cr3.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_nomem if @profile could not be extended.
+ */
+extern int pt_block_profile_add_edge(struct pt_block_profile *profile,
+				     uint64_t cr3, uint64_t from, uint64_t to,
+				     uint64_t count);
+
+#endif /* __PT_BLOCK_PROFILE_H__ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_BLOCK_SAMPLE_H__
+#define __PT_BLOCK_SAMPLE_H__
+
+#include "pt_block_profile.h"
+
+#include "intel-pt.h"
+
+
+/* A sampled block profile.
+ *
+ * For each block and edge, we keep the sum of its per-segment counts and the
+ * sum of their squares.  Together with the number of sampled segments, this
+ * gives the mean and the variance of the per-segment counts.
+ */
+struct pt_block_sample {
+	/* The sum of the per-segment counts. */
+	struct pt_block_profile sum;
+
+	/* The sum of the squares of the per-segment counts. */
+	struct pt_block_profile sumsq;
+
+	/* The counts of the current segment. */
+	struct pt_block_profile segment;
+
+	/* The statistics. */
+	struct pt_sample_stats stats;
+};
+
+
+/* Initialize a sampled block profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @sample is NULL.
+ * Returns -pte_nomem if the initial tables could not be allocated.
+ */
+extern int pt_block_sample_init(struct pt_block_sample *sample);
+
+/* Finalize a sampled block profile. */
+extern void pt_block_sample_fini(struct pt_block_sample *sample);
+
+/* Add the counts of the current segment to @sample.
+ *
+ * Counts the segment as sampled and clears @sample->segment for the next
+ * segment.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @sample is NULL.
+ * Returns -pte_nomem if @sample could not be extended.
+ */
+extern int pt_block_sample_end_segment(struct pt_block_sample *sample);
+
+#endif /* __PT_BLOCK_SAMPLE_H__ */
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __PT_ELF_H__
+#define __PT_ELF_H__
+
+#include <stdint.h>
+
+struct pt_section;
+struct pt_image;
+struct pt_asid;
+
+
+/* The ELF constants we need. */
+enum pt_elf_constants {
+	/* The ELF file classes. */
+	pt_elf_class_32		= 1,
+	pt_elf_class_64		= 2,
+
+	/* The ELF file types. */
+	pt_elf_type_exec	= 2,
+	pt_elf_type_dyn		= 3,
+	pt_elf_type_core	= 4,
+
+	/* The loadable program header type. */
+	pt_elf_pt_load		= 1,
+
+	/* The program header flags. */
+	pt_elf_pf_x		= 1,
+	pt_elf_pf_w		= 2,
+	pt_elf_pf_r		= 4,
+
+	/* The e_phnum value indicating that the real number of program
+	 * headers is stored in the sh_info field of section header zero.
+	 */
+	pt_elf_pn_xnum		= 0xffff
+};
+
+/* The parts of an ELF file header we need. */
+struct pt_elf_header {
+	/* The file offset of the program header table. */
+	uint64_t phoff;
+
+	/* The number of program headers. */
+	uint32_t phnum;
+
+	/* The size of a program header table entry in bytes. */
+	uint16_t phentsize;
+
+	/* The ELF file type. */
+	uint16_t type;
+
+	/* The ELF file class - pt_elf_class_32 or pt_elf_class_64. */
+	uint8_t class;
+};
+
+/* The parts of an ELF program header we need - independent of the class. */
+struct pt_elf_phdr {
+	/* The file offset of the segment. */
+	uint64_t offset;
+
+	/* The virtual address of the segment. */
+	uint64_t vaddr;
+
+	/* The number of bytes of the segment stored in the file. */
+	uint64_t filesz;
+
+	/* The number of bytes of the segment in memory. */
+	uint64_t memsz;
+
+	/* The segment type. */
+	uint32_t type;
+
+	/* The segment flags. */
+	uint32_t flags;
+};
+
+
+/* Read the ELF file header.
+ *
+ * Reads the ELF header of the ELF file in @section into @header.
+ *
+ * Only little-endian ELF32 and ELF64 files are supported.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @header or @section is NULL.
+ * Returns -pte_invalid if @section does not contain a supported ELF file.
+ */
+extern int pt_elf_read_header(struct pt_elf_header *header,
+			      const struct pt_section *section);
+
+/* Read an ELF program header.
+ *
+ * Reads the @index'th program header of the ELF file in @section described by
+ * @header into @phdr.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @phdr, @header, or @section is NULL.
+ * Returns -pte_invalid if @index is out of bounds or the program header
+ * could not be read.
+ */
+extern int pt_elf_read_phdr(struct pt_elf_phdr *phdr,
+			    const struct pt_elf_header *header,
+			    const struct pt_section *section, uint32_t index);
+
+/* Add the loadable segments of an ELF file to an image.
+ *
+ * Adds the file-backed part of each PT_LOAD segment of the ELF file in
+ * @section whose flags contain all of @flags to @image at its virtual address
+ * plus @bias in @asid.
+ *
+ * If @section contains an ELF core file, only segments that were dumped
+ * completely are added.
+ *
+ * All segments share @section; each takes its own reference.  The caller's
+ * reference is not affected.
+ *
+ * The image is not modified if any segment cannot be added.
+ *
+ * Returns the number of added segments on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @image, @section, or @asid is NULL.
+ * Returns -pte_invalid if @section does not contain a supported ELF file.
+ * Returns -pte_bad_image if a segment overlaps with a section in @image.
+ */
+extern int pt_elf_add_segments(struct pt_image *image,
+			       struct pt_section *section,
+			       const struct pt_asid *asid, uint64_t bias,
+			       uint32_t flags);
+
+#endif /* __PT_ELF_H__ */
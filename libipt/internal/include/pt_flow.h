@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_FLOW_H__
+#define __PT_FLOW_H__
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* The size of the flow writer's output buffer. */
+enum {
+	pt_flow_buffer_size	= 0x10000
+};
+
+/* An entry in the index of an execution flow.
+ *
+ * Each entry describes an anchor record.
+ */
+struct pt_flow_index_entry {
+	/* The offset of the anchor record in the file. */
+	uint64_t offset;
+
+	/* The time at the anchor. */
+	uint64_t tsc;
+
+	/* The number of blocks before the anchor. */
+	uint64_t block;
+};
+
+/* The state that is carried from one block record to the next. */
+struct pt_flow_state {
+	/* The current time. */
+	uint64_t tsc;
+
+	/* The end IP of the last block.
+	 *
+	 * The IP of the next block is encoded relative to it.
+	 */
+	uint64_t ip;
+
+	/* The execution mode and the speculative flag. */
+	uint16_t flags;
+};
+
+struct pt_flow_writer {
+	/* The output file. */
+	FILE *file;
+
+	/* The state at the end of the last written block. */
+	struct pt_flow_state state;
+
+	/* The time given in pt_flow_write_time(). */
+	uint64_t tsc;
+
+	/* The current block built by pt_flow_write_insn(). */
+	struct pt_flow_block block;
+
+	/* The IP following the current block's last instruction. */
+	uint64_t next_ip;
+
+	/* The number of written blocks. */
+	uint64_t nblocks;
+
+	/* The number of bytes flushed to @file. */
+	uint64_t offset;
+
+	/* The index. */
+	struct pt_flow_index_entry *index;
+
+	/* The number of index entries and the size of the @index array. */
+	uint32_t nentries;
+	uint32_t capacity;
+
+	/* A collection of flags saying:
+	 *
+	 * - the writer owns @file.
+	 */
+	uint32_t owns_file:1;
+
+	/* - the writer has been finished. */
+	uint32_t finished:1;
+
+	/* The number of bytes in @buffer. */
+	uint32_t size;
+
+	/* The output buffer. */
+	uint8_t buffer[pt_flow_buffer_size];
+};
+
+struct pt_flow_reader {
+	/* The file content. */
+	uint8_t *content;
+
+	/* The beginning and the end of the records. */
+	const uint8_t *begin;
+	const uint8_t *end;
+
+	/* The current position. */
+	const uint8_t *pos;
+
+	/* The state at the current position. */
+	struct pt_flow_state state;
+
+	/* The index. */
+	struct pt_flow_index_entry *index;
+
+	/* The number of index entries. */
+	uint32_t nentries;
+};
+
+
+/* Initialize a flow writer.
+ *
+ * Writes the file header to @file.  The writer does not take ownership of
+ * @file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @writer or @file is NULL.
+ * Returns -pte_invalid if @file could not be written.
+ */
+extern int pt_flow_writer_init(struct pt_flow_writer *writer, FILE *file);
+
+/* Finalize a flow writer. */
+extern void pt_flow_writer_fini(struct pt_flow_writer *writer);
+
+/* Initialize a flow reader.
+ *
+ * Parses the @size bytes at @content.  On success, the reader takes
+ * ownership of @content, which must have been allocated with malloc().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @reader or @content is NULL.
+ * Returns -pte_invalid if @content does not contain a valid flow.
+ * Returns -pte_nomem if the index could not be allocated.
+ */
+extern int pt_flow_reader_init(struct pt_flow_reader *reader,
+			       uint8_t *content, size_t size);
+
+/* Finalize a flow reader. */
+extern void pt_flow_reader_fini(struct pt_flow_reader *reader);
+
+#endif /* __PT_FLOW_H__ */
@@ -30,31 +30,194 @@
 #define __PT_IMAGE_H__
 
 #include "pt_mapped_section.h"
+#include "pt_read_cache.h"
 
 #include "intel-pt.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 
-/* A list of sections. */
+/* A list of sections.
+ *
+ * List elements are shared between maps that were copied from one another.
+ * A shared list element must not be modified.  It is copied, instead, when
+ * one of its users wants to modify it.
+ */
 struct pt_section_list {
 	/* The next list element. */
 	struct pt_section_list *next;
 
 	/* The mapped section. */
 	struct pt_mapped_section section;
+
+	/* The number of users - partitions or preceding list elements.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t ucount;
+};
+
+/* A partition of an image's sections holding the sections of one CR3 value. */
+struct pt_image_partition {
+	/* The CR3 value - pt_asid_no_cr3 for an unused hash table slot. */
+	uint64_t cr3;
+
+	/* The list of sections - we hold a reference.
+	 *
+	 * The list is NULL if all sections have been removed.  The slot
+	 * remains in use until the hash table is rebuilt.
+	 */
+	struct pt_section_list *sections;
+};
+
+/* The sections of an image partitioned by CR3 value.
+ *
+ * Reads and modifications for one address space need not look at sections
+ * of other address spaces.  Sections without a CR3 value match every address
+ * space.  They are kept in a separate partition.
+ *
+ * A map is shared between images that were copied from one another and with
+ * versions and snapshots.  A shared map must not be modified.  It is copied,
+ * instead, when one of its users wants to modify it.  The copy shares the
+ * lists of sections.
+ */
+struct pt_image_map {
+	/* A hash table of partitions with @mask + 1 slots followed by the
+	 * partition of sections without a CR3 value.
+	 */
+	struct pt_image_partition *partitions;
+	uint32_t mask;
+
+	/* The number of used hash table slots. */
+	uint32_t nused;
+
+	/* The number of sections in all partitions. */
+	uint32_t nsections;
+
+	/* The number of users - images, versions, or snapshots.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t ucount;
+};
+
+/* A version of an image's sections. */
+struct pt_image_version {
+	/* The time stamp count at which this version became valid. */
+	uint64_t tsc;
+
+	/* The sections - we hold a reference.
+	 *
+	 * The map may be shared with other versions.
+	 */
+	struct pt_image_map *map;
+
+	/* The last section in @map that satisfied a read request.
+	 *
+	 * This is accessed atomically.
+	 */
+	const struct pt_mapped_section *cache;
+};
+
+/* An immutable snapshot of an image's sections.
+ *
+ * Readers access an image's sections only via its current snapshot.  Writers
+ * modify the image and then publish a new snapshot.  The old snapshot is
+ * retired and freed once no reader can be using it anymore.
+ */
+struct pt_image_snapshot {
+	/* The sections - we hold a reference. */
+	struct pt_image_map *map;
+
+	/* The time stamp count at which @map became valid. */
+	uint64_t tsc;
+
+	/* The older versions - shared with the image and other snapshots. */
+	struct pt_image_version *versions;
+
+	/* The number of older versions. */
+	uint32_t nversions;
+
+	/* The epoch in which this snapshot was retired. */
+	uint32_t epoch;
+
+	/* The last section in @map that satisfied a read request.
+	 *
+	 * This is accessed atomically.
+	 */
+	const struct pt_mapped_section *cache;
+
+	/* An array of versions to be freed together with this snapshot. */
+	struct pt_image_version *garbage;
+
+	/* The next retired snapshot. */
+	struct pt_image_snapshot *next;
 };
 
-/* A traced image consisting of a collection of sections. */
+/* A traced image consisting of a collection of sections.
+ *
+ * Modifications must be serialized.  They may run concurrently with reads,
+ * which only use @snapshot.
+ */
 struct pt_image {
 	/* The optional image name. */
 	char *name;
 
-	/* The list of sections. */
-	struct pt_section_list *sections;
+	/* The sections - NULL for an empty image.
+	 *
+	 * The map may be shared with copies of this image and with older
+	 * versions of this image.
+	 */
+	struct pt_image_map *map;
 
-	/* The last section that satisfied a read request. */
-	const struct pt_mapped_section *cache;
+	/* The time stamp count at which @map became valid. */
+	uint64_t tsc;
+
+	/* The older versions of this image sorted by ascending time.
+	 *
+	 * Each version is valid until the next version or, for the last
+	 * version, until @tsc.
+	 */
+	struct pt_image_version *versions;
+
+	/* The number of older versions and the size of the @versions array. */
+	uint32_t nversions;
+	uint32_t capacity;
+
+	/* The snapshot of the above used by readers.
+	 *
+	 * This is accessed atomically.  It is NULL for an empty image.
+	 */
+	struct pt_image_snapshot *snapshot;
+
+	/* Snapshots that have been replaced but may still be in use. */
+	struct pt_image_snapshot *retired;
+
+	/* A replaced array of versions that is still used by @snapshot. */
+	struct pt_image_version *garbage;
+
+	/* The current epoch.
+	 *
+	 * Readers announce themselves in @readers for the parity of the epoch
+	 * they entered in.  This is accessed atomically.
+	 */
+	uint32_t epoch;
+
+	/* The number of readers per epoch parity.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t readers[2];
+
+	/* The generation of the traced memory.
+	 *
+	 * It is incremented whenever sections are published or memory is
+	 * invalidated so that users can detect stale information.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t generation;
 
 	/* An optional read memory callback. */
 	struct {
@@ -63,6 +226,9 @@ struct pt_image {
 
 		/* The callback context. */
 		void *context;
+
+		/* An optional cache for memory read via @callback. */
+		struct pt_read_cache cache;
 	} readmem;
 };
 
@@ -75,11 +241,26 @@ extern void pt_image_init(struct pt_image *image, const char *name);
  */
 extern void pt_image_fini(struct pt_image *image);
 
+/* Initialize @image as a copy of @src with an optional @name.
+ *
+ * The copy shares @src's sections until either image is modified.
+ *
+ * The copy uses the same read memory callback and the same read cache
+ * configuration as @src but starts with an empty read cache.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @image or @src is NULL.
+ * Returns -pte_nomem if the read cache could not be allocated.
+ */
+extern int pt_image_init_copy(struct pt_image *image,
+			      const struct pt_image *src, const char *name);
+
 /* Add a section to an image.
  *
  * Add @section to @image at @vaddr in @asid if @section fits without overlap.
  *
- * Successfully added sections will be freed when they are removed.
+ * On success, @image takes over the caller's reference to @section.  The
+ * reference is put when the section is removed.
  *
  * Returns zero on success.
  * Returns -pte_internal if @image, @section, or @asid is NULL.
@@ -88,9 +269,69 @@ extern void pt_image_fini(struct pt_image *image);
 extern int pt_image_add(struct pt_image *image, struct pt_section *section,
 			const struct pt_asid *asid, uint64_t vaddr);
 
+/* Add part of a section to an image.
+ *
+ * Add @size bytes of @section starting at @offset to @image at @vaddr in @asid
+ * if they fit without overlap.
+ *
+ * Several parts of the same section may be added, each with its own reference
+ * to @section.
+ *
+ * On success, @image takes over the caller's reference to @section.  The
+ * reference is put when the section is removed.
+ *
+ * Returns zero on success.
+ * Returns -pte_internal if @image, @section, or @asid is NULL.
+ * Returns -pte_internal if @offset and @size are not contained in @section.
+ * Returns -pte_bad_image if the range overlaps with a section in @image.
+ */
+extern int pt_image_add_range(struct pt_image *image,
+			      struct pt_section *section,
+			      const struct pt_asid *asid, uint64_t vaddr,
+			      uint64_t offset, uint64_t size);
+
+/* A part of a section to be added to an image. */
+struct pt_image_range {
+	/* The section. */
+	struct pt_section *section;
+
+	/* The virtual address at which the part is loaded. */
+	uint64_t vaddr;
+
+	/* The offset and size of the part in @section. */
+	uint64_t offset;
+	uint64_t size;
+};
+
+/* Add parts of sections to an image in one batch.
+ *
+ * Add the @nranges parts of sections described by @ranges to @image in @asid
+ * if they fit without overlap.
+ *
+ * This sorts @ranges by virtual address and checks for overlaps in a single
+ * pass instead of once for each part.
+ *
+ * Several parts of the same section may be added, each with its own reference
+ * to the section.
+ *
+ * On success, @image takes over the caller's reference to each part's section.
+ * On errors, @image is not modified.
+ *
+ * Returns zero on success.
+ * Returns -pte_internal if @image or @asid is NULL.
+ * Returns -pte_internal if a part is not contained in its section.
+ * Returns -pte_bad_image if the parts overlap with each other or with a section
+ * in @image.
+ * Returns -pte_nomem if the parts could not be allocated.
+ */
+extern int pt_image_add_ranges(struct pt_image *image,
+			       struct pt_image_range *ranges, size_t nranges,
+			       const struct pt_asid *asid);
+
 /* Remove a section from an image.
  *
- * Removes and frees @section mapped at @vaddr in @asid from @image.
+ * Removes @section mapped at @vaddr in @asid from @image and puts @image's
+ * reference to @section.
  *
  * Returns zero on success.
  * Returns -pte_internal if @image, @section, or @asid is NULL.
@@ -99,9 +340,21 @@ extern int pt_image_add(struct pt_image *image, struct pt_section *section,
 extern int pt_image_remove(struct pt_image *image, struct pt_section *section,
 			   const struct pt_asid *asid, uint64_t vaddr);
 
+/* Get the generation of an image's memory.
+ *
+ * Provides the current generation of @image in @generation.  It changes
+ * whenever the memory read from @image may change.
+ *
+ * Returns a positive integer if @image has older versions so that reads
+ * depend on the time, zero if they do not, a negative error code otherwise.
+ * Returns -pte_internal if @image or @generation is NULL.
+ */
+extern int pt_image_generation(struct pt_image *image, uint32_t *generation);
+
 /* Read memory from an image.
  *
- * Reads at most @size bytes from @image at @addr in @asid into @buffer.
+ * Reads at most @size bytes from the latest version of @image at @addr in
+ * @asid into @buffer.
  *
  * Returns the number of bytes read on success, a negative error code otherwise.
  * Returns -pte_internal if @image, @buffer, or @asid is NULL.
@@ -111,4 +364,41 @@ extern int pt_image_read(struct pt_image *image, uint8_t *buffer,
 			 uint16_t size, const struct pt_asid *asid,
 			 uint64_t addr);
 
+/* Read memory from an image at a given time.
+ *
+ * Reads at most @size bytes from the version of @image that was valid at @tsc
+ * at @addr in @asid into @buffer.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_internal if @image, @buffer, or @asid is NULL.
+ * Returns -pte_nomap if the section does not contain @addr.
+ */
+extern int pt_image_read_at(struct pt_image *image, uint8_t *buffer,
+			    uint16_t size, const struct pt_asid *asid,
+			    uint64_t addr, uint64_t tsc);
+
+/* Access memory of an image in place at a given time.
+ *
+ * Provides a pointer to the memory of the version of @image that was valid at
+ * @tsc at @addr in @asid in @begin.  At most @size bytes may be accessed.
+ *
+ * This requires the memory of the section containing @addr to be mapped.  It
+ * does not use the read memory callback.  The memory remains valid until the
+ * section is removed from @image and from all its copies and versions.
+ *
+ * If @buffer is not NULL, memory that can not be accessed in place is read
+ * into @buffer as with pt_image_read_at() instead and @buffer is provided in
+ * @begin.  This saves a second lookup.
+ *
+ * Returns the number of accessible bytes on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @image, @begin, or @asid is NULL.
+ * Returns -pte_nomap if no section contains @addr or if its memory is not
+ * mapped and @buffer is NULL.
+ */
+extern int pt_image_peek_at(struct pt_image *image, const uint8_t **begin,
+			    uint8_t *buffer, uint16_t size,
+			    const struct pt_asid *asid, uint64_t addr,
+			    uint64_t tsc);
+
 #endif /* __PT_IMAGE_H__ */
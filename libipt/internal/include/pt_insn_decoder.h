@@ -34,9 +34,57 @@
 #include "pt_retstack.h"
 #include "pti-ild.h"
 
+struct pt_block_profile;
+struct pt_segment_cache;
+
 #include <inttypes.h>
 
 
+/* A block in the block cache used in coverage and breakpoint mode.
+ *
+ * It holds the information about the block's last instruction that is
+ * needed to determine the next IP.
+ */
+struct pt_insn_cov_block {
+	/* The IP of the block's first instruction. */
+	uint64_t ip;
+
+	/* The CR3 value of the block's address space. */
+	uint64_t cr3;
+
+	/* The IP of the block's last instruction. */
+	uint64_t end;
+
+	/* The direct branch target of the block's last instruction. */
+	uint64_t target;
+
+	/* The branch flags of the block's last instruction - see pti_ild_t. */
+	uint32_t flags;
+
+	/* The number of instructions in the block. */
+	uint32_t ninsn;
+
+	/* The size of the block's last instruction. */
+	uint8_t size;
+
+	/* The execution mode or ptem_unknown if the entry is unused. */
+	uint8_t mode;
+
+	/* The class of the block's last instruction. */
+	uint8_t iclass;
+};
+
+/* The number of entries in the block cache. */
+enum {
+	pt_insn_cov_cache_size	= 0x1000
+};
+
+/* Compute the coverage bitmap location of the block at @ip. */
+static inline uint32_t pt_insn_cov_loc(uint64_t ip)
+{
+	return (uint32_t) ((ip * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
 struct pt_insn_decoder {
 	/* The Intel(R) Processor Trace query decoder. */
 	struct pt_query_decoder query;
@@ -59,6 +107,12 @@ struct pt_insn_decoder {
 	/* The Intel(R) Processor Trace instruction (length) decoder. */
 	pti_ild_t ild;
 
+	/* How instruction bytes are provided. */
+	enum pt_insn_bytes_mode bytes_mode;
+
+	/* The instruction bytes if they are not provided. */
+	uint8_t raw[pt_max_insn_size];
+
 	/* The current IP. */
 	uint64_t ip;
 
@@ -72,9 +126,58 @@ struct pt_insn_decoder {
 	/* The current execution mode. */
 	enum pt_exec_mode mode;
 
+	/* The instruction length decoder and the decoder's machine mode for
+	 * @mode or PTI_MODE_LAST if @mode is unknown.
+	 *
+	 * They are selected whenever @mode changes.
+	 */
+	pti_bool_t (*length_decode)(pti_ild_t *ild);
+	pti_machine_mode_enum_t ild_mode;
+
 	/* The status of the last decoder query. */
 	int status;
 
+	/* The IP and the time of the last instruction in resilient mode. */
+	uint64_t last_ip;
+	uint64_t last_tsc;
+
+	/* The last gap in resilient mode. */
+	struct pt_insn_gap gap;
+
+	/* The gap statistics in resilient mode. */
+	struct pt_insn_gap_stats gap_stats;
+
+	/* The block profile or NULL if we're not profiling. */
+	struct pt_block_profile *block_profile;
+
+	/* The CR3 value of the last decoded instruction. */
+	uint64_t insn_cr3;
+
+	/* The address of the last instruction of the previous block. */
+	uint64_t block_from;
+
+	/* The block cache or NULL if it is not allocated.
+	 *
+	 * It has pt_insn_cov_cache_size entries.
+	 */
+	struct pt_insn_cov_block *cov_cache;
+
+	/* The generation of @image the blocks in @cov_cache were decoded for. */
+	uint32_t cov_generation;
+
+	/* The sorted breakpoint addresses and their number. */
+	uint64_t *breakpoints;
+	uint32_t nbreakpoints;
+
+	/* The instruction filter - see enum pt_insn_filter. */
+	uint32_t filter;
+
+	/* The number of instructions skipped by @filter. */
+	uint64_t filtered;
+
+	/* The PSB segment cache used in sampling or NULL. */
+	struct pt_segment_cache *segment_cache;
+
 	/* A collection of flags defining how to proceed flow reconstruction:
 	 *
 	 * - tracing is enabled.
@@ -89,6 +192,27 @@ struct pt_insn_decoder {
 
 	/* - instructions are executed speculatively. */
 	uint32_t speculative:1;
+
+	/* - errors are skipped by resynchronizing. */
+	uint32_t resilient:1;
+
+	/* - we skipped trace and have not decoded an instruction since. */
+	uint32_t in_gap:1;
+
+	/* - @last_tsc is valid. */
+	uint32_t have_last_tsc:1;
+
+	/* - the next instruction begins a new block. */
+	uint32_t block_begin:1;
+
+	/* - @block_from is valid. */
+	uint32_t have_block_from:1;
+
+	/* - @cov_generation is valid. */
+	uint32_t cov_bound:1;
+
+	/* - reads from @image depend on the time so we may not use @cov_cache. */
+	uint32_t cov_versioned:1;
 };
 
 
@@ -104,4 +228,7 @@ extern int pt_insn_decoder_init(struct pt_insn_decoder *decoder,
 /* Finalize an instruction flow decoder. */
 extern void pt_insn_decoder_fini(struct pt_insn_decoder *decoder);
 
+/* Return the flags and the execution mode of @insn - see enum pt_insn_flags. */
+extern uint16_t pt_insn_flags(const struct pt_insn *insn);
+
 #endif /* __PT_INSN_DECODER_H__ */
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_INSN_MERGE_H__
+#define __PT_INSN_MERGE_H__
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* The state of a processor's free buffer. */
+enum pt_merge_state {
+	/* The buffer is empty. */
+	pt_merge_empty,
+
+	/* The buffer is being decoded. */
+	pt_merge_busy,
+
+	/* The buffer has been decoded. */
+	pt_merge_full
+};
+
+/* A processor in a merge. */
+struct pt_merge_cpu {
+	/* The decoder. */
+	struct pt_insn_decoder *decoder;
+
+	/* The two buffers of the merge's lookahead instructions each. */
+	struct pt_merge_insn *buffer[2];
+
+	/* The index of the buffer the merge is reading from. */
+	uint32_t front;
+
+	/* The number of instructions in the front buffer and the index of
+	 * the next one.
+	 */
+	uint32_t nfront;
+	uint32_t pos;
+
+	/* The number of instructions in the other buffer. */
+	uint32_t nback;
+
+	/* The state of the other buffer - see enum pt_merge_state.
+	 *
+	 * It hands the buffer over between pt_insn_merge_fill() and
+	 * pt_insn_merge_next().  The remaining fields are owned by the side
+	 * that owns the buffer.
+	 */
+	uint32_t state;
+
+	/* The time of the last decoded instruction. */
+	uint64_t tsc;
+
+	/* The processor given by the user. */
+	uint32_t cpu;
+
+	/* A collection of flags saying whether:
+	 *
+	 * - the decoder is synchronized.
+	 */
+	uint32_t synced:1;
+
+	/* - the trace has ended. */
+	uint32_t done:1;
+
+	/* The number of decoded buffers and decode errors. */
+	uint64_t fills;
+	uint64_t errors;
+};
+
+/* A merge.
+ *
+ * The processors whose next instruction is known are kept in a binary
+ * min-heap ordered by the time of that instruction and by their index.
+ */
+struct pt_insn_merge {
+	/* The processors, their number, and the size of @cpus. */
+	struct pt_merge_cpu *cpus;
+	uint32_t ncpus;
+	uint32_t size;
+
+	/* The heap of indices into @cpus and its number of elements. */
+	uint32_t *heap;
+	uint32_t nheap;
+
+	/* The maximal number of instructions in a buffer. */
+	uint32_t lookahead;
+
+	/* A flag saying whether merging has started. */
+	uint32_t started:1;
+
+	/* The number of merged instructions and of stalls. */
+	uint64_t insns;
+	uint64_t stalls;
+};
+
+
+/* Initialize a merge with @lookahead instructions per buffer.
+ *
+ * A default is used if @lookahead is zero.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @merge is NULL.
+ */
+extern int pt_insn_merge_init(struct pt_insn_merge *merge,
+			      uint32_t lookahead);
+
+/* Finalize a merge. */
+extern void pt_insn_merge_fini(struct pt_insn_merge *merge);
+
+#endif /* __PT_INSN_MERGE_H__ */
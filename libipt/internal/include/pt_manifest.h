@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_MANIFEST_H__
+#define __PT_MANIFEST_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct pt_section;
+
+
+/* A file recorded in an image manifest. */
+struct pt_manifest_file {
+	/* The name of the file. */
+	char *name;
+
+	/* The size and modification time of the file when it was recorded.
+	 *
+	 * Both are zero if they are not known.
+	 */
+	uint64_t size;
+	uint64_t mtime;
+};
+
+/* A section recorded in an image manifest. */
+struct pt_manifest_section {
+	/* The index of the section's file in the manifest's file table. */
+	uint32_t file;
+
+	/* The offset and size of the section in its file. */
+	uint64_t offset;
+	uint64_t size;
+
+	/* The virtual address at which the section is loaded. */
+	uint64_t vaddr;
+
+	/* The CR3 and VMCS Base values of the section's address space. */
+	uint64_t cr3;
+	uint64_t vmcs;
+
+	/* The hash of the section's content. */
+	uint64_t hash;
+};
+
+/* An image manifest.
+ *
+ * It describes the sections of an image and the files they were loaded from
+ * so the image can be reconstructed later.
+ */
+struct pt_manifest {
+	/* The file table. */
+	struct pt_manifest_file *files;
+
+	/* The number of files and the size of the @files array. */
+	uint32_t nfiles;
+	uint32_t fcapacity;
+
+	/* The sections. */
+	struct pt_manifest_section *sections;
+
+	/* The number of sections and the size of the @sections array. */
+	uint32_t nsections;
+	uint32_t scapacity;
+};
+
+
+/* Initialize an empty manifest. */
+extern void pt_manifest_init(struct pt_manifest *manifest);
+
+/* Finalize a manifest. */
+extern void pt_manifest_fini(struct pt_manifest *manifest);
+
+/* Add a file to a manifest.
+ *
+ * Adds @filename to @manifest's file table unless it is already contained.
+ * Records the current size and modification time of @filename, if they can be
+ * determined.
+ *
+ * Returns the index of @filename in the file table on success, a negative
+ * error code otherwise.
+ * Returns -pte_internal if @manifest or @filename is NULL.
+ * Returns -pte_nomem if the file table could not be enlarged.
+ */
+extern int pt_manifest_add_file(struct pt_manifest *manifest,
+				const char *filename);
+
+/* Add a section to a manifest.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @manifest or @section is NULL.
+ * Returns -pte_internal if @section refers to an unknown file.
+ * Returns -pte_nomem if the section table could not be enlarged.
+ */
+extern int pt_manifest_add_section(struct pt_manifest *manifest,
+				   const struct pt_manifest_section *section);
+
+/* Write a manifest.
+ *
+ * Writes @manifest to @file in a compact little-endian binary format.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @manifest or @file is NULL.
+ * Returns -pte_invalid if @manifest could not be written.
+ */
+extern int pt_manifest_write(const struct pt_manifest *manifest, FILE *file);
+
+/* Read a manifest.
+ *
+ * Reads a manifest written by pt_manifest_write() from @file into @manifest,
+ * which must be empty.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @manifest or @file is NULL.
+ * Returns -pte_invalid if @file does not contain a valid manifest.
+ * Returns -pte_nomem if the manifest could not be allocated.
+ */
+extern int pt_manifest_read(struct pt_manifest *manifest, FILE *file);
+
+/* Check whether a file is unchanged.
+ *
+ * Compares the current size and modification time of @file's name against
+ * the ones recorded in @file.
+ *
+ * Returns a positive number if they are known and match, zero otherwise.
+ */
+extern int pt_manifest_file_unchanged(const struct pt_manifest_file *file);
+
+/* Compute the hash of a section's content.
+ *
+ * Computes the hash of @size bytes starting at @offset in @section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @hash or @section is NULL.
+ * Returns -pte_nomap if @section does not contain the requested bytes.
+ */
+extern int pt_manifest_hash(uint64_t *hash, const struct pt_section *section,
+			    uint64_t offset, uint64_t size);
+
+#endif /* __PT_MANIFEST_H__ */
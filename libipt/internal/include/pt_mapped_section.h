@@ -46,13 +46,26 @@ struct pt_mapped_section {
 
 	/* The virtual address at which the section is mapped. */
 	uint64_t vaddr;
+
+	/* The offset into @section at which the mapping begins.
+	 *
+	 * This allows several mapped sections to share a single underlying
+	 * section, e.g. the loadable segments of an ELF file.
+	 */
+	uint64_t offset;
+
+	/* The size of the mapping in bytes. */
+	uint64_t size;
 };
 
 
-/* Initialize a mapped section - @section may be NULL. */
+/* Initialize a mapped section - @section may be NULL.
+ *
+ * Maps @size bytes of @section starting at @offset at @vaddr in @asid.
+ */
 extern void pt_msec_init(struct pt_mapped_section *msec,
 			 struct pt_section *section, const struct pt_asid *asid,
-			 uint64_t vaddr);
+			 uint64_t vaddr, uint64_t offset, uint64_t size);
 
 /* Destroy a mapped section - does not free @msec->section. */
 extern void pt_msec_fini(struct pt_mapped_section *msec);
@@ -90,4 +103,20 @@ extern int pt_msec_read(const struct pt_mapped_section *msec, uint8_t *buffer,
 			uint16_t size, const struct pt_asid *asid,
 			uint64_t addr);
 
+/* Access memory of a mapped section in place.
+ *
+ * Provides a pointer to the memory of @msec at @addr in @asid in @begin.  At
+ * most @size bytes may be accessed.
+ *
+ * Returns the number of accessible bytes on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal, if @msec or @asid are NULL.
+ * Returns -pte_invalid, if @begin is NULL.
+ * Returns -pte_nomap, if the mapped section does not contain @addr in @asid.
+ * Returns -pte_nomap, if the section's memory is not mapped.
+ */
+extern int pt_msec_peek(const struct pt_mapped_section *msec,
+			const uint8_t **begin, uint16_t size,
+			const struct pt_asid *asid, uint64_t addr);
+
 #endif /* __PT_MAPPED_SECTION_H__ */
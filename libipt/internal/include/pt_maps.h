@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_MAPS_H__
+#define __PT_MAPS_H__
+
+#include <stdint.h>
+
+struct pt_image;
+struct pt_asid;
+
+
+/* The permissions of a memory mapping. */
+enum pt_maps_perm {
+	pt_maps_read	= 1 << 0,
+	pt_maps_write	= 1 << 1,
+	pt_maps_exec	= 1 << 2
+};
+
+/* A memory mapping described by a line of a maps file. */
+struct pt_maps_entry {
+	/* The mapped virtual address range [@begin; @end[. */
+	uint64_t begin, end;
+
+	/* The offset of the mapping in @filename. */
+	uint64_t offset;
+
+	/* The name of the mapped file or pseudo-file.
+	 *
+	 * This points into the parsed line.  It is NULL for anonymous
+	 * mappings.
+	 */
+	const char *filename;
+
+	/* The permissions - a bit-vector of enum pt_maps_perm. */
+	uint32_t perms;
+};
+
+
+/* Parse a line of a maps file.
+ *
+ * Parses @line in the format of /proc/<pid>/maps into @entry:
+ *
+ *   begin-end perms offset major:minor inode [filename]
+ *
+ * Trailing whitespace is removed from @line.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @entry or @line is NULL.
+ * Returns -pte_invalid if @line is malformed.
+ */
+extern int pt_maps_parse_line(struct pt_maps_entry *entry, char *line);
+
+/* Add the executable file mappings of a maps file to an image.
+ *
+ * Parses @text, the contents of a maps file, and adds each executable mapping
+ * of a file to @image in @asid.  Mappings are truncated to the size of the
+ * mapped file.
+ *
+ * Pseudo-files like [vdso], files that cannot be opened, and mappings that lie
+ * beyond the end of their file are skipped.
+ *
+ * Each file is opened only once and shared by all its mappings.  All mappings
+ * are added in one batch.
+ *
+ * The @text is modified.  The image is not modified if any mapping cannot be
+ * added.
+ *
+ * Returns the number of added mappings on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @image, @text, or @asid is NULL.
+ * Returns -pte_invalid if @text is malformed.
+ * Returns -pte_bad_image if mappings overlap with each other or with a section
+ * in @image.
+ */
+extern int pt_maps_add(struct pt_image *image, char *text,
+		       const struct pt_asid *asid);
+
+#endif /* __PT_MAPS_H__ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_PROFILE_H__
+#define __PT_PROFILE_H__
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* A node in the call tree. */
+struct pt_profile_tree_node {
+	/* The address of the function or zero if it is not known. */
+	uint64_t entry;
+
+	/* The number of instructions executed in the function itself. */
+	uint64_t self;
+
+	/* The number of instructions including callees.
+	 *
+	 * This is only valid if the profile's totals are valid.
+	 */
+	uint64_t total;
+
+	/* The index of the calling node. */
+	uint32_t parent;
+
+	/* The number of calls from the outermost node. */
+	uint32_t depth;
+};
+
+/* A frame on the shadow call stack. */
+struct pt_profile_frame {
+	/* The return address or zero if it is not known. */
+	uint64_t ret;
+
+	/* The index of the function's node. */
+	uint32_t node;
+};
+
+/* How the call stack changes at the next instruction. */
+enum pt_profile_pending {
+	ppp_none,
+	ppp_call,
+	ppp_return
+};
+
+struct pt_profile {
+	/* The call tree nodes in the order in which they were created. */
+	struct pt_profile_tree_node *nodes;
+
+	/* The number of nodes and the size of the @nodes array. */
+	uint32_t nnodes;
+	uint32_t nodes_capacity;
+
+	/* A hash table mapping a caller's node index and a callee's address
+	 * to the callee's node index.
+	 *
+	 * Each slot holds a node index plus one or zero if it is empty.
+	 */
+	uint32_t *table;
+
+	/* The number of slots in @table - a power of two. */
+	uint32_t table_size;
+
+	/* The shadow call stack.
+	 *
+	 * The bottom frame represents the outermost node.
+	 */
+	struct pt_profile_frame *stack;
+
+	/* The number of frames and the size of the @stack array. */
+	uint32_t nframes;
+	uint32_t stack_capacity;
+
+	/* The change to the call stack at the next instruction. */
+	enum pt_profile_pending pending;
+
+	/* The return address of a pending call. */
+	uint64_t pending_ret;
+
+	/* A collection of flags saying:
+	 *
+	 * - the total counts of @nodes are valid.
+	 */
+	uint32_t have_totals:1;
+};
+
+
+/* Initialize a call-tree profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_nomem if the initial nodes or frames could not be allocated.
+ */
+extern int pt_profile_init(struct pt_profile *profile);
+
+/* Finalize a call-tree profile. */
+extern void pt_profile_fini(struct pt_profile *profile);
+
+#endif /* __PT_PROFILE_H__ */
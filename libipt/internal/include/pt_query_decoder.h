@@ -68,6 +68,18 @@ struct pt_query_decoder {
 	/* The current event. */
 	struct pt_event *event;
 
+	/* The sorted address space filter or NULL if there is no filter. */
+	uint64_t *cr3_filter;
+
+	/* The number of cr3 values in @cr3_filter. */
+	uint32_t ncr3_filter;
+
+	/* The current cr3 or pt_asid_no_cr3 if it is not known. */
+	uint64_t cr3;
+
+	/* Statistics about trace skipped by the address space filter. */
+	struct pt_skip_stats skip_stats;
+
 	/* A collection of flags relevant for decoding:
 	 *
 	 * - tracing is enabled.
@@ -76,6 +88,12 @@ struct pt_query_decoder {
 
 	/* - consume the current packet. */
 	uint32_t consume_packet:1;
+
+	/* - enable tracing at the next TIP or PSBEND after skipping trace. */
+	uint32_t resume:1;
+
+	/* - the current PSB+ ends skipped trace. */
+	uint32_t resume_psb:1;
 };
 
 /* Initialize the query decoder.
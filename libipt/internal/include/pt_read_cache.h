@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_READ_CACHE_H__
+#define __PT_READ_CACHE_H__
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* A cached window of memory read via the read memory callback. */
+struct pt_read_cache_entry {
+	/* The CR3 and VMCS Base values of the address space the memory was
+	 * read from.
+	 */
+	uint64_t cr3;
+	uint64_t vmcs;
+
+	/* The virtual address of the beginning of the window. */
+	uint64_t vaddr;
+
+	/* The number of valid bytes at the beginning of the window.
+	 *
+	 * This is zero if the callback failed to read the window.
+	 */
+	uint32_t size;
+
+	/* A flag saying whether this entry is in use. */
+	uint32_t valid:1;
+};
+
+/* A cache of memory read via the read memory callback.
+ *
+ * Instead of reading the requested bytes, the cache reads aligned windows of
+ * @page_size bytes and keeps up to @nentries of them.
+ *
+ * The cache is direct-mapped.  A new window replaces the window that has
+ * previously been stored in the same slot.
+ */
+struct pt_read_cache {
+	/* The cache entries. */
+	struct pt_read_cache_entry *entries;
+
+	/* The cached memory - @page_size bytes per entry. */
+	uint8_t *data;
+
+	/* The size of a window in bytes - a power of two.
+	 *
+	 * The cache is disabled if this is zero.
+	 */
+	uint32_t page_size;
+
+	/* The number of entries. */
+	uint32_t nentries;
+};
+
+
+/* Initialize a disabled read cache. */
+extern void pt_read_cache_init(struct pt_read_cache *cache);
+
+/* Finalize a read cache. */
+extern void pt_read_cache_fini(struct pt_read_cache *cache);
+
+/* Configure a read cache.
+ *
+ * Discards all cached memory and reconfigures @cache to hold up to @nentries
+ * windows of @page_size bytes.  If @page_size or @nentries is zero, the cache
+ * is disabled.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @cache is NULL.
+ * Returns -pte_invalid if @page_size is not a power of two.
+ * Returns -pte_invalid if @page_size is smaller than pt_max_insn_size.
+ * Returns -pte_nomem if the cache could not be allocated.
+ */
+extern int pt_read_cache_configure(struct pt_read_cache *cache,
+				   uint32_t page_size, uint32_t nentries);
+
+/* Check whether a read cache is enabled.
+ *
+ * Returns a positive number if @cache is enabled, zero otherwise.
+ */
+extern int pt_read_cache_enabled(const struct pt_read_cache *cache);
+
+/* Read memory through a read cache.
+ *
+ * Reads at most @size bytes at @addr in @asid into @buffer.  Memory that is
+ * not cached is read in aligned windows via @callback with @context.
+ *
+ * If @callback fails to provide the window containing @addr, @callback is
+ * used to read @size bytes at @addr directly.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_internal if @cache, @buffer, @asid, or @callback is NULL.
+ */
+extern int pt_read_cache_read(struct pt_read_cache *cache, uint8_t *buffer,
+			      uint16_t size, const struct pt_asid *asid,
+			      uint64_t addr, read_memory_callback_t *callback,
+			      void *context);
+
+/* Invalidate cached memory.
+ *
+ * Discards all windows in @cache that overlap with @size bytes at @addr in
+ * @asid.  If @asid does not specify a CR3 or a VMCS Base value, discards
+ * windows in all address spaces that match the values it does specify.
+ *
+ * Returns the number of discarded windows on success, a negative error code
+ * otherwise.
+ * Returns -pte_internal if @cache or @asid is NULL.
+ */
+extern int pt_read_cache_invalidate(struct pt_read_cache *cache,
+				    const struct pt_asid *asid, uint64_t addr,
+				    uint64_t size);
+
+#endif /* __PT_READ_CACHE_H__ */
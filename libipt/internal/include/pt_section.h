@@ -29,10 +29,12 @@
 #ifndef __PT_SECTION_H__
 #define __PT_SECTION_H__
 
+#include "intel-pt.h"
+
 #include <stdint.h>
 
 
-/* A section of contiguous memory loaded from a file. */
+/* A section of contiguous memory loaded from a file or provided in a buffer. */
 struct pt_section;
 
 /* Create a section.
@@ -45,20 +47,90 @@ struct pt_section;
  *
  * If @offset lies beyond the end of @file, no section is created.
  *
+ * The returned section has a user count of one.
+ *
  * Returns a new section on success, NULL otherwise.
  */
 extern struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 					uint64_t size);
 
+/* Create a section from a memory buffer.
+ *
+ * The returned section describes @size bytes of memory starting at @buffer.
+ * The memory is not copied.  It must remain valid until the section is
+ * freed.
+ *
+ * The section has no filename.  It is of generation @generation.
+ *
+ * The returned section has a user count of one.
+ *
+ * Returns a new section on success, NULL otherwise.
+ */
+extern struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					       uint64_t size,
+					       uint32_t generation);
+
 /* Free a section.
  *
- * The @section must have been allocated by pt_mk_section() or be NULL.
+ * The @section must have been allocated by pt_mk_section() or
+ * pt_mk_section_buffer() or be NULL.
+ *
+ * This ignores the user count.  Use pt_section_put() for shared sections.
  */
 extern void pt_section_free(struct pt_section *section);
 
-/* Return the filename of @section. */
+/* Add another user.
+ *
+ * Increments the user count of @section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_internal if the user count would overflow.
+ */
+extern int pt_section_get(struct pt_section *section);
+
+/* Remove a user.
+ *
+ * Decrements the user count of @section.  Frees @section when the last user
+ * is removed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_internal if the user count is already zero.
+ */
+extern int pt_section_put(struct pt_section *section);
+
+/* Set the release callback of a buffer section.
+ *
+ * When @section is freed, @release is called with the section's buffer and
+ * size and with @context.  If @release is NULL, nothing is called.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_internal if @section was not created from a buffer.
+ */
+extern int pt_section_set_release(struct pt_section *section,
+				  release_memory_callback_t *release,
+				  void *context);
+
+/* Return the filename of @section.
+ *
+ * Returns NULL for sections created from a buffer.
+ */
 extern const char *pt_section_filename(const struct pt_section *section);
 
+/* Return the generation of @section.
+ *
+ * Returns zero for sections created from a file.
+ */
+extern uint32_t pt_section_generation(const struct pt_section *section);
+
+/* Return the offset of the section in its file.
+ *
+ * Returns zero for sections created from a buffer.
+ */
+extern uint64_t pt_section_offset(const struct pt_section *section);
+
 /* Return the size of the section in bytes. */
 extern uint64_t pt_section_size(const struct pt_section *section);
 
@@ -66,6 +138,9 @@ extern uint64_t pt_section_size(const struct pt_section *section);
  *
  * Reads at most @size bytes from @section at @offset into @buffer.
  *
+ * This may be called on different threads for the same section at the same
+ * time.
+ *
  * Returns the number of bytes read on success, a negative error code otherwise.
  * Returns -pte_invalid, if @section or @buffer are NULL.
  * Returns -pte_nomap, if @offset is beyond the end of the section.
@@ -73,4 +148,22 @@ extern uint64_t pt_section_size(const struct pt_section *section);
 extern int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 			   uint16_t size, uint64_t offset);
 
+/* Access memory of a section in place.
+ *
+ * Provides a pointer to the memory of @section at @offset in @begin.  At most
+ * @size bytes may be accessed.  The memory remains valid until @section is
+ * freed.
+ *
+ * This requires @section's memory to be mapped.
+ *
+ * Returns the number of accessible bytes on success, a negative error code
+ * otherwise.
+ * Returns -pte_invalid, if @section or @begin are NULL.
+ * Returns -pte_nomap, if @offset is beyond the end of the section.
+ * Returns -pte_nomap, if @section's memory is not mapped.
+ */
+extern int pt_section_peek(const struct pt_section *section,
+			   const uint8_t **begin, uint16_t size,
+			   uint64_t offset);
+
 #endif /* __PT_SECTION_H__ */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_SEGMENT_CACHE_H__
+#define __PT_SEGMENT_CACHE_H__
+
+#include "pt_block_profile.h"
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* The key of a cached segment.
+ *
+ * It consists of two independent hashes of the segment's packets and the
+ * size of the hashed packets.
+ */
+struct pt_segment_key {
+	/* The hashes. */
+	uint64_t hash[2];
+
+	/* The number of hashed bytes - zero for an unused entry. */
+	uint64_t size;
+};
+
+/* A cached segment. */
+struct pt_segment_entry {
+	/* The key. */
+	struct pt_segment_key key;
+
+	/* The segment's blocks and their number. */
+	struct pt_block_count *blocks;
+	uint32_t nblocks;
+
+	/* The segment's edges and their number. */
+	struct pt_edge_count *edges;
+	uint32_t nedges;
+
+	/* The number of decode errors in the segment. */
+	uint32_t errors;
+};
+
+/* A PSB segment cache.
+ *
+ * Segments are kept in an open addressing hash table.  Its size is a power
+ * of two.  It is kept at most half full.
+ */
+struct pt_segment_cache {
+	/* The cached segments. */
+	struct pt_segment_entry *table;
+
+	/* The size of the @table. */
+	uint32_t size;
+
+	/* The maximal memory use in bytes. */
+	uint64_t limit;
+
+	/* The traced image and its generation the segments were decoded
+	 * with.
+	 */
+	const void *image;
+	uint32_t generation;
+
+	/* A hash of the decoder configuration the segments were decoded
+	 * with.
+	 */
+	uint64_t context;
+
+	/* The statistics. */
+	struct pt_segment_cache_stats stats;
+};
+
+
+/* Initialize a segment cache using at most @limit bytes.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @cache is NULL.
+ * Returns -pte_nomem if the initial table could not be allocated or if it
+ * does not fit into @limit.
+ */
+extern int pt_segment_cache_init(struct pt_segment_cache *cache,
+				 uint64_t limit);
+
+/* Finalize a segment cache. */
+extern void pt_segment_cache_fini(struct pt_segment_cache *cache);
+
+/* Prepare @cache for decoding with @image of @generation and a decoder
+ * configuration hashed into @context.
+ *
+ * Clears @cache if any of them changed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @cache is NULL.
+ */
+extern int pt_segment_cache_bind(struct pt_segment_cache *cache,
+				 const void *image, uint32_t generation,
+				 uint64_t context);
+
+/* Compute the key of the segment from @begin to @end in @config.
+ *
+ * Timing packets are ignored.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @key or @config is NULL.
+ * Returns -pte_bad_opc or -pte_bad_packet if a packet could not be decoded.
+ */
+extern int pt_segment_key(struct pt_segment_key *key,
+			  const struct pt_config *config,
+			  const uint8_t *begin, const uint8_t *end);
+
+/* Look up the segment with @key in @cache.
+ *
+ * Returns the segment if it is found, NULL otherwise.
+ */
+extern const struct pt_segment_entry *
+pt_segment_cache_lookup(struct pt_segment_cache *cache,
+			const struct pt_segment_key *key);
+
+/* Add the segment with @key with the counts in @profile and @errors decode
+ * errors to @cache.
+ *
+ * Clears @cache first if the segment would exceed its memory limit.  The
+ * segment is not added if it alone exceeds the limit.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @cache, @key, or @profile is NULL.
+ * Returns -pte_nomem if the segment could not be allocated.
+ */
+extern int pt_segment_cache_add(struct pt_segment_cache *cache,
+				const struct pt_segment_key *key,
+				const struct pt_block_profile *profile,
+				uint32_t errors);
+
+#endif /* __PT_SEGMENT_CACHE_H__ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PT_TIP_HISTOGRAM_H__
+#define __PT_TIP_HISTOGRAM_H__
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+
+
+/* An indirect branch target histogram.
+ *
+ * The counts are kept in an open addressing hash table.  Its size is a power
+ * of two.  It is kept at most half full.
+ */
+struct pt_tip_histogram {
+	/* The counts. */
+	struct pt_tip_count *table;
+
+	/* The number of counts and the size of the @table. */
+	uint32_t ncounts;
+	uint32_t size;
+
+	/* The context in which targets are counted as a bit-vector of
+	 * enum pt_tip_context.
+	 */
+	uint32_t context;
+
+	/* Statistics about the decoded trace. */
+	struct pt_tip_histogram_stats stats;
+};
+
+
+/* Initialize a histogram counting targets in @context.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @hist is NULL.
+ * Returns -pte_nomem if the initial table could not be allocated.
+ */
+extern int pt_tip_histogram_init(struct pt_tip_histogram *hist,
+				 uint32_t context);
+
+/* Finalize a histogram. */
+extern void pt_tip_histogram_fini(struct pt_tip_histogram *hist);
+
+/* Add @count branches from @from to @to in @cr3.
+ *
+ * The @from and @cr3 arguments are stored as given independent of the
+ * histogram's context.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @hist is NULL.
+ * Returns -pte_nomem if @hist could not be extended.
+ */
+extern int pt_tip_histogram_add(struct pt_tip_histogram *hist, uint64_t cr3,
+				uint64_t from, uint64_t to, uint64_t count);
+
+#endif /* __PT_TIP_HISTOGRAM_H__ */
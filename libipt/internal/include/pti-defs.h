@@ -71,6 +71,7 @@
 
 #if defined(__GNUC__)
 #define PTI_INLINE static inline
+#define PTI_FORCEINLINE static inline __attribute__ ((always_inline))
 #define PTI_NORETURN __attribute__ ((noreturn))
 #if __GNUC__ == 2
 #define PTI_NOINLINE
@@ -79,6 +80,7 @@
 #endif
 #else
 #define PTI_INLINE static __inline
+#define PTI_FORCEINLINE static __forceinline
 #if defined(PTI_MSVC6)
 #define PTI_NOINLINE
 #else
@@ -212,6 +212,9 @@ void pti_ild_init (void);
    instruction.) */
 pti_bool_t pti_instruction_length_decode (pti_ild_t * ild);
 
+/* same as above for 64-bit code. ignores and sets ild->mode. */
+pti_bool_t pti_instruction_length_decode_64 (pti_ild_t * ild);
+
 /* returns 1 if an interesting instruction was encountered. */
 pti_bool_t pti_instruction_decode (pti_ild_t * ild);
 
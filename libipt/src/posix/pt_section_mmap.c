@@ -27,6 +27,7 @@
  */
 
 #include "pt_section.h"
+#include "pt_atomic.h"
 
 #include "intel-pt.h"
 
@@ -40,19 +41,35 @@
 #include <unistd.h>
 
 
-/* A section based on mmap. */
+/* A section based on mmap or on a memory buffer. */
 struct pt_section {
-	/* The name of the file this was mapped from. */
+	/* The name of the file this was mapped from - NULL for buffers. */
 	char *filename;
 
-	/* The mmap base address. */
+	/* The mmap base address - NULL for buffers. */
 	uint8_t *base;
 
 	/* The mapped memory size. */
 	size_t size;
 
-	/* The begin and end of the mapped memory. */
+	/* The begin and end of the mapped memory or of the buffer. */
 	const uint8_t *begin, *end;
+
+	/* The offset of @begin in the file - zero for buffers. */
+	uint64_t offset;
+
+	/* The generation of a buffer - zero for files. */
+	uint32_t generation;
+
+	/* An optional function for releasing a buffer and its context. */
+	release_memory_callback_t *release;
+	void *context;
+
+	/* The number of current users.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t ucount;
 };
 
 static char *dupstr(const char *str)
@@ -76,7 +93,7 @@ struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 {
 	struct pt_section *section;
 	struct stat stat;
-	uint64_t fsize, adjustment;
+	uint64_t fsize, adjustment, moffset;
 	uint8_t *base;
 	int fd, errcode;
 
@@ -106,6 +123,7 @@ struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 
 	/* Mmap does not like unaligned offsets. */
 	adjustment = offset % PAGE_SIZE;
+	moffset = offset;
 
 	/* Adjust size and offset accordingly. */
 	size += adjustment;
@@ -126,6 +144,11 @@ struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 	section->size = size;
 	section->begin = base + adjustment;
 	section->end = base + size;
+	section->offset = moffset;
+	section->generation = 0;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
 
 out:
 	close(fd);
@@ -133,16 +156,101 @@ out:
 	return section;
 }
 
+struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					uint64_t size, uint32_t generation)
+{
+	struct pt_section *section;
+	const uint8_t *end;
+
+	if (!buffer || !size)
+		return NULL;
+
+	if ((uint64_t) (size_t) size != size)
+		return NULL;
+
+	end = buffer + (size_t) size;
+	if (end < buffer)
+		return NULL;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	section->filename = NULL;
+	section->base = NULL;
+	section->size = 0;
+	section->begin = buffer;
+	section->end = end;
+	section->offset = 0ull;
+	section->generation = generation;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
+
+	return section;
+}
+
 void pt_section_free(struct pt_section *section)
 {
 	if (!section)
 		return;
 
-	munmap(section->base, section->size);
+	if (section->base)
+		munmap(section->base, section->size);
+
+	if (section->release)
+		section->release(section->begin,
+				 (uint64_t) (section->end - section->begin),
+				 section->context);
+
 	free(section->filename);
 	free(section);
 }
 
+int pt_section_get(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	if (!pt_atomic_inc32(&section->ucount)) {
+		(void) pt_atomic_dec32(&section->ucount);
+		return -pte_internal;
+	}
+
+	return 0;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	uint32_t ucount;
+
+	if (!section)
+		return -pte_internal;
+
+	ucount = pt_atomic_dec32(&section->ucount);
+	if (ucount == UINT32_MAX) {
+		(void) pt_atomic_inc32(&section->ucount);
+		return -pte_internal;
+	}
+
+	if (!ucount)
+		pt_section_free(section);
+
+	return 0;
+}
+
+int pt_section_set_release(struct pt_section *section,
+			   release_memory_callback_t *release, void *context)
+{
+	if (!section || section->base)
+		return -pte_internal;
+
+	section->release = release;
+	section->context = context;
+
+	return 0;
+}
+
 const char *pt_section_filename(const struct pt_section *section)
 {
 	if (!section)
@@ -151,6 +259,22 @@ const char *pt_section_filename(const struct pt_section *section)
 	return section->filename;
 }
 
+uint32_t pt_section_generation(const struct pt_section *section)
+{
+	if (!section)
+		return 0;
+
+	return section->generation;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->offset;
+}
+
 uint64_t pt_section_size(const struct pt_section *section)
 {
 	if (!section)
@@ -185,3 +309,30 @@ int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 	memcpy(buffer, begin, size);
 	return (int) size;
 }
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **pbegin,
+		    uint16_t size, uint64_t offset)
+{
+	const uint8_t *begin, *end;
+
+	if (!pbegin || !section)
+		return -pte_invalid;
+
+	begin = section->begin + offset;
+	end = begin + size;
+
+	if (end < begin)
+		return -pte_nomap;
+
+	if (section->end <= begin)
+		return -pte_nomap;
+
+	if (begin < section->begin)
+		return -pte_nomap;
+
+	if (section->end < end)
+		size -= (end - section->end);
+
+	*pbegin = begin;
+	return (int) size;
+}
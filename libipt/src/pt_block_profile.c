@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_block_profile.h"
+#include "pt_asid.h"
+
+#include "intel-pt.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The initial sizes of a block profile's tables. */
+enum {
+	pt_block_profile_initial_blocks	= 0x100,
+	pt_block_profile_initial_edges	= 0x100
+};
+
+int pt_block_profile_init(struct pt_block_profile *profile)
+{
+	if (!profile)
+		return -pte_internal;
+
+	memset(profile, 0, sizeof(*profile));
+
+	profile->blocks = calloc(pt_block_profile_initial_blocks,
+				 sizeof(*profile->blocks));
+	profile->edges = calloc(pt_block_profile_initial_edges,
+				sizeof(*profile->edges));
+
+	if (!profile->blocks || !profile->edges) {
+		pt_block_profile_fini(profile);
+		return -pte_nomem;
+	}
+
+	profile->blocks_size = pt_block_profile_initial_blocks;
+	profile->edges_size = pt_block_profile_initial_edges;
+
+	return 0;
+}
+
+void pt_block_profile_fini(struct pt_block_profile *profile)
+{
+	if (!profile)
+		return;
+
+	free(profile->blocks);
+	free(profile->edges);
+}
+
+void pt_block_profile_clear(struct pt_block_profile *profile)
+{
+	if (!profile)
+		return;
+
+	memset(profile->blocks, 0,
+	       (size_t) profile->blocks_size * sizeof(*profile->blocks));
+	memset(profile->edges, 0,
+	       (size_t) profile->edges_size * sizeof(*profile->edges));
+
+	profile->nblocks = 0;
+	profile->nedges = 0;
+}
+
+struct pt_block_profile *pt_block_profile_alloc(void)
+{
+	struct pt_block_profile *profile;
+	int errcode;
+
+	profile = malloc(sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	errcode = pt_block_profile_init(profile);
+	if (errcode < 0) {
+		free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+void pt_block_profile_free(struct pt_block_profile *profile)
+{
+	pt_block_profile_fini(profile);
+	free(profile);
+}
+
+/* Compute the first slot to search for @key in a table of @size entries. */
+static uint32_t pt_block_profile_hash(uint64_t key, uint32_t size)
+{
+	key *= 0x9e3779b97f4a7c15ull;
+
+	return (uint32_t) (key >> 32) & (size - 1);
+}
+
+/* Combine @cr3 and @ip into a block's hash key. */
+static uint64_t pt_block_key(uint64_t cr3, uint64_t ip)
+{
+	return ip ^ (cr3 << 20) ^ (cr3 >> 44);
+}
+
+/* Combine @cr3, @from, and @to into an edge's hash key. */
+static uint64_t pt_edge_key(uint64_t cr3, uint64_t from, uint64_t to)
+{
+	return pt_block_key(cr3, to) ^ (from << 32) ^ (from >> 32);
+}
+
+/* Find the slot for the block at @ip in @cr3 in @blocks of size @size.
+ *
+ * This is either the block's slot or the empty slot at which to insert it.
+ * The table must have an empty slot.
+ */
+static struct pt_block_count *pt_block_find(struct pt_block_count *blocks,
+					    uint32_t size, uint64_t cr3,
+					    uint64_t ip)
+{
+	uint32_t slot, mask;
+
+	mask = size - 1;
+	slot = pt_block_profile_hash(pt_block_key(cr3, ip), size);
+	for (;; slot = (slot + 1) & mask) {
+		struct pt_block_count *block;
+
+		block = &blocks[slot];
+		if (!block->count)
+			return block;
+
+		if (block->ip == ip && block->cr3 == cr3)
+			return block;
+	}
+}
+
+/* Find the slot for the edge from @from to @to in @cr3 in @edges of size
+ * @size.
+ *
+ * This is either the edge's slot or the empty slot at which to insert it.
+ * The table must have an empty slot.
+ */
+static struct pt_edge_count *pt_edge_find(struct pt_edge_count *edges,
+					  uint32_t size, uint64_t cr3,
+					  uint64_t from, uint64_t to)
+{
+	uint32_t slot, mask;
+
+	mask = size - 1;
+	slot = pt_block_profile_hash(pt_edge_key(cr3, from, to), size);
+	for (;; slot = (slot + 1) & mask) {
+		struct pt_edge_count *edge;
+
+		edge = &edges[slot];
+		if (!edge->count)
+			return edge;
+
+		if (edge->to == to && edge->from == from && edge->cr3 == cr3)
+			return edge;
+	}
+}
+
+/* Double the size of @profile's block table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_block_profile_grow_blocks(struct pt_block_profile *profile)
+{
+	struct pt_block_count *blocks;
+	uint32_t size, slot;
+
+	size = profile->blocks_size;
+	if ((UINT32_MAX >> 1) < size)
+		return -pte_nomem;
+
+	blocks = calloc((size_t) size << 1, sizeof(*blocks));
+	if (!blocks)
+		return -pte_nomem;
+
+	for (slot = 0; slot < size; ++slot) {
+		const struct pt_block_count *block;
+
+		block = &profile->blocks[slot];
+		if (!block->count)
+			continue;
+
+		*pt_block_find(blocks, size << 1, block->cr3, block->ip) =
+			*block;
+	}
+
+	free(profile->blocks);
+	profile->blocks = blocks;
+	profile->blocks_size = size << 1;
+
+	return 0;
+}
+
+/* Double the size of @profile's edge table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_block_profile_grow_edges(struct pt_block_profile *profile)
+{
+	struct pt_edge_count *edges;
+	uint32_t size, slot;
+
+	size = profile->edges_size;
+	if ((UINT32_MAX >> 1) < size)
+		return -pte_nomem;
+
+	edges = calloc((size_t) size << 1, sizeof(*edges));
+	if (!edges)
+		return -pte_nomem;
+
+	for (slot = 0; slot < size; ++slot) {
+		const struct pt_edge_count *edge;
+
+		edge = &profile->edges[slot];
+		if (!edge->count)
+			continue;
+
+		*pt_edge_find(edges, size << 1, edge->cr3, edge->from,
+			      edge->to) = *edge;
+	}
+
+	free(profile->edges);
+	profile->edges = edges;
+	profile->edges_size = size << 1;
+
+	return 0;
+}
+
+int pt_block_profile_add_block(struct pt_block_profile *profile,
+			       uint64_t cr3, uint64_t ip, uint64_t count)
+{
+	struct pt_block_count *block;
+
+	if (!profile)
+		return -pte_internal;
+
+	/* A zero count would mark the slot empty. */
+	if (!count)
+		return 0;
+
+	block = pt_block_find(profile->blocks, profile->blocks_size, cr3, ip);
+	if (block->count) {
+		block->count += count;
+		return 0;
+	}
+
+	/* We keep the table at most half full. */
+	if ((profile->blocks_size >> 1) <= profile->nblocks) {
+		int errcode;
+
+		errcode = pt_block_profile_grow_blocks(profile);
+		if (errcode < 0)
+			return errcode;
+
+		block = pt_block_find(profile->blocks, profile->blocks_size,
+				      cr3, ip);
+	}
+
+	block->cr3 = cr3;
+	block->ip = ip;
+	block->count = count;
+
+	profile->nblocks += 1;
+
+	return 0;
+}
+
+int pt_block_profile_add_edge(struct pt_block_profile *profile,
+			      uint64_t cr3, uint64_t from, uint64_t to,
+			      uint64_t count)
+{
+	struct pt_edge_count *edge;
+
+	if (!profile)
+		return -pte_internal;
+
+	/* A zero count would mark the slot empty. */
+	if (!count)
+		return 0;
+
+	edge = pt_edge_find(profile->edges, profile->edges_size, cr3, from, to);
+	if (edge->count) {
+		edge->count += count;
+		return 0;
+	}
+
+	/* We keep the table at most half full. */
+	if ((profile->edges_size >> 1) <= profile->nedges) {
+		int errcode;
+
+		errcode = pt_block_profile_grow_edges(profile);
+		if (errcode < 0)
+			return errcode;
+
+		edge = pt_edge_find(profile->edges, profile->edges_size, cr3,
+				    from, to);
+	}
+
+	edge->cr3 = cr3;
+	edge->from = from;
+	edge->to = to;
+	edge->count = count;
+
+	profile->nedges += 1;
+
+	return 0;
+}
+
+int pt_block_profile_merge(struct pt_block_profile *profile,
+			   const struct pt_block_profile *other)
+{
+	uint32_t slot;
+
+	if (!profile || !other)
+		return -pte_invalid;
+
+	for (slot = 0; slot < other->blocks_size; ++slot) {
+		const struct pt_block_count *block;
+		int errcode;
+
+		block = &other->blocks[slot];
+		if (!block->count)
+			continue;
+
+		errcode = pt_block_profile_add_block(profile, block->cr3,
+						     block->ip, block->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	for (slot = 0; slot < other->edges_size; ++slot) {
+		const struct pt_edge_count *edge;
+		int errcode;
+
+		edge = &other->edges[slot];
+		if (!edge->count)
+			continue;
+
+		errcode = pt_block_profile_add_edge(profile, edge->cr3,
+						    edge->from, edge->to,
+						    edge->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+/* Provide the CR3 value of the user-provided @uasid in @cr3.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_block_profile_cr3(uint64_t *cr3, const struct pt_asid *uasid)
+{
+	struct pt_asid asid;
+	int errcode;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	*cr3 = asid.cr3;
+
+	return 0;
+}
+
+int pt_block_profile_block(const struct pt_block_profile *profile,
+			   const struct pt_asid *asid, uint64_t ip,
+			   uint64_t *count)
+{
+	const struct pt_block_count *block;
+	uint64_t cr3;
+	int errcode;
+
+	if (!profile || !count)
+		return -pte_invalid;
+
+	errcode = pt_block_profile_cr3(&cr3, asid);
+	if (errcode < 0)
+		return errcode;
+
+	block = pt_block_find(profile->blocks, profile->blocks_size, cr3, ip);
+	*count = block->count;
+
+	return 0;
+}
+
+int pt_block_profile_edge(const struct pt_block_profile *profile,
+			  const struct pt_asid *asid, uint64_t from,
+			  uint64_t to, uint64_t *count)
+{
+	const struct pt_edge_count *edge;
+	uint64_t cr3;
+	int errcode;
+
+	if (!profile || !count)
+		return -pte_invalid;
+
+	errcode = pt_block_profile_cr3(&cr3, asid);
+	if (errcode < 0)
+		return errcode;
+
+	edge = pt_edge_find(profile->edges, profile->edges_size, cr3, from,
+			    to);
+	*count = edge->count;
+
+	return 0;
+}
+
+/* Write @cr3 followed by a comma to @file.  An unknown @cr3 is omitted. */
+static void pt_block_profile_write_cr3(FILE *file, uint64_t cr3)
+{
+	if (cr3 != pt_asid_no_cr3)
+		fprintf(file, "0x%" PRIx64, cr3);
+
+	fputc(',', file);
+}
+
+int pt_block_profile_write_csv(const struct pt_block_profile *profile,
+			       const char *filename)
+{
+	uint32_t slot;
+	FILE *file;
+	int errcode;
+
+	if (!profile || !filename)
+		return -pte_invalid;
+
+	file = fopen(filename, "w");
+	if (!file)
+		return -pte_invalid;
+
+	fputs("type,cr3,from,to,count\n", file);
+
+	for (slot = 0; slot < profile->blocks_size; ++slot) {
+		const struct pt_block_count *block;
+
+		block = &profile->blocks[slot];
+		if (!block->count)
+			continue;
+
+		fputs("block,", file);
+		pt_block_profile_write_cr3(file, block->cr3);
+		fprintf(file, "0x%" PRIx64 ",,%" PRIu64 "\n", block->ip,
+			block->count);
+	}
+
+	for (slot = 0; slot < profile->edges_size; ++slot) {
+		const struct pt_edge_count *edge;
+
+		edge = &profile->edges[slot];
+		if (!edge->count)
+			continue;
+
+		fputs("edge,", file);
+		pt_block_profile_write_cr3(file, edge->cr3);
+		fprintf(file, "0x%" PRIx64 ",0x%" PRIx64 ",%" PRIu64 "\n",
+			edge->from, edge->to, edge->count);
+	}
+
+	errcode = ferror(file) ? -pte_invalid : 0;
+	if (fclose(file))
+		errcode = -pte_invalid;
+
+	return errcode;
+}
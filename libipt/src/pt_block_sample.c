@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_block_sample.h"
+
+#include "intel-pt.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+int pt_block_sample_init(struct pt_block_sample *sample)
+{
+	int errcode;
+
+	if (!sample)
+		return -pte_internal;
+
+	memset(sample, 0, sizeof(*sample));
+
+	errcode = pt_block_profile_init(&sample->sum);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_block_profile_init(&sample->sumsq);
+	if (errcode < 0)
+		goto out_sum;
+
+	errcode = pt_block_profile_init(&sample->segment);
+	if (errcode < 0)
+		goto out_sumsq;
+
+	return 0;
+
+out_sumsq:
+	pt_block_profile_fini(&sample->sumsq);
+
+out_sum:
+	pt_block_profile_fini(&sample->sum);
+	return errcode;
+}
+
+void pt_block_sample_fini(struct pt_block_sample *sample)
+{
+	if (!sample)
+		return;
+
+	pt_block_profile_fini(&sample->sum);
+	pt_block_profile_fini(&sample->sumsq);
+	pt_block_profile_fini(&sample->segment);
+}
+
+struct pt_block_sample *pt_block_sample_alloc(void)
+{
+	struct pt_block_sample *sample;
+	int errcode;
+
+	sample = malloc(sizeof(*sample));
+	if (!sample)
+		return NULL;
+
+	errcode = pt_block_sample_init(sample);
+	if (errcode < 0) {
+		free(sample);
+		return NULL;
+	}
+
+	return sample;
+}
+
+void pt_block_sample_free(struct pt_block_sample *sample)
+{
+	pt_block_sample_fini(sample);
+	free(sample);
+}
+
+int pt_block_sample_end_segment(struct pt_block_sample *sample)
+{
+	const struct pt_block_profile *segment;
+	uint32_t slot;
+
+	if (!sample)
+		return -pte_internal;
+
+	segment = &sample->segment;
+
+	for (slot = 0; slot < segment->blocks_size; ++slot) {
+		const struct pt_block_count *block;
+		int errcode;
+
+		block = &segment->blocks[slot];
+		if (!block->count)
+			continue;
+
+		errcode = pt_block_profile_add_block(&sample->sum, block->cr3,
+						     block->ip, block->count);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_block_profile_add_block(&sample->sumsq,
+						     block->cr3, block->ip,
+						     block->count *
+						     block->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	for (slot = 0; slot < segment->edges_size; ++slot) {
+		const struct pt_edge_count *edge;
+		int errcode;
+
+		edge = &segment->edges[slot];
+		if (!edge->count)
+			continue;
+
+		errcode = pt_block_profile_add_edge(&sample->sum, edge->cr3,
+						    edge->from, edge->to,
+						    edge->count);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_block_profile_add_edge(&sample->sumsq, edge->cr3,
+						    edge->from, edge->to,
+						    edge->count *
+						    edge->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	pt_block_profile_clear(&sample->segment);
+	sample->stats.sampled += 1;
+
+	return 0;
+}
+
+int pt_block_sample_merge(struct pt_block_sample *sample,
+			  const struct pt_block_sample *other)
+{
+	int errcode;
+
+	if (!sample || !other)
+		return -pte_invalid;
+
+	errcode = pt_block_profile_merge(&sample->sum, &other->sum);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_block_profile_merge(&sample->sumsq, &other->sumsq);
+	if (errcode < 0)
+		return errcode;
+
+	sample->stats.segments += other->stats.segments;
+	sample->stats.sampled += other->stats.sampled;
+	sample->stats.errors += other->stats.errors;
+	sample->stats.time += other->stats.time;
+	sample->stats.exhausted += other->stats.exhausted;
+
+	return 0;
+}
+
+/* Compute the square root of a non-negative @value.
+ *
+ * We use Newton's method to avoid depending on the math library.
+ */
+static double pt_sample_sqrt(double value)
+{
+	double root, last;
+
+	if (!(0.0 < value))
+		return 0.0;
+
+	/* Starting above the root, the iteration decreases monotonically
+	 * until it converges.
+	 */
+	root = (1.0 < value) ? value : 1.0;
+	do {
+		last = root;
+		root = (root + value / root) / 2.0;
+	} while (root < last);
+
+	return last;
+}
+
+/* Convert a non-negative @value to an unsigned integer.
+ *
+ * Rounds to the nearest integer and saturates at UINT64_MAX.
+ */
+static uint64_t pt_sample_round(double value)
+{
+	if (!(0.0 < value))
+		return 0ull;
+
+	value += 0.5;
+	if (18446744073709551615.0 <= value)
+		return UINT64_MAX;
+
+	return (uint64_t) value;
+}
+
+/* Estimate the total count for the entire trace in @estimate from the @sum
+ * of the per-segment counts and the sum of their squares @sumsq.
+ *
+ * We estimate the total as the mean per-segment count times the number of
+ * segments.  Its standard error is derived from the sample variance with the
+ * finite population correction.
+ */
+static void pt_sample_estimate(struct pt_estimate *estimate,
+			       const struct pt_sample_stats *stats,
+			       uint64_t sum, uint64_t sumsq)
+{
+	double nsampled, nsegments, mean, variance;
+
+	if (!stats->sampled) {
+		estimate->count = 0ull;
+		estimate->error = 0ull;
+		return;
+	}
+
+	nsampled = (double) stats->sampled;
+	nsegments = (double) stats->segments;
+	if (nsegments < nsampled)
+		nsegments = nsampled;
+
+	mean = (double) sum / nsampled;
+	estimate->count = pt_sample_round(mean * nsegments);
+
+	if (nsegments <= nsampled) {
+		estimate->error = 0ull;
+		return;
+	}
+
+	if (stats->sampled < 2) {
+		estimate->error = UINT64_MAX;
+		return;
+	}
+
+	variance = ((double) sumsq - (double) sum * mean) / (nsampled - 1.0);
+	variance *= nsegments * nsegments / nsampled;
+	variance *= 1.0 - nsampled / nsegments;
+
+	estimate->error = pt_sample_round(1.96 * pt_sample_sqrt(variance));
+}
+
+int pt_block_sample_block(const struct pt_block_sample *sample,
+			  const struct pt_asid *asid, uint64_t ip,
+			  struct pt_estimate *estimate)
+{
+	uint64_t sum, sumsq;
+	int errcode;
+
+	if (!sample || !estimate)
+		return -pte_invalid;
+
+	errcode = pt_block_profile_block(&sample->sum, asid, ip, &sum);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_block_profile_block(&sample->sumsq, asid, ip, &sumsq);
+	if (errcode < 0)
+		return errcode;
+
+	pt_sample_estimate(estimate, &sample->stats, sum, sumsq);
+
+	return 0;
+}
+
+int pt_block_sample_edge(const struct pt_block_sample *sample,
+			 const struct pt_asid *asid, uint64_t from,
+			 uint64_t to, struct pt_estimate *estimate)
+{
+	uint64_t sum, sumsq;
+	int errcode;
+
+	if (!sample || !estimate)
+		return -pte_invalid;
+
+	errcode = pt_block_profile_edge(&sample->sum, asid, from, to, &sum);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_block_profile_edge(&sample->sumsq, asid, from, to,
+					&sumsq);
+	if (errcode < 0)
+		return errcode;
+
+	pt_sample_estimate(estimate, &sample->stats, sum, sumsq);
+
+	return 0;
+}
+
+int pt_block_sample_get_stats(const struct pt_block_sample *sample,
+			      struct pt_sample_stats *stats)
+{
+	if (!sample || !stats)
+		return -pte_invalid;
+
+	*stats = sample->stats;
+
+	return 0;
+}
+
+/* Write @cr3 followed by a comma to @file.  An unknown @cr3 is omitted. */
+static void pt_block_sample_write_cr3(FILE *file, uint64_t cr3)
+{
+	if (cr3 != pt_asid_no_cr3)
+		fprintf(file, "0x%" PRIx64, cr3);
+
+	fputc(',', file);
+}
+
+/* Write the count and error of @estimate and end the line in @file.  An
+ * unknown error is omitted.
+ */
+static void pt_block_sample_write_estimate(FILE *file,
+					   const struct pt_estimate *estimate)
+{
+	fprintf(file, "%" PRIu64 ",", estimate->count);
+
+	if (estimate->error != UINT64_MAX)
+		fprintf(file, "%" PRIu64, estimate->error);
+
+	fputc('\n', file);
+}
+
+int pt_block_sample_write_csv(const struct pt_block_sample *sample,
+			      const char *filename)
+{
+	const struct pt_block_profile *sum;
+	struct pt_asid asid;
+	uint32_t slot;
+	FILE *file;
+	int errcode;
+
+	if (!sample || !filename)
+		return -pte_invalid;
+
+	file = fopen(filename, "w");
+	if (!file)
+		return -pte_invalid;
+
+	fputs("type,cr3,from,to,count,error\n", file);
+
+	pt_asid_init(&asid);
+	sum = &sample->sum;
+
+	for (slot = 0; slot < sum->blocks_size; ++slot) {
+		const struct pt_block_count *block;
+		struct pt_estimate estimate;
+
+		block = &sum->blocks[slot];
+		if (!block->count)
+			continue;
+
+		asid.cr3 = block->cr3;
+		errcode = pt_block_sample_block(sample, &asid, block->ip,
+						&estimate);
+		if (errcode < 0)
+			goto out;
+
+		fputs("block,", file);
+		pt_block_sample_write_cr3(file, block->cr3);
+		fprintf(file, "0x%" PRIx64 ",,", block->ip);
+		pt_block_sample_write_estimate(file, &estimate);
+	}
+
+	for (slot = 0; slot < sum->edges_size; ++slot) {
+		const struct pt_edge_count *edge;
+		struct pt_estimate estimate;
+
+		edge = &sum->edges[slot];
+		if (!edge->count)
+			continue;
+
+		asid.cr3 = edge->cr3;
+		errcode = pt_block_sample_edge(sample, &asid, edge->from,
+					       edge->to, &estimate);
+		if (errcode < 0)
+			goto out;
+
+		fputs("edge,", file);
+		pt_block_sample_write_cr3(file, edge->cr3);
+		fprintf(file, "0x%" PRIx64 ",0x%" PRIx64 ",", edge->from,
+			edge->to);
+		pt_block_sample_write_estimate(file, &estimate);
+	}
+
+	errcode = ferror(file) ? -pte_invalid : 0;
+
+out:
+	if (fclose(file))
+		errcode = -pte_invalid;
+
+	return errcode;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "pt_elf.h"
+#include "pt_section.h"
+#include "pt_image.h"
+
+#include "intel-pt.h"
+
+
+/* The ELF identification. */
+enum {
+	pt_elf_ident_class	= 4,
+	pt_elf_ident_data	= 5,
+	pt_elf_ident_size	= 16,
+
+	/* The little-endian data encoding. */
+	pt_elf_data_lsb		= 1
+};
+
+/* The sizes and field offsets of the ELF structures we read. */
+enum {
+	pt_elf32_ehdr_size	= 52,
+	pt_elf32_ehdr_phoff	= 28,
+	pt_elf32_ehdr_shoff	= 32,
+	pt_elf32_ehdr_phentsize	= 42,
+	pt_elf32_ehdr_phnum	= 44,
+	pt_elf32_ehdr_shentsize	= 46,
+	pt_elf32_phdr_size	= 32,
+	pt_elf32_shdr_info	= 28,
+
+	pt_elf64_ehdr_size	= 64,
+	pt_elf64_ehdr_phoff	= 32,
+	pt_elf64_ehdr_shoff	= 40,
+	pt_elf64_ehdr_phentsize	= 54,
+	pt_elf64_ehdr_phnum	= 56,
+	pt_elf64_ehdr_shentsize	= 58,
+	pt_elf64_phdr_size	= 56,
+	pt_elf64_shdr_info	= 44,
+
+	pt_elf_ehdr_type	= 16,
+
+	/* The maximal size of any of the above structures. */
+	pt_elf_max_size		= 64
+};
+
+
+static uint16_t pt_elf_get16(const uint8_t *buffer)
+{
+	return (uint16_t) (buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t pt_elf_get32(const uint8_t *buffer)
+{
+	return (uint32_t) pt_elf_get16(buffer) |
+		((uint32_t) pt_elf_get16(buffer + 2) << 16);
+}
+
+static uint64_t pt_elf_get64(const uint8_t *buffer)
+{
+	return (uint64_t) pt_elf_get32(buffer) |
+		((uint64_t) pt_elf_get32(buffer + 4) << 32);
+}
+
+/* Read exactly @size bytes at @offset in @section into @buffer.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if @section is too small.
+ */
+static int pt_elf_read(const struct pt_section *section, uint8_t *buffer,
+		       uint16_t size, uint64_t offset)
+{
+	int status;
+
+	status = pt_section_read(section, buffer, size, offset);
+	if (status < 0)
+		return -pte_invalid;
+
+	if (status != size)
+		return -pte_invalid;
+
+	return 0;
+}
+
+int pt_elf_read_header(struct pt_elf_header *header,
+		       const struct pt_section *section)
+{
+	uint8_t buffer[pt_elf_max_size];
+	uint64_t shoff;
+	uint16_t phnum, shentsize, minsize;
+	int errcode;
+
+	if (!header || !section)
+		return -pte_internal;
+
+	errcode = pt_elf_read(section, buffer, pt_elf_ident_size, 0ull);
+	if (errcode < 0)
+		return errcode;
+
+	if (buffer[0] != 0x7f || buffer[1] != 'E' || buffer[2] != 'L' ||
+	    buffer[3] != 'F')
+		return -pte_invalid;
+
+	if (buffer[pt_elf_ident_data] != pt_elf_data_lsb)
+		return -pte_invalid;
+
+	header->class = buffer[pt_elf_ident_class];
+	switch (header->class) {
+	case pt_elf_class_32:
+		errcode = pt_elf_read(section, buffer, pt_elf32_ehdr_size,
+				      0ull);
+		if (errcode < 0)
+			return errcode;
+
+		header->phoff = pt_elf_get32(&buffer[pt_elf32_ehdr_phoff]);
+		header->phentsize =
+			pt_elf_get16(&buffer[pt_elf32_ehdr_phentsize]);
+		phnum = pt_elf_get16(&buffer[pt_elf32_ehdr_phnum]);
+		shoff = pt_elf_get32(&buffer[pt_elf32_ehdr_shoff]);
+		shentsize = pt_elf_get16(&buffer[pt_elf32_ehdr_shentsize]);
+		minsize = pt_elf32_phdr_size;
+		break;
+
+	case pt_elf_class_64:
+		errcode = pt_elf_read(section, buffer, pt_elf64_ehdr_size,
+				      0ull);
+		if (errcode < 0)
+			return errcode;
+
+		header->phoff = pt_elf_get64(&buffer[pt_elf64_ehdr_phoff]);
+		header->phentsize =
+			pt_elf_get16(&buffer[pt_elf64_ehdr_phentsize]);
+		phnum = pt_elf_get16(&buffer[pt_elf64_ehdr_phnum]);
+		shoff = pt_elf_get64(&buffer[pt_elf64_ehdr_shoff]);
+		shentsize = pt_elf_get16(&buffer[pt_elf64_ehdr_shentsize]);
+		minsize = pt_elf64_phdr_size;
+		break;
+
+	default:
+		return -pte_invalid;
+	}
+
+	header->type = pt_elf_get16(&buffer[pt_elf_ehdr_type]);
+	header->phnum = phnum;
+
+	if (!phnum)
+		return 0;
+
+	if (header->phentsize < minsize)
+		return -pte_invalid;
+
+	/* If there are too many program headers, the real number is stored in
+	 * the sh_info field of section header zero.
+	 */
+	if (phnum == pt_elf_pn_xnum) {
+		uint16_t info;
+
+		info = header->class == pt_elf_class_32 ?
+			pt_elf32_shdr_info : pt_elf64_shdr_info;
+
+		if (!shoff || shentsize < info + 4)
+			return -pte_invalid;
+
+		errcode = pt_elf_read(section, buffer, 4, shoff + info);
+		if (errcode < 0)
+			return errcode;
+
+		header->phnum = pt_elf_get32(buffer);
+	}
+
+	return 0;
+}
+
+int pt_elf_read_phdr(struct pt_elf_phdr *phdr,
+		     const struct pt_elf_header *header,
+		     const struct pt_section *section, uint32_t index)
+{
+	uint8_t buffer[pt_elf_max_size];
+	uint64_t offset;
+	int errcode;
+
+	if (!phdr || !header || !section)
+		return -pte_internal;
+
+	if (header->phnum <= index)
+		return -pte_invalid;
+
+	offset = header->phoff + ((uint64_t) index * header->phentsize);
+
+	switch (header->class) {
+	case pt_elf_class_32:
+		errcode = pt_elf_read(section, buffer, pt_elf32_phdr_size,
+				      offset);
+		if (errcode < 0)
+			return errcode;
+
+		phdr->type = pt_elf_get32(&buffer[0]);
+		phdr->offset = pt_elf_get32(&buffer[4]);
+		phdr->vaddr = pt_elf_get32(&buffer[8]);
+		phdr->filesz = pt_elf_get32(&buffer[16]);
+		phdr->memsz = pt_elf_get32(&buffer[20]);
+		phdr->flags = pt_elf_get32(&buffer[24]);
+		return 0;
+
+	case pt_elf_class_64:
+		errcode = pt_elf_read(section, buffer, pt_elf64_phdr_size,
+				      offset);
+		if (errcode < 0)
+			return errcode;
+
+		phdr->type = pt_elf_get32(&buffer[0]);
+		phdr->flags = pt_elf_get32(&buffer[4]);
+		phdr->offset = pt_elf_get64(&buffer[8]);
+		phdr->vaddr = pt_elf_get64(&buffer[16]);
+		phdr->filesz = pt_elf_get64(&buffer[32]);
+		phdr->memsz = pt_elf_get64(&buffer[40]);
+		return 0;
+	}
+
+	return -pte_invalid;
+}
+
+/* Return the number of bytes of @phdr to add or zero to skip @phdr. */
+static uint64_t pt_elf_load_size(const struct pt_elf_header *header,
+				 const struct pt_elf_phdr *phdr,
+				 uint32_t flags)
+{
+	if (phdr->type != pt_elf_pt_load)
+		return 0ull;
+
+	if ((phdr->flags & flags) != flags)
+		return 0ull;
+
+	/* A core file contains the full segment if it was dumped.
+	 *
+	 * File-backed mappings are typically not dumped or only their first
+	 * page is dumped.  We leave them to file sections or to the read
+	 * memory callback.
+	 */
+	if (header->type == pt_elf_type_core && phdr->filesz < phdr->memsz)
+		return 0ull;
+
+	/* We can only add the part of the segment that is stored in the file.
+	 * The rest is zero-filled on load.
+	 */
+	if (phdr->memsz < phdr->filesz)
+		return phdr->memsz;
+
+	return phdr->filesz;
+}
+
+/* Remove the first @nsegments segments matching @flags that were added to
+ * @image by pt_elf_add_segments().
+ */
+static void pt_elf_remove_segments(struct pt_image *image,
+				   struct pt_section *section,
+				   const struct pt_asid *asid,
+				   const struct pt_elf_header *header,
+				   uint64_t bias, uint32_t flags,
+				   int nsegments)
+{
+	uint32_t index;
+
+	for (index = 0; nsegments && index < header->phnum; ++index) {
+		struct pt_elf_phdr phdr;
+		int errcode;
+
+		errcode = pt_elf_read_phdr(&phdr, header, section, index);
+		if (errcode < 0)
+			break;
+
+		if (!pt_elf_load_size(header, &phdr, flags))
+			continue;
+
+		errcode = pt_image_remove(image, section, asid,
+					  phdr.vaddr + bias);
+		if (errcode < 0)
+			continue;
+
+		nsegments -= 1;
+	}
+}
+
+int pt_elf_add_segments(struct pt_image *image, struct pt_section *section,
+			const struct pt_asid *asid, uint64_t bias,
+			uint32_t flags)
+{
+	struct pt_elf_header header;
+	uint64_t ssize;
+	uint32_t index;
+	int errcode, nsegments;
+
+	if (!image || !section || !asid)
+		return -pte_internal;
+
+	errcode = pt_elf_read_header(&header, section);
+	if (errcode < 0)
+		return errcode;
+
+	ssize = pt_section_size(section);
+	nsegments = 0;
+
+	for (index = 0; index < header.phnum; ++index) {
+		struct pt_elf_phdr phdr;
+		uint64_t size;
+
+		errcode = pt_elf_read_phdr(&phdr, &header, section, index);
+		if (errcode < 0)
+			break;
+
+		size = pt_elf_load_size(&header, &phdr, flags);
+		if (!size)
+			continue;
+
+		/* The file may have been truncated. */
+		if (ssize <= phdr.offset) {
+			errcode = -pte_invalid;
+			break;
+		}
+
+		if (ssize - phdr.offset < size)
+			size = ssize - phdr.offset;
+
+		errcode = pt_section_get(section);
+		if (errcode < 0)
+			break;
+
+		errcode = pt_image_add_range(image, section, asid,
+					     phdr.vaddr + bias, phdr.offset,
+					     size);
+		if (errcode < 0) {
+			(void) pt_section_put(section);
+			break;
+		}
+
+		nsegments += 1;
+	}
+
+	if (errcode < 0) {
+		pt_elf_remove_segments(image, section, asid, &header, bias,
+				       flags, nsegments);
+		return errcode;
+	}
+
+	return nsegments;
+}
@@ -0,0 +1,852 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_flow.h"
+#include "pt_insn_decoder.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The flow format.
+ *
+ * A flow file consists of a header, a sequence of records, an index, and a
+ * trailer.  All fixed-size numbers are stored in little-endian byte order.
+ *
+ * Each record starts with a tag byte.  The low two bits give the type of the
+ * record.  The tag is followed by variable-length numbers in LEB128 format.
+ * Signed numbers are zigzag encoded.
+ *
+ * The index lists the anchor records.  An anchor resets the state so a
+ * reader may start decoding at any anchor.
+ */
+enum {
+	/* The format version. */
+	pt_flow_version		= 1,
+
+	/* The header: magic, version, reserved. */
+	pt_flow_magic_size	= 8,
+	pt_flow_header_size	= 16,
+
+	/* An index entry: offset, tsc, block. */
+	pt_flow_entry_size	= 24,
+
+	/* The trailer: index offset, number of entries, reserved, magic. */
+	pt_flow_trailer_size	= 24,
+
+	/* The maximal number of blocks between two anchors. */
+	pt_flow_anchor_blocks	= 0x400,
+
+	/* The maximal size of the records written for a single block. */
+	pt_flow_max_records	= 0x80
+};
+
+/* The record types. */
+enum pt_flow_record {
+	/* A block.
+	 *
+	 * The upper six bits of the tag give the number of instructions.  If
+	 * they are zero, the number follows the tag.  Then follow the signed
+	 * distance of the block's IP from the end IP of the previous block
+	 * and the distance of the block's end IP from its IP.
+	 */
+	pfr_block,
+
+	/* The flags of the next block.
+	 *
+	 * The execution mode and the speculative flag also apply to
+	 * subsequent blocks.
+	 */
+	pfr_event,
+
+	/* The signed distance of the new time from the current time. */
+	pfr_time,
+
+	/* An anchor: the flags, the time, and the end IP of the previous
+	 * block.
+	 */
+	pfr_anchor,
+
+	pfr_mask	= 0x3,
+	pfr_shift	= 2,
+	pfr_max_ninsn	= 0x3f
+};
+
+/* Block flags. */
+enum {
+	/* The flags that are carried from one block to the next. */
+	pt_flow_sticky		= ptif_mode_mask | ptif_speculative,
+
+	/* The events that begin a new block. */
+	pt_flow_begin_events	= ptif_enabled | ptif_resumed | ptif_resynced |
+				  ptif_gap,
+
+	/* The events that end the current block. */
+	pt_flow_end_events	= ptif_aborted | ptif_committed |
+				  ptif_disabled | ptif_interrupted
+};
+
+static const char pt_flow_magic[pt_flow_magic_size] = {
+	'p', 't', 'f', 'l', 'o', 'w', 0, 0
+};
+
+static const char pt_flow_index_magic[pt_flow_magic_size] = {
+	'p', 't', 'f', 'l', 'o', 'w', 'i', 'x'
+};
+
+
+static void pt_flow_put32(uint8_t *buffer, uint32_t value)
+{
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t) (value >> 8);
+	buffer[2] = (uint8_t) (value >> 16);
+	buffer[3] = (uint8_t) (value >> 24);
+}
+
+static void pt_flow_put64(uint8_t *buffer, uint64_t value)
+{
+	pt_flow_put32(buffer, (uint32_t) value);
+	pt_flow_put32(buffer + 4, (uint32_t) (value >> 32));
+}
+
+static uint32_t pt_flow_get32(const uint8_t *buffer)
+{
+	return (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8) |
+		((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+}
+
+static uint64_t pt_flow_get64(const uint8_t *buffer)
+{
+	return (uint64_t) pt_flow_get32(buffer) |
+		((uint64_t) pt_flow_get32(buffer + 4) << 32);
+}
+
+static uint64_t pt_flow_zigzag(uint64_t value)
+{
+	if (value >> 63)
+		return ~(value << 1);
+
+	return value << 1;
+}
+
+static uint64_t pt_flow_unzigzag(uint64_t value)
+{
+	return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+static uint8_t *pt_flow_put_varint(uint8_t *pos, uint64_t value)
+{
+	for (; 0x7f < value; value >>= 7)
+		*pos++ = (uint8_t) (value | 0x80);
+
+	*pos++ = (uint8_t) value;
+
+	return pos;
+}
+
+static int pt_flow_get_varint(uint64_t *value, const uint8_t **pos,
+			      const uint8_t *end)
+{
+	const uint8_t *begin;
+	uint64_t result;
+	int shift;
+
+	begin = *pos;
+	result = 0ull;
+
+	for (shift = 0; shift < 64; shift += 7) {
+		uint8_t byte;
+
+		if (end <= begin)
+			return -pte_bad_packet;
+
+		byte = *begin++;
+		result |= (uint64_t) (byte & 0x7f) << shift;
+
+		if (!(byte & 0x80)) {
+			*value = result;
+			*pos = begin;
+
+			return 0;
+		}
+	}
+
+	return -pte_bad_packet;
+}
+
+int pt_flow_writer_init(struct pt_flow_writer *writer, FILE *file)
+{
+	if (!writer || !file)
+		return -pte_internal;
+
+	memset(writer, 0, sizeof(*writer));
+
+	writer->file = file;
+
+	memcpy(writer->buffer, pt_flow_magic, sizeof(pt_flow_magic));
+	pt_flow_put32(&writer->buffer[8], pt_flow_version);
+	pt_flow_put32(&writer->buffer[12], 0);
+
+	writer->size = pt_flow_header_size;
+
+	return 0;
+}
+
+void pt_flow_writer_fini(struct pt_flow_writer *writer)
+{
+	if (!writer)
+		return;
+
+	free(writer->index);
+
+	if (writer->owns_file)
+		fclose(writer->file);
+}
+
+struct pt_flow_writer *pt_flow_alloc_writer(const char *filename)
+{
+	struct pt_flow_writer *writer;
+	FILE *file;
+	int errcode;
+
+	if (!filename)
+		return NULL;
+
+	writer = malloc(sizeof(*writer));
+	if (!writer)
+		return NULL;
+
+	file = fopen(filename, "wb");
+	if (!file) {
+		free(writer);
+		return NULL;
+	}
+
+	errcode = pt_flow_writer_init(writer, file);
+	if (errcode < 0) {
+		fclose(file);
+		free(writer);
+		return NULL;
+	}
+
+	writer->owns_file = 1;
+
+	return writer;
+}
+
+void pt_flow_free_writer(struct pt_flow_writer *writer)
+{
+	pt_flow_writer_fini(writer);
+	free(writer);
+}
+
+/* Write the output buffer to the file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_flow_flush(struct pt_flow_writer *writer)
+{
+	size_t size;
+
+	size = writer->size;
+	if (!size)
+		return 0;
+
+	if (fwrite(writer->buffer, 1, size, writer->file) != size)
+		return -pte_invalid;
+
+	writer->offset += size;
+	writer->size = 0;
+
+	return 0;
+}
+
+/* Add an index entry for an anchor at the current position.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_flow_add_anchor(struct pt_flow_writer *writer, uint64_t tsc)
+{
+	struct pt_flow_index_entry *entry;
+
+	if (writer->nentries == writer->capacity) {
+		struct pt_flow_index_entry *index;
+		uint32_t capacity;
+
+		capacity = writer->capacity ? writer->capacity * 2 : 0x40;
+		if (capacity < writer->capacity)
+			return -pte_nomem;
+
+		index = realloc(writer->index, capacity * sizeof(*index));
+		if (!index)
+			return -pte_nomem;
+
+		writer->index = index;
+		writer->capacity = capacity;
+	}
+
+	entry = &writer->index[writer->nentries++];
+	entry->offset = writer->offset + writer->size;
+	entry->tsc = tsc;
+	entry->block = writer->nblocks;
+
+	return 0;
+}
+
+/* Encode a block.
+ *
+ * Writes the records for @block and updates @writer's state.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_flow_encode(struct pt_flow_writer *writer,
+			  const struct pt_flow_block *block)
+{
+	struct pt_flow_state *state;
+	uint8_t *pos;
+	uint16_t sticky;
+
+	if (pt_flow_buffer_size - writer->size < pt_flow_max_records) {
+		int errcode;
+
+		errcode = pt_flow_flush(writer);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	state = &writer->state;
+	sticky = block->flags & pt_flow_sticky;
+
+	if (!(writer->nblocks % pt_flow_anchor_blocks)) {
+		int errcode;
+
+		errcode = pt_flow_add_anchor(writer, block->tsc);
+		if (errcode < 0)
+			return errcode;
+
+		state->tsc = block->tsc;
+		state->flags = sticky;
+
+		pos = &writer->buffer[writer->size];
+		*pos++ = pfr_anchor;
+		pos = pt_flow_put_varint(pos, state->flags);
+		pos = pt_flow_put_varint(pos, state->tsc);
+		pos = pt_flow_put_varint(pos, state->ip);
+	} else
+		pos = &writer->buffer[writer->size];
+
+	if (block->tsc != state->tsc) {
+		*pos++ = pfr_time;
+		pos = pt_flow_put_varint(pos, pt_flow_zigzag(block->tsc -
+							     state->tsc));
+
+		state->tsc = block->tsc;
+	}
+
+	if (block->flags != state->flags) {
+		*pos++ = pfr_event;
+		pos = pt_flow_put_varint(pos, block->flags);
+
+		state->flags = sticky;
+	}
+
+	if (block->ninsn <= pfr_max_ninsn)
+		*pos++ = (uint8_t) (pfr_block | (block->ninsn << pfr_shift));
+	else {
+		*pos++ = pfr_block;
+		pos = pt_flow_put_varint(pos, block->ninsn);
+	}
+
+	pos = pt_flow_put_varint(pos, pt_flow_zigzag(block->ip - state->ip));
+	pos = pt_flow_put_varint(pos, block->end_ip - block->ip);
+
+	state->ip = block->end_ip;
+
+	writer->size = (uint32_t) (pos - writer->buffer);
+	writer->nblocks += 1;
+
+	return 0;
+}
+
+/* End the current block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_flow_end_block(struct pt_flow_writer *writer)
+{
+	struct pt_flow_block *block;
+	int errcode;
+
+	block = &writer->block;
+	if (!block->ninsn)
+		return 0;
+
+	block->tsc = writer->tsc;
+
+	errcode = pt_flow_encode(writer, block);
+
+	block->ninsn = 0;
+	block->flags = 0;
+
+	return errcode;
+}
+
+int pt_flow_write_insn(struct pt_flow_writer *writer,
+		       const struct pt_insn *insn)
+{
+	struct pt_flow_block *block;
+	uint16_t flags;
+
+	if (!writer || !insn)
+		return -pte_invalid;
+
+	if (writer->finished)
+		return -pte_invalid;
+
+	block = &writer->block;
+	flags = pt_insn_flags(insn);
+
+	if (block->ninsn) {
+		if ((insn->ip != writer->next_ip) ||
+		    (flags & pt_flow_begin_events) ||
+		    ((flags ^ block->flags) & pt_flow_sticky) ||
+		    (block->ninsn == UINT32_MAX)) {
+			int errcode;
+
+			errcode = pt_flow_end_block(writer);
+			if (errcode < 0)
+				return errcode;
+		}
+	}
+
+	if (!block->ninsn)
+		block->ip = insn->ip;
+
+	block->end_ip = insn->ip;
+	block->ninsn += 1;
+	block->flags |= flags;
+
+	writer->next_ip = insn->ip + insn->size;
+
+	if ((insn->iclass != ptic_other) || (flags & pt_flow_end_events))
+		return pt_flow_end_block(writer);
+
+	return 0;
+}
+
+int pt_flow_write_block(struct pt_flow_writer *writer,
+			const struct pt_flow_block *block)
+{
+	int errcode;
+
+	if (!writer || !block)
+		return -pte_invalid;
+
+	if (writer->finished)
+		return -pte_invalid;
+
+	if (!block->ninsn || (block->end_ip < block->ip))
+		return -pte_invalid;
+
+	errcode = pt_flow_end_block(writer);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_flow_encode(writer, block);
+}
+
+int pt_flow_write_time(struct pt_flow_writer *writer, uint64_t tsc)
+{
+	if (!writer)
+		return -pte_invalid;
+
+	writer->tsc = tsc;
+
+	return 0;
+}
+
+int pt_flow_finish(struct pt_flow_writer *writer)
+{
+	uint64_t index_offset;
+	uint32_t entry;
+	uint8_t *trailer;
+	int errcode;
+
+	if (!writer)
+		return -pte_invalid;
+
+	if (writer->finished)
+		return -pte_invalid;
+
+	errcode = pt_flow_end_block(writer);
+	if (errcode < 0)
+		return errcode;
+
+	index_offset = writer->offset + writer->size;
+
+	for (entry = 0; entry < writer->nentries; ++entry) {
+		const struct pt_flow_index_entry *index;
+		uint8_t *pos;
+
+		if (pt_flow_buffer_size - writer->size < pt_flow_entry_size) {
+			errcode = pt_flow_flush(writer);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		index = &writer->index[entry];
+		pos = &writer->buffer[writer->size];
+
+		pt_flow_put64(&pos[0], index->offset);
+		pt_flow_put64(&pos[8], index->tsc);
+		pt_flow_put64(&pos[16], index->block);
+
+		writer->size += pt_flow_entry_size;
+	}
+
+	if (pt_flow_buffer_size - writer->size < pt_flow_trailer_size) {
+		errcode = pt_flow_flush(writer);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	trailer = &writer->buffer[writer->size];
+
+	pt_flow_put64(&trailer[0], index_offset);
+	pt_flow_put32(&trailer[8], writer->nentries);
+	pt_flow_put32(&trailer[12], 0);
+	memcpy(&trailer[16], pt_flow_index_magic, sizeof(pt_flow_index_magic));
+
+	writer->size += pt_flow_trailer_size;
+
+	errcode = pt_flow_flush(writer);
+	if (errcode < 0)
+		return errcode;
+
+	if (fflush(writer->file))
+		return -pte_invalid;
+
+	writer->finished = 1;
+
+	return 0;
+}
+
+int pt_flow_reader_init(struct pt_flow_reader *reader, uint8_t *content,
+			size_t size)
+{
+	const uint8_t *trailer, *pos;
+	uint64_t index_offset, index_size, last;
+	uint32_t nentries, entry;
+
+	if (!reader || !content)
+		return -pte_internal;
+
+	if (size < pt_flow_header_size + pt_flow_trailer_size)
+		return -pte_invalid;
+
+	if (memcmp(content, pt_flow_magic, sizeof(pt_flow_magic)) != 0)
+		return -pte_invalid;
+
+	if (pt_flow_get32(&content[8]) != pt_flow_version)
+		return -pte_invalid;
+
+	trailer = &content[size - pt_flow_trailer_size];
+	if (memcmp(&trailer[16], pt_flow_index_magic,
+		   sizeof(pt_flow_index_magic)) != 0)
+		return -pte_invalid;
+
+	index_offset = pt_flow_get64(&trailer[0]);
+	nentries = pt_flow_get32(&trailer[8]);
+
+	if ((index_offset < pt_flow_header_size) ||
+	    ((size - pt_flow_trailer_size) < index_offset))
+		return -pte_invalid;
+
+	index_size = (size - pt_flow_trailer_size) - index_offset;
+	if (index_size != (uint64_t) nentries * pt_flow_entry_size)
+		return -pte_invalid;
+
+	memset(reader, 0, sizeof(*reader));
+
+	if (nentries) {
+		reader->index = malloc(nentries * sizeof(*reader->index));
+		if (!reader->index)
+			return -pte_nomem;
+	}
+
+	pos = &content[index_offset];
+	last = 0ull;
+	for (entry = 0; entry < nentries; ++entry) {
+		struct pt_flow_index_entry *index;
+
+		index = &reader->index[entry];
+		index->offset = pt_flow_get64(&pos[0]);
+		index->tsc = pt_flow_get64(&pos[8]);
+		index->block = pt_flow_get64(&pos[16]);
+
+		pos += pt_flow_entry_size;
+
+		if ((index->offset < pt_flow_header_size) ||
+		    (index->offset <= last) ||
+		    (index_offset <= index->offset)) {
+			free(reader->index);
+			reader->index = NULL;
+
+			return -pte_invalid;
+		}
+
+		last = index->offset;
+	}
+
+	reader->content = content;
+	reader->begin = &content[pt_flow_header_size];
+	reader->end = &content[index_offset];
+	reader->pos = reader->begin;
+	reader->nentries = nentries;
+
+	return 0;
+}
+
+void pt_flow_reader_fini(struct pt_flow_reader *reader)
+{
+	if (!reader)
+		return;
+
+	free(reader->index);
+	free(reader->content);
+}
+
+struct pt_flow_reader *pt_flow_alloc_reader(const char *filename)
+{
+	struct pt_flow_reader *reader;
+	uint8_t *content;
+	FILE *file;
+	long size;
+	int errcode;
+
+	if (!filename)
+		return NULL;
+
+	file = fopen(filename, "rb");
+	if (!file)
+		return NULL;
+
+	errcode = fseek(file, 0, SEEK_END);
+	if (errcode)
+		goto out_file;
+
+	size = ftell(file);
+	if (size < 0)
+		goto out_file;
+
+	errcode = fseek(file, 0, SEEK_SET);
+	if (errcode)
+		goto out_file;
+
+	content = malloc(size ? (size_t) size : 1);
+	if (!content)
+		goto out_file;
+
+	if (fread(content, 1, (size_t) size, file) != (size_t) size)
+		goto out_content;
+
+	reader = malloc(sizeof(*reader));
+	if (!reader)
+		goto out_content;
+
+	errcode = pt_flow_reader_init(reader, content, (size_t) size);
+	if (errcode < 0)
+		goto out_reader;
+
+	fclose(file);
+	return reader;
+
+out_reader:
+	free(reader);
+
+out_content:
+	free(content);
+
+out_file:
+	fclose(file);
+	return NULL;
+}
+
+void pt_flow_free_reader(struct pt_flow_reader *reader)
+{
+	pt_flow_reader_fini(reader);
+	free(reader);
+}
+
+int pt_flow_seek(struct pt_flow_reader *reader, uint64_t tsc)
+{
+	uint32_t begin, end;
+
+	if (!reader)
+		return -pte_invalid;
+
+	memset(&reader->state, 0, sizeof(reader->state));
+
+	/* Find the first anchor after @tsc. */
+	begin = 0;
+	end = reader->nentries;
+	while (begin < end) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (reader->index[mid].tsc <= tsc)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+
+	if (!begin)
+		reader->pos = reader->begin;
+	else
+		reader->pos = &reader->content[reader->index[begin - 1].offset];
+
+	return 0;
+}
+
+int pt_flow_next(struct pt_flow_reader *reader, struct pt_flow_block *block)
+{
+	struct pt_flow_state state;
+	const uint8_t *pos, *end;
+	uint64_t value;
+	uint16_t flags;
+	int errcode, event;
+
+	if (!reader || !block)
+		return -pte_invalid;
+
+	state = reader->state;
+	pos = reader->pos;
+	end = reader->end;
+	flags = 0;
+	event = 0;
+
+	for (;;) {
+		uint8_t tag;
+
+		if (end <= pos)
+			return -pte_eos;
+
+		tag = *pos++;
+		switch (tag & pfr_mask) {
+		case pfr_anchor:
+			if (tag >> pfr_shift)
+				return -pte_bad_opc;
+
+			errcode = pt_flow_get_varint(&value, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			if (UINT16_MAX < value)
+				return -pte_bad_packet;
+
+			state.flags = (uint16_t) value;
+
+			errcode = pt_flow_get_varint(&state.tsc, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = pt_flow_get_varint(&state.ip, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			break;
+
+		case pfr_time:
+			if (tag >> pfr_shift)
+				return -pte_bad_opc;
+
+			errcode = pt_flow_get_varint(&value, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			state.tsc += pt_flow_unzigzag(value);
+			break;
+
+		case pfr_event:
+			if (tag >> pfr_shift)
+				return -pte_bad_opc;
+
+			errcode = pt_flow_get_varint(&value, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			if (UINT16_MAX < value)
+				return -pte_bad_packet;
+
+			flags = (uint16_t) value;
+			event = 1;
+			break;
+
+		case pfr_block:
+			value = tag >> pfr_shift;
+			if (!value) {
+				errcode = pt_flow_get_varint(&value, &pos, end);
+				if (errcode < 0)
+					return errcode;
+
+				if (!value || (UINT32_MAX < value))
+					return -pte_bad_packet;
+			}
+
+			block->ninsn = (uint32_t) value;
+
+			errcode = pt_flow_get_varint(&value, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			block->ip = state.ip + pt_flow_unzigzag(value);
+
+			errcode = pt_flow_get_varint(&value, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			block->end_ip = block->ip + value;
+			block->tsc = state.tsc;
+
+			if (!event)
+				flags = state.flags;
+
+			block->flags = flags;
+
+			state.ip = block->end_ip;
+			state.flags = flags & pt_flow_sticky;
+
+			reader->state = state;
+			reader->pos = pos;
+
+			return 0;
+		}
+	}
+}
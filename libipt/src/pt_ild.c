@@ -143,15 +143,15 @@ get_byte_ptr (pti_ild_t * ild, pti_uint_t i)
 }
 
 PTI_INLINE pti_bool_t
-mode_64b (pti_ild_t * ild)
+mode_64b (pti_machine_mode_enum_t mode)
 {
-  return ild->mode == PTI_MODE_64;
+  return mode == PTI_MODE_64;
 }
 
 PTI_INLINE pti_bool_t
-mode_32b (pti_ild_t * ild)
+mode_32b (pti_machine_mode_enum_t mode)
 {
-  return ild->mode == PTI_MODE_32;
+  return mode == PTI_MODE_32;
 }
 
 PTI_INLINE pti_bool_t
@@ -191,10 +191,10 @@ pti_get_rex_vex_w (pti_ild_t * ild)
   return 0;
 }
 
-PTI_INLINE
-  pti_machine_mode_enum_t pti_get_nominal_eosz_non64 (pti_ild_t * ild)
+PTI_INLINE pti_machine_mode_enum_t
+pti_get_nominal_eosz_non64 (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
-  if (mode_32b (ild))
+  if (mode_32b (mode))
     {
       if (ild->u.s.osz)
         return PTI_MODE_16;
@@ -206,9 +206,9 @@ PTI_INLINE
 }
 
 PTI_INLINE pti_machine_mode_enum_t
-pti_get_nominal_eosz (pti_ild_t * ild)
+pti_get_nominal_eosz (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
-  if (mode_64b (ild))
+  if (mode_64b (mode))
     {
       if (pti_get_rex_vex_w (ild))
         return PTI_MODE_64;
@@ -216,13 +216,13 @@ pti_get_nominal_eosz (pti_ild_t * ild)
         return PTI_MODE_16;
       return PTI_MODE_32;
     }
-  return pti_get_nominal_eosz_non64 (ild);
+  return pti_get_nominal_eosz_non64 (ild, mode);
 }
 
 PTI_INLINE pti_machine_mode_enum_t
-pti_get_nominal_eosz_df64 (pti_ild_t * ild)
+pti_get_nominal_eosz_df64 (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
-  if (mode_64b (ild))
+  if (mode_64b (mode))
     {
       if (pti_get_rex_vex_w (ild))
         return PTI_MODE_64;
@@ -232,7 +232,7 @@ pti_get_nominal_eosz_df64 (pti_ild_t * ild)
          to pti_get_nominal_eosz(), above */
       return PTI_MODE_64;
     }
-  return pti_get_nominal_eosz_non64 (ild);
+  return pti_get_nominal_eosz_non64 (ild, mode);
 }
 
 PTI_INLINE pti_uint_t
@@ -255,8 +255,8 @@ resolve_v (pti_machine_mode_enum_t eosz)
 
 /*  DECODERS */
 
-static void
-prefix_rex_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+prefix_rex_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   pti_uint_t max_bytes = ild->max_bytes;
   pti_uint_t length = 0;
@@ -284,7 +284,7 @@ prefix_rex_dec (pti_ild_t * ild)
         case 0x3E:
         case 0x26:
         case 0x36:
-          if (mode_64b (ild) == 0)
+          if (mode_64b (mode) == 0)
             ild->seg = b;
           /* ignore possible REX prefix encountered earlier */
           rex = 0;
@@ -318,7 +318,7 @@ prefix_rex_dec (pti_ild_t * ild)
 
         default:
           /*Take care of REX prefix */
-          if (mode_64b (ild) && (b & 0xf0) == 0x40)
+          if (mode_64b (mode) && (b & 0xf0) == 0x40)
             {
               rex = b;
             }
@@ -351,12 +351,12 @@ vex_opcode_dec (pti_ild_t * ild)
   ild->length = length + 1;
 }
 
-static void
-vex_c5_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+vex_c5_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   pti_uint_t max_bytes = ild->max_bytes;
   pti_uint_t length = ild->length;
-  if (mode_64b (ild))
+  if (mode_64b (mode))
     {
       ild->u.s.vexc5 = 1;
       length++;                 /* eat the c5 */
@@ -399,12 +399,12 @@ vex_c5_dec (pti_ild_t * ild)
     }
 }
 
-static void
-vex_c4_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+vex_c4_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   pti_uint_t max_bytes = ild->max_bytes;
   pti_uint_t length = ild->length;
-  if (mode_64b (ild))
+  if (mode_64b (mode))
     {
       ild->u.s.vexc4 = 1;
       length++;                 /* eat the c4 */
@@ -452,15 +452,15 @@ vex_c4_dec (pti_ild_t * ild)
     }
 }
 
-static void
-vex_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+vex_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   /* prefix scanner checked length for us so we know at least 1B is left. */
   pti_uint8_t b = get_byte (ild, ild->length);
   if (b == 0xC5)
-    vex_c5_dec (ild);
+    vex_c5_dec (ild, mode);
   else if (b == 0xC4)
-    vex_c4_dec (ild);
+    vex_c4_dec (ild, mode);
 }
 
 
@@ -567,8 +567,8 @@ opcode_dec (pti_ild_t * ild)
 #include "pti-disp.h"
 
 
-static void
-modrm_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+modrm_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   static pti_uint8_t const *const has_modrm_2d[2] = {
     has_modrm_map_0x0,
@@ -598,7 +598,7 @@ modrm_dec (pti_ild_t * ild)
     {
       /* set disp_bytes and sib using simple tables */
 
-      pti_uint8_t eamode = eamode_table[ild->u.s.asz][ild->mode];
+      pti_uint8_t eamode = eamode_table[ild->u.s.asz][mode];
       pti_uint8_t mod = (pti_uint8_t) pti_get_modrm_mod(ild);
       pti_uint8_t rm = (pti_uint8_t) pti_get_modrm_rm(ild);
 
@@ -628,8 +628,8 @@ sib_dec (pti_ild_t * ild)
     }
 }
 
-static void
-compute_disp_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+compute_disp_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   /* set ild->disp_bytes for maps 0 and 1. */
   static pti_uint8_t const *const map_map[] = {
@@ -660,25 +660,25 @@ compute_disp_dec (pti_ild_t * ild)
       break;
     case PTI_DISP_BUCKET_0_l1:
       /* BRDISPz(eosz) for 16/32 modes, and BRDISP32 for 64b mode */
-      if (mode_64b (ild))
+      if (mode_64b (mode))
         ild->disp_bytes = 4;
       else
         {
-          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
           ild->disp_bytes = (pti_uint8_t) resolve_z(eosz);
         }
       break;
     case PTI_MEMDISPv_DISP_WIDTH_ASZ_NONTERM_EASZ_l2:
       /* MEMDISPv(easz) */
       {
-        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
         ild->disp_bytes = (pti_uint8_t) resolve_v(eosz);
       }
       break;
     case PTI_BRDISPz_BRDISP_WIDTH_OSZ_NONTERM_EOSZ_l2:
       /* BRDISPz(eosz) for 16/32/64 modes */
       {
-        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
         ild->disp_bytes = (pti_uint8_t) resolve_z(eosz);
       }
       break;
@@ -686,7 +686,7 @@ compute_disp_dec (pti_ild_t * ild)
       /* reg=0 -> preserve, reg=7 -> BRDISPz(eosz) */
       if (ild->map == PTI_MAP_0 && pti_get_modrm_reg (ild) == 7)
         {
-          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
           ild->disp_bytes = (pti_uint8_t) resolve_z(eosz);
         }
       break;
@@ -695,13 +695,13 @@ compute_disp_dec (pti_ild_t * ild)
     }
 }
 
-static void
-disp_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+disp_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   pti_uint_t disp_bytes;
   if (ild->disp_bytes == 0 && pti_get_map (ild) < PTI_MAP_2)
     {
-      compute_disp_dec (ild);
+      compute_disp_dec (ild, mode);
     }
   disp_bytes = ild->disp_bytes;
   if (disp_bytes == 0)
@@ -722,8 +722,8 @@ disp_dec (pti_ild_t * ild)
 #include "pti-imm-defs.h"
 #include "pti-imm.h"
 
-static void
-set_imm_bytes (pti_ild_t * ild)
+PTI_FORCEINLINE void
+set_imm_bytes (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   /*: set ild->imm1_bytes and  ild->imm2_bytes for maps 0/1 */
   static pti_uint8_t const *const map_map[] = {
@@ -756,14 +756,14 @@ set_imm_bytes (pti_ild_t * ild)
     case PTI_SIMMz_IMM_WIDTH_OSZ_NONTERM_EOSZ_l2:
       /* SIMMz(eosz) */
       {
-        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
         ild->imm1_bytes = (pti_uint8_t) resolve_z(eosz);
       }
       break;
     case PTI_UIMMv_IMM_WIDTH_OSZ_NONTERM_EOSZ_l2:
       /* UIMMv(eosz) */
       {
-        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
         ild->imm1_bytes = (pti_uint8_t) resolve_v(eosz);
       }
 
@@ -774,21 +774,21 @@ set_imm_bytes (pti_ild_t * ild)
     case PTI_SIMMz_IMM_WIDTH_OSZ_NONTERM_DF64_EOSZ_l2:
       /* push defaults to eosz64 in 64b mode, then uses SIMMz */
       {
-        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz_df64 (ild);
+        pti_machine_mode_enum_t eosz = pti_get_nominal_eosz_df64 (ild, mode);
         ild->imm1_bytes = (pti_uint8_t) resolve_z(eosz);
       }
       break;
     case PTI_RESOLVE_BYREG_IMM_WIDTH_map0x0_op0xf7_l1:
       if (ild->map == PTI_MAP_0 && pti_get_modrm_reg (ild) < 2)
         {
-          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
           ild->imm1_bytes = (pti_uint8_t) resolve_z(eosz);
         }
       break;
     case PTI_RESOLVE_BYREG_IMM_WIDTH_map0x0_op0xc7_l1:
       if (ild->map == PTI_MAP_0 && pti_get_modrm_reg (ild) == 0)
         {
-          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild);
+          pti_machine_mode_enum_t eosz = pti_get_nominal_eosz (ild, mode);
           ild->imm1_bytes = (pti_uint8_t) resolve_z(eosz);
         }
       break;
@@ -822,8 +822,8 @@ set_imm_bytes (pti_ild_t * ild)
     }
 }
 
-static void
-imm_dec (pti_ild_t * ild)
+PTI_FORCEINLINE void
+imm_dec (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   if (ild->map == PTI_MAP_AMD3DNOW)
     {
@@ -836,7 +836,7 @@ imm_dec (pti_ild_t * ild)
         set_error (ild);
       return;
     }
-  set_imm_bytes (ild);
+  set_imm_bytes (ild, mode);
   if (ild->imm1_bytes == 0)
     return;
 
@@ -859,17 +859,17 @@ imm_dec (pti_ild_t * ild)
   ild->length += ild->imm2_bytes;
 }
 
-static void
-decode (pti_ild_t * ild)
+PTI_FORCEINLINE void
+decode (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
-  prefix_rex_dec (ild);
-  vex_dec (ild);
+  prefix_rex_dec (ild, mode);
+  vex_dec (ild, mode);
   if (ild->nominal_opcode_pos == 0)
     opcode_dec (ild);
-  modrm_dec (ild);
+  modrm_dec (ild, mode);
   sib_dec (ild);
-  disp_dec (ild);
-  imm_dec (ild);
+  disp_dec (ild, mode);
+  imm_dec (ild, mode);
 }
 
 PTI_INLINE pti_int64_t
@@ -923,17 +923,32 @@ pti_ild_init (void)
   init_eamode_table ();
 }
 
-PTI_DLL_EXPORT pti_bool_t
-pti_instruction_length_decode (pti_ild_t * ild)
+/* the decoders above take the machine mode as an argument so that the
+   compiler can specialize them for a constant mode. */
+PTI_FORCEINLINE pti_bool_t
+length_decode (pti_ild_t * ild, pti_machine_mode_enum_t mode)
 {
   /*FIXME: could remove this. rely on user memset. */
   ild->iclass = PTI_INST_INVALID;
   ild->u.i = 0;
   ild->direct_target = 0;
-  decode (ild);
+  decode (ild, mode);
   return ild->u.s.error == 0;
 }
 
+PTI_DLL_EXPORT pti_bool_t
+pti_instruction_length_decode (pti_ild_t * ild)
+{
+  return length_decode (ild, ild->mode);
+}
+
+PTI_DLL_EXPORT pti_bool_t
+pti_instruction_length_decode_64 (pti_ild_t * ild)
+{
+  ild->mode = PTI_MODE_64;
+  return length_decode (ild, PTI_MODE_64);
+}
+
 PTI_DLL_EXPORT pti_bool_t
 pti_instruction_decode (pti_ild_t * ild)
 {
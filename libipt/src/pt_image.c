@@ -29,6 +29,10 @@
 #include "pt_image.h"
 #include "pt_section.h"
 #include "pt_asid.h"
+#include "pt_elf.h"
+#include "pt_maps.h"
+#include "pt_manifest.h"
+#include "pt_atomic.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -52,7 +56,9 @@ static char *dupstr(const char *str)
 
 static struct pt_section_list *pt_mk_section_list(struct pt_section *section,
 						  const struct pt_asid *asid,
-						  uint64_t vaddr)
+						  uint64_t vaddr,
+						  uint64_t offset,
+						  uint64_t size)
 {
 	struct pt_section_list *list;
 
@@ -61,7 +67,8 @@ static struct pt_section_list *pt_mk_section_list(struct pt_section *section,
 		return NULL;
 
 	list->next = NULL;
-	pt_msec_init(&list->section, section, asid, vaddr);
+	list->ucount = 1;
+	pt_msec_init(&list->section, section, asid, vaddr, offset, size);
 
 	return list;
 }
@@ -71,326 +78,2419 @@ static void pt_section_list_free(struct pt_section_list *list)
 	if (!list)
 		return;
 
-	pt_section_free(list->section.section);
+	pt_section_put(list->section.section);
 	pt_msec_fini(&list->section);
 	free(list);
 }
 
+static void pt_section_list_get(struct pt_section_list *list)
+{
+	if (!list)
+		return;
+
+	(void) pt_atomic_inc32(&list->ucount);
+}
+
+/* Remove a user from @list.
+ *
+ * Frees @list if this was its last user and removes a user from its successor.
+ */
+static void pt_section_list_put(struct pt_section_list *list)
+{
+	while (list) {
+		struct pt_section_list *trash;
+
+		if (pt_atomic_dec32(&list->ucount))
+			break;
+
+		trash = list;
+		list = list->next;
+
+		pt_section_list_free(trash);
+	}
+}
+
+/* Make the list element at @plist exclusively owned.
+ *
+ * If the list element at @plist is shared, replace it with a copy.
+ *
+ * The caller must own the object containing @plist exclusively.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_section_list_unshare(struct pt_section_list **plist)
+{
+	const struct pt_mapped_section *msec;
+	struct pt_section_list *list, *copy;
+	int errcode;
+
+	if (!plist)
+		return -pte_internal;
+
+	list = *plist;
+	if (!list)
+		return -pte_internal;
+
+	/* If we hold the only reference, nobody else can obtain one. */
+	if (pt_atomic_load32(&list->ucount) <= 1)
+		return 0;
+
+	msec = &list->section;
+
+	errcode = pt_section_get(msec->section);
+	if (errcode < 0)
+		return errcode;
+
+	copy = pt_mk_section_list(msec->section, &msec->asid, msec->vaddr,
+				  msec->offset, msec->size);
+	if (!copy) {
+		(void) pt_section_put(msec->section);
+		return -pte_nomem;
+	}
+
+	copy->next = list->next;
+	pt_section_list_get(copy->next);
+
+	/* Other users may have dropped their references in the meantime. */
+	pt_section_list_put(list);
+	*plist = copy;
+
+	return 0;
+}
+
+static uint32_t pt_image_map_hash(uint64_t cr3)
+{
+	return (uint32_t) ((cr3 * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+/* Find the slot for @cr3 in a hash table of partitions with @mask + 1 slots.
+ *
+ * Returns the slot of @cr3's partition if it exists, the unused slot it would
+ * occupy otherwise.
+ */
+static uint32_t pt_image_map_slot(const struct pt_image_partition *partitions,
+				  uint32_t mask, uint64_t cr3)
+{
+	uint32_t slot;
+
+	for (slot = pt_image_map_hash(cr3) & mask;; slot = (slot + 1) & mask) {
+		const struct pt_image_partition *partition;
+
+		partition = &partitions[slot];
+		if (partition->cr3 == pt_asid_no_cr3 || partition->cr3 == cr3)
+			return slot;
+	}
+}
+
+/* Return the number of hash table slots for @npartitions partitions.
+ *
+ * Returns zero if there are too many partitions.
+ */
+static uint32_t pt_image_map_nslots(uint32_t npartitions)
+{
+	uint32_t nslots;
+
+	/* Keep the hash table at most half full. */
+	for (nslots = 8; nslots < npartitions * 2; nslots *= 2) {
+		if (!nslots)
+			return 0;
+	}
+
+	return nslots;
+}
+
+/* Create an empty map with @nslots hash table slots.
+ *
+ * The number of slots must be a power of two.
+ *
+ * Returns the new map on success, NULL otherwise.
+ */
+static struct pt_image_map *pt_mk_image_map(uint32_t nslots)
+{
+	struct pt_image_map *map;
+	uint32_t slot;
+
+	map = malloc(sizeof(*map));
+	if (!map)
+		return NULL;
+
+	/* The last slot holds the sections without a CR3 value. */
+	map->partitions = malloc((nslots + 1) * sizeof(*map->partitions));
+	if (!map->partitions) {
+		free(map);
+		return NULL;
+	}
+
+	for (slot = 0; slot <= nslots; ++slot) {
+		map->partitions[slot].cr3 = pt_asid_no_cr3;
+		map->partitions[slot].sections = NULL;
+	}
+
+	map->mask = nslots - 1;
+	map->nused = 0;
+	map->nsections = 0;
+	map->ucount = 1;
+
+	return map;
+}
+
+static void pt_image_map_free(struct pt_image_map *map)
+{
+	uint32_t slot;
+
+	if (!map)
+		return;
+
+	for (slot = 0; slot <= map->mask + 1; ++slot)
+		pt_section_list_put(map->partitions[slot].sections);
+
+	free(map->partitions);
+	free(map);
+}
+
+static void pt_image_map_get(struct pt_image_map *map)
+{
+	if (!map)
+		return;
+
+	(void) pt_atomic_inc32(&map->ucount);
+}
+
+static void pt_image_map_put(struct pt_image_map *map)
+{
+	if (!map)
+		return;
+
+	if (!pt_atomic_dec32(&map->ucount))
+		pt_image_map_free(map);
+}
+
+/* Find the partition for @cr3 in @map.
+ *
+ * Returns the partition of sections without a CR3 value if @cr3 is
+ * pt_asid_no_cr3.
+ *
+ * Returns the partition if it exists, NULL otherwise.
+ */
+static struct pt_image_partition *
+pt_image_map_find(const struct pt_image_map *map, uint64_t cr3)
+{
+	struct pt_image_partition *partition;
+	uint32_t slot;
+
+	if (cr3 == pt_asid_no_cr3)
+		return &map->partitions[map->mask + 1];
+
+	slot = pt_image_map_slot(map->partitions, map->mask, cr3);
+	partition = &map->partitions[slot];
+	if (partition->cr3 == pt_asid_no_cr3)
+		return NULL;
+
+	return partition;
+}
+
+/* Iterate over the partitions of @map that may hold sections in @asid.
+ *
+ * Start with zero in @pslot.  If @asid is NULL, iterates over all partitions.
+ *
+ * Returns the next partition with sections, NULL at the end.
+ */
+static struct pt_image_partition *
+pt_image_map_next(const struct pt_image_map *map, const struct pt_asid *asid,
+		  uint32_t *pslot)
+{
+	struct pt_image_partition *partition;
+	uint32_t slot;
+
+	if (!map)
+		return NULL;
+
+	/* An address space without a CR3 value matches every section. */
+	if (!asid || asid->cr3 == pt_asid_no_cr3) {
+		for (slot = *pslot; slot <= map->mask + 1; ++slot) {
+			partition = &map->partitions[slot];
+			if (partition->sections) {
+				*pslot = slot + 1;
+				return partition;
+			}
+		}
+
+		*pslot = slot;
+		return NULL;
+	}
+
+	/* Otherwise, only @asid's partition and the sections without a CR3
+	 * value, which match every address space, are of interest.
+	 */
+	for (slot = *pslot; slot < 2; ++slot) {
+		if (slot)
+			partition = &map->partitions[map->mask + 1];
+		else
+			partition = pt_image_map_find(map, asid->cr3);
+
+		if (partition && partition->sections) {
+			*pslot = slot + 1;
+			return partition;
+		}
+	}
+
+	*pslot = slot;
+	return NULL;
+}
+
+/* Make the map at @pmap exclusively owned.
+ *
+ * If the map at @pmap is shared, replace it with a copy that shares the lists
+ * of sections.  The copy keeps the layout of the hash table so slots remain
+ * valid.  If there is no map, create an empty one.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_map_unshare(struct pt_image_map **pmap)
+{
+	struct pt_image_map *map, *copy;
+	uint32_t slot;
+
+	if (!pmap)
+		return -pte_internal;
+
+	map = *pmap;
+	if (!map) {
+		map = pt_mk_image_map(pt_image_map_nslots(0));
+		if (!map)
+			return -pte_nomem;
+
+		*pmap = map;
+		return 0;
+	}
+
+	/* If we hold the only reference, nobody else can obtain one. */
+	if (pt_atomic_load32(&map->ucount) <= 1)
+		return 0;
+
+	copy = pt_mk_image_map(map->mask + 1);
+	if (!copy)
+		return -pte_nomem;
+
+	for (slot = 0; slot <= map->mask + 1; ++slot) {
+		copy->partitions[slot] = map->partitions[slot];
+		pt_section_list_get(copy->partitions[slot].sections);
+	}
+
+	copy->nused = map->nused;
+	copy->nsections = map->nsections;
+
+	/* Other users may have dropped their references in the meantime. */
+	pt_image_map_put(map);
+	*pmap = copy;
+
+	return 0;
+}
+
+/* Rebuild the hash table of an exclusively owned @map.
+ *
+ * Drops partitions without sections and makes room for one more partition.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_map_rehash(struct pt_image_map *map)
+{
+	struct pt_image_partition *partitions;
+	uint32_t slot, nused, nslots;
+
+	nused = 0;
+	for (slot = 0; slot <= map->mask; ++slot) {
+		if (map->partitions[slot].sections)
+			nused += 1;
+	}
+
+	nslots = pt_image_map_nslots(nused + 1);
+	if (!nslots)
+		return -pte_nomem;
+
+	partitions = malloc((nslots + 1) * sizeof(*partitions));
+	if (!partitions)
+		return -pte_nomem;
+
+	for (slot = 0; slot < nslots; ++slot) {
+		partitions[slot].cr3 = pt_asid_no_cr3;
+		partitions[slot].sections = NULL;
+	}
+
+	partitions[nslots] = map->partitions[map->mask + 1];
+
+	for (slot = 0; slot <= map->mask; ++slot) {
+		const struct pt_image_partition *partition;
+		uint32_t pos;
+
+		partition = &map->partitions[slot];
+		if (!partition->sections)
+			continue;
+
+		pos = pt_image_map_slot(partitions, nslots - 1, partition->cr3);
+		partitions[pos] = *partition;
+	}
+
+	free(map->partitions);
+
+	map->partitions = partitions;
+	map->mask = nslots - 1;
+	map->nused = nused;
+
+	return 0;
+}
+
+/* Provide the partition for @cr3 in the map at @pmap for modification.
+ *
+ * Makes the map exclusively owned and adds the partition if it does not
+ * exist.  This may move other partitions.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_map_partition(struct pt_image_map **pmap,
+				  struct pt_image_partition **ppartition,
+				  uint64_t cr3)
+{
+	struct pt_image_partition *partition;
+	struct pt_image_map *map;
+	int errcode;
+
+	if (!ppartition)
+		return -pte_internal;
+
+	errcode = pt_image_map_unshare(pmap);
+	if (errcode < 0)
+		return errcode;
+
+	map = *pmap;
+
+	partition = pt_image_map_find(map, cr3);
+	if (!partition) {
+		uint32_t slot;
+
+		if ((map->mask + 1) < (map->nused + 1) * 2) {
+			errcode = pt_image_map_rehash(map);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		slot = pt_image_map_slot(map->partitions, map->mask, cr3);
+		partition = &map->partitions[slot];
+		partition->cr3 = cr3;
+
+		map->nused += 1;
+	}
+
+	*ppartition = partition;
+
+	return 0;
+}
+
+/* Save the map of @image in @psaved.
+ *
+ * We keep a reference to the saved map.  While we hold it, modifications of
+ * @image apply to a copy of the map so they can be undone.
+ *
+ * Use pt_image_restore_map() to undo the modifications or pt_image_map_put()
+ * to keep them.
+ */
+static void pt_image_save_map(const struct pt_image *image,
+			      struct pt_image_map **psaved)
+{
+	*psaved = image->map;
+
+	pt_image_map_get(*psaved);
+}
+
+/* Restore the map of @image saved in @saved.
+ *
+ * We pass our reference to @saved on to @image.
+ */
+static void pt_image_restore_map(struct pt_image *image,
+				 struct pt_image_map *saved)
+{
+	pt_image_map_put(image->map);
+	image->map = saved;
+}
+
+/* Allocate a snapshot.
+ *
+ * The snapshot is filled in when it is published.
+ */
+static struct pt_image_snapshot *pt_mk_image_snapshot(void)
+{
+	return malloc(sizeof(struct pt_image_snapshot));
+}
+
+static void pt_image_snapshot_free(struct pt_image_snapshot *snapshot)
+{
+	if (!snapshot)
+		return;
+
+	pt_image_map_put(snapshot->map);
+	free(snapshot->garbage);
+	free(snapshot);
+}
+
+/* Free retired snapshots of @image that are no longer in use.
+ *
+ * We advance the epoch if all readers that entered in the previous epoch have
+ * left.  A snapshot that was retired in epoch e may be in use by readers that
+ * entered in epoch e or earlier.  It can be freed when we reached epoch e + 2.
+ */
+static void pt_image_reclaim(struct pt_image *image)
+{
+	struct pt_image_snapshot **pretired;
+	uint32_t epoch;
+	int advance;
+
+	for (advance = 0; advance < 2; ++advance) {
+		epoch = pt_atomic_load32(&image->epoch);
+
+		/* The previous epoch has the same parity as the next. */
+		if (pt_atomic_load32(&image->readers[(epoch + 1) & 1]))
+			break;
+
+		pt_atomic_store32(&image->epoch, epoch + 1);
+	}
+
+	epoch = pt_atomic_load32(&image->epoch);
+
+	for (pretired = &image->retired; *pretired;) {
+		struct pt_image_snapshot *snapshot;
+
+		snapshot = *pretired;
+		if ((uint32_t) (epoch - snapshot->epoch) < 2) {
+			pretired = &snapshot->next;
+			continue;
+		}
+
+		*pretired = snapshot->next;
+		pt_image_snapshot_free(snapshot);
+	}
+}
+
+/* Publish the current state of @image in @snapshot.
+ *
+ * Retires the previous snapshot and frees retired snapshots that are no longer
+ * in use.
+ */
+static void pt_image_publish(struct pt_image *image,
+			     struct pt_image_snapshot *snapshot)
+{
+	struct pt_image_snapshot *old;
+
+	/* Only writers modify @image->snapshot. */
+	old = image->snapshot;
+
+	snapshot->map = image->map;
+	snapshot->tsc = image->tsc;
+	snapshot->versions = image->versions;
+	snapshot->nversions = image->nversions;
+	snapshot->epoch = 0;
+	snapshot->cache = NULL;
+	snapshot->garbage = NULL;
+	snapshot->next = NULL;
+
+	pt_image_map_get(snapshot->map);
+
+	pt_atomic_store_ptr(&image->snapshot, snapshot);
+	(void) pt_atomic_inc32(&image->generation);
+
+	if (old) {
+		old->epoch = pt_atomic_load32(&image->epoch);
+		old->garbage = image->garbage;
+		old->next = image->retired;
+
+		image->retired = old;
+		image->garbage = NULL;
+	}
+
+	pt_image_reclaim(image);
+}
+
+/* Enter a read-side critical section.
+ *
+ * The current snapshot and all list elements reachable from it remain valid
+ * until we leave.
+ *
+ * Returns the epoch parity to pass to pt_image_leave().
+ */
+static uint32_t pt_image_enter(struct pt_image *image)
+{
+	for (;;) {
+		uint32_t epoch, parity;
+
+		epoch = pt_atomic_load32(&image->epoch);
+		parity = epoch & 1;
+
+		(void) pt_atomic_inc32(&image->readers[parity]);
+
+		/* If the epoch changed in the meantime, writers may have
+		 * missed us.  Try again.
+		 */
+		if (pt_atomic_load32(&image->epoch) == epoch)
+			return parity;
+
+		(void) pt_atomic_dec32(&image->readers[parity]);
+	}
+}
+
+/* Leave a read-side critical section entered with parity @parity. */
+static void pt_image_leave(struct pt_image *image, uint32_t parity)
+{
+	(void) pt_atomic_dec32(&image->readers[parity]);
+}
+
 void pt_image_init(struct pt_image *image, const char *name)
 {
 	if (!image)
 		return;
 
-	memset(image, 0, sizeof(*image));
+	memset(image, 0, sizeof(*image));
+
+	image->name = dupstr(name);
+
+	pt_read_cache_init(&image->readmem.cache);
+}
+
+int pt_image_init_copy(struct pt_image *image, const struct pt_image *src,
+		       const char *name)
+{
+	struct pt_image_snapshot *snapshot;
+	const struct pt_read_cache *cache;
+	int errcode;
+
+	if (!image || !src)
+		return -pte_internal;
+
+	pt_image_init(image, name);
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot) {
+		pt_image_fini(image);
+		return -pte_nomem;
+	}
+
+	cache = &src->readmem.cache;
+	errcode = pt_read_cache_configure(&image->readmem.cache,
+					  cache->page_size, cache->nentries);
+	if (errcode < 0) {
+		free(snapshot);
+		pt_image_fini(image);
+		return errcode;
+	}
+
+	if (src->nversions) {
+		uint32_t version;
+
+		image->versions = malloc(src->nversions *
+					 sizeof(*image->versions));
+		if (!image->versions) {
+			free(snapshot);
+			pt_image_fini(image);
+			return -pte_nomem;
+		}
+
+		for (version = 0; version < src->nversions; ++version) {
+			struct pt_image_version *copy;
+
+			copy = &image->versions[version];
+			copy->tsc = src->versions[version].tsc;
+			copy->map = src->versions[version].map;
+			copy->cache = NULL;
+
+			pt_image_map_get(copy->map);
+		}
+
+		image->nversions = src->nversions;
+		image->capacity = src->nversions;
+	}
+
+	image->map = src->map;
+	image->tsc = src->tsc;
+	image->readmem.callback = src->readmem.callback;
+	image->readmem.context = src->readmem.context;
+
+	pt_image_map_get(image->map);
+
+	pt_image_publish(image, snapshot);
+
+	return 0;
+}
+
+void pt_image_fini(struct pt_image *image)
+{
+	if (!image)
+		return;
+
+	pt_image_snapshot_free(image->snapshot);
+
+	while (image->retired) {
+		struct pt_image_snapshot *trash;
+
+		trash = image->retired;
+		image->retired = trash->next;
+
+		pt_image_snapshot_free(trash);
+	}
+
+	free(image->garbage);
+
+	while (image->nversions) {
+		struct pt_image_version *version;
+
+		image->nversions -= 1;
+
+		version = &image->versions[image->nversions];
+		pt_image_map_put(version->map);
+	}
+
+	pt_image_map_put(image->map);
+	pt_read_cache_fini(&image->readmem.cache);
+
+	free(image->versions);
+
+	free(image->name);
+
+	memset(image, 0, sizeof(*image));
+}
+
+struct pt_image *pt_image_alloc(const char *name)
+{
+	struct pt_image *image;
+
+	image = malloc(sizeof(*image));
+	if (image)
+		pt_image_init(image, name);
+
+	return image;
+}
+
+struct pt_image *pt_image_copy(const struct pt_image *src, const char *name)
+{
+	struct pt_image *image;
+	int errcode;
+
+	image = malloc(sizeof(*image));
+	if (!image)
+		return NULL;
+
+	errcode = pt_image_init_copy(image, src, name);
+	if (errcode < 0) {
+		free(image);
+		return NULL;
+	}
+
+	return image;
+}
+
+void pt_image_free(struct pt_image *image)
+{
+	pt_image_fini(image);
+	free(image);
+}
+
+const char *pt_image_name(const struct pt_image *image)
+{
+	if (!image)
+		return NULL;
+
+	return image->name;
+}
+
+int pt_image_add(struct pt_image *image, struct pt_section *section,
+		 const struct pt_asid *asid, uint64_t vaddr)
+{
+	return pt_image_add_range(image, section, asid, vaddr, 0ull,
+				  pt_section_size(section));
+}
+
+/* Remove @image's map if it does not hold any sections.
+ *
+ * An empty image does not have a map.
+ */
+static void pt_image_shrink(struct pt_image *image)
+{
+	if (!image->map || image->map->nsections)
+		return;
+
+	pt_image_map_put(image->map);
+	image->map = NULL;
+}
+
+/* Add part of a section to an image without publishing the change.
+ *
+ * See pt_image_add_range().
+ */
+static int pt_image_insert(struct pt_image *image, struct pt_section *section,
+			   const struct pt_asid *asid, uint64_t vaddr,
+			   uint64_t offset, uint64_t size)
+{
+	struct pt_image_partition *partition;
+	struct pt_section_list *next;
+	uint64_t begin, end, ssize;
+	uint32_t slot;
+	int errcode;
+
+	if (!image || !section || !asid)
+		return -pte_internal;
+
+	ssize = pt_section_size(section);
+	if (ssize < offset || ssize - offset < size)
+		return -pte_internal;
+
+	begin = vaddr;
+	end = begin + size;
+
+	/* Check for overlaps. */
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, asid, &slot))) {
+		const struct pt_section_list *list;
+
+		for (list = partition->sections; list; list = list->next) {
+			const struct pt_mapped_section *msec;
+			uint64_t lbegin, lend;
+
+			msec = &list->section;
+
+			errcode = pt_msec_matches_asid(msec, asid);
+			if (errcode < 0)
+				return errcode;
+
+			if (!errcode)
+				continue;
+
+			lbegin = pt_msec_begin(msec);
+			lend = pt_msec_end(msec);
+
+			if (end <= lbegin)
+				continue;
+			if (lend <= begin)
+				continue;
+
+			return -pte_bad_image;
+		}
+	}
+
+	errcode = pt_image_map_partition(&image->map, &partition, asid->cr3);
+	if (errcode < 0) {
+		pt_image_shrink(image);
+		return errcode;
+	}
+
+	next = pt_mk_section_list(section, asid, vaddr, offset, size);
+	if (!next) {
+		pt_image_shrink(image);
+		return -pte_nomap;
+	}
+
+	/* We add new sections at the front so the rest of the list may be
+	 * shared with copies of @image.
+	 *
+	 * We pass our reference to the old head on to @next.
+	 */
+	next->next = partition->sections;
+	partition->sections = next;
+	image->map->nsections += 1;
+
+	return 0;
+}
+
+int pt_image_add_range(struct pt_image *image, struct pt_section *section,
+		       const struct pt_asid *asid, uint64_t vaddr,
+		       uint64_t offset, uint64_t size)
+{
+	struct pt_image_snapshot *snapshot;
+	int errcode;
+
+	if (!image)
+		return -pte_internal;
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot)
+		return -pte_nomem;
+
+	errcode = pt_image_insert(image, section, asid, vaddr, offset, size);
+	if (errcode < 0) {
+		free(snapshot);
+		return errcode;
+	}
+
+	pt_image_publish(image, snapshot);
+
+	return 0;
+}
+
+/* Order image ranges by virtual address. */
+static int pt_image_range_compare(const void *lhs, const void *rhs)
+{
+	const struct pt_image_range *lrange, *rrange;
+
+	lrange = (const struct pt_image_range *) lhs;
+	rrange = (const struct pt_image_range *) rhs;
+
+	if (lrange->vaddr < rrange->vaddr)
+		return -1;
+
+	if (rrange->vaddr < lrange->vaddr)
+		return 1;
+
+	return 0;
+}
+
+/* Check whether sorted @ranges overlap with sections in @asid in @image.
+ *
+ * Returns zero if there is no overlap, a negative error code otherwise.
+ * Returns -pte_bad_image if there is an overlap.
+ */
+static int pt_image_check_ranges(const struct pt_image *image,
+				 const struct pt_image_range *ranges,
+				 size_t nranges, const struct pt_asid *asid)
+{
+	const struct pt_image_partition *partition;
+	const struct pt_section_list *list;
+	struct pt_image_range *mapped;
+	size_t nmapped, index, pos;
+	uint32_t slot;
+	int errcode;
+
+	nmapped = 0;
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, asid, &slot))) {
+		for (list = partition->sections; list; list = list->next) {
+			errcode = pt_msec_matches_asid(&list->section, asid);
+			if (errcode < 0)
+				return errcode;
+
+			if (errcode)
+				nmapped += 1;
+		}
+	}
+
+	if (!nmapped)
+		return 0;
+
+	mapped = malloc(nmapped * sizeof(*mapped));
+	if (!mapped)
+		return -pte_nomem;
+
+	pos = 0;
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, asid, &slot))) {
+		for (list = partition->sections; list; list = list->next) {
+			const struct pt_mapped_section *msec;
+
+			msec = &list->section;
+
+			errcode = pt_msec_matches_asid(msec, asid);
+			if (errcode <= 0)
+				continue;
+
+			mapped[pos].section = NULL;
+			mapped[pos].vaddr = pt_msec_begin(msec);
+			mapped[pos].offset = 0ull;
+			mapped[pos].size = pt_msec_end(msec) -
+				pt_msec_begin(msec);
+			pos += 1;
+		}
+	}
+
+	qsort(mapped, nmapped, sizeof(*mapped), pt_image_range_compare);
+
+	/* Both arrays are sorted so we can check them in a single pass. */
+	errcode = 0;
+	for (index = 0, pos = 0; index < nranges && pos < nmapped;) {
+		const struct pt_image_range *range, *msec;
+
+		range = &ranges[index];
+		msec = &mapped[pos];
+
+		if (range->vaddr + range->size <= msec->vaddr)
+			index += 1;
+		else if (msec->vaddr + msec->size <= range->vaddr)
+			pos += 1;
+		else {
+			errcode = -pte_bad_image;
+			break;
+		}
+	}
+
+	free(mapped);
+
+	return errcode;
+}
+
+int pt_image_add_ranges(struct pt_image *image, struct pt_image_range *ranges,
+			size_t nranges, const struct pt_asid *asid)
+{
+	struct pt_image_snapshot *snapshot;
+	struct pt_image_partition *partition;
+	struct pt_section_list *list, *first, **ptail;
+	size_t index;
+	int errcode;
+
+	if (!image || !asid)
+		return -pte_internal;
+
+	if (!nranges)
+		return 0;
+
+	if (!ranges)
+		return -pte_internal;
+
+	qsort(ranges, nranges, sizeof(*ranges), pt_image_range_compare);
+
+	for (index = 0; index < nranges; ++index) {
+		const struct pt_image_range *range;
+		uint64_t ssize;
+
+		range = &ranges[index];
+		if (!range->section)
+			return -pte_internal;
+
+		ssize = pt_section_size(range->section);
+		if (ssize < range->offset || ssize - range->offset < range->size)
+			return -pte_internal;
+
+		if (index && range->vaddr < ranges[index - 1].vaddr +
+		    ranges[index - 1].size)
+			return -pte_bad_image;
+	}
+
+	errcode = pt_image_check_ranges(image, ranges, nranges, asid);
+	if (errcode < 0)
+		return errcode;
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot)
+		return -pte_nomem;
+
+	errcode = pt_image_map_partition(&image->map, &partition, asid->cr3);
+	if (errcode < 0) {
+		pt_image_shrink(image);
+		free(snapshot);
+		return errcode;
+	}
+
+	first = NULL;
+	ptail = &first;
+	for (index = 0; index < nranges; ++index) {
+		const struct pt_image_range *range;
+
+		range = &ranges[index];
+
+		list = pt_mk_section_list(range->section, asid, range->vaddr,
+					  range->offset, range->size);
+		if (!list)
+			break;
+
+		*ptail = list;
+		ptail = &list->next;
+	}
+
+	if (index < nranges) {
+		/* The caller keeps its references on errors. */
+		for (list = first; list; list = list->next)
+			(void) pt_section_get(list->section.section);
+
+		pt_section_list_put(first);
+		pt_image_shrink(image);
+		free(snapshot);
+
+		return -pte_nomem;
+	}
+
+	/* We pass our reference to the old head on to the last part. */
+	*ptail = partition->sections;
+	partition->sections = first;
+	image->map->nsections += (uint32_t) nranges;
+
+	pt_image_publish(image, snapshot);
+
+	return 0;
+}
+
+/* A filter for selecting sections in an image. */
+struct pt_section_filter {
+	/* The address space - must not be NULL. */
+	const struct pt_asid *asid;
+
+	/* An optional section and the virtual address it is mapped at. */
+	const struct pt_section *section;
+	uint64_t vaddr;
+
+	/* An optional file name. */
+	const char *filename;
+
+	/* An optional memory region [@begin; @end[ - ignored if empty.
+	 *
+	 * Sections overlapping with the region are selected.
+	 */
+	uint64_t begin;
+	uint64_t end;
+};
+
+/* Check if @msec is selected by @filter.
+ *
+ * Returns a positive number if @msec is selected, zero if it is not.
+ * Returns a negative error code otherwise.
+ */
+static int pt_section_filter_match(const struct pt_section_filter *filter,
+				   const struct pt_mapped_section *msec)
+{
+	int errcode;
+
+	if (!filter || !msec)
+		return -pte_internal;
+
+	errcode = pt_msec_matches_asid(msec, filter->asid);
+	if (errcode <= 0)
+		return errcode;
+
+	if (filter->section) {
+		if (msec->section != filter->section)
+			return 0;
+
+		if (msec->vaddr != filter->vaddr)
+			return 0;
+	}
+
+	if (filter->filename) {
+		const char *name;
+
+		name = pt_section_filename(msec->section);
+		if (!name)
+			return 0;
+
+		if (strcmp(name, filter->filename) != 0)
+			return 0;
+	}
+
+	if (filter->begin < filter->end) {
+		if (pt_msec_end(msec) <= filter->begin)
+			return 0;
+
+		if (filter->end <= pt_msec_begin(msec))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Find the last section in @list that is selected by @filter.
+ *
+ * Returns a positive number and provides the section's list element in @plast
+ * if there is such a section, zero if there is not.
+ * Returns a negative error code otherwise.
+ */
+static int pt_section_list_find_last(struct pt_section_list **plast,
+				     struct pt_section_list *list,
+				     const struct pt_section_filter *filter)
+{
+	struct pt_section_list *last;
+
+	last = NULL;
+	for (; list; list = list->next) {
+		int errcode;
+
+		errcode = pt_section_filter_match(filter, &list->section);
+		if (errcode < 0)
+			return errcode;
+
+		if (errcode)
+			last = list;
+	}
+
+	*plast = last;
+
+	return last ? 1 : 0;
+}
+
+/* Remove all sections selected by @filter from @plist in @map.
+ *
+ * List elements that are shared with other maps are copied on the way to the
+ * last selected section @last.  The rest of the list remains shared.
+ *
+ * Returns the number of removed sections on success, a negative error code
+ * otherwise.
+ */
+static int pt_section_list_remove(struct pt_image_map *map,
+				  struct pt_section_list **plist,
+				  const struct pt_section_list *last,
+				  const struct pt_section_filter *filter)
+{
+	struct pt_section_list *list;
+	int removed;
+
+	removed = 0;
+	while (*plist) {
+		int errcode, done;
+
+		list = *plist;
+		done = (list == last);
+
+		errcode = pt_section_filter_match(filter, &list->section);
+		if (errcode < 0)
+			return errcode;
+
+		if (errcode) {
+			*plist = list->next;
+
+			pt_section_list_get(list->next);
+			pt_section_list_put(list);
+
+			map->nsections -= 1;
+			removed += 1;
+		} else {
+			errcode = pt_section_list_unshare(plist);
+			if (errcode < 0)
+				return errcode;
+
+			plist = &(*plist)->next;
+		}
+
+		if (done)
+			break;
+	}
+
+	return removed;
+}
+
+/* Remove all sections selected by @filter from @image.
+ *
+ * Only partitions that may hold sections in @filter's address space are
+ * modified.  The other partitions remain shared.
+ *
+ * On errors, @image is not modified.
+ *
+ * Returns the number of removed sections on success, a negative error code
+ * otherwise.
+ */
+static int pt_image_remove_filtered(struct pt_image *image,
+				    const struct pt_section_filter *filter)
+{
+	struct pt_image_partition *partition;
+	struct pt_image_map *saved;
+	uint32_t slot;
+	int removed, errcode;
+
+	if (!image || !filter || !filter->asid)
+		return -pte_internal;
+
+	pt_image_save_map(image, &saved);
+
+	removed = 0;
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, filter->asid,
+					      &slot))) {
+		struct pt_section_list *last;
+
+		/* Find the last section we need to remove so we do not copy
+		 * any shared list elements beyond it.
+		 */
+		errcode = pt_section_list_find_last(&last, partition->sections,
+						    filter);
+		if (errcode < 0)
+			goto out;
+
+		if (!errcode)
+			continue;
+
+		/* A shared map is copied before we modify it.  The copy keeps
+		 * the position of @partition.
+		 */
+		errcode = pt_image_map_partition(&image->map, &partition,
+						 partition->cr3);
+		if (errcode < 0)
+			goto out;
+
+		errcode = pt_section_list_remove(image->map,
+						 &partition->sections, last,
+						 filter);
+		if (errcode < 0)
+			goto out;
+
+		removed += errcode;
+	}
+
+	pt_image_map_put(saved);
+	pt_image_shrink(image);
+
+	return removed;
+
+out:
+	pt_image_restore_map(image, saved);
+	return errcode;
+}
+
+/* Remove all sections selected by @filter from @image and publish the result.
+ *
+ * Returns the number of removed sections on success, a negative error code
+ * otherwise.
+ */
+static int pt_image_remove_and_publish(struct pt_image *image,
+				       const struct pt_section_filter *filter)
+{
+	struct pt_image_snapshot *snapshot;
+	int removed;
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot)
+		return -pte_nomem;
+
+	removed = pt_image_remove_filtered(image, filter);
+	if (removed <= 0) {
+		free(snapshot);
+		return removed;
+	}
+
+	pt_image_publish(image, snapshot);
+
+	return removed;
+}
+
+int pt_image_remove(struct pt_image *image, struct pt_section *section,
+		    const struct pt_asid *asid, uint64_t vaddr)
+{
+	struct pt_section_filter filter;
+	int removed;
+
+	if (!image || !section)
+		return -pte_internal;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.asid = asid;
+	filter.section = section;
+	filter.vaddr = vaddr;
+
+	removed = pt_image_remove_and_publish(image, &filter);
+	if (removed < 0)
+		return removed;
+
+	if (!removed)
+		return -pte_bad_image;
+
+	return 0;
+}
+
+int pt_image_add_file(struct pt_image *image, const char *filename,
+		      uint64_t offset, uint64_t size,
+		      const struct pt_asid *uasid, uint64_t vaddr)
+{
+	struct pt_section *section;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!image || !filename)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	section = pt_mk_section(filename, offset, size);
+	if (!section)
+		return -pte_invalid;
+
+	errcode = pt_image_add(image, section, &asid, vaddr);
+	if (errcode < 0)
+		(void) pt_section_put(section);
+
+	return errcode;
+}
+
+int pt_image_add_elf(struct pt_image *image, const char *filename,
+		     const struct pt_asid *uasid, uint64_t load_bias)
+{
+	struct pt_section *section;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!image || !filename)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	section = pt_mk_section(filename, 0ull, UINT64_MAX);
+	if (!section)
+		return -pte_invalid;
+
+	/* Each segment takes its own reference to @section. */
+	errcode = pt_elf_add_segments(image, section, &asid, load_bias,
+				      pt_elf_pf_x);
+
+	(void) pt_section_put(section);
+
+	return errcode;
+}
+
+int pt_image_add_core(struct pt_image *image, const char *filename,
+		      const struct pt_asid *uasid)
+{
+	struct pt_elf_header header;
+	struct pt_section *section;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!image || !filename)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	section = pt_mk_section(filename, 0ull, UINT64_MAX);
+	if (!section)
+		return -pte_invalid;
+
+	errcode = pt_elf_read_header(&header, section);
+	if (errcode >= 0 && header.type != pt_elf_type_core)
+		errcode = -pte_invalid;
+
+	/* Each segment takes its own reference to @section. */
+	if (errcode >= 0)
+		errcode = pt_elf_add_segments(image, section, &asid, 0ull, 0);
+
+	(void) pt_section_put(section);
+
+	return errcode;
+}
+
+int pt_image_add_maps(struct pt_image *image, const char *maps,
+		      const struct pt_asid *uasid)
+{
+	struct pt_asid asid;
+	char *text;
+	int errcode;
+
+	if (!image || !maps)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	text = dupstr(maps);
+	if (!text)
+		return -pte_nomem;
+
+	errcode = pt_maps_add(image, text, &asid);
+
+	free(text);
+
+	return errcode;
+}
+
+int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
+				const struct pt_asid *uasid)
+{
+	struct pt_section_filter filter;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!image || !filename)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.asid = &asid;
+	filter.filename = filename;
+
+	return pt_image_remove_and_publish(image, &filter);
+}
+
+int pt_image_remove_by_asid(struct pt_image *image,
+			    const struct pt_asid *uasid)
+{
+	struct pt_section_filter filter;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!image)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.asid = &asid;
+
+	return pt_image_remove_and_publish(image, &filter);
+}
+
+/* Create a list element for part of the section mapped in @msec.
+ *
+ * The part is mapped at @vaddr, which must lie inside @msec, and spans @size
+ * bytes.  It takes its own reference to @msec's section.
+ *
+ * Returns the new list element on success, NULL otherwise.
+ */
+static struct pt_section_list *
+pt_mk_section_part(const struct pt_mapped_section *msec, uint64_t vaddr,
+		   uint64_t size)
+{
+	struct pt_section_list *part;
+	int errcode;
+
+	if (!msec || vaddr < msec->vaddr)
+		return NULL;
+
+	errcode = pt_section_get(msec->section);
+	if (errcode < 0)
+		return NULL;
+
+	part = pt_mk_section_list(msec->section, &msec->asid, vaddr,
+				  msec->offset + (vaddr - msec->vaddr), size);
+	if (!part)
+		(void) pt_section_put(msec->section);
+
+	return part;
+}
+
+/* Unmap a memory region from an image.
+ *
+ * Removes sections in @asid that lie completely inside the region of @size
+ * bytes starting at @vaddr and trims sections that overlap with it.
+ *
+ * On errors, @image is not modified.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_unmap(struct pt_image *image, const struct pt_asid *asid,
+			  uint64_t vaddr, uint64_t size)
+{
+	struct pt_image_partition *partition;
+	struct pt_section_filter filter;
+	struct pt_section_list *list, *rest, **ptail;
+	struct pt_image_map *saved;
+	uint32_t slot;
+	int errcode;
+
+	if (!image)
+		return -pte_internal;
+
+	if (!size)
+		return 0;
+
+	pt_image_save_map(image, &saved);
+
+	memset(&filter, 0, sizeof(filter));
+	filter.asid = asid;
+	filter.begin = vaddr;
+	filter.end = vaddr + size;
+
+	if (filter.end < filter.begin)
+		filter.end = UINT64_MAX;
+
+	/* Collect the parts of selected sections outside of the region. */
+	rest = NULL;
+	ptail = &rest;
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, asid, &slot))) {
+		for (list = partition->sections; list; list = list->next) {
+			const struct pt_mapped_section *msec;
+			struct pt_section_list *part;
+			uint64_t begin, end;
+
+			msec = &list->section;
+
+			errcode = pt_section_filter_match(&filter, msec);
+			if (errcode < 0)
+				goto out;
+
+			if (!errcode)
+				continue;
+
+			begin = pt_msec_begin(msec);
+			end = pt_msec_end(msec);
+
+			if (begin < filter.begin) {
+				part = pt_mk_section_part(msec, begin,
+							  filter.begin - begin);
+				if (!part) {
+					errcode = -pte_nomem;
+					goto out;
+				}
+
+				*ptail = part;
+				ptail = &part->next;
+			}
+
+			if (filter.end < end) {
+				part = pt_mk_section_part(msec, filter.end,
+							  end - filter.end);
+				if (!part) {
+					errcode = -pte_nomem;
+					goto out;
+				}
+
+				*ptail = part;
+				ptail = &part->next;
+			}
+		}
+	}
+
+	errcode = pt_image_remove_filtered(image, &filter);
+	if (errcode < 0)
+		goto out;
+
+	/* Add the remaining parts at the front of their partitions. */
+	while (rest) {
+		list = rest;
+
+		errcode = pt_image_map_partition(&image->map, &partition,
+						 list->section.asid.cr3);
+		if (errcode < 0)
+			goto out;
+
+		/* We pass our reference to the rest of the parts on to @rest
+		 * and our reference to the old head on to @list.
+		 */
+		rest = list->next;
+		list->next = partition->sections;
+		partition->sections = list;
+		image->map->nsections += 1;
+	}
+
+	pt_image_map_put(saved);
+
+	return 0;
+
+out:
+	pt_section_list_put(rest);
+	pt_image_restore_map(image, saved);
+	return errcode;
+}
+
+/* Begin a new version of @image at @tsc.
+ *
+ * If @tsc lies beyond the beginning of the current version, the current
+ * version is preserved and subsequent changes apply to a new version.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if @tsc lies before the current version.
+ * Returns -pte_nomem if the current version could not be preserved.
+ */
+static int pt_image_begin_version(struct pt_image *image, uint64_t tsc)
+{
+	struct pt_image_version *version;
+
+	if (!image)
+		return -pte_internal;
+
+	if (tsc < image->tsc)
+		return -pte_invalid;
+
+	if (tsc == image->tsc)
+		return 0;
+
+	if (image->nversions == image->capacity) {
+		struct pt_image_version *versions;
+		uint32_t capacity;
+
+		capacity = image->capacity ? image->capacity * 2 : 8;
+		if (capacity < image->capacity)
+			return -pte_nomem;
+
+		versions = malloc(capacity * sizeof(*versions));
+		if (!versions)
+			return -pte_nomem;
+
+		/* Readers may be updating the cache fields in the old array
+		 * so we do not copy them.
+		 */
+		for (version = versions;
+		     version < versions + image->nversions; ++version) {
+			const struct pt_image_version *old;
+
+			old = &image->versions[version - versions];
+
+			version->tsc = old->tsc;
+			version->map = old->map;
+			version->cache = NULL;
+		}
+
+		/* Readers may still be using the old array via the current
+		 * snapshot.  We free it together with that snapshot.
+		 */
+		if (image->snapshot &&
+		    image->snapshot->versions == image->versions)
+			image->garbage = image->versions;
+		else
+			free(image->versions);
+
+		image->versions = versions;
+		image->capacity = capacity;
+	}
+
+	/* Readers of the current snapshot do not access this entry. */
+	version = &image->versions[image->nversions];
+	version->tsc = image->tsc;
+	version->map = image->map;
+	version->cache = NULL;
+
+	pt_image_map_get(version->map);
+
+	image->nversions += 1;
+	image->tsc = tsc;
+
+	return 0;
+}
+
+int pt_image_apply(struct pt_image *image,
+		   const struct pt_image_record *record)
+{
+	struct pt_image_snapshot *snapshot;
+	struct pt_image_map *saved;
+	struct pt_section *section;
+	struct pt_asid asid;
+	uint64_t tsc;
+	uint32_t nversions;
+	int errcode;
+
+	if (!image || !record)
+		return -pte_invalid;
+
+	if (record->tsc < image->tsc)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, record->asid);
+	if (errcode < 0)
+		return errcode;
+
+	section = NULL;
+	switch (record->type) {
+	case ptir_add:
+		section = pt_mk_section(record->filename, record->offset,
+					record->size);
+		if (!section)
+			return -pte_invalid;
+		break;
+
+	case ptir_remove:
+		break;
+
+	default:
+		return -pte_invalid;
+	}
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot) {
+		if (section)
+			(void) pt_section_put(section);
+
+		return -pte_nomem;
+	}
+
+	/* We apply the record completely or not at all. */
+	pt_image_save_map(image, &saved);
+	nversions = image->nversions;
+	tsc = image->tsc;
+
+	errcode = pt_image_begin_version(image, record->tsc);
+	if (errcode >= 0)
+		errcode = pt_image_unmap(image, &asid, record->vaddr,
+					 record->size);
+
+	if (errcode >= 0 && section) {
+		errcode = pt_image_insert(image, section, &asid, record->vaddr,
+					  0ull, pt_section_size(section));
+		if (errcode >= 0)
+			section = NULL;
+	}
+
+	if (section)
+		(void) pt_section_put(section);
+
+	if (errcode < 0) {
+		pt_image_restore_map(image, saved);
+
+		/* The versions array may have grown but the old versions are
+		 * still in place.
+		 */
+		while (nversions < image->nversions) {
+			image->nversions -= 1;
+			pt_image_map_put(image->versions[image->nversions].map);
+		}
+
+		image->tsc = tsc;
+
+		free(snapshot);
+		return errcode;
+	}
+
+	pt_image_map_put(saved);
+
+	/* We publish the unmap and the map together. */
+	pt_image_publish(image, snapshot);
+
+	return 0;
+}
+
+int pt_image_add_buffer(struct pt_image *image, const uint8_t *buffer,
+			uint64_t size, const struct pt_asid *uasid,
+			uint64_t vaddr, uint32_t generation,
+			release_memory_callback_t *release, void *context)
+{
+	const struct pt_image_partition *partition;
+	struct pt_image_snapshot *snapshot;
+	struct pt_section_filter filter;
+	struct pt_section_list *list;
+	struct pt_image_map *saved;
+	struct pt_section *section;
+	struct pt_asid asid;
+	uint32_t slot;
+	int errcode;
+
+	if (!image || !buffer || !size)
+		return -pte_invalid;
+
+	if (vaddr + size < vaddr)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	memset(&filter, 0, sizeof(filter));
+	filter.asid = &asid;
+	filter.begin = vaddr;
+	filter.end = vaddr + size;
+
+	/* We may only replace older generations of buffer sections. */
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, &asid, &slot))) {
+		for (list = partition->sections; list; list = list->next) {
+			const struct pt_section *lsec;
+
+			errcode = pt_section_filter_match(&filter,
+							  &list->section);
+			if (errcode < 0)
+				return errcode;
+
+			if (!errcode)
+				continue;
+
+			lsec = list->section.section;
+			if (pt_section_filename(lsec))
+				return -pte_bad_image;
+
+			if (generation <= pt_section_generation(lsec))
+				return -pte_bad_image;
+		}
+	}
+
+	section = pt_mk_section_buffer(buffer, size, generation);
+	if (!section)
+		return -pte_nomem;
+
+	snapshot = pt_mk_image_snapshot();
+	if (!snapshot) {
+		(void) pt_section_put(section);
+		return -pte_nomem;
+	}
+
+	pt_image_save_map(image, &saved);
+
+	errcode = pt_image_unmap(image, &asid, vaddr, size);
+	if (errcode < 0) {
+		(void) pt_section_put(section);
+		goto out;
+	}
+
+	errcode = pt_image_insert(image, section, &asid, vaddr, 0ull, size);
+	if (errcode < 0) {
+		(void) pt_section_put(section);
+		goto out;
+	}
+
+	/* The section is not visible to readers before we publish it.  We
+	 * install @release only now so it is not called on errors.
+	 */
+	errcode = pt_section_set_release(section, release, context);
+	if (errcode < 0)
+		goto out;
+
+	pt_image_map_put(saved);
+
+	/* We publish the unmap and the map together. */
+	pt_image_publish(image, snapshot);
 
-	image->name = dupstr(name);
+	return 0;
+
+out:
+	/* This drops the new section if we already inserted it. */
+	pt_image_restore_map(image, saved);
+	free(snapshot);
+	return errcode;
 }
 
-void pt_image_fini(struct pt_image *image)
+/* Add the sections in @list to @manifest.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_save_list(struct pt_manifest *manifest,
+			      const struct pt_section_list *list)
 {
-	struct pt_section_list *list;
+	for (; list; list = list->next) {
+		const struct pt_mapped_section *msec;
+		struct pt_manifest_section entry;
+		const char *name;
+		int errcode;
 
-	if (!image)
-		return;
+		msec = &list->section;
 
-	for (list = image->sections; list; ) {
-		struct pt_section_list *trash;
+		/* Sections created from a buffer can not be restored. */
+		name = pt_section_filename(msec->section);
+		if (!name)
+			continue;
 
-		trash = list;
-		list = list->next;
+		errcode = pt_manifest_add_file(manifest, name);
+		if (errcode < 0)
+			return errcode;
 
-		pt_section_list_free(trash);
-	}
+		entry.file = (uint32_t) errcode;
+		entry.offset = pt_section_offset(msec->section) + msec->offset;
+		entry.size = msec->size;
+		entry.vaddr = msec->vaddr;
+		entry.cr3 = msec->asid.cr3;
+		entry.vmcs = msec->asid.vmcs;
 
-	free(image->name);
+		errcode = pt_manifest_hash(&entry.hash, msec->section,
+					   msec->offset, msec->size);
+		if (errcode < 0)
+			return errcode;
 
-	memset(image, 0, sizeof(*image));
+		errcode = pt_manifest_add_section(manifest, &entry);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
 }
 
-struct pt_image *pt_image_alloc(const char *name)
+int pt_image_save(const struct pt_image *image, const char *filename)
 {
-	struct pt_image *image;
+	const struct pt_image_partition *partition;
+	struct pt_manifest manifest;
+	uint32_t slot;
+	FILE *file;
+	int errcode;
 
-	image = malloc(sizeof(*image));
-	if (image)
-		pt_image_init(image, name);
+	if (!image || !filename)
+		return -pte_invalid;
 
-	return image;
-}
+	pt_manifest_init(&manifest);
 
-void pt_image_free(struct pt_image *image)
-{
-	pt_image_fini(image);
-	free(image);
-}
+	errcode = 0;
+	slot = 0;
+	while ((partition = pt_image_map_next(image->map, NULL, &slot))) {
+		errcode = pt_image_save_list(&manifest, partition->sections);
+		if (errcode < 0)
+			break;
+	}
 
-const char *pt_image_name(const struct pt_image *image)
-{
-	if (!image)
-		return NULL;
+	if (errcode >= 0) {
+		file = fopen(filename, "wb");
+		if (file) {
+			errcode = pt_manifest_write(&manifest, file);
+			if (fclose(file) && errcode >= 0)
+				errcode = -pte_invalid;
+		} else
+			errcode = -pte_invalid;
+	}
 
-	return image->name;
+	if (errcode >= 0)
+		errcode = (int) manifest.nsections;
+
+	pt_manifest_fini(&manifest);
+
+	return errcode;
 }
 
-int pt_image_add(struct pt_image *image, struct pt_section *section,
-		 const struct pt_asid *asid, uint64_t vaddr)
+/* Create the sections described in @manifest.
+ *
+ * Maps each file in @manifest once into @files and adds the sections in
+ * @manifest to the map at @pmap.
+ *
+ * The content of a section is only hashed if its file's size or modification
+ * time changed or are not known.  The result is stored in @unchanged for each
+ * mapped file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_image if a file is missing or has changed.
+ */
+static int pt_image_load_sections(struct pt_image_map **pmap,
+				  struct pt_section **files,
+				  uint8_t *unchanged,
+				  const struct pt_manifest *manifest)
 {
-	struct pt_section_list **list, *next;
-	uint64_t begin, end;
+	uint32_t index;
+
+	/* We add sections at the front of their partitions.  We go backwards
+	 * to preserve the order of @manifest.
+	 */
+	for (index = manifest->nsections; index > 0; --index) {
+		const struct pt_manifest_section *entry;
+		struct pt_image_partition *partition;
+		struct pt_section_list *list;
+		struct pt_section *section;
+		struct pt_asid asid;
+		uint64_t hash, ssize;
+		int errcode;
 
-	if (!image || !section)
-		return -pte_internal;
+		entry = &manifest->sections[index - 1];
 
-	begin = vaddr;
-	end = begin + pt_section_size(section);
+		section = files[entry->file];
+		if (!section) {
+			const struct pt_manifest_file *file;
 
-	/* Check for overlaps while we move to the end of the list. */
-	for (list = &(image->sections); *list; list = &((*list)->next)) {
-		const struct pt_mapped_section *msec;
-		uint64_t lbegin, lend;
-		int errcode;
+			file = &manifest->files[entry->file];
+
+			section = pt_mk_section(file->name, 0ull, UINT64_MAX);
+			if (!section)
+				return -pte_bad_image;
+
+			files[entry->file] = section;
+			unchanged[entry->file] =
+				(uint8_t) pt_manifest_file_unchanged(file);
+		}
+
+		ssize = pt_section_size(section);
+		if (ssize < entry->offset || ssize - entry->offset < entry->size)
+			return -pte_bad_image;
+
+		if (!unchanged[entry->file]) {
+			errcode = pt_manifest_hash(&hash, section,
+						   entry->offset, entry->size);
+			if (errcode < 0)
+				return errcode;
+
+			if (hash != entry->hash)
+				return -pte_bad_image;
+		}
 
-		msec = &(*list)->section;
+		pt_asid_init(&asid);
+		asid.cr3 = entry->cr3;
+		asid.vmcs = entry->vmcs;
 
-		errcode = pt_msec_matches_asid(msec, asid);
+		errcode = pt_image_map_partition(pmap, &partition, asid.cr3);
 		if (errcode < 0)
 			return errcode;
 
-		if (!errcode)
-			continue;
-
-		lbegin = pt_msec_begin(msec);
-		lend = pt_msec_end(msec);
+		errcode = pt_section_get(section);
+		if (errcode < 0)
+			return errcode;
 
-		if (end <= lbegin)
-			continue;
-		if (lend <= begin)
-			continue;
+		list = pt_mk_section_list(section, &asid, entry->vaddr,
+					  entry->offset, entry->size);
+		if (!list) {
+			(void) pt_section_put(section);
+			return -pte_nomem;
+		}
 
-		return -pte_bad_image;
+		list->next = partition->sections;
+		partition->sections = list;
+		(*pmap)->nsections += 1;
 	}
 
-	next = pt_mk_section_list(section, asid, vaddr);
-	if (!next)
-		return -pte_nomap;
-
-	*list = next;
 	return 0;
 }
 
-int pt_image_remove(struct pt_image *image, struct pt_section *section,
-		    const struct pt_asid *asid, uint64_t vaddr)
+int pt_image_load(struct pt_image *image, const char *filename)
 {
-	struct pt_section_list **list;
+	struct pt_image_snapshot *snapshot;
+	struct pt_image_map *map;
+	struct pt_section **files;
+	struct pt_manifest manifest;
+	uint32_t index;
+	uint8_t *unchanged;
+	FILE *file;
+	int errcode;
 
-	if (!image || !section)
-		return -pte_internal;
+	if (!image || !filename)
+		return -pte_invalid;
 
-	for (list = &image->sections; *list; list = &((*list)->next)) {
-		const struct pt_mapped_section *msec;
-		struct pt_section_list *trash;
-		int errcode;
+	if (image->map || image->nversions)
+		return -pte_invalid;
 
-		trash = *list;
-		msec = &trash->section;
+	file = fopen(filename, "rb");
+	if (!file)
+		return -pte_invalid;
 
-		errcode = pt_msec_matches_asid(msec, asid);
-		if (errcode < 0)
-			return errcode;
+	pt_manifest_init(&manifest);
 
-		if (!errcode)
-			continue;
+	errcode = pt_manifest_read(&manifest, file);
+	fclose(file);
 
-		if (msec->section == section && msec->vaddr == vaddr) {
-			if (image->cache == msec)
-				image->cache = NULL;
+	if (errcode < 0)
+		return errcode;
 
-			*list = trash->next;
-			pt_section_list_free(trash);
+	map = NULL;
+	snapshot = pt_mk_image_snapshot();
+	files = calloc(manifest.nfiles + 1, sizeof(*files));
+	unchanged = calloc(manifest.nfiles + 1, sizeof(*unchanged));
+
+	if (!snapshot || !files || !unchanged)
+		errcode = -pte_nomem;
+	else
+		errcode = pt_image_load_sections(&map, files, unchanged,
+						 &manifest);
+
+	/* The manifest was saved from a valid image.  We do not check for
+	 * overlaps again.
+	 */
+	if (errcode >= 0) {
+		image->map = map;
+		pt_image_publish(image, snapshot);
+
+		errcode = (int) manifest.nsections;
+		map = NULL;
+		snapshot = NULL;
+	}
 
-			return 0;
+	/* Each section holds its own reference to its file. */
+	if (files) {
+		for (index = 0; index < manifest.nfiles; ++index) {
+			if (files[index])
+				(void) pt_section_put(files[index]);
 		}
 	}
 
-	return -pte_bad_image;
+	pt_image_map_put(map);
+	free(snapshot);
+	free(unchanged);
+	free(files);
+	pt_manifest_fini(&manifest);
+
+	return errcode;
 }
 
-int pt_image_add_file(struct pt_image *image, const char *filename,
-		      uint64_t offset, uint64_t size,
-		      const struct pt_asid *uasid, uint64_t vaddr)
+int pt_image_set_callback(struct pt_image *image,
+			  read_memory_callback_t *callback, void *context)
+{
+	if (!image)
+		return -pte_invalid;
+
+	image->readmem.callback = callback;
+	image->readmem.context = context;
+
+	/* Memory we cached for the old callback may not be valid anymore. */
+	return pt_image_invalidate(image, NULL, 0ull, UINT64_MAX);
+}
+
+int pt_image_set_callback_cache(struct pt_image *image, uint32_t page_size,
+				uint32_t nr_pages)
+{
+	if (!image)
+		return -pte_invalid;
+
+	return pt_read_cache_configure(&image->readmem.cache, page_size,
+				       nr_pages);
+}
+
+int pt_image_invalidate(struct pt_image *image, const struct pt_asid *uasid,
+			uint64_t vaddr, uint64_t size)
 {
-	struct pt_section *section;
 	struct pt_asid asid;
 	int errcode;
 
-	if (!image || !filename)
+	if (!image)
 		return -pte_invalid;
 
 	errcode = pt_asid_from_user(&asid, uasid);
 	if (errcode < 0)
 		return errcode;
 
-	section = pt_mk_section(filename, offset, size);
-	if (!section)
-		return -pte_invalid;
-
-	errcode = pt_image_add(image, section, &asid, vaddr);
+	errcode = pt_read_cache_invalidate(&image->readmem.cache, &asid, vaddr,
+					   size);
 	if (errcode < 0)
-		pt_section_free(section);
+		return errcode;
 
-	return errcode;
+	(void) pt_atomic_inc32(&image->generation);
+
+	return 0;
 }
 
-int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
-				const struct pt_asid *uasid)
+/* Check if @msec contains @addr in @asid.
+ *
+ * Returns a positive number if it does, zero if it does not.
+ * Returns a negative error code otherwise.
+ */
+static int pt_image_msec_contains(const struct pt_mapped_section *msec,
+				  const struct pt_asid *asid, uint64_t addr)
 {
-	struct pt_section_list **list;
-	struct pt_asid asid;
-	int errcode, removed;
-
-	if (!image || !filename)
-		return -pte_invalid;
+	int errcode;
 
-	errcode = pt_asid_from_user(&asid, uasid);
-	if (errcode < 0)
+	errcode = pt_msec_matches_asid(msec, asid);
+	if (errcode <= 0)
 		return errcode;
 
-	removed = 0;
-	for (list = &image->sections; *list;) {
-		const struct pt_mapped_section *msec;
-		struct pt_section_list *trash;
-		const char *tname;
+	if (addr < msec->vaddr)
+		return 0;
 
-		trash = *list;
-		msec = &trash->section;
+	return (addr - msec->vaddr) < msec->size;
+}
 
-		errcode = pt_msec_matches_asid(msec, &asid);
-		if (errcode < 0)
-			return errcode;
+/* Find the section in @list that contains @addr in @asid.
+ *
+ * Returns the section on success, NULL if no section contains @addr.
+ */
+static const struct pt_mapped_section *
+pt_image_find_list(const struct pt_section_list *list,
+		   const struct pt_asid *asid, uint64_t addr)
+{
+	for (; list; list = list->next) {
+		if (pt_image_msec_contains(&list->section, asid, addr) > 0)
+			return &list->section;
+	}
 
-		if (!errcode) {
-			list = &trash->next;
-			continue;
-		}
+	return NULL;
+}
+
+/* Find the section in @map that contains @addr in @asid.
+ *
+ * If @pcache is not NULL, it points to the last section in @map that was
+ * found.  It is checked first and updated on success.
+ *
+ * Returns the section on success, NULL if no section contains @addr.
+ */
+static const struct pt_mapped_section *
+pt_image_find(const struct pt_image_map *map,
+	      const struct pt_mapped_section **pcache,
+	      const struct pt_asid *asid, uint64_t addr)
+{
+	const struct pt_image_partition *partition;
+	const struct pt_mapped_section *msec;
+	uint32_t slot;
+
+	if (pcache) {
+		msec = pt_atomic_load_ptr(pcache);
+		if (msec && pt_image_msec_contains(msec, asid, addr) > 0)
+			return msec;
+	}
 
-		tname = pt_section_filename(msec->section);
+	slot = 0;
+	do {
+		partition = pt_image_map_next(map, asid, &slot);
+		if (!partition)
+			return NULL;
 
-		if (tname && (strcmp(tname, filename) == 0)) {
-			if (image->cache == msec)
-				image->cache = NULL;
+		msec = pt_image_find_list(partition->sections, asid, addr);
+	} while (!msec);
 
-			*list = trash->next;
-			pt_section_list_free(trash);
+	if (pcache)
+		pt_atomic_store_ptr(pcache, msec);
 
-			removed += 1;
-		} else
-			list = &trash->next;
+	return msec;
+}
+
+/* Read memory from @image using the sections in @map.
+ *
+ * If @pcache is not NULL, it points to the last section in @map that
+ * satisfied a read request.
+ */
+static int pt_image_read_map(struct pt_image *image,
+			     const struct pt_image_map *map,
+			     const struct pt_mapped_section **pcache,
+			     uint8_t *buffer, uint16_t size,
+			     const struct pt_asid *asid, uint64_t addr)
+{
+	const struct pt_mapped_section *msec;
+	read_memory_callback_t *callback;
+
+	if (!image || !asid)
+		return -pte_internal;
+
+	msec = pt_image_find(map, pcache, asid, addr);
+	if (msec) {
+		int status;
+
+		status = pt_msec_read(msec, buffer, size, asid, addr);
+		if (status >= 0)
+			return status;
 	}
 
-	return removed;
+	callback = image->readmem.callback;
+	if (callback)
+		return pt_read_cache_read(&image->readmem.cache, buffer, size,
+					  asid, addr, callback,
+					  image->readmem.context);
+
+	return -pte_nomap;
 }
 
-int pt_image_remove_by_asid(struct pt_image *image,
-			    const struct pt_asid *uasid)
+int pt_image_generation(struct pt_image *image, uint32_t *generation)
 {
-	struct pt_section_list **list;
-	struct pt_asid asid;
-	int errcode, removed;
+	const struct pt_image_snapshot *snapshot;
+	uint32_t parity;
+	int versioned;
 
-	if (!image)
-		return -pte_invalid;
+	if (!image || !generation)
+		return -pte_internal;
 
-	errcode = pt_asid_from_user(&asid, uasid);
-	if (errcode < 0)
-		return errcode;
+	parity = pt_image_enter(image);
 
-	removed = 0;
-	for (list = &image->sections; *list;) {
-		const struct pt_mapped_section *msec;
-		struct pt_section_list *trash;
+	/* We publish the snapshot before we increment the generation.  If we
+	 * read an old generation, we will notice the new one next time.
+	 */
+	*generation = pt_atomic_load32(&image->generation);
 
-		trash = *list;
-		msec = &trash->section;
+	snapshot = pt_atomic_load_ptr(&image->snapshot);
+	versioned = (snapshot && snapshot->nversions) ? 1 : 0;
 
-		errcode = pt_msec_matches_asid(msec, &asid);
-		if (errcode < 0)
-			return errcode;
+	pt_image_leave(image, parity);
 
-		if (!errcode) {
-			list = &trash->next;
-			continue;
-		}
+	return versioned;
+}
 
-		if (image->cache == msec)
-			image->cache = NULL;
+int pt_image_read(struct pt_image *image, uint8_t *buffer, uint16_t size,
+		  const struct pt_asid *asid, uint64_t addr)
+{
+	struct pt_image_snapshot *snapshot;
+	uint32_t parity;
+	int status;
 
-		*list = trash->next;
-		pt_section_list_free(trash);
+	if (!image)
+		return -pte_internal;
+
+	parity = pt_image_enter(image);
+
+	snapshot = pt_atomic_load_ptr(&image->snapshot);
+	if (snapshot)
+		status = pt_image_read_map(image, snapshot->map,
+					   &snapshot->cache, buffer, size,
+					   asid, addr);
+	else
+		status = pt_image_read_map(image, NULL, NULL, buffer, size,
+					   asid, addr);
+
+	pt_image_leave(image, parity);
+
+	return status;
+}
+
+/* Return the older version of @snapshot that was valid at @tsc.
+ *
+ * Returns NULL if the latest version was valid at @tsc.
+ */
+static struct pt_image_version *
+pt_image_version_at(const struct pt_image_snapshot *snapshot, uint64_t tsc)
+{
+	uint32_t begin, end;
+
+	if (!snapshot->nversions || snapshot->tsc <= tsc)
+		return NULL;
 
-		removed += 1;
+	/* Find the last version that began at or before @tsc.  If @tsc lies
+	 * before all versions, we use the oldest version.
+	 */
+	begin = 0;
+	end = snapshot->nversions;
+	while (1 < end - begin) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (snapshot->versions[mid].tsc <= tsc)
+			begin = mid;
+		else
+			end = mid;
 	}
 
-	return removed;
+	return &snapshot->versions[begin];
 }
 
-int pt_image_set_callback(struct pt_image *image,
-			  read_memory_callback_t *callback, void *context)
+/* Select the sections of @snapshot that were valid at @tsc.
+ *
+ * Provides the map of sections and its read cache.
+ */
+static void pt_image_select(struct pt_image_snapshot *snapshot, uint64_t tsc,
+			    const struct pt_image_map **pmap,
+			    const struct pt_mapped_section ***pcache)
 {
-	if (!image)
-		return -pte_invalid;
+	struct pt_image_version *version;
 
-	image->readmem.callback = callback;
-	image->readmem.context = context;
+	if (!snapshot) {
+		*pmap = NULL;
+		*pcache = NULL;
+		return;
+	}
 
-	return 0;
+	version = pt_image_version_at(snapshot, tsc);
+	if (version) {
+		*pmap = version->map;
+		*pcache = &version->cache;
+	} else {
+		*pmap = snapshot->map;
+		*pcache = &snapshot->cache;
+	}
 }
 
-static int pt_image_read_from(struct pt_image *image,
-			      const struct pt_mapped_section *msec,
-			      uint8_t *buffer, uint16_t size,
-			      const struct pt_asid *asid, uint64_t addr)
+int pt_image_read_at(struct pt_image *image, uint8_t *buffer, uint16_t size,
+		     const struct pt_asid *asid, uint64_t addr, uint64_t tsc)
 {
+	const struct pt_mapped_section **pcache;
+	const struct pt_image_map *map;
+	uint32_t parity;
 	int status;
 
 	if (!image)
 		return -pte_internal;
 
-	status = pt_msec_read(msec, buffer, size, asid, addr);
-	if (status >= 0)
-		image->cache = msec;
+	parity = pt_image_enter(image);
+
+	pt_image_select(pt_atomic_load_ptr(&image->snapshot), tsc, &map,
+			&pcache);
+
+	status = pt_image_read_map(image, map, pcache, buffer, size, asid,
+				   addr);
+
+	pt_image_leave(image, parity);
 
 	return status;
 }
 
-int pt_image_read(struct pt_image *image, uint8_t *buffer, uint16_t size,
-		  const struct pt_asid *asid, uint64_t addr)
+int pt_image_peek_at(struct pt_image *image, const uint8_t **begin,
+		     uint8_t *buffer, uint16_t size, const struct pt_asid *asid,
+		     uint64_t addr, uint64_t tsc)
 {
-	struct pt_section_list *list;
-	read_memory_callback_t *callback;
+	const struct pt_mapped_section **pcache, *msec;
+	const struct pt_image_map *map;
+	uint32_t parity;
 	int status;
 
-	if (!image || !asid)
+	if (!image || !begin || !asid)
 		return -pte_internal;
 
-	status = pt_image_read_from(image, image->cache, buffer, size, asid,
-				    addr);
-	if (status >= 0)
-		return status;
+	parity = pt_image_enter(image);
 
-	for (list = image->sections; list; list = list->next) {
-		struct pt_mapped_section *msec;
+	pt_image_select(pt_atomic_load_ptr(&image->snapshot), tsc, &map,
+			&pcache);
 
-		msec = &list->section;
-		status = pt_image_read_from(image, msec, buffer, size, asid,
-					    addr);
+	msec = pt_image_find(map, pcache, asid, addr);
+	if (msec)
+		status = pt_msec_peek(msec, begin, size, asid, addr);
+	else
+		status = -pte_nomap;
+
+	/* Copy memory that can not be accessed in place.  If there is a
+	 * section, the read finds it in @pcache.
+	 */
+	if (status < 0 && buffer) {
+		status = pt_image_read_map(image, map, pcache, buffer, size,
+					   asid, addr);
 		if (status >= 0)
-			return status;
+			*begin = buffer;
 	}
 
-	callback = image->readmem.callback;
-	if (callback)
-		return callback(buffer, size, asid, addr,
-				image->readmem.context);
+	pt_image_leave(image, parity);
 
-	return -pte_nomap;
+	return status;
 }
@@ -27,24 +27,73 @@
  */
 
 #include "pt_insn_decoder.h"
+#include "pt_sync.h"
+#include "pt_block_profile.h"
+#include "pt_segment_cache.h"
+#include "pt_block_sample.h"
+#include "pt_atomic.h"
+#include "pt_thread.h"
 
 #include "intel-pt.h"
 
+#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <limits.h>
 
 
+static pti_machine_mode_enum_t translate_mode(enum pt_exec_mode mode)
+{
+	switch (mode) {
+	case ptem_unknown:
+		return PTI_MODE_LAST;
+
+	case ptem_16bit:
+		return PTI_MODE_16;
+
+	case ptem_32bit:
+		return PTI_MODE_32;
+
+	case ptem_64bit:
+		return PTI_MODE_64;
+	}
+
+	return PTI_MODE_LAST;
+}
+
+/* Set @decoder's execution mode to @mode.
+ *
+ * Also selects the instruction length decoder and its machine mode for @mode.
+ */
+static void pt_insn_set_mode(struct pt_insn_decoder *decoder,
+			     enum pt_exec_mode mode)
+{
+	decoder->mode = mode;
+	decoder->ild_mode = translate_mode(mode);
+
+	/* Most traced code is 64-bit.  Use the length decoder that has been
+	 * specialized for it.
+	 */
+	if (mode == ptem_64bit)
+		decoder->length_decode = pti_instruction_length_decode_64;
+	else
+		decoder->length_decode = pti_instruction_length_decode;
+}
+
 static void pt_insn_reset(struct pt_insn_decoder *decoder)
 {
 	if (!decoder)
 		return;
 
-	decoder->mode = ptem_unknown;
+	pt_insn_set_mode(decoder, ptem_unknown);
 	decoder->ip = 0ull;
 	decoder->last_disable_ip = 0ull;
 	decoder->status = 0;
 	decoder->enabled = 0;
 	decoder->process_event = 0;
 	decoder->speculative = 0;
+	decoder->block_begin = 1;
+	decoder->have_block_from = 0;
 
 	pt_retstack_init(&decoder->retstack);
 	pt_asid_init(&decoder->asid);
@@ -67,6 +116,27 @@ int pt_insn_decoder_init(struct pt_insn_decoder *decoder,
 
 	pt_image_init(&decoder->default_image, NULL);
 	decoder->image = &decoder->default_image;
+	decoder->bytes_mode = ptib_copy;
+	decoder->last_ip = 0ull;
+	decoder->last_tsc = 0ull;
+	decoder->resilient = 0;
+	decoder->in_gap = 0;
+	decoder->have_last_tsc = 0;
+	decoder->block_profile = NULL;
+	decoder->insn_cr3 = pt_asid_no_cr3;
+	decoder->block_from = 0ull;
+	decoder->cov_cache = NULL;
+	decoder->cov_generation = 0;
+	decoder->cov_bound = 0;
+	decoder->cov_versioned = 0;
+	decoder->breakpoints = NULL;
+	decoder->nbreakpoints = 0;
+	decoder->filter = 0;
+	decoder->filtered = 0ull;
+	decoder->segment_cache = NULL;
+
+	memset(&decoder->gap, 0, sizeof(decoder->gap));
+	memset(&decoder->gap_stats, 0, sizeof(decoder->gap_stats));
 
 	pt_insn_reset(decoder);
 
@@ -78,6 +148,9 @@ void pt_insn_decoder_fini(struct pt_insn_decoder *decoder)
 	if (!decoder)
 		return;
 
+	free(decoder->cov_cache);
+	free(decoder->breakpoints);
+
 	pt_image_fini(&decoder->default_image);
 	pt_qry_decoder_fini(&decoder->query);
 }
@@ -207,6 +280,105 @@ int pt_insn_set_image(struct pt_insn_decoder *decoder,
 		image = &decoder->default_image;
 
 	decoder->image = image;
+
+	/* The cached blocks may not be valid for the new image. */
+	decoder->cov_bound = 0;
+
+	return 0;
+}
+
+int pt_insn_set_bytes_mode(struct pt_insn_decoder *decoder,
+			   enum pt_insn_bytes_mode mode)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	switch (mode) {
+	case ptib_copy:
+	case ptib_ref:
+	case ptib_none:
+		decoder->bytes_mode = mode;
+		return 0;
+	}
+
+	return -pte_invalid;
+}
+
+int pt_insn_set_resilient(struct pt_insn_decoder *decoder, int enable)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	decoder->resilient = enable ? 1 : 0;
+
+	return 0;
+}
+
+int pt_insn_set_block_profile(struct pt_insn_decoder *decoder,
+			      struct pt_block_profile *profile)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	decoder->block_profile = profile;
+
+	/* We don't know where the next block begins. */
+	decoder->block_begin = 1;
+	decoder->have_block_from = 0;
+
+	return 0;
+}
+
+int pt_insn_set_segment_cache(struct pt_insn_decoder *decoder,
+			      struct pt_segment_cache *cache)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	decoder->segment_cache = cache;
+
+	return 0;
+}
+
+int pt_insn_set_asid_filter(struct pt_insn_decoder *decoder,
+			    const uint64_t *cr3, uint32_t ncr3)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_set_asid_filter(&decoder->query, cr3, ncr3);
+}
+
+int pt_insn_get_skip_stats(struct pt_insn_decoder *decoder,
+			   struct pt_skip_stats *stats)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	return pt_qry_get_skip_stats(&decoder->query, stats);
+}
+
+int pt_insn_get_gap(struct pt_insn_decoder *decoder, struct pt_insn_gap *gap)
+{
+	if (!decoder || !gap)
+		return -pte_invalid;
+
+	if (!decoder->gap_stats.ngaps)
+		return -pte_nosync;
+
+	*gap = decoder->gap;
+
+	return 0;
+}
+
+int pt_insn_get_gap_stats(struct pt_insn_decoder *decoder,
+			  struct pt_insn_gap_stats *stats)
+{
+	if (!decoder || !stats)
+		return -pte_invalid;
+
+	*stats = decoder->gap_stats;
+
 	return 0;
 }
 
@@ -318,23 +490,102 @@ static int pt_insn_next_ip(uint64_t *ip, const pti_ild_t *ild)
 	return -pte_bad_query;
 }
 
-static pti_machine_mode_enum_t translate_mode(enum pt_exec_mode mode)
+/* Read the instruction bytes at @decoder->ip at @tsc.
+ *
+ * Provides a pointer to the bytes in @itext.  Depending on @decoder's bytes
+ * mode, they are accessed in place, copied into @insn->raw, or copied into
+ * @decoder->raw.  If they are accessed in place, @insn->bytes is set.
+ *
+ * Returns the number of bytes on success, a negative error code otherwise.
+ */
+static int read_insn(struct pt_insn *insn, struct pt_insn_decoder *decoder,
+		     const uint8_t **itext, uint64_t tsc)
 {
-	switch (mode) {
-	case ptem_unknown:
-		return PTI_MODE_LAST;
+	uint8_t *buffer;
+	int size;
 
-	case ptem_16bit:
-		return PTI_MODE_16;
+	if (decoder->bytes_mode == ptib_none)
+		buffer = decoder->raw;
+	else
+		buffer = insn->raw;
 
-	case ptem_32bit:
-		return PTI_MODE_32;
+	/* Bytes that can not be accessed in place are copied into @buffer
+	 * with the same lookup.
+	 */
+	if (decoder->bytes_mode != ptib_copy) {
+		size = pt_image_peek_at(decoder->image, itext, buffer,
+					pt_max_insn_size, &decoder->asid,
+					decoder->ip, tsc);
+	} else {
+		size = pt_image_read_at(decoder->image, buffer,
+					pt_max_insn_size, &decoder->asid,
+					decoder->ip, tsc);
+		*itext = buffer;
+	}
 
-	case ptem_64bit:
-		return PTI_MODE_64;
+	if (size < 0)
+		return size;
+
+	if (*itext != buffer) {
+		if (size == pt_max_insn_size) {
+			if (decoder->bytes_mode == ptib_ref)
+				insn->bytes = *itext;
+
+			return size;
+		}
+
+		/* An instruction may straddle sections if fewer bytes are
+		 * available.  We copy such instructions.
+		 */
+		memcpy(buffer, *itext, (size_t) size);
+		*itext = buffer;
 	}
 
-	return PTI_MODE_LAST;
+	/* Continue reading from adjacent sections in case the instruction
+	 * straddles sections.
+	 */
+	while (size < pt_max_insn_size) {
+		int status;
+
+		status = pt_image_read_at(decoder->image, buffer + size,
+					  (uint16_t) (pt_max_insn_size - size),
+					  &decoder->asid, decoder->ip + size,
+					  tsc);
+		if (status <= 0)
+			break;
+
+		size += status;
+	}
+
+	return size;
+}
+
+/* Decode the instruction at @decoder->ip in @decoder's mode given by @size
+ * bytes at @itext into @decoder->ild.
+ *
+ * Returns a negative error code on failure.
+ * Returns zero on success if the instruction is not relevant for our purposes.
+ * Returns a positive number on success if the instruction is relevant.
+ * Returns -pte_bad_insn if the instruction could not be decoded.
+ */
+static int decode_ild(struct pt_insn_decoder *decoder, const uint8_t *itext,
+		      int size)
+{
+	pti_ild_t *ild;
+
+	ild = &decoder->ild;
+
+	memset(ild, 0, sizeof(*ild));
+
+	ild->itext = itext;
+	ild->max_bytes = size;
+	ild->mode = decoder->ild_mode;
+	ild->runtime_address = decoder->ip;
+
+	if (!decoder->length_decode(ild))
+		return -pte_bad_insn;
+
+	return pti_instruction_decode(ild) ? 1 : 0;
 }
 
 /* Decode and analyze one instruction.
@@ -349,10 +600,10 @@ static pti_machine_mode_enum_t translate_mode(enum pt_exec_mode mode)
  */
 static int decode_insn(struct pt_insn *insn, struct pt_insn_decoder *decoder)
 {
-	static pti_machine_mode_enum_t mode;
+	const uint8_t *itext;
 	pti_ild_t *ild;
-	pti_bool_t status, relevant;
-	int size;
+	uint64_t tsc;
+	int size, errcode, relevant;
 
 	if (!insn || !decoder)
 		return -pte_internal;
@@ -365,32 +616,30 @@ static int decode_insn(struct pt_insn *insn, struct pt_insn_decoder *decoder)
 	insn->ip = decoder->ip;
 
 	/* If we don't know the execution mode, we can't decode. */
-	mode = translate_mode(decoder->mode);
-	if (PTI_MODE_LAST <= mode)
+	if (PTI_MODE_LAST <= decoder->ild_mode)
 		return -pte_bad_insn;
 
-	/* Read the memory at the current IP in the current address space. */
-	size = pt_image_read(decoder->image, insn->raw, sizeof(insn->raw),
-			     &decoder->asid, decoder->ip);
+	/* Read the memory at the current IP in the current address space at
+	 * the current time.
+	 *
+	 * Without timing information, we use the latest version of the image.
+	 */
+	errcode = pt_qry_time(&decoder->query, &tsc);
+	if (errcode < 0)
+		tsc = UINT64_MAX;
+
+	size = read_insn(insn, decoder, &itext, tsc);
 	if (size < 0)
 		return size;
 
 	/* Decode the instruction. */
 	ild = &decoder->ild;
-	memset(ild, 0, sizeof(*ild));
-
-	ild->itext = insn->raw;
-	ild->max_bytes = size;
-	ild->mode = mode;
-	ild->runtime_address = decoder->ip;
-
-	status = pti_instruction_length_decode(ild);
-	if (!status)
-		return -pte_bad_insn;
+	relevant = decode_ild(decoder, itext, size);
+	if (relevant < 0)
+		return relevant;
 
 	insn->size = (uint8_t) ild->length;
 
-	relevant = pti_instruction_decode(ild);
 	if (relevant)
 		insn->iclass = pt_insn_classify(ild);
 	else
@@ -626,7 +875,7 @@ static int process_exec_mode_event(struct pt_insn_decoder *decoder,
 	    decoder->mode != ptem_unknown && decoder->mode != mode)
 		return -pte_nosync;
 
-	decoder->mode = mode;
+	pt_insn_set_mode(decoder, mode);
 
 	return 1;
 }
@@ -1024,14 +1273,29 @@ static int proceed(struct pt_insn_decoder *decoder)
 	return 0;
 }
 
-int pt_insn_next(struct pt_insn_decoder *decoder, struct pt_insn *insn)
+static int pt_insn_decode_next(struct pt_insn_decoder *decoder,
+			       struct pt_insn *insn)
 {
 	int errcode;
 
 	if (!insn || !decoder)
 		return -pte_invalid;
 
-	memset(insn, 0, sizeof(*insn));
+	/* We do not clear @insn->raw.  It is filled in if needed. */
+	insn->ip = 0ull;
+	insn->iclass = ptic_error;
+	insn->mode = ptem_unknown;
+	insn->size = 0;
+	insn->bytes = NULL;
+	insn->speculative = 0;
+	insn->aborted = 0;
+	insn->committed = 0;
+	insn->disabled = 0;
+	insn->enabled = 0;
+	insn->resumed = 0;
+	insn->interrupted = 0;
+	insn->resynced = 0;
+	insn->gap = 0;
 
 	/* Report any errors we encountered. */
 	if (decoder->status < 0)
@@ -1076,6 +1340,8 @@ int pt_insn_next(struct pt_insn_decoder *decoder, struct pt_insn *insn)
 	if (errcode < 0)
 		goto err;
 
+	decoder->insn_cr3 = decoder->asid.cr3;
+
 	/* After decoding the instruction, we must not change the IP in this
 	 * iteration - postpone processing of events that would to the next
 	 * iteration.
@@ -1110,3 +1376,1308 @@ err:
 	decoder->status = errcode;
 	return errcode;
 }
+
+/* Check whether we may skip the trace that caused @errcode.
+ *
+ * Returns non-zero if we may resynchronize after @errcode; zero otherwise.
+ */
+static int pt_insn_may_skip(int errcode)
+{
+	switch (-errcode) {
+	case pte_nosync:
+	case pte_bad_opc:
+	case pte_bad_packet:
+	case pte_bad_context:
+	case pte_bad_query:
+	case pte_noip:
+	case pte_nomap:
+	case pte_bad_insn:
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Synchronize @decoder at the synchronization point following the one at
+ * which it was last synchronized.
+ *
+ * The query decoder may already have read beyond that synchronization point.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no further synchronization point.
+ */
+static int pt_insn_sync_next(struct pt_insn_decoder *decoder)
+{
+	const struct pt_config *config;
+	const uint8_t *sync;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	sync = decoder->query.sync;
+	if (!sync)
+		return -pte_nosync;
+
+	config = &decoder->query.config;
+
+	errcode = pt_sync_forward(&sync, sync + ptps_psb, config);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_insn_sync_set(decoder, (uint64_t) (sync - config->begin));
+}
+
+/* Skip the trace that caused @errcode and resynchronize @decoder at the next
+ * synchronization point.
+ *
+ * Records the skipped trace in @decoder's gap and gap statistics.  If we
+ * have not decoded an instruction since the last skip, extends that gap.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no further synchronization point.
+ * Returns @errcode if @decoder has never been synchronized.
+ */
+static int pt_insn_skip(struct pt_insn_decoder *decoder, int errcode)
+{
+	struct pt_insn_gap *gap;
+	uint64_t begin, end, tsc_begin, tsc_end;
+	int status, have_tsc;
+
+	if (!decoder)
+		return -pte_internal;
+
+	/* We can't skip anything if we never synchronized. */
+	status = pt_qry_get_offset(&decoder->query, &begin);
+	if (status < 0)
+		return errcode;
+
+	/* The query decoder may already have read the time of the next
+	 * synchronization point.  Measure from the last instruction.
+	 */
+	tsc_begin = decoder->last_tsc;
+	have_tsc = decoder->have_last_tsc;
+
+	/* Skip synchronization points we can't start from, too. */
+	do {
+		status = pt_insn_sync_next(decoder);
+	} while (status < 0 && pt_insn_may_skip(status));
+
+	if (status < 0) {
+		/* We lose the rest of the trace. */
+		end = (uint64_t) (decoder->query.config.end -
+				  decoder->query.config.begin);
+		have_tsc = 0;
+
+		decoder->status = status;
+	} else {
+		status = pt_qry_get_sync_offset(&decoder->query, &end);
+		if (status < 0)
+			return status;
+
+		if (have_tsc)
+			have_tsc = (pt_qry_time(&decoder->query,
+						&tsc_end) >= 0);
+	}
+
+	gap = &decoder->gap;
+	if (!decoder->in_gap) {
+		/* The query decoder may have read ahead beyond the
+		 * synchronization point at which we resume.
+		 */
+		if (end < begin)
+			begin = end;
+
+		gap->begin = begin;
+		gap->end = begin;
+		gap->ip = decoder->last_ip;
+		gap->time = 0ull;
+		gap->errcode = errcode;
+
+		decoder->gap_stats.ngaps += 1;
+		decoder->in_gap = 1;
+	}
+
+	if (gap->end < end) {
+		decoder->gap_stats.bytes += end - gap->end;
+		gap->end = end;
+	}
+
+	if (have_tsc && tsc_begin < tsc_end) {
+		decoder->gap_stats.time += tsc_end - tsc_begin;
+		gap->time += tsc_end - tsc_begin;
+	}
+
+	return status;
+}
+
+/* Decode the next instruction in resilient mode.
+ *
+ * Skips trace that caused recoverable errors.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_next_resilient(struct pt_insn_decoder *decoder,
+				  struct pt_insn *insn)
+{
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	for (;;) {
+		errcode = pt_insn_decode_next(decoder, insn);
+		if (errcode >= 0)
+			break;
+
+		if (!pt_insn_may_skip(errcode))
+			return errcode;
+
+		errcode = pt_insn_skip(decoder, errcode);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (decoder->in_gap) {
+		insn->gap = 1;
+		decoder->in_gap = 0;
+	}
+
+	decoder->last_ip = insn->ip;
+	decoder->have_last_tsc =
+		(pt_qry_time(&decoder->query, &decoder->last_tsc) >= 0);
+
+	return errcode;
+}
+
+/* Count @insn in @decoder's block profile.
+ *
+ * Counts the block if @insn begins one and the edge from the previous block
+ * if we know it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_count_block(struct pt_insn_decoder *decoder,
+			       const struct pt_insn *insn)
+{
+	struct pt_block_profile *profile;
+	uint64_t cr3;
+	int errcode;
+
+	if (!decoder || !insn)
+		return -pte_internal;
+
+	profile = decoder->block_profile;
+	cr3 = decoder->insn_cr3;
+
+	/* We don't know where we came from. */
+	if (insn->gap || insn->resynced || (insn->enabled && !insn->resumed)) {
+		decoder->block_begin = 1;
+		decoder->have_block_from = 0;
+	}
+
+	if (decoder->block_begin) {
+		errcode = pt_block_profile_add_block(profile, cr3, insn->ip, 1);
+		if (errcode < 0)
+			return errcode;
+
+		if (decoder->have_block_from) {
+			errcode = pt_block_profile_add_edge(profile, cr3,
+							    decoder->block_from,
+							    insn->ip, 1);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		decoder->block_begin = 0;
+		decoder->have_block_from = 0;
+	}
+
+	/* The block ends with an instruction that may transfer control. */
+	if (insn->iclass != ptic_other || insn->interrupted || insn->aborted) {
+		decoder->block_from = insn->ip;
+		decoder->block_begin = 1;
+		decoder->have_block_from = 1;
+	}
+
+	return 0;
+}
+
+/* Decode the next instruction.
+ *
+ * This is pt_insn_next() without filtering.
+ */
+static int pt_insn_next_one(struct pt_insn_decoder *decoder,
+			    struct pt_insn *insn)
+{
+	int errcode;
+
+	if (!decoder || !decoder->resilient)
+		errcode = pt_insn_decode_next(decoder, insn);
+	else
+		errcode = pt_insn_next_resilient(decoder, insn);
+
+	if (errcode < 0 || !decoder->block_profile)
+		return errcode;
+
+	return pt_insn_count_block(decoder, insn);
+}
+
+uint16_t pt_insn_flags(const struct pt_insn *insn)
+{
+	uint16_t flags;
+
+	flags = (uint16_t) (insn->mode << ptif_mode_shift);
+
+	if (insn->speculative)
+		flags |= ptif_speculative;
+
+	if (insn->aborted)
+		flags |= ptif_aborted;
+
+	if (insn->committed)
+		flags |= ptif_committed;
+
+	if (insn->disabled)
+		flags |= ptif_disabled;
+
+	if (insn->enabled)
+		flags |= ptif_enabled;
+
+	if (insn->resumed)
+		flags |= ptif_resumed;
+
+	if (insn->interrupted)
+		flags |= ptif_interrupted;
+
+	if (insn->resynced)
+		flags |= ptif_resynced;
+
+	if (insn->gap)
+		flags |= ptif_gap;
+
+	return flags;
+}
+
+int pt_insn_next_batch(struct pt_insn_decoder *decoder,
+		       struct pt_insn_batch *batch, uint32_t *nevents)
+{
+	enum pt_insn_bytes_mode bytes_mode;
+	uint32_t row, nrows, events;
+	int errcode;
+
+	if (!decoder || !batch || !nevents)
+		return -pte_invalid;
+
+	if (!batch->ip || !batch->size || !batch->iclass || !batch->flags)
+		return -pte_invalid;
+
+	if (!batch->events && batch->max_events)
+		return -pte_invalid;
+
+	nrows = batch->nrows;
+	if (INT_MAX < nrows)
+		nrows = INT_MAX;
+
+	/* We only need the bytes if the user asked for them.  We copy them
+	 * into the raw column from wherever they are.
+	 */
+	bytes_mode = decoder->bytes_mode;
+	decoder->bytes_mode = batch->raw ? ptib_ref : ptib_none;
+
+	errcode = 0;
+	events = 0;
+	for (row = 0; row < nrows; ++row) {
+		struct pt_insn insn;
+		uint16_t flags;
+
+		errcode = pt_insn_next(decoder, &insn, sizeof(insn));
+		if (errcode < 0)
+			break;
+
+		flags = pt_insn_flags(&insn);
+
+		batch->ip[row] = insn.ip;
+		batch->size[row] = insn.size;
+		batch->iclass[row] = (uint8_t) insn.iclass;
+		batch->flags[row] = flags;
+
+		if (batch->raw)
+			memcpy(batch->raw[row], insn.bytes ? insn.bytes : insn.raw,
+			       insn.size);
+
+		if (flags & ptif_events) {
+			if (events < batch->max_events) {
+				batch->events[events].row = row;
+				batch->events[events].flags =
+					(uint16_t) (flags & ptif_events);
+
+				events += 1;
+			}
+
+			if (batch->max_events <= events) {
+				row += 1;
+				break;
+			}
+		}
+	}
+
+	decoder->bytes_mode = bytes_mode;
+	*nevents = events;
+
+	/* We report errors after the first instruction on the next call. */
+	if (!row && errcode < 0)
+		return errcode;
+
+	return (int) row;
+}
+
+/* Add the block at @decoder->ip to the block cache.
+ *
+ * Decodes instructions up to and including the first branch and stores the
+ * block in @block.  Leaves @block unchanged on errors.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_cov_add(struct pt_insn_cov_block *block,
+			   struct pt_insn_decoder *decoder)
+{
+	struct pt_insn insn;
+	pti_ild_t *ild;
+	uint64_t begin, tsc;
+	uint32_t ninsn;
+	int errcode;
+
+	if (!block || !decoder)
+		return -pte_internal;
+
+	if (PTI_MODE_LAST <= decoder->ild_mode)
+		return -pte_bad_insn;
+
+	errcode = pt_qry_time(&decoder->query, &tsc);
+	if (errcode < 0)
+		tsc = UINT64_MAX;
+
+	ild = &decoder->ild;
+	begin = decoder->ip;
+	for (ninsn = 1;; ++ninsn) {
+		const uint8_t *itext;
+		int size;
+
+		/* We don't provide instructions so this reads into
+		 * @decoder->raw.
+		 */
+		size = read_insn(&insn, decoder, &itext, tsc);
+		if (size < 0) {
+			errcode = size;
+			break;
+		}
+
+		errcode = decode_ild(decoder, itext, size);
+		if (errcode < 0)
+			break;
+
+		if (ild->u.s.branch) {
+			block->ip = begin;
+			block->cr3 = decoder->asid.cr3;
+			block->end = decoder->ip;
+			block->target = ild->direct_target;
+			block->flags = ild->u.i;
+			block->ninsn = ninsn;
+			block->size = (uint8_t) ild->length;
+			block->mode = (uint8_t) decoder->mode;
+			block->iclass = (uint8_t) pt_insn_classify(ild);
+
+			errcode = 0;
+			break;
+		}
+
+		decoder->ip += ild->length;
+	}
+
+	decoder->ip = begin;
+
+	return errcode;
+}
+
+/* Check whether @decoder may follow cached blocks.
+ *
+ * This is the case while tracing is enabled and there are no events to
+ * process.  Events only become pending when we query the trace, which we do
+ * at the end of a block.
+ *
+ * Returns non-zero if it may, zero otherwise.
+ */
+static int pt_insn_cov_may_follow(const struct pt_insn_decoder *decoder)
+{
+	return decoder->enabled && !decoder->process_event &&
+		(0 <= decoder->status) &&
+		!(decoder->status & pts_event_pending);
+}
+
+/* Prepare @decoder's block cache for the current generation of @decoder's
+ * image.
+ *
+ * Flushes the cache if the image changed since the blocks were decoded.
+ *
+ * Returns non-zero if @decoder may use cached blocks, zero otherwise.
+ */
+static int pt_insn_cov_bind(struct pt_insn_decoder *decoder)
+{
+	uint32_t generation;
+	int versioned;
+
+	/* Versions are only added when the generation changes. */
+	generation = pt_atomic_load32(&decoder->image->generation);
+	if (decoder->cov_bound && decoder->cov_generation == generation)
+		return !decoder->cov_versioned;
+
+	versioned = pt_image_generation(decoder->image, &generation);
+	if (versioned < 0)
+		return 0;
+
+	memset(decoder->cov_cache, 0, pt_insn_cov_cache_size *
+	       sizeof(*decoder->cov_cache));
+
+	/* A block decoded at one time may not be valid at another.  We don't
+	 * know for which times it is valid so we don't use cached blocks.
+	 */
+	decoder->cov_generation = generation;
+	decoder->cov_versioned = versioned ? 1 : 0;
+	decoder->cov_bound = 1;
+
+	return !decoder->cov_versioned;
+}
+
+/* Find the block at @decoder->ip in the block cache.
+ *
+ * Adds the block if it is not in the cache, yet.
+ *
+ * Returns the block on success, NULL if it could not be added or if @decoder
+ * may not use cached blocks.
+ */
+static const struct pt_insn_cov_block *
+pt_insn_cov_lookup(struct pt_insn_decoder *decoder)
+{
+	struct pt_insn_cov_block *block;
+	uint64_t ip, cr3, key;
+	int errcode;
+
+	if (!pt_insn_cov_bind(decoder))
+		return NULL;
+
+	ip = decoder->ip;
+	cr3 = decoder->asid.cr3;
+
+	key = (ip ^ (cr3 << 20) ^ (cr3 >> 44)) * 0x9e3779b97f4a7c15ull;
+	block = &decoder->cov_cache[(key >> 32) &
+				    (pt_insn_cov_cache_size - 1)];
+
+	if (block->ip == ip && block->cr3 == cr3 &&
+	    block->mode == (uint8_t) decoder->mode &&
+	    block->mode != ptem_unknown)
+		return block;
+
+	errcode = pt_insn_cov_add(block, decoder);
+	if (errcode < 0)
+		return NULL;
+
+	return block;
+}
+
+/* Proceed after the last instruction of the cached @block.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_cov_proceed(struct pt_insn_decoder *decoder,
+			       const struct pt_insn_cov_block *block)
+{
+	pti_ild_t *ild;
+	int errcode;
+
+	/* We only restore what proceed() needs. */
+	ild = &decoder->ild;
+	ild->runtime_address = block->end;
+	ild->length = block->size;
+	ild->direct_target = block->target;
+	ild->u.i = block->flags;
+
+	decoder->ip = block->end;
+
+	errcode = proceed(decoder);
+	if (errcode < 0)
+		decoder->status = errcode;
+
+	return errcode;
+}
+
+/* Count the transition to the block at @ip in @bitmap.
+ *
+ * The location of the previous block is given in @prev.  It is updated to
+ * the block at @ip.
+ */
+static void pt_insn_cov_hit(struct pt_insn_decoder *decoder, uint8_t *bitmap,
+			    uint32_t mask, uint32_t *prev, uint64_t ip)
+{
+	uint8_t *counter;
+	uint32_t loc;
+
+	loc = pt_insn_cov_loc(ip);
+	counter = &bitmap[(loc ^ *prev) & mask];
+	if (*counter != UINT8_MAX)
+		*counter += 1;
+
+	*prev = loc >> 1;
+
+	if (decoder->resilient) {
+		decoder->in_gap = 0;
+		decoder->last_ip = ip;
+		decoder->have_last_tsc =
+			(pt_qry_time(&decoder->query, &decoder->last_tsc) >= 0);
+	}
+}
+
+/* Collect edge coverage in @bitmap with @mask + 1 counters.
+ *
+ * Returns zero at the end of the trace, a negative error code otherwise.
+ */
+static int pt_insn_cov_run(struct pt_insn_decoder *decoder, uint8_t *bitmap,
+			   uint32_t mask)
+{
+	uint32_t prev;
+	int begin, errcode;
+
+	prev = 0;
+	begin = 1;
+	for (;;) {
+		struct pt_insn insn;
+
+		if (pt_insn_cov_may_follow(decoder)) {
+			const struct pt_insn_cov_block *block;
+
+			block = pt_insn_cov_lookup(decoder);
+			if (block) {
+				if (begin)
+					pt_insn_cov_hit(decoder, bitmap, mask,
+							&prev, block->ip);
+
+				begin = 1;
+
+				errcode = pt_insn_cov_proceed(decoder, block);
+				if (errcode >= 0)
+					continue;
+
+				goto err;
+			}
+
+			/* Let the regular path diagnose the problem. */
+		}
+
+		errcode = pt_insn_decode_next(decoder, &insn);
+		if (errcode >= 0) {
+			if (insn.resynced || (insn.enabled && !insn.resumed)) {
+				prev = 0;
+				begin = 1;
+			}
+
+			if (begin)
+				pt_insn_cov_hit(decoder, bitmap, mask, &prev,
+						insn.ip);
+
+			begin = (insn.iclass != ptic_other) ||
+				insn.interrupted || insn.aborted;
+
+			continue;
+		}
+
+err:
+		if (errcode == -pte_eos)
+			return 0;
+
+		if (!decoder->resilient || !pt_insn_may_skip(errcode))
+			return errcode;
+
+		errcode = pt_insn_skip(decoder, errcode);
+		if (errcode < 0)
+			return (errcode == -pte_eos) ? 0 : errcode;
+
+		prev = 0;
+		begin = 1;
+	}
+}
+
+/* Allocate @decoder's block cache unless it has already been allocated.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_cov_alloc(struct pt_insn_decoder *decoder)
+{
+	if (decoder->cov_cache)
+		return 0;
+
+	decoder->cov_cache = calloc(pt_insn_cov_cache_size,
+				    sizeof(*decoder->cov_cache));
+	if (!decoder->cov_cache)
+		return -pte_nomem;
+
+	return 0;
+}
+
+int pt_insn_coverage(struct pt_insn_decoder *decoder, uint8_t *bitmap,
+		     uint32_t size)
+{
+	enum pt_insn_bytes_mode bytes_mode;
+	int errcode;
+
+	if (!decoder || !bitmap)
+		return -pte_invalid;
+
+	if (!size || (size & (size - 1)))
+		return -pte_invalid;
+
+	errcode = pt_insn_cov_alloc(decoder);
+	if (errcode < 0)
+		return errcode;
+
+	/* We never provide the instruction bytes. */
+	bytes_mode = decoder->bytes_mode;
+	decoder->bytes_mode = ptib_none;
+
+	errcode = pt_insn_cov_run(decoder, bitmap, size - 1);
+
+	decoder->bytes_mode = bytes_mode;
+
+	return errcode;
+}
+
+/* The number of instructions between checks of the time budget. */
+enum {
+	pt_insn_sample_interval	= 0x400
+};
+
+/* Provide the calling thread's processor time since @start in microseconds.
+ *
+ * We do not use clock() since other threads would use up our budget.
+ */
+static uint64_t pt_insn_sample_time(uint64_t start)
+{
+	uint64_t now;
+
+	now = pt_thread_time();
+	if (now < start)
+		return 0ull;
+
+	return now - start;
+}
+
+/* Decide whether to decode the next segment.
+ *
+ * The @state of the pseudo-random sequence is updated if @config has a seed.
+ *
+ * Returns non-zero if the segment at @index is selected, zero otherwise.
+ */
+static int pt_insn_sample_select(uint32_t *state, uint64_t index,
+				 const struct pt_sample_config *config)
+{
+	uint32_t value;
+
+	if (config->stride <= 1)
+		return 1;
+
+	if (!config->seed)
+		return !(index % config->stride);
+
+	/* A xorshift generator.  It never yields zero. */
+	value = *state;
+	value ^= value << 13;
+	value ^= value >> 17;
+	value ^= value << 5;
+	*state = value;
+
+	return !(value % config->stride);
+}
+
+/* Add the counts of the cached segment @entry to @sample's segment.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_sample_cached(struct pt_block_sample *sample,
+				 const struct pt_segment_entry *entry)
+{
+	uint32_t idx;
+
+	if (!sample || !entry)
+		return -pte_internal;
+
+	for (idx = 0; idx < entry->nblocks; ++idx) {
+		const struct pt_block_count *block;
+		int errcode;
+
+		block = &entry->blocks[idx];
+		errcode = pt_block_profile_add_block(&sample->segment,
+						     block->cr3, block->ip,
+						     block->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	for (idx = 0; idx < entry->nedges; ++idx) {
+		const struct pt_edge_count *edge;
+		int errcode;
+
+		edge = &entry->edges[idx];
+		errcode = pt_block_profile_add_edge(&sample->segment,
+						    edge->cr3, edge->from,
+						    edge->to, edge->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	sample->stats.errors += entry->errors;
+
+	return 0;
+}
+
+/* Decode the segment from offset @begin to offset @end into @sample.
+ *
+ * If @cache is not NULL, the segment's counts are taken from @cache if it
+ * has been decoded before.  Otherwise, they are added to @cache.
+ *
+ * If the time budget is exhausted in the middle of the segment, the segment
+ * is dropped.  It would understate the counts of the segments we completed.
+ *
+ * Returns zero when the end of the segment has been reached.
+ * Returns a positive integer if the time budget has been exhausted.
+ * Returns a negative error code if @sample could not be extended.
+ */
+static int pt_insn_sample_segment(struct pt_insn_decoder *decoder,
+				  struct pt_block_sample *sample,
+				  struct pt_segment_cache *cache,
+				  uint64_t begin, uint64_t end,
+				  const struct pt_sample_config *config,
+				  uint64_t start)
+{
+	struct pt_segment_key key;
+	uint8_t *trace_end;
+	uint32_t ninsn, errors;
+	int status, errcode;
+
+	if (!decoder || !sample || !config)
+		return -pte_internal;
+
+	if (cache) {
+		const struct pt_segment_entry *entry;
+		const uint8_t *tbegin;
+
+		/* We decode segments we can't hash the normal way so we get
+		 * the same errors.
+		 */
+		tbegin = decoder->query.config.begin;
+		errcode = pt_segment_key(&key, &decoder->query.config,
+					 tbegin + begin, tbegin + end);
+		if (errcode < 0)
+			cache = NULL;
+		else {
+			entry = pt_segment_cache_lookup(cache, &key);
+			if (entry) {
+				errcode = pt_insn_sample_cached(sample, entry);
+				if (errcode < 0)
+					return errcode;
+
+				errcode = pt_block_sample_end_segment(sample);
+				if (errcode < 0)
+					return errcode;
+
+				return 0;
+			}
+		}
+	}
+
+	/* We end the trace at the next segment. */
+	trace_end = decoder->query.config.end;
+	decoder->query.config.end = decoder->query.config.begin + end;
+
+	status = pt_insn_sync_set(decoder, begin);
+	for (ninsn = 1; status >= 0; ++ninsn) {
+		struct pt_insn insn;
+
+		status = pt_insn_next(decoder, &insn, sizeof(insn));
+
+		if (config->budget && !(ninsn % pt_insn_sample_interval) &&
+		    (config->budget <= pt_insn_sample_time(start)))
+			break;
+	}
+
+	decoder->query.config.end = trace_end;
+
+	if (status >= 0) {
+		pt_block_profile_clear(&sample->segment);
+		return 1;
+	}
+
+	if (status == -pte_nomem)
+		return status;
+
+	errors = 0;
+	if (status != -pte_eos)
+		errors = 1;
+
+	sample->stats.errors += errors;
+
+	if (cache) {
+		errcode = pt_segment_cache_add(cache, &key, &sample->segment,
+					       errors);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return pt_block_sample_end_segment(sample);
+}
+
+/* Prepare @decoder's segment cache for @decoder's image and address space
+ * filter.
+ *
+ * Returns a positive integer if the cache may be used, zero if it may not.
+ * Returns a negative error code otherwise.
+ */
+static int pt_insn_bind_segment_cache(struct pt_insn_decoder *decoder)
+{
+	const struct pt_query_decoder *query;
+	uint64_t context;
+	uint32_t idx, generation;
+	int versioned, errcode;
+
+	if (!decoder || !decoder->image)
+		return -pte_internal;
+
+	versioned = pt_image_generation(decoder->image, &generation);
+	if (versioned < 0)
+		return versioned;
+
+	/* The same segment may be decoded using different versions of the
+	 * image depending on its time.  Segments are cached by their packets
+	 * without timing so we can't tell them apart.
+	 */
+	if (versioned)
+		return 0;
+
+	query = &decoder->query;
+
+	context = 0xcbf29ce484222325ull;
+	for (idx = 0; idx < query->ncr3_filter; ++idx) {
+		context ^= query->cr3_filter[idx];
+		context *= 0x100000001b3ull;
+	}
+
+	errcode = pt_segment_cache_bind(decoder->segment_cache, decoder->image,
+				      generation, context);
+	if (errcode < 0)
+		return errcode;
+
+	return 1;
+}
+
+int pt_insn_sample(struct pt_insn_decoder *decoder,
+		   struct pt_block_sample *sample,
+		   const struct pt_sample_config *uconfig)
+{
+	struct pt_segment_cache *cache;
+	struct pt_block_profile *profile;
+	struct pt_sample_config config;
+	const struct pt_config *tconfig;
+	const uint8_t *psb;
+	uint64_t index;
+	uint64_t start;
+	uint32_t state;
+	size_t size;
+	int errcode, exhausted;
+
+	if (!decoder || !sample || !uconfig)
+		return -pte_invalid;
+
+	/* Ignore fields in the user's configuration we don't know. */
+	memset(&config, 0, sizeof(config));
+	size = uconfig->size;
+	if (sizeof(config) < size)
+		size = sizeof(config);
+	memcpy(&config, uconfig, size);
+
+	start = pt_thread_time();
+	tconfig = &decoder->query.config;
+	state = config.seed;
+	exhausted = 0;
+
+	cache = NULL;
+	if (decoder->segment_cache) {
+		errcode = pt_insn_bind_segment_cache(decoder);
+		if (errcode < 0)
+			return errcode;
+
+		if (errcode)
+			cache = decoder->segment_cache;
+	}
+
+	profile = decoder->block_profile;
+	errcode = pt_insn_set_block_profile(decoder, &sample->segment);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sync_forward(&psb, tconfig->begin, tconfig);
+	for (index = 0; !errcode; ++index) {
+		const uint8_t *next;
+
+		errcode = pt_sync_forward(&next, psb + ptps_psb, tconfig);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				break;
+
+			next = tconfig->end;
+		}
+
+		sample->stats.segments += 1;
+
+		if (!exhausted && pt_insn_sample_select(&state, index,
+							&config)) {
+			uint64_t begin, end;
+			int status;
+
+			begin = (uint64_t) (psb - tconfig->begin);
+			end = (uint64_t) (next - tconfig->begin);
+
+			status = pt_insn_sample_segment(decoder, sample, cache,
+							begin, end, &config,
+							start);
+			if (status < 0) {
+				errcode = status;
+				break;
+			}
+
+			if (config.budget && (status ||
+			    (config.budget <= pt_insn_sample_time(start))))
+				exhausted = 1;
+		}
+
+		psb = next;
+	}
+
+	sample->stats.time += pt_insn_sample_time(start);
+	if (exhausted)
+		sample->stats.exhausted += 1;
+
+	(void) pt_insn_set_block_profile(decoder, profile);
+
+	return (errcode == -pte_eos) ? 0 : errcode;
+}
+
+static int pt_insn_bp_compare(const void *lhs, const void *rhs)
+{
+	uint64_t lip, rip;
+
+	lip = *(const uint64_t *) lhs;
+	rip = *(const uint64_t *) rhs;
+
+	return (lip < rip) ? -1 : (rip < lip) ? 1 : 0;
+}
+
+int pt_insn_set_breakpoints(struct pt_insn_decoder *decoder,
+			    const uint64_t *ips, uint32_t nips)
+{
+	uint64_t *breakpoints;
+	uint32_t in, out;
+
+	if (!decoder)
+		return -pte_invalid;
+
+	if (!nips) {
+		free(decoder->breakpoints);
+		decoder->breakpoints = NULL;
+		decoder->nbreakpoints = 0;
+
+		return 0;
+	}
+
+	if (!ips)
+		return -pte_invalid;
+
+	breakpoints = malloc((size_t) nips * sizeof(*breakpoints));
+	if (!breakpoints)
+		return -pte_nomem;
+
+	memcpy(breakpoints, ips, (size_t) nips * sizeof(*breakpoints));
+	qsort(breakpoints, nips, sizeof(*breakpoints), pt_insn_bp_compare);
+
+	for (out = 0, in = 1; in < nips; ++in) {
+		if (breakpoints[in] != breakpoints[out])
+			breakpoints[++out] = breakpoints[in];
+	}
+
+	free(decoder->breakpoints);
+	decoder->breakpoints = breakpoints;
+	decoder->nbreakpoints = out + 1;
+
+	return 0;
+}
+
+/* Check whether there is a breakpoint in [@begin; @end].
+ *
+ * Returns non-zero if there is, zero otherwise.
+ */
+static int pt_insn_has_breakpoint(const struct pt_insn_decoder *decoder,
+				  uint64_t begin, uint64_t end)
+{
+	const uint64_t *breakpoints;
+	uint32_t lo, hi;
+
+	breakpoints = decoder->breakpoints;
+	lo = 0;
+	hi = decoder->nbreakpoints;
+
+	while (lo < hi) {
+		uint32_t mid;
+
+		mid = lo + ((hi - lo) >> 1);
+		if (breakpoints[mid] < begin)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo < decoder->nbreakpoints) && (breakpoints[lo] <= end);
+}
+
+/* Decode until an instruction at a breakpoint has been executed.
+ *
+ * Provides the breakpoint in @ip.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_insn_bp_run(struct pt_insn_decoder *decoder, uint64_t *ip)
+{
+	int step, errcode;
+
+	/* We step through blocks that contain a breakpoint. */
+	step = 0;
+	for (;;) {
+		struct pt_insn insn;
+
+		if (!step && pt_insn_cov_may_follow(decoder)) {
+			const struct pt_insn_cov_block *block;
+
+			block = pt_insn_cov_lookup(decoder);
+			if (block) {
+				if (!pt_insn_has_breakpoint(decoder, block->ip,
+							    block->end)) {
+					errcode = pt_insn_cov_proceed(decoder,
+								      block);
+					if (errcode >= 0) {
+						decoder->in_gap = 0;
+						continue;
+					}
+
+					goto err;
+				}
+
+				step = 1;
+			}
+		}
+
+		errcode = pt_insn_decode_next(decoder, &insn);
+		if (errcode >= 0) {
+			decoder->in_gap = 0;
+
+			if ((insn.iclass != ptic_other) || insn.interrupted ||
+			    insn.aborted)
+				step = 0;
+
+			if (pt_insn_has_breakpoint(decoder, insn.ip, insn.ip)) {
+				*ip = insn.ip;
+				return 0;
+			}
+
+			continue;
+		}
+
+err:
+		if (!decoder->resilient || !pt_insn_may_skip(errcode))
+			return errcode;
+
+		errcode = pt_insn_skip(decoder, errcode);
+		if (errcode < 0)
+			return errcode;
+
+		step = 0;
+	}
+}
+
+int pt_insn_next_breakpoint(struct pt_insn_decoder *decoder, uint64_t *ip,
+			    uint64_t *tsc)
+{
+	enum pt_insn_bytes_mode bytes_mode;
+	int errcode;
+
+	if (!decoder || !ip || !tsc)
+		return -pte_invalid;
+
+	errcode = pt_insn_cov_alloc(decoder);
+	if (errcode < 0)
+		return errcode;
+
+	/* We never provide the instruction bytes. */
+	bytes_mode = decoder->bytes_mode;
+	decoder->bytes_mode = ptib_none;
+
+	errcode = pt_insn_bp_run(decoder, ip);
+
+	decoder->bytes_mode = bytes_mode;
+
+	if (errcode < 0)
+		return errcode;
+
+	if (pt_qry_time(&decoder->query, tsc) < 0)
+		*tsc = 0ull;
+
+	return 0;
+}
+
+int pt_insn_set_filter(struct pt_insn_decoder *decoder, uint32_t filter)
+{
+	if (!decoder)
+		return -pte_invalid;
+
+	/* We skip blocks of other instructions using the block cache. */
+	if (filter && !(filter & ptfm_other)) {
+		int errcode;
+
+		errcode = pt_insn_cov_alloc(decoder);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	decoder->filter = filter;
+	decoder->filtered = 0ull;
+
+	return 0;
+}
+
+int pt_insn_get_filtered(struct pt_insn_decoder *decoder, uint64_t *skipped)
+{
+	if (!decoder || !skipped)
+		return -pte_invalid;
+
+	*skipped = decoder->filtered;
+
+	return 0;
+}
+
+/* Skip cached blocks that do not contain instructions that pass @decoder's
+ * filter.
+ *
+ * Stops at the last instruction of a block if it passes the filter.  All
+ * other instructions in cached blocks are assumed to be of class ptic_other.
+ *
+ * Errors are recorded in @decoder->status and reported when decoding the
+ * next instruction.
+ */
+static void pt_insn_filter_skip(struct pt_insn_decoder *decoder)
+{
+	while (pt_insn_cov_may_follow(decoder)) {
+		const struct pt_insn_cov_block *block;
+
+		block = pt_insn_cov_lookup(decoder);
+		if (!block)
+			return;
+
+		if (decoder->filter & (1u << block->iclass)) {
+			decoder->filtered += block->ninsn - 1;
+			decoder->ip = block->end;
+			return;
+		}
+
+		decoder->filtered += block->ninsn;
+
+		if (pt_insn_cov_proceed(decoder, block) < 0)
+			return;
+	}
+}
+
+/* Check whether @insn passes @filter.
+ *
+ * Returns non-zero if it does, zero otherwise.
+ */
+static int pt_insn_filter_match(uint32_t filter, const struct pt_insn *insn)
+{
+	if (filter & (1u << insn->iclass))
+		return 1;
+
+	if ((filter & ptfm_events) && (pt_insn_flags(insn) & ptif_events))
+		return 1;
+
+	return 0;
+}
+
+/* Decode the next instruction that passes @decoder's filter.
+ *
+ * This is pt_insn_next() for a complete @insn.
+ */
+static int pt_insn_next_filtered(struct pt_insn_decoder *decoder,
+				 struct pt_insn *insn)
+{
+	uint32_t filter;
+
+	if (!decoder || !decoder->filter)
+		return pt_insn_next_one(decoder, insn);
+
+	filter = decoder->filter;
+	for (;;) {
+		int errcode;
+
+		/* We can't skip blocks if we need to profile them. */
+		if (!(filter & ptfm_other) && !decoder->block_profile &&
+		    decoder->cov_cache)
+			pt_insn_filter_skip(decoder);
+
+		errcode = pt_insn_next_one(decoder, insn);
+		if (errcode < 0)
+			return errcode;
+
+		if (pt_insn_filter_match(filter, insn))
+			return errcode;
+
+		decoder->filtered += 1;
+	}
+}
+
+int pt_insn_next(struct pt_insn_decoder *decoder, struct pt_insn *uinsn,
+		 size_t size)
+{
+	struct pt_insn insn, *pinsn;
+	int status;
+
+	if (!uinsn)
+		return -pte_invalid;
+
+	/* The bytes pointer was added last.  Older users do not have it. */
+	if (size < offsetof(struct pt_insn, bytes))
+		return -pte_invalid;
+
+	/* Avoid copying if the user's instruction has the expected size. */
+	pinsn = (size == sizeof(insn)) ? uinsn : &insn;
+
+	status = pt_insn_next_filtered(decoder, pinsn);
+
+	if (pinsn != uinsn) {
+		/* Users without the bytes pointer expect the bytes in @raw. */
+		if (size < sizeof(insn) && insn.bytes) {
+			memcpy(insn.raw, insn.bytes, insn.size);
+			insn.bytes = NULL;
+		}
+
+		/* Do not provide more than we actually have. */
+		if (sizeof(insn) < size)
+			size = sizeof(insn);
+
+		memcpy(uinsn, &insn, size);
+	}
+
+	return status;
+}
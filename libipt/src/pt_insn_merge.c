@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_insn_merge.h"
+#include "pt_atomic.h"
+#include "pt_thread.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The default number of instructions per buffer. */
+enum {
+	pt_insn_merge_lookahead	= 0x400
+};
+
+int pt_insn_merge_init(struct pt_insn_merge *merge, uint32_t lookahead)
+{
+	if (!merge)
+		return -pte_internal;
+
+	memset(merge, 0, sizeof(*merge));
+
+	if (!lookahead)
+		lookahead = pt_insn_merge_lookahead;
+
+	merge->lookahead = lookahead;
+
+	return 0;
+}
+
+void pt_insn_merge_fini(struct pt_insn_merge *merge)
+{
+	uint32_t idx;
+
+	if (!merge)
+		return;
+
+	for (idx = 0; idx < merge->ncpus; ++idx) {
+		struct pt_merge_cpu *cpu;
+
+		cpu = &merge->cpus[idx];
+
+		pt_insn_free_decoder(cpu->decoder);
+		free(cpu->buffer[0]);
+		free(cpu->buffer[1]);
+	}
+
+	free(merge->cpus);
+	free(merge->heap);
+}
+
+struct pt_insn_merge *pt_insn_merge_alloc(uint32_t lookahead)
+{
+	struct pt_insn_merge *merge;
+	int errcode;
+
+	merge = malloc(sizeof(*merge));
+	if (!merge)
+		return NULL;
+
+	errcode = pt_insn_merge_init(merge, lookahead);
+	if (errcode < 0) {
+		free(merge);
+		return NULL;
+	}
+
+	return merge;
+}
+
+void pt_insn_merge_free(struct pt_insn_merge *merge)
+{
+	pt_insn_merge_fini(merge);
+	free(merge);
+}
+
+int pt_insn_merge_add(struct pt_insn_merge *merge,
+		      const struct pt_config *config,
+		      struct pt_image *image, uint32_t cpu)
+{
+	struct pt_merge_cpu *mcpu;
+	int errcode;
+
+	if (!merge || !config)
+		return -pte_invalid;
+
+	if (merge->started)
+		return -pte_invalid;
+
+	if ((uint32_t) INT32_MAX <= merge->ncpus)
+		return -pte_nomem;
+
+	if (merge->size <= merge->ncpus) {
+		struct pt_merge_cpu *cpus;
+		uint32_t *heap;
+		uint32_t size;
+
+		size = merge->size ? merge->size << 1 : 8;
+
+		cpus = realloc(merge->cpus, size * sizeof(*cpus));
+		if (!cpus)
+			return -pte_nomem;
+
+		merge->cpus = cpus;
+
+		heap = realloc(merge->heap, size * sizeof(*heap));
+		if (!heap)
+			return -pte_nomem;
+
+		merge->heap = heap;
+		merge->size = size;
+	}
+
+	mcpu = &merge->cpus[merge->ncpus];
+	memset(mcpu, 0, sizeof(*mcpu));
+
+	mcpu->buffer[0] = calloc(merge->lookahead, sizeof(*mcpu->buffer[0]));
+	mcpu->buffer[1] = calloc(merge->lookahead, sizeof(*mcpu->buffer[1]));
+	if (!mcpu->buffer[0] || !mcpu->buffer[1]) {
+		errcode = -pte_nomem;
+		goto out_buffer;
+	}
+
+	mcpu->decoder = pt_insn_alloc_decoder(config);
+	if (!mcpu->decoder) {
+		errcode = -pte_nomem;
+		goto out_buffer;
+	}
+
+	if (image) {
+		errcode = pt_insn_set_image(mcpu->decoder, image);
+		if (errcode < 0)
+			goto out_decoder;
+	}
+
+	mcpu->cpu = cpu;
+	mcpu->state = pt_merge_empty;
+
+	return (int) merge->ncpus++;
+
+out_decoder:
+	pt_insn_free_decoder(mcpu->decoder);
+
+out_buffer:
+	free(mcpu->buffer[0]);
+	free(mcpu->buffer[1]);
+	return errcode;
+}
+
+struct pt_insn_decoder *pt_insn_merge_decoder(struct pt_insn_merge *merge,
+					      uint32_t index)
+{
+	if (!merge || merge->ncpus <= index)
+		return NULL;
+
+	return merge->cpus[index].decoder;
+}
+
+/* Decode the next instructions of @cpu into its other buffer.
+ *
+ * The caller must own the buffer.  Hands it over to the merge.
+ *
+ * Returns the number of decoded instructions.
+ */
+static int pt_insn_merge_decode(struct pt_merge_cpu *cpu, uint32_t lookahead)
+{
+	struct pt_merge_insn *buffer;
+	uint32_t ninsn;
+
+	buffer = cpu->buffer[cpu->front ^ 1];
+
+	for (ninsn = 0; ninsn < lookahead && !cpu->done;) {
+		struct pt_merge_insn *insn;
+		int status;
+
+		if (!cpu->synced) {
+			status = pt_insn_sync_forward(cpu->decoder);
+			if (status < 0) {
+				if (status != -pte_eos)
+					cpu->errors += 1;
+
+				cpu->done = 1;
+				break;
+			}
+
+			cpu->synced = 1;
+		}
+
+		insn = &buffer[ninsn];
+
+		status = pt_insn_next(cpu->decoder, &insn->insn,
+				      sizeof(insn->insn));
+		if (status < 0) {
+			if (status == -pte_eos) {
+				cpu->done = 1;
+				break;
+			}
+
+			/* We resume at the next synchronization point. */
+			cpu->errors += 1;
+			cpu->synced = 0;
+			continue;
+		}
+
+		/* Without a time stamp, we use the last known time. */
+		(void) pt_insn_time(cpu->decoder, &cpu->tsc);
+
+		insn->tsc = cpu->tsc;
+		insn->cpu = cpu->cpu;
+
+		ninsn += 1;
+	}
+
+	cpu->nback = ninsn;
+	cpu->fills += 1;
+
+	pt_atomic_store32(&cpu->state, pt_merge_full);
+
+	return (int) ninsn;
+}
+
+int pt_insn_merge_fill(struct pt_insn_merge *merge, uint32_t index)
+{
+	struct pt_merge_cpu *cpu;
+
+	if (!merge || merge->ncpus <= index)
+		return -pte_invalid;
+
+	cpu = &merge->cpus[index];
+
+	if (!pt_atomic_cas32(&cpu->state, pt_merge_empty, pt_merge_busy))
+		return 0;
+
+	return pt_insn_merge_decode(cpu, merge->lookahead);
+}
+
+/* Wait until @cpu's other buffer is no longer being decoded on another
+ * thread.
+ *
+ * Decodes other processors' empty buffers in the meantime.  Yields if there
+ * is nothing to decode.
+ */
+static void pt_insn_merge_wait(struct pt_insn_merge *merge,
+			       const struct pt_merge_cpu *cpu)
+{
+	uint32_t idx;
+
+	for (idx = 0; pt_atomic_load32(&cpu->state) == pt_merge_busy;
+	     idx = (idx + 1) % merge->ncpus) {
+		struct pt_merge_cpu *other;
+
+		other = &merge->cpus[idx];
+		if (other != cpu &&
+		    pt_atomic_cas32(&other->state, pt_merge_empty,
+				    pt_merge_busy)) {
+			(void) pt_insn_merge_decode(other, merge->lookahead);
+			continue;
+		}
+
+		pt_thread_yield();
+	}
+}
+
+/* Switch @cpu to its other buffer.
+ *
+ * Decodes the other buffer if it has not been decoded, yet.  Waits if it is
+ * being decoded.
+ *
+ * Returns the number of instructions in the new front buffer.
+ */
+static uint32_t pt_insn_merge_swap(struct pt_insn_merge *merge,
+				   struct pt_merge_cpu *cpu)
+{
+	uint32_t state;
+
+	for (;;) {
+		state = pt_atomic_load32(&cpu->state);
+		if (state == pt_merge_full)
+			break;
+
+		if (state == pt_merge_empty &&
+		    pt_atomic_cas32(&cpu->state, pt_merge_empty,
+				    pt_merge_busy)) {
+			merge->stalls += 1;
+
+			(void) pt_insn_merge_decode(cpu, merge->lookahead);
+			break;
+		}
+
+		if (state == pt_merge_busy)
+			merge->stalls += 1;
+
+		/* Wait for pt_insn_merge_fill() on another thread. */
+		pt_insn_merge_wait(merge, cpu);
+	}
+
+	cpu->front ^= 1;
+	cpu->nfront = cpu->nback;
+	cpu->pos = 0;
+
+	pt_atomic_store32(&cpu->state, pt_merge_empty);
+
+	return cpu->nfront;
+}
+
+/* Check whether the processor at index @lhs comes before the processor at
+ * index @rhs in @merge.
+ */
+static int pt_insn_merge_before(const struct pt_insn_merge *merge,
+				uint32_t lhs, uint32_t rhs)
+{
+	const struct pt_merge_cpu *lcpu, *rcpu;
+	uint64_t ltsc, rtsc;
+
+	lcpu = &merge->cpus[lhs];
+	rcpu = &merge->cpus[rhs];
+
+	ltsc = lcpu->buffer[lcpu->front][lcpu->pos].tsc;
+	rtsc = rcpu->buffer[rcpu->front][rcpu->pos].tsc;
+
+	if (ltsc != rtsc)
+		return ltsc < rtsc;
+
+	return lhs < rhs;
+}
+
+/* Restore the heap order from @slot downwards. */
+static void pt_insn_merge_sift_down(struct pt_insn_merge *merge,
+				    uint32_t slot)
+{
+	uint32_t *heap, nheap;
+
+	heap = merge->heap;
+	nheap = merge->nheap;
+
+	for (;;) {
+		uint32_t child, tmp;
+
+		child = (slot << 1) + 1;
+		if (nheap <= child)
+			break;
+
+		if (child + 1 < nheap &&
+		    pt_insn_merge_before(merge, heap[child + 1], heap[child]))
+			child += 1;
+
+		if (!pt_insn_merge_before(merge, heap[child], heap[slot]))
+			break;
+
+		tmp = heap[slot];
+		heap[slot] = heap[child];
+		heap[child] = tmp;
+
+		slot = child;
+	}
+}
+
+/* Start merging.
+ *
+ * Decodes the first buffer of each processor and builds the heap.
+ */
+static void pt_insn_merge_start(struct pt_insn_merge *merge)
+{
+	uint32_t idx;
+
+	merge->started = 1;
+
+	for (idx = 0; idx < merge->ncpus; ++idx) {
+		if (pt_insn_merge_swap(merge, &merge->cpus[idx]))
+			merge->heap[merge->nheap++] = idx;
+	}
+
+	for (idx = merge->nheap >> 1; idx > 0; --idx)
+		pt_insn_merge_sift_down(merge, idx - 1);
+}
+
+int pt_insn_merge_next(struct pt_insn_merge *merge,
+		       struct pt_merge_insn *insn)
+{
+	struct pt_merge_cpu *cpu;
+
+	if (!merge || !insn)
+		return -pte_invalid;
+
+	if (!merge->started)
+		pt_insn_merge_start(merge);
+
+	if (!merge->nheap)
+		return -pte_eos;
+
+	cpu = &merge->cpus[merge->heap[0]];
+
+	*insn = cpu->buffer[cpu->front][cpu->pos];
+	merge->insns += 1;
+
+	cpu->pos += 1;
+	if (cpu->nfront <= cpu->pos && !pt_insn_merge_swap(merge, cpu)) {
+		/* The trace has ended.  We remove the processor. */
+		merge->nheap -= 1;
+		merge->heap[0] = merge->heap[merge->nheap];
+	}
+
+	pt_insn_merge_sift_down(merge, 0);
+
+	return 0;
+}
+
+int pt_insn_merge_get_stats(const struct pt_insn_merge *merge,
+			    struct pt_merge_stats *stats)
+{
+	uint32_t idx;
+
+	if (!merge || !stats)
+		return -pte_invalid;
+
+	memset(stats, 0, sizeof(*stats));
+
+	stats->insns = merge->insns;
+	stats->stalls = merge->stalls;
+
+	for (idx = 0; idx < merge->ncpus; ++idx) {
+		stats->fills += merge->cpus[idx].fills;
+		stats->errors += merge->cpus[idx].errors;
+	}
+
+	return 0;
+}
@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_manifest.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+/* The manifest format.
+ *
+ * All numbers are stored in little-endian byte order.  The header is followed
+ * by the file table and by the section table.
+ */
+enum {
+	/* The format version. */
+	pt_manifest_version		= 2,
+
+	/* The header: magic, version, nfiles, nsections, reserved. */
+	pt_manifest_magic_size		= 8,
+	pt_manifest_header_size		= 24,
+
+	/* A file table entry: the length of the name followed by the name
+	 * without terminating zero, the file size, and the file modification
+	 * time.
+	 */
+	pt_manifest_max_filename	= 0x10000,
+	pt_manifest_file_id_size	= 16,
+	pt_manifest_min_file_size	= 4 + 1 + pt_manifest_file_id_size,
+
+	/* A section table entry: file, offset, size, vaddr, cr3, vmcs, hash. */
+	pt_manifest_section_size	= 52,
+
+	/* The number of bytes hashed at a time. */
+	pt_manifest_hash_chunk		= 0x1000
+};
+
+static const char pt_manifest_magic[pt_manifest_magic_size] = {
+	'p', 't', 'i', 'm', 'a', 'g', 'e', 0
+};
+
+static const uint64_t pt_manifest_fnv_basis = 0xcbf29ce484222325ull;
+static const uint64_t pt_manifest_fnv_prime = 0x100000001b3ull;
+
+
+static char *dupstr(const char *str)
+{
+	char *dup;
+	size_t len;
+
+	if (!str)
+		return NULL;
+
+	len = strlen(str);
+	dup = malloc(len + 1);
+	if (!dup)
+		return NULL;
+
+	return strcpy(dup, str);
+}
+
+static void pt_manifest_put32(uint8_t *buffer, uint32_t value)
+{
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t) (value >> 8);
+	buffer[2] = (uint8_t) (value >> 16);
+	buffer[3] = (uint8_t) (value >> 24);
+}
+
+static void pt_manifest_put64(uint8_t *buffer, uint64_t value)
+{
+	pt_manifest_put32(buffer, (uint32_t) value);
+	pt_manifest_put32(buffer + 4, (uint32_t) (value >> 32));
+}
+
+static uint32_t pt_manifest_get32(const uint8_t *buffer)
+{
+	return (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8) |
+		((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+}
+
+static uint64_t pt_manifest_get64(const uint8_t *buffer)
+{
+	return (uint64_t) pt_manifest_get32(buffer) |
+		((uint64_t) pt_manifest_get32(buffer + 4) << 32);
+}
+
+/* Provide the size and modification time of @filename in @size and @mtime.
+ *
+ * Provides zero for both if they can not be determined.
+ */
+static void pt_manifest_file_id(uint64_t *size, uint64_t *mtime,
+				const char *filename)
+{
+	struct stat buffer;
+
+	*size = 0ull;
+	*mtime = 0ull;
+
+	if (stat(filename, &buffer))
+		return;
+
+	*size = (uint64_t) buffer.st_size;
+	*mtime = (uint64_t) buffer.st_mtime;
+}
+
+void pt_manifest_init(struct pt_manifest *manifest)
+{
+	if (!manifest)
+		return;
+
+	memset(manifest, 0, sizeof(*manifest));
+}
+
+void pt_manifest_fini(struct pt_manifest *manifest)
+{
+	uint32_t index;
+
+	if (!manifest)
+		return;
+
+	for (index = 0; index < manifest->nfiles; ++index)
+		free(manifest->files[index].name);
+
+	free(manifest->files);
+	free(manifest->sections);
+
+	pt_manifest_init(manifest);
+}
+
+int pt_manifest_add_file(struct pt_manifest *manifest, const char *filename)
+{
+	uint32_t index;
+
+	if (!manifest || !filename)
+		return -pte_internal;
+
+	/* Sections of the same file tend to be adjacent - search backwards. */
+	for (index = manifest->nfiles; index; --index) {
+		if (strcmp(manifest->files[index - 1].name, filename) == 0)
+			return (int) (index - 1);
+	}
+
+	if ((uint32_t) INT32_MAX <= manifest->nfiles)
+		return -pte_nomem;
+
+	if (manifest->nfiles == manifest->fcapacity) {
+		struct pt_manifest_file *files;
+		uint32_t capacity;
+
+		capacity = manifest->fcapacity ? manifest->fcapacity * 2 : 8;
+		files = realloc(manifest->files, capacity * sizeof(*files));
+		if (!files)
+			return -pte_nomem;
+
+		manifest->files = files;
+		manifest->fcapacity = capacity;
+	}
+
+	index = manifest->nfiles;
+
+	manifest->files[index].name = dupstr(filename);
+	if (!manifest->files[index].name)
+		return -pte_nomem;
+
+	pt_manifest_file_id(&manifest->files[index].size,
+			    &manifest->files[index].mtime, filename);
+
+	manifest->nfiles += 1;
+
+	return (int) index;
+}
+
+int pt_manifest_add_section(struct pt_manifest *manifest,
+			    const struct pt_manifest_section *section)
+{
+	if (!manifest || !section)
+		return -pte_internal;
+
+	if (manifest->nfiles <= section->file)
+		return -pte_internal;
+
+	if (manifest->nsections == manifest->scapacity) {
+		struct pt_manifest_section *sections;
+		uint32_t capacity;
+
+		capacity = manifest->scapacity ? manifest->scapacity * 2 : 8;
+		if (capacity < manifest->scapacity)
+			return -pte_nomem;
+
+		sections = realloc(manifest->sections,
+				   capacity * sizeof(*sections));
+		if (!sections)
+			return -pte_nomem;
+
+		manifest->sections = sections;
+		manifest->scapacity = capacity;
+	}
+
+	manifest->sections[manifest->nsections++] = *section;
+
+	return 0;
+}
+
+int pt_manifest_write(const struct pt_manifest *manifest, FILE *file)
+{
+	uint8_t buffer[pt_manifest_header_size];
+	uint32_t index;
+
+	if (!manifest || !file)
+		return -pte_internal;
+
+	memcpy(buffer, pt_manifest_magic, sizeof(pt_manifest_magic));
+	pt_manifest_put32(&buffer[8], pt_manifest_version);
+	pt_manifest_put32(&buffer[12], manifest->nfiles);
+	pt_manifest_put32(&buffer[16], manifest->nsections);
+	pt_manifest_put32(&buffer[20], 0);
+
+	if (fwrite(buffer, pt_manifest_header_size, 1, file) != 1)
+		return -pte_invalid;
+
+	for (index = 0; index < manifest->nfiles; ++index) {
+		const struct pt_manifest_file *mfile;
+		size_t length;
+
+		mfile = &manifest->files[index];
+		length = strlen(mfile->name);
+
+		if (pt_manifest_max_filename < length)
+			return -pte_invalid;
+
+		pt_manifest_put32(buffer, (uint32_t) length);
+
+		if (fwrite(buffer, 4, 1, file) != 1)
+			return -pte_invalid;
+
+		if (fwrite(mfile->name, 1, length, file) != length)
+			return -pte_invalid;
+
+		pt_manifest_put64(&buffer[0], mfile->size);
+		pt_manifest_put64(&buffer[8], mfile->mtime);
+
+		if (fwrite(buffer, pt_manifest_file_id_size, 1, file) != 1)
+			return -pte_invalid;
+	}
+
+	for (index = 0; index < manifest->nsections; ++index) {
+		const struct pt_manifest_section *section;
+		uint8_t entry[pt_manifest_section_size];
+
+		section = &manifest->sections[index];
+
+		pt_manifest_put32(&entry[0], section->file);
+		pt_manifest_put64(&entry[4], section->offset);
+		pt_manifest_put64(&entry[12], section->size);
+		pt_manifest_put64(&entry[20], section->vaddr);
+		pt_manifest_put64(&entry[28], section->cr3);
+		pt_manifest_put64(&entry[36], section->vmcs);
+		pt_manifest_put64(&entry[44], section->hash);
+
+		if (fwrite(entry, pt_manifest_section_size, 1, file) != 1)
+			return -pte_invalid;
+	}
+
+	if (fflush(file))
+		return -pte_invalid;
+
+	return 0;
+}
+
+/* Read the file table.
+ *
+ * Reads @nfiles file names from @file into @manifest.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_manifest_read_files(struct pt_manifest *manifest, FILE *file,
+				  uint32_t nfiles)
+{
+	if (!nfiles)
+		return 0;
+
+	manifest->files = calloc(nfiles, sizeof(*manifest->files));
+	if (!manifest->files)
+		return -pte_nomem;
+
+	manifest->fcapacity = nfiles;
+
+	for (; manifest->nfiles < nfiles; manifest->nfiles += 1) {
+		uint8_t buffer[pt_manifest_file_id_size];
+		uint32_t length;
+		char *filename;
+
+		if (fread(buffer, 4, 1, file) != 1)
+			return -pte_invalid;
+
+		length = pt_manifest_get32(buffer);
+		if (!length || pt_manifest_max_filename < length)
+			return -pte_invalid;
+
+		filename = malloc(length + 1);
+		if (!filename)
+			return -pte_nomem;
+
+		if (fread(filename, 1, length, file) != length) {
+			free(filename);
+			return -pte_invalid;
+		}
+
+		filename[length] = 0;
+		if (strlen(filename) != length) {
+			free(filename);
+			return -pte_invalid;
+		}
+
+		if (fread(buffer, sizeof(buffer), 1, file) != 1) {
+			free(filename);
+			return -pte_invalid;
+		}
+
+		manifest->files[manifest->nfiles].name = filename;
+		manifest->files[manifest->nfiles].size =
+			pt_manifest_get64(&buffer[0]);
+		manifest->files[manifest->nfiles].mtime =
+			pt_manifest_get64(&buffer[8]);
+	}
+
+	return 0;
+}
+
+/* Read the section table.
+ *
+ * Reads @nsections sections from @file into @manifest.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_manifest_read_sections(struct pt_manifest *manifest, FILE *file,
+				     uint32_t nsections)
+{
+	size_t size;
+
+	if (!nsections)
+		return 0;
+
+	/* The size may overflow on 32-bit hosts. */
+	size = (size_t) nsections * sizeof(*manifest->sections);
+	if ((size / sizeof(*manifest->sections)) != nsections)
+		return -pte_nomem;
+
+	manifest->sections = malloc(size);
+	if (!manifest->sections)
+		return -pte_nomem;
+
+	manifest->scapacity = nsections;
+
+	for (; manifest->nsections < nsections; manifest->nsections += 1) {
+		struct pt_manifest_section *section;
+		uint8_t entry[pt_manifest_section_size];
+
+		if (fread(entry, sizeof(entry), 1, file) != 1)
+			return -pte_invalid;
+
+		section = &manifest->sections[manifest->nsections];
+
+		section->file = pt_manifest_get32(&entry[0]);
+		section->offset = pt_manifest_get64(&entry[4]);
+		section->size = pt_manifest_get64(&entry[12]);
+		section->vaddr = pt_manifest_get64(&entry[20]);
+		section->cr3 = pt_manifest_get64(&entry[28]);
+		section->vmcs = pt_manifest_get64(&entry[36]);
+		section->hash = pt_manifest_get64(&entry[44]);
+
+		if (manifest->nfiles <= section->file)
+			return -pte_invalid;
+	}
+
+	return 0;
+}
+
+/* Determine the number of bytes from the current position to the end of
+ * @file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_manifest_remaining(FILE *file, uint64_t *remaining)
+{
+	long pos, end;
+
+	pos = ftell(file);
+	if (pos < 0)
+		return -pte_invalid;
+
+	if (fseek(file, 0, SEEK_END))
+		return -pte_invalid;
+
+	end = ftell(file);
+	if (fseek(file, pos, SEEK_SET) || end < pos)
+		return -pte_invalid;
+
+	*remaining = (uint64_t) (end - pos);
+	return 0;
+}
+
+int pt_manifest_read(struct pt_manifest *manifest, FILE *file)
+{
+	uint8_t buffer[pt_manifest_header_size];
+	uint32_t nfiles, nsections;
+	uint64_t remaining;
+	int errcode;
+
+	if (!manifest || !file)
+		return -pte_internal;
+
+	if (fread(buffer, sizeof(buffer), 1, file) != 1)
+		return -pte_invalid;
+
+	if (memcmp(buffer, pt_manifest_magic, sizeof(pt_manifest_magic)) != 0)
+		return -pte_invalid;
+
+	if (pt_manifest_get32(&buffer[8]) != pt_manifest_version)
+		return -pte_invalid;
+
+	nfiles = pt_manifest_get32(&buffer[12]);
+	nsections = pt_manifest_get32(&buffer[16]);
+
+	if ((uint32_t) INT32_MAX < nfiles || (uint32_t) INT32_MAX < nsections)
+		return -pte_invalid;
+
+	/* The counts come from the file.  Check that the file holds that many
+	 * entries before we allocate the tables.
+	 */
+	errcode = pt_manifest_remaining(file, &remaining);
+	if (errcode < 0)
+		return errcode;
+
+	if ((remaining / pt_manifest_min_file_size) < nfiles)
+		return -pte_invalid;
+
+	remaining -= (uint64_t) nfiles * pt_manifest_min_file_size;
+	if ((remaining / pt_manifest_section_size) < nsections)
+		return -pte_invalid;
+
+	errcode = pt_manifest_read_files(manifest, file, nfiles);
+	if (errcode >= 0)
+		errcode = pt_manifest_read_sections(manifest, file, nsections);
+
+	if (errcode < 0)
+		pt_manifest_fini(manifest);
+
+	return errcode;
+}
+
+int pt_manifest_file_unchanged(const struct pt_manifest_file *file)
+{
+	uint64_t size, mtime;
+
+	if (!file || !file->name)
+		return 0;
+
+	/* We can't tell if we don't know the file's identity. */
+	if (!file->size && !file->mtime)
+		return 0;
+
+	pt_manifest_file_id(&size, &mtime, file->name);
+
+	return (size == file->size) && (mtime == file->mtime);
+}
+
+int pt_manifest_hash(uint64_t *hash, const struct pt_section *section,
+		     uint64_t offset, uint64_t size)
+{
+	uint8_t buffer[pt_manifest_hash_chunk];
+	uint64_t value;
+
+	if (!hash || !section)
+		return -pte_internal;
+
+	value = pt_manifest_fnv_basis;
+	while (size) {
+		uint16_t chunk;
+		int status, index;
+
+		chunk = sizeof(buffer);
+		if (size < chunk)
+			chunk = (uint16_t) size;
+
+		status = pt_section_read(section, buffer, chunk, offset);
+		if (status < 0)
+			return status;
+
+		if (status != chunk)
+			return -pte_nomap;
+
+		for (index = 0; index < status; ++index) {
+			value ^= buffer[index];
+			value *= pt_manifest_fnv_prime;
+		}
+
+		offset += chunk;
+		size -= chunk;
+	}
+
+	*hash = value;
+	return 0;
+}
@@ -34,13 +34,16 @@
 
 
 void pt_msec_init(struct pt_mapped_section *msec, struct pt_section *section,
-		  const struct pt_asid *asid, uint64_t vaddr)
+		  const struct pt_asid *asid, uint64_t vaddr, uint64_t offset,
+		  uint64_t size)
 {
 	if (!msec)
 		return;
 
 	msec->section = section;
 	msec->vaddr = vaddr;
+	msec->offset = offset;
+	msec->size = size;
 
 	if (asid)
 		msec->asid = *asid;
@@ -55,6 +58,8 @@ void pt_msec_fini(struct pt_mapped_section *msec)
 
 	msec->section = NULL;
 	msec->vaddr = 0ull;
+	msec->offset = 0ull;
+	msec->size = 0ull;
 }
 
 uint64_t pt_msec_begin(const struct pt_mapped_section *msec)
@@ -67,16 +72,13 @@ uint64_t pt_msec_begin(const struct pt_mapped_section *msec)
 
 uint64_t pt_msec_end(const struct pt_mapped_section *msec)
 {
-	uint64_t size;
-
 	if (!msec)
 		return 0ull;
 
-	size = pt_section_size(msec->section);
-	if (!size)
+	if (!msec->size)
 		return 0ull;
 
-	return msec->vaddr + size;
+	return msec->vaddr + msec->size;
 }
 
 const struct pt_asid *pt_msec_asid(const struct pt_mapped_section *msec)
@@ -115,6 +117,41 @@ int pt_msec_read(const struct pt_mapped_section *msec, uint8_t *buffer,
 		return -pte_nomap;
 
 	addr -= msec->vaddr;
+	if (msec->size <= addr)
+		return -pte_nomap;
+
+	if (msec->size - addr < size)
+		size = (uint16_t) (msec->size - addr);
+
+	return pt_section_read(msec->section, buffer, size,
+			       msec->offset + addr);
+}
+
+int pt_msec_peek(const struct pt_mapped_section *msec, const uint8_t **begin,
+		 uint16_t size, const struct pt_asid *asid, uint64_t addr)
+{
+	int errcode;
+
+	if (!msec || !asid)
+		return -pte_internal;
+
+	errcode = pt_msec_matches_asid(msec, asid);
+	if (errcode < 0)
+		return errcode;
+
+	if (!errcode)
+		return -pte_nomap;
+
+	if (addr < msec->vaddr)
+		return -pte_nomap;
+
+	addr -= msec->vaddr;
+	if (msec->size <= addr)
+		return -pte_nomap;
+
+	if (msec->size - addr < size)
+		size = (uint16_t) (msec->size - addr);
 
-	return pt_section_read(msec->section, buffer, size, addr);
+	return pt_section_peek(msec->section, begin, size,
+			       msec->offset + addr);
 }
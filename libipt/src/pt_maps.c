@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_maps.h"
+#include "pt_image.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static int pt_maps_isspace(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+/* Skip the whitespace separating two fields.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if there is no whitespace at @pline.
+ */
+static int pt_maps_next_field(char **pline)
+{
+	char *line;
+
+	line = *pline;
+	if (!pt_maps_isspace(*line))
+		return -pte_invalid;
+
+	do {
+		line += 1;
+	} while (pt_maps_isspace(*line));
+
+	*pline = line;
+	return 0;
+}
+
+/* Parse a hexadecimal number at @pline and advance @pline beyond it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if there is no number or if it does not fit.
+ */
+static int pt_maps_parse_hex(uint64_t *value, char **pline)
+{
+	uint64_t val;
+	char *line;
+
+	line = *pline;
+	val = 0ull;
+
+	for (;; ++line) {
+		uint8_t digit;
+		char c;
+
+		c = *line;
+		if ('0' <= c && c <= '9')
+			digit = (uint8_t) (c - '0');
+		else if ('a' <= c && c <= 'f')
+			digit = (uint8_t) (c - 'a' + 10);
+		else if ('A' <= c && c <= 'F')
+			digit = (uint8_t) (c - 'A' + 10);
+		else
+			break;
+
+		if (val >> 60)
+			return -pte_invalid;
+
+		val = (val << 4) | digit;
+	}
+
+	if (line == *pline)
+		return -pte_invalid;
+
+	*value = val;
+	*pline = line;
+	return 0;
+}
+
+/* Parse a permission character at @pline and advance @pline beyond it.
+ *
+ * Adds @perm to @perms if the character is @c.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_invalid if the character is neither @c nor '-'.
+ */
+static int pt_maps_parse_perm(uint32_t *perms, char **pline, char c,
+			      uint32_t perm)
+{
+	char *line;
+
+	line = *pline;
+	if (*line == c)
+		*perms |= perm;
+	else if (*line != '-')
+		return -pte_invalid;
+
+	*pline = line + 1;
+	return 0;
+}
+
+int pt_maps_parse_line(struct pt_maps_entry *entry, char *line)
+{
+	uint64_t major, minor;
+	char *end;
+	int errcode;
+
+	if (!entry || !line)
+		return -pte_internal;
+
+	end = line + strlen(line);
+	while (line < end && pt_maps_isspace(end[-1]))
+		end -= 1;
+
+	*end = 0;
+
+	errcode = pt_maps_parse_hex(&entry->begin, &line);
+	if (errcode < 0)
+		return errcode;
+
+	if (*line++ != '-')
+		return -pte_invalid;
+
+	errcode = pt_maps_parse_hex(&entry->end, &line);
+	if (errcode < 0)
+		return errcode;
+
+	if (entry->end < entry->begin)
+		return -pte_invalid;
+
+	errcode = pt_maps_next_field(&line);
+	if (errcode < 0)
+		return errcode;
+
+	entry->perms = 0;
+
+	errcode = pt_maps_parse_perm(&entry->perms, &line, 'r', pt_maps_read);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_maps_parse_perm(&entry->perms, &line, 'w', pt_maps_write);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_maps_parse_perm(&entry->perms, &line, 'x', pt_maps_exec);
+	if (errcode < 0)
+		return errcode;
+
+	/* The mapping is either private or shared. */
+	if (*line != 'p' && *line != 's')
+		return -pte_invalid;
+
+	line += 1;
+
+	errcode = pt_maps_next_field(&line);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_maps_parse_hex(&entry->offset, &line);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_maps_next_field(&line);
+	if (errcode < 0)
+		return errcode;
+
+	/* We ignore the device. */
+	errcode = pt_maps_parse_hex(&major, &line);
+	if (errcode < 0)
+		return errcode;
+
+	if (*line++ != ':')
+		return -pte_invalid;
+
+	errcode = pt_maps_parse_hex(&minor, &line);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_maps_next_field(&line);
+	if (errcode < 0)
+		return errcode;
+
+	/* We ignore the inode. */
+	if (*line < '0' || '9' < *line)
+		return -pte_invalid;
+
+	do {
+		line += 1;
+	} while ('0' <= *line && *line <= '9');
+
+	entry->filename = NULL;
+	if (!*line)
+		return 0;
+
+	errcode = pt_maps_next_field(&line);
+	if (errcode < 0)
+		return errcode;
+
+	entry->filename = line;
+	return 0;
+}
+
+/* Order maps entries by file name. */
+static int pt_maps_compare_filename(const void *lhs, const void *rhs)
+{
+	const struct pt_maps_entry *lentry, *rentry;
+
+	lentry = (const struct pt_maps_entry *) lhs;
+	rentry = (const struct pt_maps_entry *) rhs;
+
+	return strcmp(lentry->filename, rentry->filename);
+}
+
+/* Check whether a maps entry describes an executable mapping of a file. */
+static int pt_maps_is_exec_file(const struct pt_maps_entry *entry)
+{
+	if (!(entry->perms & pt_maps_exec))
+		return 0;
+
+	/* Pseudo-files like [vdso] or [heap] do not start with a slash. */
+	if (!entry->filename || entry->filename[0] != '/')
+		return 0;
+
+	return 1;
+}
+
+/* Parse the executable file mappings in @text.
+ *
+ * Stores the executable file mappings in @text in @entries, which must have
+ * room for one entry per line of @text.
+ *
+ * Returns the number of stored entries on success, a negative error code
+ * otherwise.
+ */
+static int pt_maps_parse(struct pt_maps_entry *entries, char *text)
+{
+	char *line, *next;
+	int nentries;
+
+	nentries = 0;
+	for (line = text; line; line = next) {
+		struct pt_maps_entry *entry;
+		const char *pos;
+		int errcode;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = 0;
+
+		/* Skip empty lines. */
+		for (pos = line; pt_maps_isspace(*pos); ++pos)
+			;
+
+		if (!*pos)
+			continue;
+
+		entry = &entries[nentries];
+
+		errcode = pt_maps_parse_line(entry, line);
+		if (errcode < 0)
+			return errcode;
+
+		if (pt_maps_is_exec_file(entry))
+			nentries += 1;
+	}
+
+	return nentries;
+}
+
+int pt_maps_add(struct pt_image *image, char *text, const struct pt_asid *asid)
+{
+	struct pt_maps_entry *entries;
+	struct pt_image_range *ranges;
+	const char *pos;
+	size_t nlines;
+	int nentries, nranges, index, errcode;
+
+	if (!image || !text || !asid)
+		return -pte_internal;
+
+	nlines = 1;
+	for (pos = text; *pos; ++pos) {
+		if (*pos == '\n')
+			nlines += 1;
+	}
+
+	entries = malloc(nlines * sizeof(*entries));
+	if (!entries)
+		return -pte_nomem;
+
+	nentries = pt_maps_parse(entries, text);
+	if (nentries <= 0) {
+		free(entries);
+		return nentries;
+	}
+
+	ranges = malloc(nentries * sizeof(*ranges));
+	if (!ranges) {
+		free(entries);
+		return -pte_nomem;
+	}
+
+	/* Group the mappings by file so we open each file only once. */
+	qsort(entries, nentries, sizeof(*entries), pt_maps_compare_filename);
+
+	nranges = 0;
+	errcode = 0;
+	for (index = 0; index < nentries;) {
+		struct pt_section *section;
+		const char *filename;
+		uint64_t ssize;
+
+		filename = entries[index].filename;
+
+		section = pt_mk_section(filename, 0ull, UINT64_MAX);
+		ssize = pt_section_size(section);
+
+		for (; index < nentries; ++index) {
+			const struct pt_maps_entry *entry;
+			struct pt_image_range *range;
+			uint64_t size;
+
+			entry = &entries[index];
+			if (strcmp(entry->filename, filename) != 0)
+				break;
+
+			if (!section || ssize <= entry->offset)
+				continue;
+
+			size = entry->end - entry->begin;
+			if (ssize - entry->offset < size)
+				size = ssize - entry->offset;
+
+			if (!size)
+				continue;
+
+			errcode = pt_section_get(section);
+			if (errcode < 0)
+				break;
+
+			range = &ranges[nranges++];
+			range->section = section;
+			range->vaddr = entry->begin;
+			range->offset = entry->offset;
+			range->size = size;
+		}
+
+		/* Each mapping holds its own reference. */
+		if (section)
+			(void) pt_section_put(section);
+
+		if (errcode < 0)
+			break;
+	}
+
+	if (errcode >= 0)
+		errcode = pt_image_add_ranges(image, ranges, (size_t) nranges,
+					      asid);
+
+	if (errcode < 0) {
+		for (index = 0; index < nranges; ++index)
+			(void) pt_section_put(ranges[index].section);
+	}
+
+	free(ranges);
+	free(entries);
+
+	return (errcode < 0) ? errcode : nranges;
+}
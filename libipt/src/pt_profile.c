@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_profile.h"
+
+#include "intel-pt.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The initial sizes of a profile's arrays. */
+enum {
+	pt_profile_initial_nodes	= 0x40,
+	pt_profile_initial_table	= 0x80,
+	pt_profile_initial_frames	= 0x40
+};
+
+int pt_profile_init(struct pt_profile *profile)
+{
+	if (!profile)
+		return -pte_internal;
+
+	memset(profile, 0, sizeof(*profile));
+
+	profile->nodes = malloc(pt_profile_initial_nodes *
+				sizeof(*profile->nodes));
+	profile->table = calloc(pt_profile_initial_table,
+				sizeof(*profile->table));
+	profile->stack = malloc(pt_profile_initial_frames *
+				sizeof(*profile->stack));
+
+	if (!profile->nodes || !profile->table || !profile->stack) {
+		pt_profile_fini(profile);
+		return -pte_nomem;
+	}
+
+	profile->nodes_capacity = pt_profile_initial_nodes;
+	profile->table_size = pt_profile_initial_table;
+	profile->stack_capacity = pt_profile_initial_frames;
+
+	/* The outermost node is its own parent.  It is not in the table. */
+	memset(&profile->nodes[0], 0, sizeof(profile->nodes[0]));
+	profile->nnodes = 1;
+
+	profile->stack[0].ret = 0ull;
+	profile->stack[0].node = 0;
+	profile->nframes = 1;
+
+	profile->pending = ppp_none;
+
+	return 0;
+}
+
+void pt_profile_fini(struct pt_profile *profile)
+{
+	if (!profile)
+		return;
+
+	free(profile->nodes);
+	free(profile->table);
+	free(profile->stack);
+}
+
+struct pt_profile *pt_profile_alloc(void)
+{
+	struct pt_profile *profile;
+	int errcode;
+
+	profile = malloc(sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	errcode = pt_profile_init(profile);
+	if (errcode < 0) {
+		free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+void pt_profile_free(struct pt_profile *profile)
+{
+	pt_profile_fini(profile);
+	free(profile);
+}
+
+/* Compute the first table slot to search for the callee at @entry of the
+ * node at index @caller.
+ */
+static uint32_t pt_profile_hash(const struct pt_profile *profile,
+				uint32_t caller, uint64_t entry)
+{
+	uint64_t key;
+
+	key = (entry ^ ((uint64_t) caller << 40)) * 0x9e3779b97f4a7c15ull;
+
+	return (uint32_t) (key >> 32) & (profile->table_size - 1);
+}
+
+/* Insert the node at @index into @profile's table.
+ *
+ * The table must have an empty slot.
+ */
+static void pt_profile_insert(struct pt_profile *profile, uint32_t index)
+{
+	const struct pt_profile_tree_node *node;
+	uint32_t slot, mask;
+
+	node = &profile->nodes[index];
+	mask = profile->table_size - 1;
+
+	slot = pt_profile_hash(profile, node->parent, node->entry);
+	while (profile->table[slot])
+		slot = (slot + 1) & mask;
+
+	profile->table[slot] = index + 1;
+}
+
+/* Double the size of @profile's table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_profile_grow_table(struct pt_profile *profile)
+{
+	uint32_t *table, size, index;
+
+	size = profile->table_size;
+	if ((UINT32_MAX >> 1) < size)
+		return -pte_nomem;
+
+	table = calloc((size_t) size << 1, sizeof(*table));
+	if (!table)
+		return -pte_nomem;
+
+	free(profile->table);
+	profile->table = table;
+	profile->table_size = size << 1;
+
+	for (index = 1; index < profile->nnodes; ++index)
+		pt_profile_insert(profile, index);
+
+	return 0;
+}
+
+/* Add a node for the callee at @entry of the node at index @caller.
+ *
+ * On success, provides the new node's index in @callee.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_profile_add_node(struct pt_profile *profile, uint32_t *callee,
+			       uint32_t caller, uint64_t entry)
+{
+	struct pt_profile_tree_node *node;
+	uint32_t index;
+	int errcode;
+
+	index = profile->nnodes;
+
+	/* We keep the table at most half full. */
+	if ((profile->table_size >> 1) <= index) {
+		errcode = pt_profile_grow_table(profile);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (profile->nodes_capacity <= index) {
+		uint32_t capacity;
+
+		capacity = profile->nodes_capacity << 1;
+		if (capacity <= index)
+			return -pte_nomem;
+
+		node = realloc(profile->nodes, capacity * sizeof(*node));
+		if (!node)
+			return -pte_nomem;
+
+		profile->nodes = node;
+		profile->nodes_capacity = capacity;
+	}
+
+	node = &profile->nodes[index];
+	node->entry = entry;
+	node->self = 0ull;
+	node->total = 0ull;
+	node->parent = caller;
+	node->depth = profile->nodes[caller].depth + 1;
+
+	profile->nnodes = index + 1;
+
+	pt_profile_insert(profile, index);
+
+	*callee = index;
+	return 0;
+}
+
+/* Find the callee at @entry of the node at index @caller.
+ *
+ * Adds a new node if there is none, yet.  On success, provides the callee's
+ * node index in @callee.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_profile_callee(struct pt_profile *profile, uint32_t *callee,
+			     uint32_t caller, uint64_t entry)
+{
+	uint32_t slot, mask;
+
+	mask = profile->table_size - 1;
+
+	slot = pt_profile_hash(profile, caller, entry);
+	for (;; slot = (slot + 1) & mask) {
+		const struct pt_profile_tree_node *node;
+		uint32_t index;
+
+		index = profile->table[slot];
+		if (!index)
+			break;
+
+		node = &profile->nodes[index - 1];
+		if (node->entry == entry && node->parent == caller) {
+			*callee = index - 1;
+			return 0;
+		}
+	}
+
+	return pt_profile_add_node(profile, callee, caller, entry);
+}
+
+/* Push a frame for a call to @entry.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_profile_call(struct pt_profile *profile, uint64_t entry)
+{
+	struct pt_profile_frame *frame;
+	uint32_t nframes, callee;
+	int errcode;
+
+	nframes = profile->nframes;
+	if (profile->stack_capacity <= nframes) {
+		uint32_t capacity;
+
+		capacity = profile->stack_capacity << 1;
+		if (capacity <= nframes)
+			return -pte_nomem;
+
+		frame = realloc(profile->stack, capacity * sizeof(*frame));
+		if (!frame)
+			return -pte_nomem;
+
+		profile->stack = frame;
+		profile->stack_capacity = capacity;
+	}
+
+	errcode = pt_profile_callee(profile, &callee,
+				    profile->stack[nframes - 1].node, entry);
+	if (errcode < 0)
+		return errcode;
+
+	frame = &profile->stack[nframes];
+	frame->ret = profile->pending_ret;
+	frame->node = callee;
+
+	profile->nframes = nframes + 1;
+
+	return 0;
+}
+
+/* Pop frames for a return to @ip.
+ *
+ * Pops the innermost frame that returns to @ip and all frames above it.  If
+ * there is no such frame, pops the top frame.  The bottom frame is never
+ * popped.
+ */
+static void pt_profile_return(struct pt_profile *profile, uint64_t ip)
+{
+	uint32_t frame;
+
+	for (frame = profile->nframes - 1; 0 < frame; --frame) {
+		if (profile->stack[frame].ret == ip) {
+			profile->nframes = frame;
+			return;
+		}
+	}
+
+	if (1 < profile->nframes)
+		profile->nframes -= 1;
+}
+
+int pt_profile_add_insn(struct pt_profile *profile, const struct pt_insn *insn)
+{
+	struct pt_profile_tree_node *node;
+	int errcode;
+
+	if (!profile || !insn)
+		return -pte_invalid;
+
+	/* We lose the call stack if we don't know where we came from. */
+	if (insn->gap || insn->resynced || (insn->enabled && !insn->resumed)) {
+		profile->nframes = 1;
+		profile->pending = ppp_none;
+	}
+
+	switch (profile->pending) {
+	case ppp_none:
+		break;
+
+	case ppp_call:
+		errcode = pt_profile_call(profile, insn->ip);
+		if (errcode < 0)
+			return errcode;
+
+		break;
+
+	case ppp_return:
+		pt_profile_return(profile, insn->ip);
+		break;
+	}
+
+	node = &profile->nodes[profile->stack[profile->nframes - 1].node];
+	node->self += 1;
+
+	profile->have_totals = 0;
+	profile->pending = ppp_none;
+
+	/* The interrupt handler returns to the next instruction, which we
+	 * don't know, yet.
+	 */
+	if (insn->interrupted) {
+		profile->pending = ppp_call;
+		profile->pending_ret = 0ull;
+
+		return 0;
+	}
+
+	switch (insn->iclass) {
+	case ptic_call:
+	case ptic_far_call:
+		profile->pending = ppp_call;
+		profile->pending_ret = insn->ip + insn->size;
+		break;
+
+	case ptic_return:
+	case ptic_far_return:
+		profile->pending = ppp_return;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/* Compute the total counts of @profile's nodes.
+ *
+ * Callers precede their callees so a single backwards pass suffices.
+ */
+static void pt_profile_sum(struct pt_profile *profile)
+{
+	struct pt_profile_tree_node *nodes;
+	uint32_t index;
+
+	if (profile->have_totals)
+		return;
+
+	nodes = profile->nodes;
+	for (index = 0; index < profile->nnodes; ++index)
+		nodes[index].total = nodes[index].self;
+
+	for (index = profile->nnodes - 1; 0 < index; --index)
+		nodes[nodes[index].parent].total += nodes[index].total;
+
+	profile->have_totals = 1;
+}
+
+int pt_profile_get_node(struct pt_profile *profile, uint32_t index,
+			struct pt_profile_node *node)
+{
+	const struct pt_profile_tree_node *tnode;
+
+	if (!profile || !node)
+		return -pte_invalid;
+
+	if (profile->nnodes <= index)
+		return -pte_eos;
+
+	pt_profile_sum(profile);
+
+	tnode = &profile->nodes[index];
+
+	node->entry = tnode->entry;
+	node->parent = tnode->parent;
+	node->depth = tnode->depth;
+	node->self = tnode->self;
+	node->total = tnode->total;
+
+	return 0;
+}
+
+/* Write the call stack of the node at @index to @file.
+ *
+ * Uses @path to hold the node indices on the call stack.  It must provide
+ * room for the node's depth plus one indices.
+ */
+static void pt_profile_write_path(FILE *file,
+				  const struct pt_profile *profile,
+				  uint32_t *path, uint32_t index)
+{
+	uint32_t depth, level;
+
+	depth = profile->nodes[index].depth;
+	for (level = depth; 0 < level; --level) {
+		path[level] = index;
+		index = profile->nodes[index].parent;
+	}
+	path[0] = index;
+
+	for (level = 0; level <= depth; ++level) {
+		uint64_t entry;
+
+		if (level)
+			fputc(';', file);
+
+		entry = profile->nodes[path[level]].entry;
+		if (entry)
+			fprintf(file, "0x%" PRIx64, entry);
+		else
+			fputs("[unknown]", file);
+	}
+}
+
+int pt_profile_write_folded(struct pt_profile *profile, const char *filename)
+{
+	const struct pt_profile_tree_node *node;
+	uint32_t *path, index, depth;
+	FILE *file;
+	int errcode;
+
+	if (!profile || !filename)
+		return -pte_invalid;
+
+	depth = 0;
+	for (index = 0; index < profile->nnodes; ++index) {
+		node = &profile->nodes[index];
+		if (depth < node->depth)
+			depth = node->depth;
+	}
+
+	path = malloc(((size_t) depth + 1) * sizeof(*path));
+	if (!path)
+		return -pte_nomem;
+
+	file = fopen(filename, "w");
+	if (!file) {
+		free(path);
+		return -pte_invalid;
+	}
+
+	for (index = 0; index < profile->nnodes; ++index) {
+		node = &profile->nodes[index];
+		if (!node->self)
+			continue;
+
+		pt_profile_write_path(file, profile, path, index);
+		fprintf(file, " %" PRIu64 "\n", node->self);
+	}
+
+	free(path);
+
+	errcode = ferror(file) ? -pte_invalid : 0;
+	if (fclose(file))
+		errcode = -pte_invalid;
+
+	return errcode;
+}
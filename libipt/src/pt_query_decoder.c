@@ -36,6 +36,7 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 
 int pt_qry_decoder_init(struct pt_query_decoder *decoder,
@@ -56,6 +57,7 @@ int pt_qry_decoder_init(struct pt_query_decoder *decoder,
 	memset(decoder, 0, sizeof(*decoder));
 
 	decoder->config = *config;
+	decoder->cr3 = pt_asid_no_cr3;
 
 	pt_last_ip_init(&decoder->ip);
 	pt_tnt_cache_init(&decoder->tnt);
@@ -85,7 +87,10 @@ struct pt_query_decoder *pt_qry_alloc_decoder(const struct pt_config *config)
 
 void pt_qry_decoder_fini(struct pt_query_decoder *decoder)
 {
-	/* Nothing to do. */
+	if (!decoder)
+		return;
+
+	free(decoder->cr3_filter);
 }
 
 void pt_qry_free_decoder(struct pt_query_decoder *decoder)
@@ -101,6 +106,8 @@ static void pt_qry_reset(struct pt_query_decoder *decoder)
 
 	decoder->enabled = 0;
 	decoder->consume_packet = 0;
+	decoder->resume = 0;
+	decoder->resume_psb = 0;
 	decoder->event = NULL;
 
 	pt_last_ip_init(&decoder->ip);
@@ -124,10 +131,12 @@ static int pt_qry_will_event(const struct pt_query_decoder *decoder)
 		return 1;
 
 	if (dfun->flags & pdff_psbend)
-		return pt_evq_pending(&decoder->evq, evb_psbend);
+		return decoder->resume ||
+			pt_evq_pending(&decoder->evq, evb_psbend);
 
 	if (dfun->flags & pdff_tip)
-		return pt_evq_pending(&decoder->evq, evb_tip);
+		return decoder->resume ||
+			pt_evq_pending(&decoder->evq, evb_tip);
 
 	if (dfun->flags & pdff_fup)
 		return pt_evq_pending(&decoder->evq, evb_fup);
@@ -214,6 +223,296 @@ static int pt_qry_read_ahead(struct pt_query_decoder *decoder)
 	}
 }
 
+/* Check whether @cr3 passes @decoder's address space filter.
+ *
+ * An unknown cr3 always passes.
+ *
+ * Returns non-zero if @cr3 passes the filter; zero otherwise.
+ */
+static int pt_qry_asid_match(const struct pt_query_decoder *decoder,
+			     uint64_t cr3)
+{
+	uint32_t begin, end;
+
+	if (!decoder->cr3_filter || cr3 == pt_asid_no_cr3)
+		return 1;
+
+	begin = 0;
+	end = decoder->ncr3_filter;
+	while (begin < end) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (decoder->cr3_filter[mid] < cr3)
+			begin = mid + 1;
+		else if (cr3 < decoder->cr3_filter[mid])
+			end = mid;
+		else
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Set up @decoder to resume at @pos after skipping trace.
+ *
+ * Tracing is disabled and will be enabled by the TIP.PGE or TIP packet at or
+ * following @pos.  @ip is the last-ip before that packet and @cr3 and @mode
+ * are the cr3 and execution mode that have been in effect.  The execution
+ * mode is not known if @mode is ptem_unknown.
+ *
+ * If @resume is non-zero, the packet at @pos is a TIP that is to be treated
+ * like a TIP.PGE.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_qry_resume_tip(struct pt_query_decoder *decoder,
+			     const uint8_t *pos, const struct pt_last_ip *ip,
+			     uint64_t cr3, enum pt_exec_mode mode, int resume)
+{
+	struct pt_event *ev;
+
+	if (!decoder || !pos || !ip)
+		return -pte_internal;
+
+	decoder->pos = pos;
+	decoder->ip = *ip;
+	decoder->resume = resume ? 1 : 0;
+
+	/* Report the new address space after the enabled event. */
+	ev = pt_evq_enqueue(&decoder->evq, evb_tip);
+	if (!ev)
+		return -pte_internal;
+
+	ev->type = ptev_async_paging;
+	ev->variant.async_paging.cr3 = cr3;
+
+	if (mode == ptem_unknown)
+		return 0;
+
+	ev = pt_evq_enqueue(&decoder->evq, evb_tip);
+	if (!ev)
+		return -pte_internal;
+
+	ev->type = ptev_exec_mode;
+	ev->variant.exec_mode.mode = mode;
+
+	return 0;
+}
+
+/* Skip trace for address spaces that do not pass the filter.
+ *
+ * Tracing has been disabled, explicitly or implicitly, by the PIP or PSB
+ * packet at @begin.  Skip trace at the packet level starting at @begin until
+ *
+ *   - a PSB whose PSB+ header shows a cr3 that passes the filter,
+ *   - a TIP.PGE while the cr3 passes the filter, or
+ *   - a TIP with an IP following a PIP that changes cr3 to a value that
+ *     passes the filter.
+ *
+ * Decoding continues at the first two, at a MODE.EXEC packet immediately
+ * preceding the TIP.PGE, or at the TIP.
+ *
+ * If we run out of trace or if we run into a packet we cannot read, we stop
+ * and leave reporting the error to the regular decode.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_qry_skip_asid(struct pt_query_decoder *decoder,
+			    const uint8_t *begin)
+{
+	struct pt_packet_decoder pkt;
+	struct pt_last_ip ip;
+	enum pt_exec_mode exec;
+	const uint8_t *psb, *mode;
+	uint64_t cr3, packets, psb_packets, mode_packets;
+	int errcode, track_ip;
+
+	if (!decoder || !begin)
+		return -pte_internal;
+
+	errcode = pt_pkt_decoder_init(&pkt, &decoder->config);
+	if (errcode < 0)
+		return errcode;
+
+	/* Tracing is disabled while we skip. */
+	decoder->enabled = 0;
+	decoder->consume_packet = 0;
+	decoder->resume = 0;
+	decoder->resume_psb = 0;
+
+	pt_tnt_cache_init(&decoder->tnt);
+	(void) pt_evq_clear(&decoder->evq, evb_psbend);
+	(void) pt_evq_clear(&decoder->evq, evb_tip);
+	(void) pt_evq_clear(&decoder->evq, evb_fup);
+
+	pkt.pos = begin;
+	ip = decoder->ip;
+	cr3 = decoder->cr3;
+	exec = ptem_unknown;
+	psb = NULL;
+	mode = NULL;
+	packets = 0ull;
+	psb_packets = 0ull;
+	mode_packets = 0ull;
+	track_ip = 0;
+
+	for (;;) {
+		struct pt_packet packet;
+		struct pt_last_ip last;
+		const uint8_t *pos;
+		int size;
+
+		pos = pkt.pos;
+		last = ip;
+
+		size = pt_pkt_next(&pkt, &packet);
+		if (size < 0) {
+			decoder->pos = pos;
+			break;
+		}
+
+		packets += 1;
+
+		switch (packet.type) {
+		default:
+			break;
+
+		case ppt_psb:
+			pt_last_ip_init(&ip);
+
+			psb = pos;
+			psb_packets = packets - 1;
+			mode = NULL;
+			track_ip = 0;
+			break;
+
+		case ppt_psbend:
+			if (psb && pt_qry_asid_match(decoder, cr3)) {
+				decoder->pos = psb;
+				decoder->resume = 1;
+				decoder->resume_psb = 1;
+
+				packets = psb_packets;
+				goto out;
+			}
+
+			psb = NULL;
+			break;
+
+		case ppt_pip:
+			cr3 = packet.payload.pip.cr3;
+			track_ip = psb ? 0 : pt_qry_asid_match(decoder, cr3);
+			mode = NULL;
+			break;
+
+		case ppt_mode:
+			if (packet.payload.mode.leaf != pt_mol_exec)
+				break;
+
+			exec = pt_get_exec_mode(
+				&packet.payload.mode.bits.exec);
+			if (!psb) {
+				mode = pos;
+				mode_packets = packets - 1;
+			}
+			break;
+
+		case ppt_tip_pge:
+			(void) pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						    &decoder->config);
+
+			if (pt_qry_asid_match(decoder, cr3)) {
+				/* The MODE.EXEC packet provides the mode. */
+				if (mode)
+					exec = ptem_unknown;
+				else {
+					mode = pos;
+					mode_packets = packets - 1;
+				}
+
+				errcode = pt_qry_resume_tip(decoder, mode,
+							    &last, cr3, exec,
+							    0);
+				if (errcode < 0)
+					return errcode;
+
+				packets = mode_packets;
+				goto out;
+			}
+
+			mode = NULL;
+			break;
+
+		case ppt_tip: {
+			uint64_t addr;
+
+			(void) pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						    &decoder->config);
+
+			if (track_ip && !pt_last_ip_query(&addr, &ip)) {
+				errcode = pt_qry_resume_tip(decoder, pos,
+							    &last, cr3, exec,
+							    1);
+				if (errcode < 0)
+					return errcode;
+
+				packets -= 1;
+				goto out;
+			}
+
+			mode = NULL;
+		}
+			break;
+
+		case ppt_tip_pgd:
+		case ppt_fup:
+			(void) pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						    &decoder->config);
+			mode = NULL;
+			break;
+
+		case ppt_tnt_8:
+		case ppt_tnt_64:
+			mode = NULL;
+			break;
+
+		case ppt_ovf:
+			pt_last_ip_init(&ip);
+			mode = NULL;
+			break;
+
+		case ppt_tsc:
+			(void) pt_time_update_tsc(&decoder->time,
+						  &packet.payload.tsc,
+						  &decoder->config);
+			break;
+
+		case ppt_cbr:
+			(void) pt_time_update_cbr(&decoder->time,
+						  &packet.payload.cbr,
+						  &decoder->config);
+			break;
+		}
+	}
+
+out:
+	decoder->cr3 = cr3;
+	decoder->skip_stats.bytes += decoder->pos - begin;
+	decoder->skip_stats.packets += packets;
+
+	return 0;
+}
+
+/* Read a PSB+ and skip the trace that follows if its address space does not
+ * pass the filter.
+ *
+ * Returns a positive integer if trace has been skipped.
+ * Returns zero if the PSB+ has been read.
+ * Returns a negative error code otherwise.
+ */
+static int pt_qry_read_psb(struct pt_query_decoder *decoder);
+
 static int pt_qry_start(struct pt_query_decoder *decoder, const uint8_t *pos,
 			uint64_t *addr)
 {
@@ -227,6 +526,7 @@ static int pt_qry_start(struct pt_query_decoder *decoder, const uint8_t *pos,
 
 	decoder->sync = pos;
 	decoder->pos = pos;
+	decoder->cr3 = pt_asid_no_cr3;
 
 	errcode = pt_df_fetch(&decoder->next, pos, &decoder->config);
 	if (errcode)
@@ -239,10 +539,26 @@ static int pt_qry_start(struct pt_query_decoder *decoder, const uint8_t *pos,
 		return -pte_nosync;
 
 	/* Decode the PSB+ header to initialize the state. */
-	errcode = dfun->decode(decoder);
+	errcode = pt_qry_read_psb(decoder);
 	if (errcode < 0)
 		return errcode;
 
+	/* We do not have a start address if we skipped trace.  Tracing will
+	 * be enabled by an event, if at all.
+	 */
+	if (errcode) {
+		(void) pt_qry_read_ahead(decoder);
+
+		status = pt_qry_status_flags(decoder);
+		if (status < 0)
+			return status;
+
+		if (addr)
+			status |= pts_ip_suppressed;
+
+		return status;
+	}
+
 	/* Fill in the start address.
 	 * We do this before reading ahead since the latter may read an
 	 * adjacent PSB+ that might change the decoder's IP, causing us
@@ -617,6 +933,67 @@ int pt_qry_core_bus_ratio(struct pt_query_decoder *decoder, uint32_t *cbr)
 	return pt_time_query_cbr(cbr, &decoder->time);
 }
 
+static int pt_qry_cr3_compare(const void *lhs, const void *rhs)
+{
+	uint64_t lcr3, rcr3;
+
+	lcr3 = *(const uint64_t *) lhs;
+	rcr3 = *(const uint64_t *) rhs;
+
+	return (lcr3 < rcr3) ? -1 : (rcr3 < lcr3) ? 1 : 0;
+}
+
+int pt_qry_set_asid_filter(struct pt_query_decoder *decoder,
+			   const uint64_t *cr3, uint32_t ncr3)
+{
+	uint64_t *filter;
+	uint32_t in, out;
+
+	if (!decoder)
+		return -pte_invalid;
+
+	memset(&decoder->skip_stats, 0, sizeof(decoder->skip_stats));
+
+	if (!ncr3) {
+		free(decoder->cr3_filter);
+		decoder->cr3_filter = NULL;
+		decoder->ncr3_filter = 0;
+
+		return 0;
+	}
+
+	if (!cr3)
+		return -pte_invalid;
+
+	filter = malloc((size_t) ncr3 * sizeof(*filter));
+	if (!filter)
+		return -pte_nomem;
+
+	memcpy(filter, cr3, (size_t) ncr3 * sizeof(*filter));
+	qsort(filter, ncr3, sizeof(*filter), pt_qry_cr3_compare);
+
+	for (out = 0, in = 1; in < ncr3; ++in) {
+		if (filter[in] != filter[out])
+			filter[++out] = filter[in];
+	}
+
+	free(decoder->cr3_filter);
+	decoder->cr3_filter = filter;
+	decoder->ncr3_filter = out + 1;
+
+	return 0;
+}
+
+int pt_qry_get_skip_stats(struct pt_query_decoder *decoder,
+			  struct pt_skip_stats *stats)
+{
+	if (!decoder || !stats)
+		return -pte_invalid;
+
+	*stats = decoder->skip_stats;
+	return 0;
+}
+
 int pt_qry_decode_unknown(struct pt_query_decoder *decoder)
 {
 	struct pt_packet packet;
@@ -667,10 +1044,13 @@ static int pt_qry_read_psb_header(struct pt_query_decoder *decoder)
 	}
 }
 
-int pt_qry_decode_psb(struct pt_query_decoder *decoder)
+static int pt_qry_read_psb(struct pt_query_decoder *decoder)
 {
+	const uint8_t *begin;
 	int size, errcode;
 
+	begin = decoder->pos;
+
 	size = pt_pkt_read_psb(decoder->pos, &decoder->config);
 	if (size < 0)
 		return size;
@@ -681,7 +1061,26 @@ int pt_qry_decode_psb(struct pt_query_decoder *decoder)
 	if (errcode < 0)
 		return errcode;
 
-	/* The next packet following the PSB header will be of type PSBEND.
+	if (pt_qry_asid_match(decoder, decoder->cr3))
+		return 0;
+
+	errcode = pt_qry_skip_asid(decoder, begin);
+	if (errcode < 0)
+		return errcode;
+
+	return 1;
+}
+
+int pt_qry_decode_psb(struct pt_query_decoder *decoder)
+{
+	int errcode;
+
+	errcode = pt_qry_read_psb(decoder);
+	if (errcode < 0)
+		return errcode;
+
+	/* The next packet following the PSB header will be of type PSBEND
+	 * unless we skipped trace.
 	 *
 	 * Decoding this packet will publish the PSB events what have been
 	 * accumulated while reading the PSB header.
@@ -734,6 +1133,10 @@ int pt_qry_decode_tip(struct pt_query_decoder *decoder)
 	struct pt_event *ev;
 	int size;
 
+	/* A TIP that ends skipped trace enables tracing like a TIP.PGE. */
+	if (decoder->resume)
+		return pt_qry_decode_tip_pge(decoder);
+
 	size = pt_qry_decode_ip(decoder);
 	if (size < 0)
 		return size;
@@ -825,6 +1228,7 @@ int pt_qry_decode_tnt_64(struct pt_query_decoder *decoder)
 
 static int pt_qry_consume_tip_pge(struct pt_query_decoder *decoder, int size)
 {
+	decoder->resume = 0;
 	decoder->pos += size;
 	return 0;
 }
@@ -892,6 +1296,12 @@ int pt_qry_decode_tip_pge(struct pt_query_decoder *decoder)
 			}
 				break;
 
+			case ptev_async_paging:
+				pt_qry_add_event_ip(ev,
+						    &ev->variant.async_paging.ip,
+						    decoder);
+				break;
+
 			case ptev_exec_mode:
 				pt_qry_add_event_ip(ev,
 						    &ev->variant.exec_mode.ip,
@@ -1161,11 +1571,31 @@ int pt_qry_decode_pip(struct pt_query_decoder *decoder)
 	if (size < 0)
 		return size;
 
+	decoder->cr3 = packet.cr3;
+
 	/* Paging events are either standalone or bind to the same TIP packet
 	 * as an in-flight async branch event.
 	 */
 	event = pt_evq_find(&decoder->evq, evb_tip, ptev_async_branch);
 	if (!event) {
+		/* Changing to a filtered address space disables tracing at
+		 * the instruction that changed cr3.
+		 */
+		if (!pt_qry_asid_match(decoder, packet.cr3)) {
+			if (decoder->enabled) {
+				event = pt_evq_standalone(&decoder->evq);
+				if (!event)
+					return -pte_internal;
+
+				event->type = ptev_disabled;
+				event->ip_suppressed = 1;
+
+				decoder->event = event;
+			}
+
+			return pt_qry_skip_asid(decoder, decoder->pos);
+		}
+
 		event = pt_evq_standalone(&decoder->evq);
 		if (!event)
 			return -pte_internal;
@@ -1204,6 +1634,7 @@ int pt_qry_header_pip(struct pt_query_decoder *decoder)
 	event->type = ptev_paging;
 	event->variant.paging.cr3 = packet.cr3;
 
+	decoder->cr3 = packet.cr3;
 	decoder->pos += size;
 	return 0;
 }
@@ -1244,6 +1675,10 @@ static int pt_qry_process_pending_psb_events(struct pt_query_decoder *decoder)
 	if (errcode < 0)
 		return errcode;
 
+	/* The PSB+ that ends skipped trace establishes a new context. */
+	if (decoder->resume_psb)
+		ev->status_update = 0;
+
 	switch (ev->type) {
 	default:
 		return -pte_internal;
@@ -1425,6 +1860,34 @@ int pt_qry_decode_psbend(struct pt_query_decoder *decoder)
 {
 	int status;
 
+	/* Tracing resumes at the end of a PSB+ that ends skipped trace if the
+	 * PSB+ provides an IP.
+	 *
+	 * We send the enabled event before the PSB events so they apply to
+	 * the new context.
+	 */
+	if (decoder->resume) {
+		struct pt_event *ev;
+		uint64_t ip;
+		int errcode;
+
+		decoder->resume = 0;
+
+		errcode = pt_last_ip_query(&ip, &decoder->ip);
+		if (decoder->enabled && !errcode) {
+			ev = pt_evq_standalone(&decoder->evq);
+			if (!ev)
+				return -pte_internal;
+
+			ev->type = ptev_enabled;
+			ev->variant.enabled.ip = ip;
+
+			/* Publish the event. */
+			decoder->event = ev;
+			return 0;
+		}
+	}
+
 	status = pt_qry_process_pending_psb_events(decoder);
 	if (status < 0)
 		return status;
@@ -1436,6 +1899,7 @@ int pt_qry_decode_psbend(struct pt_query_decoder *decoder)
 	/* Skip the psbend extended opcode that we fetched before if no more
 	 * psbend events are pending.
 	 */
+	decoder->resume_psb = 0;
 	decoder->pos += ptps_psbend;
 	return 0;
 }
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_read_cache.h"
+#include "pt_asid.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+void pt_read_cache_init(struct pt_read_cache *cache)
+{
+	if (!cache)
+		return;
+
+	memset(cache, 0, sizeof(*cache));
+}
+
+void pt_read_cache_fini(struct pt_read_cache *cache)
+{
+	if (!cache)
+		return;
+
+	free(cache->entries);
+	free(cache->data);
+
+	memset(cache, 0, sizeof(*cache));
+}
+
+int pt_read_cache_configure(struct pt_read_cache *cache, uint32_t page_size,
+			    uint32_t nentries)
+{
+	struct pt_read_cache_entry *entries;
+	uint8_t *data;
+
+	if (!cache)
+		return -pte_internal;
+
+	if (!page_size || !nentries) {
+		pt_read_cache_fini(cache);
+		return 0;
+	}
+
+	if (page_size & (page_size - 1))
+		return -pte_invalid;
+
+	if (page_size < pt_max_insn_size)
+		return -pte_invalid;
+
+	if ((SIZE_MAX / page_size) < nentries)
+		return -pte_nomem;
+
+	entries = calloc(nentries, sizeof(*entries));
+	if (!entries)
+		return -pte_nomem;
+
+	data = malloc((size_t) page_size * nentries);
+	if (!data) {
+		free(entries);
+		return -pte_nomem;
+	}
+
+	pt_read_cache_fini(cache);
+
+	cache->entries = entries;
+	cache->data = data;
+	cache->page_size = page_size;
+	cache->nentries = nentries;
+
+	return 0;
+}
+
+int pt_read_cache_enabled(const struct pt_read_cache *cache)
+{
+	if (!cache)
+		return 0;
+
+	return cache->page_size != 0;
+}
+
+/* Return the index of the cache entry for the window at @vaddr in the address
+ * space given by @cr3 and @vmcs.
+ */
+static uint32_t pt_read_cache_index(const struct pt_read_cache *cache,
+				    uint64_t cr3, uint64_t vmcs,
+				    uint64_t vaddr)
+{
+	uint64_t key;
+
+	key = (vaddr / cache->page_size) ^ (cr3 >> 12) ^ (vmcs << 20);
+	key *= 0x9e3779b97f4a7c15ull;
+
+	return (uint32_t) ((key >> 32) % cache->nentries);
+}
+
+int pt_read_cache_read(struct pt_read_cache *cache, uint8_t *buffer,
+		       uint16_t size, const struct pt_asid *asid,
+		       uint64_t addr, read_memory_callback_t *callback,
+		       void *context)
+{
+	uint64_t cr3, vmcs, mask;
+	uint16_t done;
+
+	if (!cache || !buffer || !asid || !callback)
+		return -pte_internal;
+
+	if (!pt_read_cache_enabled(cache))
+		return callback(buffer, size, asid, addr, context);
+
+	cr3 = asid->cr3;
+	vmcs = asid->vmcs;
+	mask = ~((uint64_t) cache->page_size - 1ull);
+
+	for (done = 0; done < size;) {
+		struct pt_read_cache_entry *entry;
+		uint64_t vaddr, offset;
+		uint32_t idx, avail;
+		uint8_t *data;
+
+		vaddr = (addr + done) & mask;
+		offset = (addr + done) - vaddr;
+
+		idx = pt_read_cache_index(cache, cr3, vmcs, vaddr);
+		entry = &cache->entries[idx];
+		data = &cache->data[(size_t) idx * cache->page_size];
+
+		if (!entry->valid || entry->cr3 != cr3 ||
+		    entry->vmcs != vmcs || entry->vaddr != vaddr) {
+			int status;
+
+			status = callback(data, cache->page_size, asid, vaddr,
+					  context);
+
+			/* We remember failed reads, as well, so we do not ask
+			 * again for the same window.
+			 */
+			if (status < 0)
+				status = 0;
+			else if (cache->page_size < (uint32_t) status)
+				status = (int) cache->page_size;
+
+			entry->cr3 = cr3;
+			entry->vmcs = vmcs;
+			entry->vaddr = vaddr;
+			entry->size = (uint32_t) status;
+			entry->valid = 1;
+		}
+
+		if (entry->size <= offset)
+			break;
+
+		avail = entry->size - (uint32_t) offset;
+		if ((uint32_t) (size - done) < avail)
+			avail = size - done;
+
+		memcpy(&buffer[done], &data[offset], avail);
+		done += (uint16_t) avail;
+
+		/* The memory does not continue beyond a partial window. */
+		if (entry->size < cache->page_size)
+			break;
+	}
+
+	if (done)
+		return (int) done;
+
+	/* The window containing @addr could not be read as a whole.  Let's
+	 * try to read just the requested memory.
+	 */
+	return callback(buffer, size, asid, addr, context);
+}
+
+int pt_read_cache_invalidate(struct pt_read_cache *cache,
+			     const struct pt_asid *asid, uint64_t addr,
+			     uint64_t size)
+{
+	uint64_t end;
+	uint32_t idx;
+	int discarded;
+
+	if (!cache || !asid)
+		return -pte_internal;
+
+	end = addr + size;
+	if (end < addr)
+		end = UINT64_MAX;
+
+	discarded = 0;
+	for (idx = 0; idx < cache->nentries; ++idx) {
+		struct pt_read_cache_entry *entry;
+		struct pt_asid easid;
+		int errcode;
+
+		entry = &cache->entries[idx];
+		if (!entry->valid)
+			continue;
+
+		if (end <= entry->vaddr)
+			continue;
+
+		if (entry->vaddr + cache->page_size <= addr)
+			continue;
+
+		pt_asid_init(&easid);
+		easid.cr3 = entry->cr3;
+		easid.vmcs = entry->vmcs;
+
+		errcode = pt_asid_match(&easid, asid);
+		if (errcode < 0)
+			return errcode;
+
+		if (!errcode)
+			continue;
+
+		entry->valid = 0;
+		discarded += 1;
+	}
+
+	return discarded;
+}
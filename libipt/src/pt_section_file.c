@@ -27,6 +27,7 @@
  */
 
 #include "pt_section.h"
+#include "pt_atomic.h"
 
 #include "intel-pt.h"
 
@@ -35,16 +36,38 @@
 #include <string.h>
 
 
-/* A section based on file operations. */
+/* A section based on file operations or on a memory buffer. */
 struct pt_section {
-	/* The name of the file. */
+	/* The name of the file - NULL for buffers. */
 	char *filename;
 
-	/* The FILE pointer. */
+	/* The FILE pointer - NULL for buffers. */
 	FILE *file;
 
-	/* The begin and end of the section as offset into @file. */
+	/* The memory buffer - NULL for files. */
+	const uint8_t *buffer;
+
+	/* The begin and end of the section as offset into @file or @buffer. */
 	long begin, end;
+
+	/* The generation of a buffer - zero for files. */
+	uint32_t generation;
+
+	/* An optional function for releasing a buffer and its context. */
+	release_memory_callback_t *release;
+	void *context;
+
+	/* The number of current users.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t ucount;
+
+	/* A lock serializing reads from @file - non-zero while it is held.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t lock;
 };
 
 static char *dupstr(const char *str)
@@ -120,8 +143,14 @@ struct pt_section *pt_mk_section(const char *filename, uint64_t offset,
 
 	section->filename = dupstr(filename);
 	section->file = file;
+	section->buffer = NULL;
 	section->begin = fbegin;
 	section->end = fend;
+	section->generation = 0;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
+	section->lock = 0;
 
 	return section;
 
@@ -130,17 +159,98 @@ out:
 	return NULL;
 }
 
+struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					uint64_t size, uint32_t generation)
+{
+	struct pt_section *section;
+	long end;
+
+	if (!buffer || !size)
+		return NULL;
+
+	/* We use the same offset computations as for files. */
+	end = (long) size;
+	if ((uint64_t) end != size || end < 0)
+		return NULL;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	section->filename = NULL;
+	section->file = NULL;
+	section->buffer = buffer;
+	section->begin = 0;
+	section->end = end;
+	section->generation = generation;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
+	section->lock = 0;
+
+	return section;
+}
+
 void pt_section_free(struct pt_section *section)
 {
 	if (!section)
 		return;
 
-	fclose(section->file);
+	if (section->file)
+		fclose(section->file);
+
+	if (section->release)
+		section->release(section->buffer, (uint64_t) section->end,
+				 section->context);
 
 	free(section->filename);
 	free(section);
 }
 
+int pt_section_get(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	if (!pt_atomic_inc32(&section->ucount)) {
+		(void) pt_atomic_dec32(&section->ucount);
+		return -pte_internal;
+	}
+
+	return 0;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	uint32_t ucount;
+
+	if (!section)
+		return -pte_internal;
+
+	ucount = pt_atomic_dec32(&section->ucount);
+	if (ucount == UINT32_MAX) {
+		(void) pt_atomic_inc32(&section->ucount);
+		return -pte_internal;
+	}
+
+	if (!ucount)
+		pt_section_free(section);
+
+	return 0;
+}
+
+int pt_section_set_release(struct pt_section *section,
+			   release_memory_callback_t *release, void *context)
+{
+	if (!section || !section->buffer)
+		return -pte_internal;
+
+	section->release = release;
+	section->context = context;
+
+	return 0;
+}
+
 const char *pt_section_filename(const struct pt_section *section)
 {
 	if (!section)
@@ -149,6 +259,22 @@ const char *pt_section_filename(const struct pt_section *section)
 	return section->filename;
 }
 
+uint32_t pt_section_generation(const struct pt_section *section)
+{
+	if (!section)
+		return 0;
+
+	return section->generation;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return (uint64_t) section->begin;
+}
+
 uint64_t pt_section_size(const struct pt_section *section)
 {
 	if (!section)
@@ -160,6 +286,7 @@ uint64_t pt_section_size(const struct pt_section *section)
 int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 		    uint16_t size, uint64_t offset)
 {
+	uint32_t *lock;
 	long begin, end;
 	size_t read;
 	int errcode;
@@ -183,10 +310,68 @@ int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 	if (begin < section->begin)
 		return -pte_nomap;
 
+	if (section->buffer) {
+		if (section->end < end)
+			size -= (uint16_t) (end - section->end);
+
+		memcpy(buffer, section->buffer + begin, size);
+		return (int) size;
+	}
+
+	/* Decoders on different threads may read from the same section.  The
+	 * file position is shared so we must not interleave seek and read.
+	 *
+	 * Reads are short so we spin.  The lock does not change the section's
+	 * content so we take it on a const @section.
+	 */
+	lock = (uint32_t *) &section->lock;
+	while (!pt_atomic_cas32(lock, 0, 1))
+		;
+
+	read = 0;
 	errcode = fseek(section->file, begin, SEEK_SET);
+	if (!errcode)
+		read = fread(buffer, 1, size, section->file);
+
+	pt_atomic_store32(lock, 0);
+
 	if (errcode)
 		return -pte_nomap;
 
-	read = fread(buffer, 1, size, section->file);
 	return (int) read;
 }
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **pbegin,
+		    uint16_t size, uint64_t offset)
+{
+	long begin, end;
+
+	if (!pbegin || !section)
+		return -pte_invalid;
+
+	/* We only have the memory of buffer sections. */
+	if (!section->buffer)
+		return -pte_nomap;
+
+	begin = (long) offset;
+	if (((uint64_t) begin) != offset)
+		return -pte_nomap;
+
+	begin += section->begin;
+	end = begin + size;
+
+	if (end < begin)
+		return -pte_nomap;
+
+	if (section->end <= begin)
+		return -pte_nomap;
+
+	if (begin < section->begin)
+		return -pte_nomap;
+
+	if (section->end < end)
+		size -= (uint16_t) (end - section->end);
+
+	*pbegin = section->buffer + begin;
+	return (int) size;
+}
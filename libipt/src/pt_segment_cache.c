@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_segment_cache.h"
+#include "pt_packet_decoder.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The initial size of a segment cache's table. */
+enum {
+	pt_segment_cache_initial_size	= 0x40
+};
+
+/* Compute the memory used by a table of @size entries. */
+static uint64_t pt_segment_table_memory(uint32_t size)
+{
+	return (uint64_t) size * sizeof(struct pt_segment_entry);
+}
+
+/* Compute the memory used by the counts of @entry. */
+static uint64_t pt_segment_entry_memory(uint32_t nblocks, uint32_t nedges)
+{
+	return ((uint64_t) nblocks * sizeof(struct pt_block_count)) +
+		((uint64_t) nedges * sizeof(struct pt_edge_count));
+}
+
+int pt_segment_cache_init(struct pt_segment_cache *cache, uint64_t limit)
+{
+	uint64_t memory;
+
+	if (!cache)
+		return -pte_internal;
+
+	memset(cache, 0, sizeof(*cache));
+
+	memory = pt_segment_table_memory(pt_segment_cache_initial_size);
+	if (limit < memory)
+		return -pte_nomem;
+
+	cache->table = calloc(pt_segment_cache_initial_size,
+			      sizeof(*cache->table));
+	if (!cache->table)
+		return -pte_nomem;
+
+	cache->size = pt_segment_cache_initial_size;
+	cache->limit = limit;
+	cache->stats.memory = memory;
+
+	return 0;
+}
+
+/* Remove all segments from @cache.
+ *
+ * The table keeps its size.
+ */
+static void pt_segment_cache_clear(struct pt_segment_cache *cache)
+{
+	uint32_t slot;
+
+	for (slot = 0; slot < cache->size; ++slot) {
+		free(cache->table[slot].blocks);
+		free(cache->table[slot].edges);
+	}
+
+	memset(cache->table, 0, (size_t) cache->size * sizeof(*cache->table));
+
+	cache->stats.segments = 0ull;
+	cache->stats.memory = pt_segment_table_memory(cache->size);
+}
+
+void pt_segment_cache_fini(struct pt_segment_cache *cache)
+{
+	if (!cache || !cache->table)
+		return;
+
+	pt_segment_cache_clear(cache);
+	free(cache->table);
+}
+
+struct pt_segment_cache *pt_segment_cache_alloc(uint64_t limit)
+{
+	struct pt_segment_cache *cache;
+	int errcode;
+
+	cache = malloc(sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	errcode = pt_segment_cache_init(cache, limit);
+	if (errcode < 0) {
+		free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void pt_segment_cache_free(struct pt_segment_cache *cache)
+{
+	pt_segment_cache_fini(cache);
+	free(cache);
+}
+
+int pt_segment_cache_get_stats(const struct pt_segment_cache *cache,
+			       struct pt_segment_cache_stats *stats)
+{
+	if (!cache || !stats)
+		return -pte_invalid;
+
+	*stats = cache->stats;
+
+	return 0;
+}
+
+int pt_segment_cache_bind(struct pt_segment_cache *cache, const void *image,
+			  uint32_t generation, uint64_t context)
+{
+	if (!cache)
+		return -pte_internal;
+
+	if (cache->image == image && cache->generation == generation &&
+	    cache->context == context)
+		return 0;
+
+	if (cache->stats.segments) {
+		pt_segment_cache_clear(cache);
+		cache->stats.flushes += 1;
+	}
+
+	cache->image = image;
+	cache->generation = generation;
+	cache->context = context;
+
+	return 0;
+}
+
+int pt_segment_key(struct pt_segment_key *key, const struct pt_config *config,
+		   const uint8_t *begin, const uint8_t *end)
+{
+	struct pt_packet_decoder pkt;
+	uint64_t hash0, hash1, size;
+	int errcode;
+
+	if (!key || !config)
+		return -pte_internal;
+
+	errcode = pt_pkt_decoder_init(&pkt, config);
+	if (errcode < 0)
+		return errcode;
+
+	/* An FNV-1a hash and a multiply-xorshift hash. */
+	hash0 = 0xcbf29ce484222325ull;
+	hash1 = 0x9e3779b97f4a7c15ull;
+	size = 0ull;
+
+	for (pkt.pos = begin; pkt.pos < end;) {
+		struct pt_packet packet;
+		const uint8_t *pos;
+		int bytes;
+
+		pos = pkt.pos;
+
+		bytes = pt_pkt_next(&pkt, &packet);
+		if (bytes < 0)
+			return bytes;
+
+		switch (packet.type) {
+		case ppt_pad:
+		case ppt_tsc:
+		case ppt_cbr:
+			/* Timing does not affect the control flow within a
+			 * version of the image.  We do not use the cache for
+			 * images with more than one version.
+			 */
+			continue;
+
+		default:
+			break;
+		}
+
+		for (; pos < pkt.pos; ++pos) {
+			hash0 ^= *pos;
+			hash0 *= 0x100000001b3ull;
+
+			hash1 ^= *pos;
+			hash1 *= 0xff51afd7ed558ccdull;
+			hash1 ^= hash1 >> 31;
+		}
+
+		size += (uint64_t) bytes;
+	}
+
+	key->hash[0] = hash0;
+	key->hash[1] = hash1;
+	key->size = size;
+
+	return 0;
+}
+
+/* Find the slot for @key in @table of size @size.
+ *
+ * This is either the segment's slot or the empty slot at which to insert it.
+ * The table must have an empty slot.
+ */
+static struct pt_segment_entry *pt_segment_find(struct pt_segment_entry *table,
+						uint32_t size,
+						const struct pt_segment_key *key)
+{
+	uint32_t slot, mask;
+
+	mask = size - 1;
+	slot = (uint32_t) (key->hash[0] >> 32) & mask;
+	for (;; slot = (slot + 1) & mask) {
+		struct pt_segment_entry *entry;
+
+		entry = &table[slot];
+		if (!entry->key.size)
+			return entry;
+
+		if (entry->key.hash[0] == key->hash[0] &&
+		    entry->key.hash[1] == key->hash[1] &&
+		    entry->key.size == key->size)
+			return entry;
+	}
+}
+
+const struct pt_segment_entry *
+pt_segment_cache_lookup(struct pt_segment_cache *cache,
+			const struct pt_segment_key *key)
+{
+	const struct pt_segment_entry *entry;
+
+	if (!cache || !key)
+		return NULL;
+
+	cache->stats.lookups += 1;
+
+	entry = pt_segment_find(cache->table, cache->size, key);
+	if (!entry->key.size)
+		return NULL;
+
+	cache->stats.hits += 1;
+
+	return entry;
+}
+
+/* Double the size of @cache's table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_segment_cache_grow(struct pt_segment_cache *cache)
+{
+	struct pt_segment_entry *table;
+	uint32_t size, slot;
+
+	size = cache->size;
+	if ((UINT32_MAX >> 1) < size)
+		return -pte_nomem;
+
+	table = calloc((size_t) size << 1, sizeof(*table));
+	if (!table)
+		return -pte_nomem;
+
+	for (slot = 0; slot < size; ++slot) {
+		const struct pt_segment_entry *entry;
+
+		entry = &cache->table[slot];
+		if (!entry->key.size)
+			continue;
+
+		*pt_segment_find(table, size << 1, &entry->key) = *entry;
+	}
+
+	free(cache->table);
+	cache->table = table;
+	cache->size = size << 1;
+	cache->stats.memory += pt_segment_table_memory(size);
+
+	return 0;
+}
+
+int pt_segment_cache_add(struct pt_segment_cache *cache,
+			 const struct pt_segment_key *key,
+			 const struct pt_block_profile *profile,
+			 uint32_t errors)
+{
+	struct pt_segment_entry *entry;
+	uint64_t memory;
+	uint32_t slot, nblocks, nedges;
+
+	if (!cache || !key || !profile)
+		return -pte_internal;
+
+	if (!key->size)
+		return 0;
+
+	memory = pt_segment_entry_memory(profile->nblocks, profile->nedges);
+
+	/* The segment does not fit even into an empty cache. */
+	if (cache->limit < pt_segment_table_memory(cache->size) + memory)
+		return 0;
+
+	/* We keep the table at most half full.
+	 *
+	 * If growing the table exceeds our memory limit, we make room by
+	 * clearing the cache, instead.
+	 */
+	if ((cache->size >> 1) <= cache->stats.segments) {
+		uint64_t grown;
+
+		grown = cache->stats.memory + memory +
+			pt_segment_table_memory(cache->size);
+		if (grown <= cache->limit) {
+			int errcode;
+
+			errcode = pt_segment_cache_grow(cache);
+			if (errcode < 0)
+				return errcode;
+		} else {
+			pt_segment_cache_clear(cache);
+			cache->stats.flushes += 1;
+		}
+	}
+
+	if (cache->limit < cache->stats.memory + memory) {
+		pt_segment_cache_clear(cache);
+		cache->stats.flushes += 1;
+	}
+
+	entry = pt_segment_find(cache->table, cache->size, key);
+	if (entry->key.size)
+		return 0;
+
+	memset(entry, 0, sizeof(*entry));
+
+	if (profile->nblocks) {
+		entry->blocks = malloc((size_t) profile->nblocks *
+				       sizeof(*entry->blocks));
+		if (!entry->blocks)
+			return -pte_nomem;
+	}
+
+	if (profile->nedges) {
+		entry->edges = malloc((size_t) profile->nedges *
+				      sizeof(*entry->edges));
+		if (!entry->edges) {
+			free(entry->blocks);
+			entry->blocks = NULL;
+			return -pte_nomem;
+		}
+	}
+
+	nblocks = 0;
+	for (slot = 0; slot < profile->blocks_size; ++slot) {
+		const struct pt_block_count *block;
+
+		block = &profile->blocks[slot];
+		if (block->count)
+			entry->blocks[nblocks++] = *block;
+	}
+
+	nedges = 0;
+	for (slot = 0; slot < profile->edges_size; ++slot) {
+		const struct pt_edge_count *edge;
+
+		edge = &profile->edges[slot];
+		if (edge->count)
+			entry->edges[nedges++] = *edge;
+	}
+
+	entry->key = *key;
+	entry->nblocks = nblocks;
+	entry->nedges = nedges;
+	entry->errors = errors;
+
+	cache->stats.segments += 1;
+	cache->stats.memory += memory;
+
+	return 0;
+}
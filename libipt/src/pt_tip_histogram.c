@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_tip_histogram.h"
+#include "pt_packet_decoder.h"
+#include "pt_last_ip.h"
+#include "pt_sync.h"
+#include "pt_asid.h"
+
+#include "intel-pt.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The initial size of a histogram's table. */
+enum {
+	pt_tip_histogram_initial_size	= 0x100
+};
+
+int pt_tip_histogram_init(struct pt_tip_histogram *hist, uint32_t context)
+{
+	if (!hist)
+		return -pte_internal;
+
+	memset(hist, 0, sizeof(*hist));
+
+	hist->table = calloc(pt_tip_histogram_initial_size,
+			     sizeof(*hist->table));
+	if (!hist->table)
+		return -pte_nomem;
+
+	hist->size = pt_tip_histogram_initial_size;
+	hist->context = context;
+
+	return 0;
+}
+
+void pt_tip_histogram_fini(struct pt_tip_histogram *hist)
+{
+	if (!hist)
+		return;
+
+	free(hist->table);
+}
+
+struct pt_tip_histogram *pt_tip_histogram_alloc(uint32_t context)
+{
+	struct pt_tip_histogram *hist;
+	int errcode;
+
+	hist = malloc(sizeof(*hist));
+	if (!hist)
+		return NULL;
+
+	errcode = pt_tip_histogram_init(hist, context);
+	if (errcode < 0) {
+		free(hist);
+		return NULL;
+	}
+
+	return hist;
+}
+
+void pt_tip_histogram_free(struct pt_tip_histogram *hist)
+{
+	pt_tip_histogram_fini(hist);
+	free(hist);
+}
+
+/* Compute the first slot to search for @cr3, @from, and @to in a table of
+ * @size entries.
+ */
+static uint32_t pt_tip_histogram_hash(uint64_t cr3, uint64_t from,
+				      uint64_t to, uint32_t size)
+{
+	uint64_t key;
+
+	key = to ^ (cr3 << 20) ^ (cr3 >> 44) ^ (from << 32) ^ (from >> 32);
+	key *= 0x9e3779b97f4a7c15ull;
+
+	return (uint32_t) (key >> 32) & (size - 1);
+}
+
+/* Find the slot for the branch from @from to @to in @cr3 in @table of size
+ * @size.
+ *
+ * This is either the branch's slot or the empty slot at which to insert it.
+ * The table must have an empty slot.
+ */
+static struct pt_tip_count *pt_tip_find(struct pt_tip_count *table,
+					uint32_t size, uint64_t cr3,
+					uint64_t from, uint64_t to)
+{
+	uint32_t slot, mask;
+
+	mask = size - 1;
+	slot = pt_tip_histogram_hash(cr3, from, to, size);
+	for (;; slot = (slot + 1) & mask) {
+		struct pt_tip_count *tip;
+
+		tip = &table[slot];
+		if (!tip->count)
+			return tip;
+
+		if (tip->to == to && tip->from == from && tip->cr3 == cr3)
+			return tip;
+	}
+}
+
+/* Double the size of @hist's table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_tip_histogram_grow(struct pt_tip_histogram *hist)
+{
+	struct pt_tip_count *table;
+	uint32_t size, slot;
+
+	size = hist->size;
+	if ((UINT32_MAX >> 1) < size)
+		return -pte_nomem;
+
+	table = calloc((size_t) size << 1, sizeof(*table));
+	if (!table)
+		return -pte_nomem;
+
+	for (slot = 0; slot < size; ++slot) {
+		const struct pt_tip_count *tip;
+
+		tip = &hist->table[slot];
+		if (!tip->count)
+			continue;
+
+		*pt_tip_find(table, size << 1, tip->cr3, tip->from, tip->to) =
+			*tip;
+	}
+
+	free(hist->table);
+	hist->table = table;
+	hist->size = size << 1;
+
+	return 0;
+}
+
+int pt_tip_histogram_add(struct pt_tip_histogram *hist, uint64_t cr3,
+			 uint64_t from, uint64_t to, uint64_t count)
+{
+	struct pt_tip_count *tip;
+
+	if (!hist)
+		return -pte_internal;
+
+	/* A zero count would mark the slot empty. */
+	if (!count)
+		return 0;
+
+	tip = pt_tip_find(hist->table, hist->size, cr3, from, to);
+	if (tip->count) {
+		tip->count += count;
+		return 0;
+	}
+
+	/* We keep the table at most half full. */
+	if ((hist->size >> 1) <= hist->ncounts) {
+		int errcode;
+
+		errcode = pt_tip_histogram_grow(hist);
+		if (errcode < 0)
+			return errcode;
+
+		tip = pt_tip_find(hist->table, hist->size, cr3, from, to);
+	}
+
+	tip->cr3 = cr3;
+	tip->from = from;
+	tip->to = to;
+	tip->count = count;
+
+	hist->ncounts += 1;
+
+	return 0;
+}
+
+/* Decode the trace in @pkt starting at the PSB packet at @pkt->pos.
+ *
+ * Stops at the end of the trace, at a decode error, or at the first PSB
+ * packet at or after @limit.
+ *
+ * Returns zero if the end of the range or of the trace has been reached.
+ * Returns a positive integer on a decode error.
+ * Returns a negative error code if adding a target failed.
+ */
+static int pt_tip_histogram_decode_segments(struct pt_tip_histogram *hist,
+					    struct pt_packet_decoder *pkt,
+					    const uint8_t *limit)
+{
+	struct pt_last_ip ip;
+	uint64_t cr3, from;
+	int have_from, skip_fup, in_psb;
+
+	if (!hist || !pkt)
+		return -pte_internal;
+
+	pt_last_ip_init(&ip);
+	cr3 = pt_asid_no_cr3;
+	from = 0ull;
+	have_from = 0;
+	skip_fup = 0;
+	in_psb = 0;
+
+	for (;;) {
+		struct pt_packet packet;
+		const uint8_t *pos;
+		uint64_t addr;
+		int size, errcode;
+
+		pos = pkt->pos;
+
+		size = pt_pkt_next(pkt, &packet);
+		if (size < 0)
+			return size == -pte_eos ? 0 : 1;
+
+		switch (packet.type) {
+		default:
+			break;
+
+		case ppt_psb:
+			if (limit <= pos)
+				return 0;
+
+			/* Each segment is decoded independently so the
+			 * result does not depend on how the trace has been
+			 * partitioned.
+			 */
+			pt_last_ip_init(&ip);
+			cr3 = pt_asid_no_cr3;
+			have_from = 0;
+			skip_fup = 0;
+			in_psb = 1;
+
+			pkt->sync = pos;
+			hist->stats.segments += 1;
+			break;
+
+		case ppt_psbend:
+			in_psb = 0;
+			break;
+
+		case ppt_pip:
+			cr3 = packet.payload.pip.cr3;
+			break;
+
+		case ppt_mode:
+			/* The FUP following MODE.TSX gives the current IP
+			 * unless the transaction was aborted.
+			 */
+			if (packet.payload.mode.leaf == pt_mol_tsx)
+				skip_fup = !packet.payload.mode.bits.tsx.abrt;
+			break;
+
+		case ppt_ovf:
+			/* The FUP following OVF gives the resume IP. */
+			have_from = 0;
+			skip_fup = 1;
+			break;
+
+		case ppt_tnt_8:
+		case ppt_tnt_64:
+			have_from = 0;
+			break;
+
+		case ppt_tip_pge:
+		case ppt_tip_pgd:
+			errcode = pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						       &pkt->config);
+			if (errcode < 0)
+				return 1;
+
+			have_from = 0;
+			break;
+
+		case ppt_fup:
+			errcode = pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						       &pkt->config);
+			if (errcode < 0)
+				return 1;
+
+			/* A FUP in PSB+ gives the current IP. */
+			if (in_psb || skip_fup) {
+				skip_fup = 0;
+				break;
+			}
+
+			have_from = !pt_last_ip_query(&from, &ip);
+			break;
+
+		case ppt_tip:
+			errcode = pt_last_ip_update_ip(&ip, &packet.payload.ip,
+						       &pkt->config);
+			if (errcode < 0)
+				return 1;
+
+			errcode = pt_last_ip_query(&addr, &ip);
+			if (errcode < 0) {
+				hist->stats.suppressed += 1;
+				have_from = 0;
+				break;
+			}
+
+			if (!(hist->context & pttc_fup))
+				have_from = 0;
+
+			errcode = pt_tip_histogram_add(hist,
+						       (hist->context &
+							pttc_cr3) ?
+						       cr3 : pt_asid_no_cr3,
+						       have_from ? from : 0ull,
+						       addr, 1ull);
+			if (errcode < 0)
+				return errcode;
+
+			hist->stats.tips += 1;
+			have_from = 0;
+			break;
+		}
+	}
+}
+
+int pt_tip_histogram_decode(struct pt_tip_histogram *hist,
+			    const struct pt_config *config, uint64_t begin,
+			    uint64_t end)
+{
+	struct pt_packet_decoder pkt;
+	const uint8_t *pos, *limit;
+	uint64_t size;
+	int errcode;
+
+	if (!hist || !config)
+		return -pte_invalid;
+
+	errcode = pt_pkt_decoder_init(&pkt, config);
+	if (errcode < 0)
+		return errcode;
+
+	size = (uint64_t) (config->end - config->begin);
+	if (size < begin)
+		return -pte_invalid;
+
+	if (size < end)
+		end = size;
+
+	if (end <= begin)
+		return 0;
+
+	pos = config->begin + begin;
+	limit = config->begin + end;
+
+	for (;;) {
+		const uint8_t *sync;
+
+		errcode = pt_sync_forward(&sync, pos, config);
+		if (errcode < 0)
+			return errcode == -pte_eos ? 0 : errcode;
+
+		/* A PSB packet overlapping @pos belongs to the preceding
+		 * range.
+		 */
+		if (sync < pos) {
+			pos = sync + ptps_psb;
+			continue;
+		}
+
+		if (limit <= sync)
+			return 0;
+
+		pkt.pos = sync;
+		pkt.sync = sync;
+
+		errcode = pt_tip_histogram_decode_segments(hist, &pkt, limit);
+		if (errcode <= 0)
+			return errcode;
+
+		/* Skip to the next segment on errors. */
+		hist->stats.errors += 1;
+		pos = pkt.sync + ptps_psb;
+		if (config->end < pos)
+			return 0;
+	}
+}
+
+int pt_tip_histogram_merge(struct pt_tip_histogram *hist,
+			   const struct pt_tip_histogram *other)
+{
+	uint32_t slot;
+
+	if (!hist || !other)
+		return -pte_invalid;
+
+	for (slot = 0; slot < other->size; ++slot) {
+		const struct pt_tip_count *tip;
+		int errcode;
+
+		tip = &other->table[slot];
+		if (!tip->count)
+			continue;
+
+		errcode = pt_tip_histogram_add(hist, tip->cr3, tip->from,
+					       tip->to, tip->count);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	hist->stats.segments += other->stats.segments;
+	hist->stats.tips += other->stats.tips;
+	hist->stats.suppressed += other->stats.suppressed;
+	hist->stats.errors += other->stats.errors;
+
+	return 0;
+}
+
+int pt_tip_histogram_count(const struct pt_tip_histogram *hist,
+			   const struct pt_asid *uasid, uint64_t from,
+			   uint64_t to, uint64_t *count)
+{
+	const struct pt_tip_count *tip;
+	struct pt_asid asid;
+	int errcode;
+
+	if (!hist || !count)
+		return -pte_invalid;
+
+	errcode = pt_asid_from_user(&asid, uasid);
+	if (errcode < 0)
+		return errcode;
+
+	tip = pt_tip_find(hist->table, hist->size, asid.cr3, from, to);
+	*count = tip->count;
+
+	return 0;
+}
+
+/* Order branch counts by descending count.
+ *
+ * Ties are broken by address space, source, and target to give a stable
+ * order.
+ */
+static int pt_tip_count_compare(const void *pa, const void *pb)
+{
+	const struct pt_tip_count *a, *b;
+
+	a = (const struct pt_tip_count *) pa;
+	b = (const struct pt_tip_count *) pb;
+
+	if (a->count != b->count)
+		return a->count < b->count ? 1 : -1;
+
+	if (a->cr3 != b->cr3)
+		return a->cr3 < b->cr3 ? -1 : 1;
+
+	if (a->from != b->from)
+		return a->from < b->from ? -1 : 1;
+
+	if (a->to != b->to)
+		return a->to < b->to ? -1 : 1;
+
+	return 0;
+}
+
+int pt_tip_histogram_top(const struct pt_tip_histogram *hist,
+			 struct pt_tip_count *top, uint32_t size)
+{
+	struct pt_tip_count *counts;
+	uint32_t slot, ncounts;
+
+	if (!hist || (!top && size))
+		return -pte_invalid;
+
+	if (!size || !hist->ncounts)
+		return 0;
+
+	counts = malloc(hist->ncounts * sizeof(*counts));
+	if (!counts)
+		return -pte_nomem;
+
+	ncounts = 0;
+	for (slot = 0; slot < hist->size; ++slot) {
+		const struct pt_tip_count *tip;
+
+		tip = &hist->table[slot];
+		if (!tip->count)
+			continue;
+
+		counts[ncounts++] = *tip;
+	}
+
+	qsort(counts, ncounts, sizeof(*counts), pt_tip_count_compare);
+
+	if (ncounts < size)
+		size = ncounts;
+
+	memcpy(top, counts, size * sizeof(*counts));
+	free(counts);
+
+	return (int) size;
+}
+
+int pt_tip_histogram_get_stats(const struct pt_tip_histogram *hist,
+			       struct pt_tip_histogram_stats *stats)
+{
+	if (!hist || !stats)
+		return -pte_invalid;
+
+	*stats = hist->stats;
+
+	return 0;
+}
+
+int pt_tip_histogram_write_csv(const struct pt_tip_histogram *hist,
+			       const char *filename)
+{
+	uint32_t slot;
+	FILE *file;
+	int errcode;
+
+	if (!hist || !filename)
+		return -pte_invalid;
+
+	file = fopen(filename, "w");
+	if (!file)
+		return -pte_invalid;
+
+	fputs("cr3,from,to,count\n", file);
+
+	for (slot = 0; slot < hist->size; ++slot) {
+		const struct pt_tip_count *tip;
+
+		tip = &hist->table[slot];
+		if (!tip->count)
+			continue;
+
+		if (tip->cr3 != pt_asid_no_cr3)
+			fprintf(file, "0x%" PRIx64, tip->cr3);
+		fputc(',', file);
+
+		if (tip->from)
+			fprintf(file, "0x%" PRIx64, tip->from);
+		fputc(',', file);
+
+		fprintf(file, "0x%" PRIx64 ",%" PRIu64 "\n", tip->to,
+			tip->count);
+	}
+
+	errcode = ferror(file) ? -pte_invalid : 0;
+	if (fclose(file))
+		errcode = -pte_invalid;
+
+	return errcode;
+}
@@ -73,6 +73,7 @@ static struct ptunit_result from_user_small(void)
 	ptu_int_eq(errcode, 0);
 	ptu_uint_eq(asid.size, sizeof(asid));
 	ptu_uint_eq(asid.cr3, pt_asid_no_cr3);
+	ptu_uint_eq(asid.vmcs, pt_asid_no_vmcs);
 
 	return ptu_passed();
 }
@@ -84,11 +85,13 @@ static struct ptunit_result from_user_big(void)
 
 	user.size = sizeof(user) + 4;
 	user.cr3 = 0x4200ull;
+	user.vmcs = 0x23000ull;
 
 	errcode = pt_asid_from_user(&asid, &user);
 	ptu_int_eq(errcode, 0);
 	ptu_uint_eq(asid.size, sizeof(asid));
 	ptu_uint_eq(asid.cr3, 0x4200ull);
+	ptu_uint_eq(asid.vmcs, 0x23000ull);
 
 	return ptu_passed();
 }
@@ -100,11 +103,13 @@ static struct ptunit_result from_user(void)
 
 	user.size = sizeof(user);
 	user.cr3 = 0x4200ull;
+	user.vmcs = 0x23000ull;
 
 	errcode = pt_asid_from_user(&asid, &user);
 	ptu_int_eq(errcode, 0);
 	ptu_uint_eq(asid.size, sizeof(asid));
 	ptu_uint_eq(asid.cr3, 0x4200ull);
+	ptu_uint_eq(asid.vmcs, 0x23000ull);
 
 	return ptu_passed();
 }
@@ -184,6 +189,61 @@ static struct ptunit_result match_cr3_false(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result match_vmcs_default(void)
+{
+	struct pt_asid lhs, rhs;
+	int errcode;
+
+	pt_asid_init(&lhs);
+	pt_asid_init(&rhs);
+
+	lhs.vmcs = 0x23000ull;
+
+	errcode = pt_asid_match(&lhs, &rhs);
+	ptu_int_eq(errcode, 1);
+
+	errcode = pt_asid_match(&rhs, &lhs);
+	ptu_int_eq(errcode, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result match_vmcs(void)
+{
+	struct pt_asid lhs, rhs;
+	int errcode;
+
+	pt_asid_init(&lhs);
+	pt_asid_init(&rhs);
+
+	lhs.vmcs = 0x23000ull;
+	rhs.vmcs = 0x23000ull;
+
+	errcode = pt_asid_match(&lhs, &rhs);
+	ptu_int_eq(errcode, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result match_vmcs_false(void)
+{
+	struct pt_asid lhs, rhs;
+	int errcode;
+
+	pt_asid_init(&lhs);
+	pt_asid_init(&rhs);
+
+	lhs.cr3 = 0x2300ull;
+	lhs.vmcs = 0x42000ull;
+	rhs.cr3 = 0x2300ull;
+	rhs.vmcs = 0x23000ull;
+
+	errcode = pt_asid_match(&lhs, &rhs);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
 int main(int argc, char **argv)
 {
 	struct ptunit_suite suite;
@@ -200,6 +260,9 @@ int main(int argc, char **argv)
 	ptu_run(suite, match_cr3_default);
 	ptu_run(suite, match_cr3);
 	ptu_run(suite, match_cr3_false);
+	ptu_run(suite, match_vmcs_default);
+	ptu_run(suite, match_vmcs);
+	ptu_run(suite, match_vmcs_false);
 
 	ptunit_report(&suite);
 	return suite.nr_fails;
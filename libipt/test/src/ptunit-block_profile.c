@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_block_profile.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test fixture providing a block profile. */
+struct block_profile_fixture {
+	/* The profile. */
+	struct pt_block_profile profile;
+
+	/* An address space. */
+	struct pt_asid asid;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct block_profile_fixture *);
+	struct ptunit_result (*fini)(struct block_profile_fixture *);
+};
+
+/* Check the count of the block at @ip in @asid. */
+static struct ptunit_result bfix_block(struct block_profile_fixture *bfix,
+				       const struct pt_asid *asid,
+				       uint64_t ip, uint64_t expected)
+{
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_block_profile_block(&bfix->profile, asid, ip, &count);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, expected);
+
+	return ptu_passed();
+}
+
+/* Check the count of the edge from @from to @to in @asid. */
+static struct ptunit_result bfix_edge(struct block_profile_fixture *bfix,
+				      const struct pt_asid *asid,
+				      uint64_t from, uint64_t to,
+				      uint64_t expected)
+{
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_block_profile_edge(&bfix->profile, asid, from, to,
+					&count);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, expected);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_block_profile_init(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_block_profile_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(void)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_block(NULL, 0ull, 0x1000ull, 1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_block_profile_add_edge(NULL, 0ull, 0x1000ull, 0x2000ull,
+					    1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_null(struct block_profile_fixture *bfix)
+{
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_block_profile_block(NULL, NULL, 0x1000ull, &count);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_profile_block(&bfix->profile, NULL, 0x1000ull,
+					 NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_profile_edge(NULL, NULL, 0x1000ull, 0x2000ull,
+					&count);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_profile_edge(&bfix->profile, NULL, 0x1000ull,
+					0x2000ull, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_null(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_merge(NULL, &bfix->profile);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_profile_merge(&bfix->profile, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_null(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_write_csv(NULL, "name");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_profile_write_csv(&bfix->profile, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct block_profile_fixture *bfix)
+{
+	ptu_test(bfix_block, bfix, NULL, 0x1000ull, 0ull);
+	ptu_test(bfix_edge, bfix, NULL, 0x1000ull, 0x2000ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result block(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&bfix->profile, bfix->asid.cr3,
+					     0x1000ull, 5ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(bfix->profile.nblocks, 2);
+	ptu_test(bfix_block, bfix, NULL, 0x1000ull, 3ull);
+	ptu_test(bfix_block, bfix, &bfix->asid, 0x1000ull, 5ull);
+	ptu_test(bfix_block, bfix, NULL, 0x1001ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result block_zero(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 0ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(bfix->profile.nblocks, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result edge(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, pt_asid_no_cr3,
+					    0x1000ull, 0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, pt_asid_no_cr3,
+					    0x1000ull, 0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, pt_asid_no_cr3,
+					    0x2000ull, 0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, bfix->asid.cr3,
+					    0x1000ull, 0x2000ull, 4ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(bfix->profile.nedges, 3);
+	ptu_test(bfix_edge, bfix, NULL, 0x1000ull, 0x2000ull, 2ull);
+	ptu_test(bfix_edge, bfix, NULL, 0x2000ull, 0x1000ull, 1ull);
+	ptu_test(bfix_edge, bfix, &bfix->asid, 0x1000ull, 0x2000ull, 4ull);
+	ptu_test(bfix_edge, bfix, &bfix->asid, 0x2000ull, 0x1000ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result grow(struct block_profile_fixture *bfix)
+{
+	uint64_t ip;
+	int errcode;
+
+	for (ip = 0x1000ull; ip < 0x3000ull; ip += 2) {
+		errcode = pt_block_profile_add_block(&bfix->profile,
+						     pt_asid_no_cr3, ip,
+						     ip - 0xfffull);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_block_profile_add_edge(&bfix->profile,
+						    pt_asid_no_cr3, ip,
+						    ip + 2, 1ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(bfix->profile.nblocks, 0x1000);
+	ptu_uint_eq(bfix->profile.nedges, 0x1000);
+	ptu_uint_le(bfix->profile.nblocks << 1, bfix->profile.blocks_size);
+	ptu_uint_le(bfix->profile.nedges << 1, bfix->profile.edges_size);
+
+	for (ip = 0x1000ull; ip < 0x3000ull; ip += 2) {
+		ptu_test(bfix_block, bfix, NULL, ip, ip - 0xfffull);
+		ptu_test(bfix_edge, bfix, NULL, ip, ip + 2, 1ull);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge(struct block_profile_fixture *bfix)
+{
+	struct pt_block_profile other;
+	int errcode;
+
+	errcode = pt_block_profile_init(&other);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&other, pt_asid_no_cr3,
+					     0x1000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&other, pt_asid_no_cr3,
+					     0x2000ull, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&other, bfix->asid.cr3,
+					    0x1000ull, 0x2000ull, 4ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_merge(&bfix->profile, &other);
+	pt_block_profile_fini(&other);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(bfix->profile.nblocks, 2);
+	ptu_uint_eq(bfix->profile.nedges, 1);
+	ptu_test(bfix_block, bfix, NULL, 0x1000ull, 3ull);
+	ptu_test(bfix_block, bfix, NULL, 0x2000ull, 3ull);
+	ptu_test(bfix_edge, bfix, &bfix->asid, 0x1000ull, 0x2000ull, 4ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result clear(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, pt_asid_no_cr3,
+					    0x1000ull, 0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	pt_block_profile_clear(&bfix->profile);
+
+	ptu_uint_eq(bfix->profile.nblocks, 0);
+	ptu_uint_eq(bfix->profile.nedges, 0);
+	ptu_test(bfix_block, bfix, NULL, 0x1000ull, 0ull);
+	ptu_test(bfix_edge, bfix, NULL, 0x1000ull, 0x2000ull, 0ull);
+
+	return ptu_passed();
+}
+
+/* Read the content of @name into @buffer of @size bytes. */
+static struct ptunit_result read_file(char *buffer, size_t size,
+				      const char *name)
+{
+	FILE *file;
+	size_t read;
+
+	file = fopen(name, "r");
+	ptu_ptr(file);
+
+	read = fread(buffer, 1, size - 1, file);
+	fclose(file);
+
+	buffer[read] = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result csv(struct block_profile_fixture *bfix)
+{
+	char buffer[256], *name;
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&bfix->profile, pt_asid_no_cr3,
+					     0x1000ull, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&bfix->profile, bfix->asid.cr3,
+					    0x1004ull, 0x2000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	errcode = pt_block_profile_write_csv(&bfix->profile, name);
+	if (errcode < 0)
+		free(name);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(read_file, buffer, sizeof(buffer), name);
+
+	remove(name);
+	free(name);
+
+	ptu_str_eq(buffer,
+		   "type,cr3,from,to,count\n"
+		   "block,,0x1000,,3\n"
+		   "edge,0xa000,0x1004,0x2000,2\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result csv_bad_file(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_write_csv(&bfix->profile,
+					     "no-such-dir/profile.csv");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(void)
+{
+	struct pt_block_profile *profile;
+	uint64_t count;
+	int errcode;
+
+	profile = pt_block_profile_alloc();
+	ptu_ptr(profile);
+
+	errcode = pt_block_profile_add_block(profile, pt_asid_no_cr3,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_block(profile, NULL, 0x1000ull, &count);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, 1ull);
+
+	pt_block_profile_free(profile);
+	pt_block_profile_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_init(struct block_profile_fixture *bfix)
+{
+	int errcode;
+
+	errcode = pt_block_profile_init(&bfix->profile);
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&bfix->asid);
+	bfix->asid.cr3 = 0xa000ull;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bfix_fini(struct block_profile_fixture *bfix)
+{
+	pt_block_profile_fini(&bfix->profile);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct block_profile_fixture bfix;
+	struct ptunit_suite suite;
+
+	bfix.init = bfix_init;
+	bfix.fini = bfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, add_null);
+	ptu_run_f(suite, get_null, bfix);
+	ptu_run_f(suite, merge_null, bfix);
+	ptu_run_f(suite, write_null, bfix);
+
+	ptu_run_f(suite, empty, bfix);
+	ptu_run_f(suite, block, bfix);
+	ptu_run_f(suite, block_zero, bfix);
+	ptu_run_f(suite, edge, bfix);
+	ptu_run_f(suite, grow, bfix);
+	ptu_run_f(suite, merge, bfix);
+	ptu_run_f(suite, clear, bfix);
+	ptu_run_f(suite, csv, bfix);
+	ptu_run_f(suite, csv_bad_file, bfix);
+
+	ptu_run(suite, alloc);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
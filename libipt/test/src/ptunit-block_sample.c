@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_block_sample.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test fixture providing a sampled block profile. */
+struct block_sample_fixture {
+	/* The sampled profile. */
+	struct pt_block_sample sample;
+
+	/* An address space. */
+	struct pt_asid asid;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct block_sample_fixture *);
+	struct ptunit_result (*fini)(struct block_sample_fixture *);
+};
+
+/* Add a segment with @count executions of the block at 0x1000 in the
+ * fixture's address space and of the edge from 0x1004 to 0x1000.
+ */
+static struct ptunit_result sfix_segment(struct block_sample_fixture *sfix,
+					 uint64_t count)
+{
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&sfix->sample.segment,
+					     sfix->asid.cr3, 0x1000ull, count);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&sfix->sample.segment,
+					    sfix->asid.cr3, 0x1004ull,
+					    0x1000ull, count);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_sample_end_segment(&sfix->sample);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(sfix->sample.segment.nblocks, 0);
+	ptu_uint_eq(sfix->sample.segment.nedges, 0);
+
+	return ptu_passed();
+}
+
+/* Check the estimated count of the block at 0x1000 and of the edge from
+ * 0x1004 to 0x1000 in the fixture's address space.
+ */
+static struct ptunit_result sfix_estimate(struct block_sample_fixture *sfix,
+					  uint64_t count, uint64_t error)
+{
+	struct pt_estimate estimate;
+	int errcode;
+
+	errcode = pt_block_sample_block(&sfix->sample, &sfix->asid, 0x1000ull,
+					&estimate);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(estimate.count, count);
+	ptu_uint_eq(estimate.error, error);
+
+	errcode = pt_block_sample_edge(&sfix->sample, &sfix->asid, 0x1004ull,
+				       0x1000ull, &estimate);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(estimate.count, count);
+	ptu_uint_eq(estimate.error, error);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_block_sample_init(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_block_sample_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result end_segment_null(void)
+{
+	int errcode;
+
+	errcode = pt_block_sample_end_segment(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result api_null(struct block_sample_fixture *sfix)
+{
+	struct pt_sample_stats stats;
+	struct pt_estimate estimate;
+	int errcode;
+
+	errcode = pt_block_sample_merge(NULL, &sfix->sample);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_merge(&sfix->sample, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_block(NULL, NULL, 0x1000ull, &estimate);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_block(&sfix->sample, NULL, 0x1000ull, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_edge(NULL, NULL, 0x1000ull, 0x2000ull,
+				       &estimate);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_edge(&sfix->sample, NULL, 0x1000ull,
+				       0x2000ull, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_get_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_get_stats(&sfix->sample, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_write_csv(NULL, "name");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_block_sample_write_csv(&sfix->sample, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct block_sample_fixture *sfix)
+{
+	sfix->sample.stats.segments = 4ull;
+
+	ptu_test(sfix_estimate, sfix, 0ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result complete(struct block_sample_fixture *sfix)
+{
+	ptu_test(sfix_segment, sfix, 1ull);
+	ptu_test(sfix_segment, sfix, 3ull);
+
+	sfix->sample.stats.segments = 2ull;
+
+	ptu_uint_eq(sfix->sample.stats.sampled, 2ull);
+	ptu_test(sfix_estimate, sfix, 4ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result partial(struct block_sample_fixture *sfix)
+{
+	ptu_test(sfix_segment, sfix, 1ull);
+	ptu_test(sfix_segment, sfix, 3ull);
+
+	sfix->sample.stats.segments = 4ull;
+
+	/* The mean is 2 with a sample variance of 2.  The standard error of
+	 * the total is 4 * sqrt(2 / 2 * (1 - 2 / 4)) = 2.83.
+	 */
+	ptu_test(sfix_estimate, sfix, 8ull, 6ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result constant(struct block_sample_fixture *sfix)
+{
+	ptu_test(sfix_segment, sfix, 2ull);
+	ptu_test(sfix_segment, sfix, 2ull);
+	ptu_test(sfix_segment, sfix, 2ull);
+
+	sfix->sample.stats.segments = 30ull;
+
+	ptu_test(sfix_estimate, sfix, 60ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result single(struct block_sample_fixture *sfix)
+{
+	ptu_test(sfix_segment, sfix, 2ull);
+
+	sfix->sample.stats.segments = 4ull;
+
+	ptu_test(sfix_estimate, sfix, 8ull, UINT64_MAX);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge(struct block_sample_fixture *sfix)
+{
+	struct pt_block_sample other;
+	int errcode;
+
+	errcode = pt_block_sample_init(&other);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(sfix_segment, sfix, 1ull);
+	sfix->sample.stats.segments = 2ull;
+	sfix->sample.stats.errors = 1ull;
+
+	errcode = pt_block_profile_add_block(&other.segment, sfix->asid.cr3,
+					     0x1000ull, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&other.segment, sfix->asid.cr3,
+					    0x1004ull, 0x1000ull, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_sample_end_segment(&other);
+	ptu_int_eq(errcode, 0);
+
+	other.stats.segments = 2ull;
+	other.stats.exhausted = 1ull;
+
+	errcode = pt_block_sample_merge(&sfix->sample, &other);
+	pt_block_sample_fini(&other);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(sfix->sample.stats.segments, 4ull);
+	ptu_uint_eq(sfix->sample.stats.sampled, 2ull);
+	ptu_uint_eq(sfix->sample.stats.errors, 1ull);
+	ptu_uint_eq(sfix->sample.stats.exhausted, 1ull);
+	ptu_test(sfix_estimate, sfix, 8ull, 6ull);
+
+	return ptu_passed();
+}
+
+/* Read the content of @name into @buffer of @size bytes. */
+static struct ptunit_result read_file(char *buffer, size_t size,
+				      const char *name)
+{
+	FILE *file;
+	size_t read;
+
+	file = fopen(name, "r");
+	ptu_ptr(file);
+
+	read = fread(buffer, 1, size - 1, file);
+	fclose(file);
+
+	buffer[read] = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result csv(struct block_sample_fixture *sfix)
+{
+	char buffer[256], *name;
+	int errcode;
+
+	ptu_test(sfix_segment, sfix, 2ull);
+	sfix->sample.stats.segments = 4ull;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	errcode = pt_block_sample_write_csv(&sfix->sample, name);
+	if (errcode < 0)
+		free(name);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(read_file, buffer, sizeof(buffer), name);
+
+	remove(name);
+	free(name);
+
+	ptu_str_eq(buffer,
+		   "type,cr3,from,to,count,error\n"
+		   "block,0xa000,0x1000,,8,\n"
+		   "edge,0xa000,0x1004,0x1000,8,\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(void)
+{
+	struct pt_block_sample *sample;
+	struct pt_sample_stats stats;
+	int errcode;
+
+	sample = pt_block_sample_alloc();
+	ptu_ptr(sample);
+
+	errcode = pt_block_sample_get_stats(sample, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.segments, 0ull);
+	ptu_uint_eq(stats.sampled, 0ull);
+
+	pt_block_sample_free(sample);
+	pt_block_sample_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_init(struct block_sample_fixture *sfix)
+{
+	int errcode;
+
+	errcode = pt_block_sample_init(&sfix->sample);
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&sfix->asid);
+	sfix->asid.cr3 = 0xa000ull;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sfix_fini(struct block_sample_fixture *sfix)
+{
+	pt_block_sample_fini(&sfix->sample);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct block_sample_fixture sfix;
+	struct ptunit_suite suite;
+
+	sfix.init = sfix_init;
+	sfix.fini = sfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, end_segment_null);
+	ptu_run_f(suite, api_null, sfix);
+
+	ptu_run_f(suite, empty, sfix);
+	ptu_run_f(suite, complete, sfix);
+	ptu_run_f(suite, partial, sfix);
+	ptu_run_f(suite, constant, sfix);
+	ptu_run_f(suite, single, sfix);
+	ptu_run_f(suite, merge, sfix);
+	ptu_run_f(suite, csv, sfix);
+
+	ptu_run(suite, alloc);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -0,0 +1,802 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ptunit.h"
+
+#include "pt_elf.h"
+#include "pt_image.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+
+/* A test section holding an ELF file. */
+struct pt_section {
+	/* The file name. */
+	const char *name;
+
+	/* The contents. */
+	uint8_t content[0x200];
+
+	/* The size - between 0 and sizeof(content). */
+	uint64_t size;
+
+	/* The number of users. */
+	uint16_t ucount;
+};
+
+struct pt_section *pt_mk_section(const char *file, uint64_t offset,
+				 uint64_t size)
+{
+	/* This function is not used by our tests. */
+	return NULL;
+}
+
+struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					uint64_t size, uint32_t generation)
+{
+	/* This function is not used by our tests. */
+	return NULL;
+}
+
+void pt_section_free(struct pt_section *section)
+{
+	(void) section;
+}
+
+int pt_section_get(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	section->ucount += 1;
+
+	return 0;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	if (!section || !section->ucount)
+		return -pte_internal;
+
+	section->ucount -= 1;
+
+	return 0;
+}
+
+int pt_section_set_release(struct pt_section *section,
+			   release_memory_callback_t *release, void *context)
+{
+	/* This function is not used by our tests. */
+	return -pte_internal;
+}
+
+const char *pt_section_filename(const struct pt_section *section)
+{
+	if (!section)
+		return NULL;
+
+	return section->name;
+}
+
+uint32_t pt_section_generation(const struct pt_section *section)
+{
+	(void) section;
+
+	return 0;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	(void) section;
+
+	return 0ull;
+}
+
+uint64_t pt_section_size(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->size;
+}
+
+int pt_section_read(const struct pt_section *section, uint8_t *buffer,
+		    uint16_t size, uint64_t offset)
+{
+	uint64_t begin, end;
+
+	if (!section || !buffer)
+		return -pte_invalid;
+
+	if (section->size <= offset)
+		return -pte_nomap;
+
+	begin = offset;
+	end = begin + size;
+
+	if (section->size < end) {
+		end = section->size;
+		size = (uint16_t) (end - begin);
+	}
+
+	memcpy(buffer, &section->content[begin], size);
+
+	return size;
+}
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **begin,
+		    uint16_t size, uint64_t offset)
+{
+	(void) size;
+	(void) offset;
+
+	if (!section || !begin)
+		return -pte_invalid;
+
+	return -pte_nomap;
+}
+
+/* A test fixture providing an ELF file section and an image. */
+struct elf_fixture {
+	/* The ELF file. */
+	struct pt_section section;
+
+	/* The image. */
+	struct pt_image image;
+
+	/* The address space. */
+	struct pt_asid asid;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct elf_fixture *);
+	struct ptunit_result (*fini)(struct elf_fixture *);
+};
+
+static void efix_put16(uint8_t *buffer, uint16_t value)
+{
+	buffer[0] = (uint8_t) value;
+	buffer[1] = (uint8_t) (value >> 8);
+}
+
+static void efix_put32(uint8_t *buffer, uint32_t value)
+{
+	efix_put16(buffer, (uint16_t) value);
+	efix_put16(buffer + 2, (uint16_t) (value >> 16));
+}
+
+static void efix_put64(uint8_t *buffer, uint64_t value)
+{
+	efix_put32(buffer, (uint32_t) value);
+	efix_put32(buffer + 4, (uint32_t) (value >> 32));
+}
+
+/* Write an ELF64 header with @phnum program headers at @phoff. */
+static void efix_ehdr64(struct elf_fixture *efix, uint16_t type,
+			uint64_t phoff, uint16_t phnum)
+{
+	uint8_t *ehdr;
+
+	ehdr = efix->section.content;
+
+	ehdr[0] = 0x7f;
+	ehdr[1] = 'E';
+	ehdr[2] = 'L';
+	ehdr[3] = 'F';
+	ehdr[4] = pt_elf_class_64;
+	ehdr[5] = 1;
+	ehdr[6] = 1;
+
+	efix_put16(&ehdr[16], type);
+	efix_put16(&ehdr[18], 62);
+	efix_put32(&ehdr[20], 1);
+	efix_put64(&ehdr[32], phoff);
+	efix_put16(&ehdr[52], 64);
+	efix_put16(&ehdr[54], 56);
+	efix_put16(&ehdr[56], phnum);
+}
+
+/* Write an ELF32 header with @phnum program headers at @phoff. */
+static void efix_ehdr32(struct elf_fixture *efix, uint16_t type,
+			uint32_t phoff, uint16_t phnum)
+{
+	uint8_t *ehdr;
+
+	ehdr = efix->section.content;
+
+	ehdr[0] = 0x7f;
+	ehdr[1] = 'E';
+	ehdr[2] = 'L';
+	ehdr[3] = 'F';
+	ehdr[4] = pt_elf_class_32;
+	ehdr[5] = 1;
+	ehdr[6] = 1;
+
+	efix_put16(&ehdr[16], type);
+	efix_put16(&ehdr[18], 3);
+	efix_put32(&ehdr[20], 1);
+	efix_put32(&ehdr[28], phoff);
+	efix_put16(&ehdr[40], 52);
+	efix_put16(&ehdr[42], 32);
+	efix_put16(&ehdr[44], phnum);
+}
+
+/* Write an ELF64 program header at @phoff. */
+static void efix_phdr64(struct elf_fixture *efix, uint64_t phoff,
+			uint32_t type, uint32_t flags, uint64_t offset,
+			uint64_t vaddr, uint64_t filesz, uint64_t memsz)
+{
+	uint8_t *phdr;
+
+	phdr = &efix->section.content[phoff];
+
+	efix_put32(&phdr[0], type);
+	efix_put32(&phdr[4], flags);
+	efix_put64(&phdr[8], offset);
+	efix_put64(&phdr[16], vaddr);
+	efix_put64(&phdr[24], vaddr);
+	efix_put64(&phdr[32], filesz);
+	efix_put64(&phdr[40], memsz);
+	efix_put64(&phdr[48], 0x1000ull);
+}
+
+/* Write an ELF32 program header at @phoff. */
+static void efix_phdr32(struct elf_fixture *efix, uint32_t phoff,
+			uint32_t type, uint32_t flags, uint32_t offset,
+			uint32_t vaddr, uint32_t filesz, uint32_t memsz)
+{
+	uint8_t *phdr;
+
+	phdr = &efix->section.content[phoff];
+
+	efix_put32(&phdr[0], type);
+	efix_put32(&phdr[4], offset);
+	efix_put32(&phdr[8], vaddr);
+	efix_put32(&phdr[12], vaddr);
+	efix_put32(&phdr[16], filesz);
+	efix_put32(&phdr[20], memsz);
+	efix_put32(&phdr[24], flags);
+	efix_put32(&phdr[28], 0x1000);
+}
+
+/* Write an ELF64 shared object with a read-only, an executable, and a
+ * writable segment.
+ */
+static void efix_dyn64(struct elf_fixture *efix)
+{
+	efix_ehdr64(efix, pt_elf_type_dyn, 0x40ull, 3);
+	efix_phdr64(efix, 0x40ull, pt_elf_pt_load, pt_elf_pf_r, 0x0ull,
+		    0x0ull, 0x100ull, 0x100ull);
+	efix_phdr64(efix, 0x78ull, pt_elf_pt_load,
+		    pt_elf_pf_r | pt_elf_pf_x, 0x100ull, 0x1100ull, 0x80ull,
+		    0x80ull);
+	efix_phdr64(efix, 0xb0ull, pt_elf_pt_load,
+		    pt_elf_pf_r | pt_elf_pf_w, 0x180ull, 0x2180ull, 0x80ull,
+		    0x1000ull);
+}
+
+static struct ptunit_result header_null(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	errcode = pt_elf_read_header(NULL, &efix->section);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_elf_read_header(&header, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_magic(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+	efix->section.content[1] = 'X';
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_class(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+	efix->section.content[4] = 3;
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_big_endian(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+	efix->section.content[5] = 2;
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_truncated(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+	efix->section.size = 0x20ull;
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_phentsize(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+	efix_put16(&efix->section.content[54], 32);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header64(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_dyn64(efix);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(header.class, pt_elf_class_64);
+	ptu_uint_eq(header.type, pt_elf_type_dyn);
+	ptu_uint_eq(header.phoff, 0x40ull);
+	ptu_uint_eq(header.phentsize, 56);
+	ptu_uint_eq(header.phnum, 3);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header32(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_ehdr32(efix, pt_elf_type_exec, 0x34, 2);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(header.class, pt_elf_class_32);
+	ptu_uint_eq(header.type, pt_elf_type_exec);
+	ptu_uint_eq(header.phoff, 0x34ull);
+	ptu_uint_eq(header.phentsize, 32);
+	ptu_uint_eq(header.phnum, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_xnum(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	int errcode;
+
+	efix_ehdr64(efix, pt_elf_type_core, 0x40ull, pt_elf_pn_xnum);
+	efix_put64(&efix->section.content[40], 0x100ull);
+	efix_put16(&efix->section.content[58], 64);
+	efix_put32(&efix->section.content[0x100 + 44], 0x12345);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(header.phnum, 0x12345);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result phdr_null(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	struct pt_elf_phdr phdr;
+	int errcode;
+
+	efix_dyn64(efix);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_elf_read_phdr(NULL, &header, &efix->section, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_elf_read_phdr(&phdr, NULL, &efix->section, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_elf_read_phdr(&phdr, &header, NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result phdr_bad_index(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	struct pt_elf_phdr phdr;
+	int errcode;
+
+	efix_dyn64(efix);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_elf_read_phdr(&phdr, &header, &efix->section, 3);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result phdr64(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	struct pt_elf_phdr phdr;
+	int errcode;
+
+	efix_dyn64(efix);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_elf_read_phdr(&phdr, &header, &efix->section, 2);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(phdr.type, pt_elf_pt_load);
+	ptu_uint_eq(phdr.flags, pt_elf_pf_r | pt_elf_pf_w);
+	ptu_uint_eq(phdr.offset, 0x180ull);
+	ptu_uint_eq(phdr.vaddr, 0x2180ull);
+	ptu_uint_eq(phdr.filesz, 0x80ull);
+	ptu_uint_eq(phdr.memsz, 0x1000ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result phdr32(struct elf_fixture *efix)
+{
+	struct pt_elf_header header;
+	struct pt_elf_phdr phdr;
+	int errcode;
+
+	efix_ehdr32(efix, pt_elf_type_exec, 0x34, 2);
+	efix_phdr32(efix, 0x34, pt_elf_pt_load, pt_elf_pf_r, 0x0, 0x8048000,
+		    0x80, 0x80);
+	efix_phdr32(efix, 0x54, pt_elf_pt_load, pt_elf_pf_r | pt_elf_pf_x,
+		    0x80, 0x8049080, 0x40, 0x40);
+
+	errcode = pt_elf_read_header(&header, &efix->section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_elf_read_phdr(&phdr, &header, &efix->section, 1);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(phdr.type, pt_elf_pt_load);
+	ptu_uint_eq(phdr.flags, pt_elf_pf_r | pt_elf_pf_x);
+	ptu_uint_eq(phdr.offset, 0x80ull);
+	ptu_uint_eq(phdr.vaddr, 0x8049080ull);
+	ptu_uint_eq(phdr.filesz, 0x40ull);
+	ptu_uint_eq(phdr.memsz, 0x40ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct elf_fixture *efix)
+{
+	int status;
+
+	status = pt_elf_add_segments(NULL, &efix->section, &efix->asid, 0ull,
+				     pt_elf_pf_x);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_elf_add_segments(&efix->image, NULL, &efix->asid, 0ull,
+				     pt_elf_pf_x);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section, NULL, 0ull,
+				     pt_elf_pf_x);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_bad_file(struct elf_fixture *efix)
+{
+	int status;
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, pt_elf_pf_x);
+	ptu_int_eq(status, -pte_invalid);
+	ptu_uint_eq(efix->section.ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_exec(struct elf_fixture *efix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	efix_dyn64(efix);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0x7f0000000000ull,
+				     pt_elf_pf_x);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(efix->section.ucount, 2);
+
+	status = pt_image_read(&efix->image, buffer, 2, &efix->asid,
+			       0x7f000000117eull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], efix->section.content[0x17e]);
+	ptu_uint_eq(buffer[1], efix->section.content[0x17f]);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x7f0000001180ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x7f0000000000ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_all(struct elf_fixture *efix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	efix_dyn64(efix);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, 0);
+	ptu_int_eq(status, 3);
+	ptu_uint_eq(efix->section.ucount, 4);
+
+	/* Only the file-backed part of the data segment is added. */
+	status = pt_image_read(&efix->image, buffer, 2, &efix->asid,
+			       0x21ffull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], efix->section.content[0x1ff]);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x2200ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_elf32(struct elf_fixture *efix)
+{
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	efix_ehdr32(efix, pt_elf_type_exec, 0x34, 2);
+	efix_phdr32(efix, 0x34, pt_elf_pt_load, pt_elf_pf_r, 0x0, 0x8048000,
+		    0x80, 0x80);
+	efix_phdr32(efix, 0x54, pt_elf_pt_load, pt_elf_pf_r | pt_elf_pf_x,
+		    0x80, 0x8049080, 0x40, 0x40);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, pt_elf_pf_x);
+	ptu_int_eq(status, 1);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x8049090ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], efix->section.content[0x90]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_truncated(struct elf_fixture *efix)
+{
+	int status;
+
+	efix_dyn64(efix);
+	efix->section.size = 0x180ull;
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, 0);
+	ptu_int_eq(status, -pte_invalid);
+	ptu_uint_eq(efix->section.ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_overlap(struct elf_fixture *efix)
+{
+	struct pt_section other;
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	efix_dyn64(efix);
+
+	memset(&other, 0, sizeof(other));
+	other.size = 0x10ull;
+	other.ucount = 1;
+
+	status = pt_image_add(&efix->image, &other, &efix->asid, 0x2190ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, 0);
+	ptu_int_eq(status, -pte_bad_image);
+	ptu_uint_eq(efix->section.ucount, 1);
+
+	/* The image is left unmodified. */
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x1100ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	status = pt_image_remove(&efix->image, &other, &efix->asid, 0x2190ull);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_core(struct elf_fixture *efix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	efix_ehdr64(efix, pt_elf_type_core, 0x40ull, 4);
+
+	/* A file-backed mapping of which only the first bytes were dumped. */
+	efix_phdr64(efix, 0x40ull, pt_elf_pt_load, pt_elf_pf_r | pt_elf_pf_x,
+		    0x100ull, 0x400000ull, 0x40ull, 0x1000ull);
+
+	/* A completely dumped executable mapping. */
+	efix_phdr64(efix, 0x78ull, pt_elf_pt_load, pt_elf_pf_r | pt_elf_pf_x,
+		    0x140ull, 0x7f00ull, 0x40ull, 0x40ull);
+
+	/* A mapping that was not dumped. */
+	efix_phdr64(efix, 0xb0ull, pt_elf_pt_load, pt_elf_pf_r, 0x180ull,
+		    0x600000ull, 0x0ull, 0x1000ull);
+
+	/* A completely dumped data mapping. */
+	efix_phdr64(efix, 0xe8ull, pt_elf_pt_load, pt_elf_pf_r | pt_elf_pf_w,
+		    0x180ull, 0x9000ull, 0x80ull, 0x80ull);
+
+	status = pt_elf_add_segments(&efix->image, &efix->section,
+				     &efix->asid, 0ull, 0);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(efix->section.ucount, 3);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x400000ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x600000ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read(&efix->image, buffer, 2, &efix->asid,
+			       0x7f3full);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], efix->section.content[0x17f]);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	status = pt_image_read(&efix->image, buffer, 1, &efix->asid,
+			       0x9010ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], efix->section.content[0x190]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result efix_init(struct elf_fixture *efix)
+{
+	uint16_t i;
+
+	memset(&efix->section, 0, sizeof(efix->section));
+	efix->section.name = "elf";
+	efix->section.size = sizeof(efix->section.content);
+	efix->section.ucount = 1;
+
+	for (i = 0; i < efix->section.size; ++i)
+		efix->section.content[i] = (uint8_t) i;
+
+	pt_asid_init(&efix->asid);
+	efix->asid.cr3 = 0x4200ull;
+
+	pt_image_init(&efix->image, NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result efix_fini(struct elf_fixture *efix)
+{
+	pt_image_fini(&efix->image);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct elf_fixture efix;
+	struct ptunit_suite suite;
+
+	efix.init = efix_init;
+	efix.fini = efix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, header_null, efix);
+	ptu_run_f(suite, header_bad_magic, efix);
+	ptu_run_f(suite, header_bad_class, efix);
+	ptu_run_f(suite, header_big_endian, efix);
+	ptu_run_f(suite, header_truncated, efix);
+	ptu_run_f(suite, header_bad_phentsize, efix);
+	ptu_run_f(suite, header64, efix);
+	ptu_run_f(suite, header32, efix);
+	ptu_run_f(suite, header_xnum, efix);
+
+	ptu_run_f(suite, phdr_null, efix);
+	ptu_run_f(suite, phdr_bad_index, efix);
+	ptu_run_f(suite, phdr64, efix);
+	ptu_run_f(suite, phdr32, efix);
+
+	ptu_run_f(suite, add_null, efix);
+	ptu_run_f(suite, add_bad_file, efix);
+	ptu_run_f(suite, add_exec, efix);
+	ptu_run_f(suite, add_all, efix);
+	ptu_run_f(suite, add_elf32, efix);
+	ptu_run_f(suite, add_truncated, efix);
+	ptu_run_f(suite, add_overlap, efix);
+	ptu_run_f(suite, add_core, efix);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
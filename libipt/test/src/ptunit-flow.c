@@ -0,0 +1,753 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_flow.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test fixture providing a flow writer and a flow reader. */
+struct flow_fixture {
+	/* The writer. */
+	struct pt_flow_writer writer;
+
+	/* The reader. */
+	struct pt_flow_reader reader;
+
+	/* The temporary file. */
+	FILE *file;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct flow_fixture *);
+	struct ptunit_result (*fini)(struct flow_fixture *);
+};
+
+/* Read the temporary file into a new buffer. */
+static struct ptunit_result ffix_content(struct flow_fixture *ffix,
+					 uint8_t **content, size_t *size)
+{
+	uint8_t *buffer;
+	size_t read;
+	long end;
+	int errcode;
+
+	errcode = fseek(ffix->file, 0, SEEK_END);
+	ptu_int_eq(errcode, 0);
+
+	end = ftell(ffix->file);
+	ptu_int_gt(end, 0);
+
+	rewind(ffix->file);
+
+	buffer = malloc((size_t) end);
+	ptu_ptr(buffer);
+
+	read = fread(buffer, 1, (size_t) end, ffix->file);
+	if (read != (size_t) end)
+		free(buffer);
+	ptu_uint_eq(read, (size_t) end);
+
+	*content = buffer;
+	*size = read;
+
+	return ptu_passed();
+}
+
+/* Finish the flow and initialize the reader from the temporary file. */
+static struct ptunit_result ffix_read(struct flow_fixture *ffix)
+{
+	uint8_t *content;
+	size_t size;
+	int errcode;
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_content, ffix, &content, &size);
+
+	errcode = pt_flow_reader_init(&ffix->reader, content, size);
+	if (errcode < 0)
+		free(content);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Check that the reader provides @expected next. */
+static struct ptunit_result ffix_next(struct flow_fixture *ffix,
+				      const struct pt_flow_block *expected)
+{
+	struct pt_flow_block block;
+	int errcode;
+
+	errcode = pt_flow_next(&ffix->reader, &block);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(block.ip, expected->ip);
+	ptu_uint_eq(block.end_ip, expected->end_ip);
+	ptu_uint_eq(block.tsc, expected->tsc);
+	ptu_uint_eq(block.ninsn, expected->ninsn);
+	ptu_uint_eq(block.flags, expected->flags);
+
+	return ptu_passed();
+}
+
+/* Check that the reader reached the end of the flow. */
+static struct ptunit_result ffix_eos(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	int errcode;
+
+	errcode = pt_flow_next(&ffix->reader, &block);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+/* Initialize a block. */
+static void mk_block(struct pt_flow_block *block, uint64_t ip,
+		     uint64_t end_ip, uint32_t ninsn, uint64_t tsc,
+		     uint16_t flags)
+{
+	block->ip = ip;
+	block->end_ip = end_ip;
+	block->ninsn = ninsn;
+	block->tsc = tsc;
+	block->flags = flags;
+}
+
+/* Initialize a 64-bit instruction. */
+static void mk_insn(struct pt_insn *insn, uint64_t ip, uint8_t size,
+		    enum pt_insn_class iclass)
+{
+	memset(insn, 0, sizeof(*insn));
+
+	insn->ip = ip;
+	insn->size = size;
+	insn->iclass = iclass;
+	insn->mode = ptem_64bit;
+}
+
+static const uint16_t flags64 = ptem_64bit << ptif_mode_shift;
+
+static struct ptunit_result alloc_null(void)
+{
+	struct pt_flow_writer *writer;
+	struct pt_flow_reader *reader;
+
+	writer = pt_flow_alloc_writer(NULL);
+	ptu_null(writer);
+
+	reader = pt_flow_alloc_reader(NULL);
+	ptu_null(reader);
+
+	pt_flow_free_writer(NULL);
+	pt_flow_free_reader(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(struct flow_fixture *ffix)
+{
+	uint8_t content[1];
+	int errcode;
+
+	errcode = pt_flow_writer_init(NULL, ffix->file);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_flow_writer_init(&ffix->writer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_flow_reader_init(NULL, content, sizeof(content));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_flow_reader_init(&ffix->reader, NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_null(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 1, 0ull, 0);
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+
+	errcode = pt_flow_write_insn(NULL, &insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_write_insn(&ffix->writer, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_write_block(NULL, &block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_write_block(&ffix->writer, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_write_time(NULL, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_finish(NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_null(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	int errcode;
+
+	ptu_test(ffix_read, ffix);
+
+	errcode = pt_flow_next(NULL, &block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_next(&ffix->reader, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_seek(NULL, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_block_bad(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	int errcode;
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 0, 0ull, 0);
+
+	errcode = pt_flow_write_block(&ffix->writer, &block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	mk_block(&block, 0x1000ull, 0xfffull, 1, 0ull, 0);
+
+	errcode = pt_flow_write_block(&ffix->writer, &block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result finished(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, 0);
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 1, 0ull, 0);
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_write_block(&ffix->writer, &block);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct flow_fixture *ffix)
+{
+	ptu_test(ffix_read, ffix);
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result blocks(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block[5];
+	int index, errcode;
+
+	mk_block(&block[0], 0x1000ull, 0x1010ull, 4, 0x100ull, flags64);
+	mk_block(&block[1], 0x800ull, 0x800ull, 1, 0x100ull,
+		 flags64 | ptif_interrupted);
+	mk_block(&block[2], 0xffffffff81000000ull, 0xffffffff81000100ull,
+		 0x1234, 0x80ull, flags64 | ptif_enabled);
+	mk_block(&block[3], 0x2000ull, 0x2004ull, 64, 0x200ull,
+		 flags64 | ptif_speculative);
+	mk_block(&block[4], 0x2008ull, 0x2008ull, 1, 0x200ull,
+		 ptem_32bit << ptif_mode_shift);
+
+	for (index = 0; index < 5; ++index) {
+		errcode = pt_flow_write_block(&ffix->writer, &block[index]);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(ffix_read, ffix);
+
+	for (index = 0; index < 5; ++index)
+		ptu_test(ffix_next, ffix, &block[index]);
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insn_blocks(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, 0x1000ull, 2, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1002ull, 1, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1003ull, 2, ptic_cond_jump);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1005ull, 5, ptic_call);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x3000ull, 1, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_read, ffix);
+
+	mk_block(&block, 0x1000ull, 0x1003ull, 3, 0ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x1005ull, 0x1005ull, 1, 0ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x3000ull, 0x3000ull, 1, 0ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insn_gap(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, 0x1000ull, 2, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x2000ull, 2, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x2002ull, 2, ptic_other);
+	insn.mode = ptem_32bit;
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_read, ffix);
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 1, 0ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x2000ull, 0x2000ull, 1, 0ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x2002ull, 0x2002ull, 1, 0ull,
+		 ptem_32bit << ptif_mode_shift);
+	ptu_test(ffix_next, ffix, &block);
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insn_events(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+	insn.enabled = 1;
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1001ull, 1, ptic_other);
+	insn.disabled = 1;
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1002ull, 1, ptic_other);
+	insn.resumed = 1;
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1003ull, 1, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1004ull, 1, ptic_other);
+	insn.resynced = 1;
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_read, ffix);
+
+	mk_block(&block, 0x1000ull, 0x1001ull, 2, 0ull,
+		 flags64 | ptif_enabled | ptif_disabled);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x1002ull, 0x1003ull, 2, 0ull,
+		 flags64 | ptif_resumed);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x1004ull, 0x1004ull, 1, 0ull,
+		 flags64 | ptif_resynced);
+	ptu_test(ffix_next, ffix, &block);
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insn_time(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_flow_write_time(&ffix->writer, 0x100ull);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_flow_write_time(&ffix->writer, 0x200ull);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x1001ull, 1, ptic_return);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	mk_insn(&insn, 0x800ull, 1, ptic_jump);
+	errcode = pt_flow_write_insn(&ffix->writer, &insn);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_read, ffix);
+
+	mk_block(&block, 0x1000ull, 0x1001ull, 2, 0x200ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	mk_block(&block, 0x800ull, 0x800ull, 1, 0x200ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result compact(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	uint32_t index;
+	int errcode;
+
+	/* A loop of two small blocks should take a few bytes per block. */
+	for (index = 0; index < 0x1000; ++index) {
+		if (index & 1)
+			mk_block(&block, 0x401020ull, 0x401030ull, 5,
+				 index / 0x10, flags64);
+		else
+			mk_block(&block, 0x401000ull, 0x401018ull, 7,
+				 index / 0x10, flags64);
+
+		errcode = pt_flow_write_block(&ffix->writer, &block);
+		ptu_int_eq(errcode, 0);
+	}
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_le(ffix->writer.offset, 0x1000 * 4);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result seek(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	uint32_t index;
+	int errcode;
+
+	for (index = 0; index < 0xa00; ++index) {
+		mk_block(&block, 0x1000ull + index, 0x1000ull + index, 1,
+			 0x100ull + index, flags64);
+
+		errcode = pt_flow_write_block(&ffix->writer, &block);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(ffix_read, ffix);
+	ptu_uint_eq(ffix->reader.nentries, 3);
+
+	errcode = pt_flow_seek(&ffix->reader, 0x100ull + 0x900ull);
+	ptu_int_eq(errcode, 0);
+
+	mk_block(&block, 0x1800ull, 0x1800ull, 1, 0x900ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	errcode = pt_flow_seek(&ffix->reader, 0x100ull + 0x400ull);
+	ptu_int_eq(errcode, 0);
+
+	mk_block(&block, 0x1400ull, 0x1400ull, 1, 0x500ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	errcode = pt_flow_seek(&ffix->reader, 0x0ull);
+	ptu_int_eq(errcode, 0);
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 1, 0x100ull, flags64);
+	ptu_test(ffix_next, ffix, &block);
+
+	errcode = pt_flow_seek(&ffix->reader, UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+
+	for (index = 0x800; index < 0xa00; ++index) {
+		mk_block(&block, 0x1000ull + index, 0x1000ull + index, 1,
+			 0x100ull + index, flags64);
+		ptu_test(ffix_next, ffix, &block);
+	}
+
+	ptu_test(ffix_eos, ffix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_bad(struct flow_fixture *ffix, long offset,
+				     uint8_t value)
+{
+	uint8_t *content;
+	size_t size;
+	int errcode;
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_content, ffix, &content, &size);
+
+	if (offset < 0)
+		offset += (long) size;
+
+	content[offset] = value;
+
+	errcode = pt_flow_reader_init(&ffix->reader, content, size);
+	free(content);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_truncated(struct flow_fixture *ffix)
+{
+	uint8_t *content;
+	size_t size;
+	int errcode;
+
+	errcode = pt_flow_finish(&ffix->writer);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_content, ffix, &content, &size);
+
+	errcode = pt_flow_reader_init(&ffix->reader, content, size - 1);
+	free(content);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next_bad(struct flow_fixture *ffix)
+{
+	struct pt_flow_block block;
+	uint8_t tag;
+	int errcode;
+
+	mk_block(&block, 0x1000ull, 0x1000ull, 1, 0ull, flags64);
+
+	errcode = pt_flow_write_block(&ffix->writer, &block);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(ffix_read, ffix);
+
+	/* Corrupt the anchor's tag. */
+	tag = ffix->reader.content[16];
+	ffix->reader.content[16] = 0xff;
+
+	errcode = pt_flow_next(&ffix->reader, &block);
+	ptu_int_eq(errcode, -pte_bad_opc);
+
+	/* Truncate the anchor. */
+	ffix->reader.content[16] = tag;
+	ffix->reader.end = ffix->reader.begin + 2;
+
+	errcode = pt_flow_next(&ffix->reader, &block);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file(void)
+{
+	struct pt_flow_writer *writer;
+	struct pt_flow_reader *reader;
+	struct pt_flow_block block;
+	char *name;
+	int errcode;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	writer = pt_flow_alloc_writer(name);
+	ptu_ptr(writer);
+
+	mk_block(&block, 0x1000ull, 0x1004ull, 2, 0x10ull, flags64);
+
+	errcode = pt_flow_write_block(writer, &block);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_flow_finish(writer);
+	ptu_int_eq(errcode, 0);
+
+	pt_flow_free_writer(writer);
+
+	reader = pt_flow_alloc_reader(name);
+	ptu_ptr(reader);
+
+	memset(&block, 0, sizeof(block));
+
+	errcode = pt_flow_next(reader, &block);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(block.ip, 0x1000ull);
+	ptu_uint_eq(block.end_ip, 0x1004ull);
+	ptu_uint_eq(block.ninsn, 2);
+	ptu_uint_eq(block.tsc, 0x10ull);
+	ptu_uint_eq(block.flags, flags64);
+
+	errcode = pt_flow_next(reader, &block);
+	ptu_int_eq(errcode, -pte_eos);
+
+	pt_flow_free_reader(reader);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ffix_init(struct flow_fixture *ffix)
+{
+	int errcode;
+
+	memset(&ffix->reader, 0, sizeof(ffix->reader));
+
+	ffix->file = tmpfile();
+	ptu_ptr(ffix->file);
+
+	errcode = pt_flow_writer_init(&ffix->writer, ffix->file);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ffix_fini(struct flow_fixture *ffix)
+{
+	pt_flow_writer_fini(&ffix->writer);
+	pt_flow_reader_fini(&ffix->reader);
+
+	if (ffix->file) {
+		fclose(ffix->file);
+		ffix->file = NULL;
+	}
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct flow_fixture ffix;
+	struct ptunit_suite suite;
+
+	ffix.init = ffix_init;
+	ffix.fini = ffix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, alloc_null);
+	ptu_run_f(suite, init_null, ffix);
+	ptu_run_f(suite, write_null, ffix);
+	ptu_run_f(suite, read_null, ffix);
+	ptu_run_f(suite, write_block_bad, ffix);
+	ptu_run_f(suite, finished, ffix);
+	ptu_run_f(suite, empty, ffix);
+	ptu_run_f(suite, blocks, ffix);
+	ptu_run_f(suite, insn_blocks, ffix);
+	ptu_run_f(suite, insn_gap, ffix);
+	ptu_run_f(suite, insn_events, ffix);
+	ptu_run_f(suite, insn_time, ffix);
+	ptu_run_f(suite, compact, ffix);
+	ptu_run_f(suite, seek, ffix);
+	ptu_run_fp(suite, read_bad, ffix, 0l, 'x');
+	ptu_run_fp(suite, read_bad, ffix, 8l, 2);
+	ptu_run_fp(suite, read_bad, ffix, -1l, 'y');
+	ptu_run_fp(suite, read_bad, ffix, -24l, 0xff);
+	ptu_run_fp(suite, read_bad, ffix, -16l, 1);
+	ptu_run_f(suite, read_truncated, ffix);
+	ptu_run_f(suite, next_bad, ffix);
+	ptu_run(suite, file);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -46,6 +46,9 @@ static const uint64_t pti_addr = 0xffccffccffccull;
  * - can be classified
  * - is corectly diagnosed as interesting/boring
  *
+ * For 64-bit instructions, also check that the 64-bit length decoder gives
+ * the same result.
+ *
  * Does not check whether the classification is correct.
  * This is left to the calling test.
  */
@@ -53,8 +56,12 @@ static struct ptunit_result ptunit_ild_decode(pti_ild_t *ild,
 					      pti_bool_t interest,
 					      pti_uint32_t size)
 {
+	pti_ild_t ild64;
 	pti_bool_t lret, dret;
 
+	ild64 = *ild;
+	ild64.mode = PTI_MODE_LAST;
+
 	lret = pti_instruction_length_decode(ild);
 	ptu_int_eq(lret, 1);
 	ptu_uint_eq(ild->length, size);
@@ -62,6 +69,19 @@ static struct ptunit_result ptunit_ild_decode(pti_ild_t *ild,
 	dret = pti_instruction_decode(ild);
 	ptu_int_eq(dret, interest);
 
+	if (ild->mode != PTI_MODE_64)
+		return ptu_passed();
+
+	lret = pti_instruction_length_decode_64(&ild64);
+	ptu_int_eq(lret, 1);
+	ptu_uint_eq(ild64.length, size);
+	ptu_int_eq(ild64.mode, PTI_MODE_64);
+
+	dret = pti_instruction_decode(&ild64);
+	ptu_int_eq(dret, interest);
+	ptu_int_eq(ild64.iclass, ild->iclass);
+	ptu_uint_eq(ild64.direct_target, ild->direct_target);
+
 	return ptu_passed();
 }
 
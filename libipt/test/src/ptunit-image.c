@@ -27,13 +27,19 @@
  */
 
 #include "ptunit.h"
+#include "ptunit_mktempname.h"
+#include "ptunit_threads.h"
 
 #include "pt_image.h"
 #include "pt_section.h"
 #include "pt_mapped_section.h"
+#include "pt_atomic.h"
 
 #include "intel-pt.h"
 
+#include <stdlib.h>
+#include <stdio.h>
+
 
 /* A test section. */
 struct pt_section {
@@ -43,14 +49,33 @@ struct pt_section {
 	/* The contents. */
 	uint8_t content[0x10];
 
-	/* The size - between 0 and sizeof(content). */
+	/* The offset in the file and the size - between 0 and sizeof(content)
+	 * for file sections.
+	 */
+	uint64_t offset;
 	uint64_t size;
 
+	/* The memory buffer - NULL for file sections. */
+	const uint8_t *buffer;
+
+	/* The generation of a buffer section. */
+	uint32_t generation;
+
+	/* The release function for a buffer section and its context. */
+	release_memory_callback_t *release;
+	void *context;
+
+	/* The number of users.  This is accessed atomically. */
+	uint32_t ucount;
+
 	/* Delete indication:
 	 * - zero, if initialized and not (yet) deleted
 	 * - non-zero if deleted and not (re-)initialized
 	 */
 	int deleted;
+
+	/* A flag saying whether the section was allocated by pt_mk_section(). */
+	int allocated;
 };
 
 static struct ptunit_result pt_init_section(struct pt_section *section,
@@ -59,8 +84,15 @@ static struct ptunit_result pt_init_section(struct pt_section *section,
 	uint8_t i;
 
 	section->name = filename;
+	section->offset = 0ull;
 	section->size = sizeof(section->content);
+	section->buffer = NULL;
+	section->generation = 0;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
 	section->deleted = 0;
+	section->allocated = 0;
 
 	for (i = 0; i < section->size; ++i)
 		section->content[i] = i;
@@ -68,6 +100,14 @@ static struct ptunit_result pt_init_section(struct pt_section *section,
 	return ptu_passed();
 }
 
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->offset;
+}
+
 uint64_t pt_section_size(const struct pt_section *section)
 {
 	if (!section)
@@ -79,8 +119,61 @@ uint64_t pt_section_size(const struct pt_section *section)
 struct pt_section *pt_mk_section(const char *file, uint64_t offset,
 				 uint64_t size)
 {
-	/* This function is not used by our tests. */
-	return NULL;
+	struct pt_section *section;
+	uint8_t i;
+
+	/* Our test files contain their offset in each byte. */
+	if (!file || sizeof(section->content) <= offset)
+		return NULL;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	section->name = file;
+	section->offset = offset;
+	section->size = sizeof(section->content) - offset;
+	section->buffer = NULL;
+	section->generation = 0;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
+	section->deleted = 0;
+	section->allocated = 1;
+
+	if (size < section->size)
+		section->size = size;
+
+	for (i = 0; i < section->size; ++i)
+		section->content[i] = (uint8_t) (offset + i);
+
+	return section;
+}
+
+struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					uint64_t size, uint32_t generation)
+{
+	struct pt_section *section;
+
+	if (!buffer || !size)
+		return NULL;
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return NULL;
+
+	section->name = NULL;
+	section->offset = 0ull;
+	section->size = size;
+	section->buffer = buffer;
+	section->generation = generation;
+	section->release = NULL;
+	section->context = NULL;
+	section->ucount = 1;
+	section->deleted = 0;
+	section->allocated = 1;
+
+	return section;
 }
 
 void pt_section_free(struct pt_section *section)
@@ -88,7 +181,50 @@ void pt_section_free(struct pt_section *section)
 	if (!section)
 		return;
 
-	section->deleted = 1;
+	if (section->release)
+		section->release(section->buffer, section->size,
+				 section->context);
+
+	if (section->allocated)
+		free(section);
+	else
+		section->deleted = 1;
+}
+
+int pt_section_get(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	if (!pt_atomic_inc32(&section->ucount)) {
+		(void) pt_atomic_dec32(&section->ucount);
+		return -pte_internal;
+	}
+
+	return 0;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	if (!pt_atomic_dec32(&section->ucount))
+		pt_section_free(section);
+
+	return 0;
+}
+
+int pt_section_set_release(struct pt_section *section,
+			   release_memory_callback_t *release, void *context)
+{
+	if (!section || !section->buffer)
+		return -pte_internal;
+
+	section->release = release;
+	section->context = context;
+
+	return 0;
 }
 
 const char *pt_section_filename(const struct pt_section *section)
@@ -99,6 +235,14 @@ const char *pt_section_filename(const struct pt_section *section)
 	return section->name;
 }
 
+uint32_t pt_section_generation(const struct pt_section *section)
+{
+	if (!section)
+		return 0;
+
+	return section->generation;
+}
+
 int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 		    uint16_t size, uint64_t offset)
 {
@@ -121,7 +265,31 @@ int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 		size = (uint16_t) (end - begin);
 	}
 
-	memcpy(buffer, &section->content[begin], size);
+	if (section->buffer)
+		memcpy(buffer, &section->buffer[begin], size);
+	else
+		memcpy(buffer, &section->content[begin], size);
+
+	return size;
+}
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **begin,
+		    uint16_t size, uint64_t offset)
+{
+	if (!section || !begin)
+		return -pte_invalid;
+
+	/* Like the file implementation, we only access buffers in place. */
+	if (!section->buffer)
+		return -pte_nomap;
+
+	if (section->size <= offset)
+		return -pte_nomap;
+
+	if (section->size - offset < size)
+		size = (uint16_t) (section->size - offset);
+
+	*begin = &section->buffer[offset];
 
 	return size;
 }
@@ -177,8 +345,8 @@ static struct ptunit_result init(void)
 
 	pt_image_init(&image, NULL);
 	ptu_null(image.name);
-	ptu_null(image.sections);
-	ptu_null(image.cache);
+	ptu_null(image.map);
+	ptu_null(image.snapshot);
 	ptu_null((void *) (uintptr_t) image.readmem.callback);
 	ptu_null(image.readmem.context);
 
@@ -191,8 +359,8 @@ static struct ptunit_result init_name(struct image_fixture *ifix)
 
 	pt_image_init(&ifix->image, "image-name");
 	ptu_str_eq(ifix->image.name, "image-name");
-	ptu_null(ifix->image.sections);
-	ptu_null(ifix->image.cache);
+	ptu_null(ifix->image.map);
+	ptu_null(ifix->image.snapshot);
 	ptu_null((void *) (uintptr_t) ifix->image.readmem.callback);
 	ptu_null(ifix->image.readmem.context);
 
@@ -354,6 +522,77 @@ static struct ptunit_result adjacent(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result add_range(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1000ull, 0x4ull, 0x4ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_get(&ifix->section[0]);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1004ull, 0x8ull, 0x8ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x1003ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x07);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x1004ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x08);
+	ptu_uint_eq(buffer[1], 0x09);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x100cull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_range_overlap(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1000ull, 0x4ull, 0x4ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[0],
+			      0x1003ull);
+	ptu_int_eq(status, -pte_bad_image);
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[0],
+			      0x1004ull);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_range_bad_size(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1000ull, 0x8ull,
+				    ifix->section[0].size - 0x7ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1000ull,
+				    ifix->section[0].size + 0x1ull, 0x0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read(struct image_fixture *ifix)
 {
 	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
@@ -444,6 +683,63 @@ static struct ptunit_result read_callback(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result read_callback_cache(struct image_fixture *ifix)
+{
+	uint8_t memory[0x20];
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	memset(memory, 0, sizeof(memory));
+	memory[1] = 0x01;
+	memory[2] = 0x02;
+
+	status = pt_image_set_callback(&ifix->image, image_readmem_callback,
+				       memory);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_set_callback_cache(&ifix->image, sizeof(memory), 2);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	/* We keep using the cached memory until it is invalidated. */
+	memory[2] = 0x03;
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+
+	status = pt_image_invalidate(&ifix->image, &ifix->asid[0], 0x3002ull,
+				     1ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x03);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result callback_cache_bad_size(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_set_callback_cache(&ifix->image, 0x30, 2);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_set_callback_cache(NULL, 0x20, 2);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read_nomem(struct image_fixture *ifix)
 {
 	uint8_t buffer[] = { 0xcc, 0xcc };
@@ -731,6 +1027,53 @@ static struct ptunit_result remove_all_by_filename(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result remove_by_filename_fail(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	uint32_t ucount;
+	int status;
+
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[0],
+			      0x3000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
+			      0x5000ull);
+	ptu_int_eq(status, 0);
+
+	/* We remove the section at 0x5000 before we fail to copy the section
+	 * at 0x3000 in front of the section at 0x1000.
+	 */
+	ucount = ifix->section[2].ucount;
+	ifix->section[2].ucount = UINT32_MAX;
+
+	status = pt_image_remove_by_filename(&ifix->image,
+					     ifix->section[0].name,
+					     &ifix->asid[0]);
+	ptu_int_eq(status, -pte_internal);
+
+	ifix->section[2].ucount = ucount;
+
+	/* Publish the image again to see what is left. */
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[2],
+			      0x2000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x5001ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x1003ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result remove_by_asid(struct image_fixture *ifix)
 {
 	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
@@ -766,53 +1109,1673 @@ static struct ptunit_result remove_by_asid(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
-struct ptunit_result ifix_init(struct image_fixture *ifix)
+static struct ptunit_result copy_null(void)
 {
-	pt_image_init(&ifix->image, NULL);
+	struct pt_image image, copy;
+	int status;
 
-	pt_init_section(&ifix->section[0], "file-0");
-	pt_init_section(&ifix->section[1], "file-1");
-	pt_init_section(&ifix->section[2], "file-2");
+	pt_image_init(&image, NULL);
 
-	pt_asid_init(&ifix->asid[0]);
-	ifix->asid[0].cr3 = 0xa000;
+	status = pt_image_init_copy(NULL, &image, NULL);
+	ptu_int_eq(status, -pte_internal);
 
-	pt_asid_init(&ifix->asid[1]);
-	ifix->asid[1].cr3 = 0xb000;
+	status = pt_image_init_copy(&copy, NULL, NULL);
+	ptu_int_eq(status, -pte_internal);
 
-	pt_asid_init(&ifix->asid[2]);
-	ifix->asid[2].cr3 = 0xc000;
+	pt_image_fini(&image);
 
 	return ptu_passed();
 }
 
-struct ptunit_result rfix_init(struct image_fixture *ifix)
+static struct ptunit_result copy(struct image_fixture *ifix)
 {
+	uint8_t memory[] = { 0xdd, 0x01, 0x02, 0xdd };
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	struct pt_image copy;
 	int status;
 
-	ptu_check(ifix_init, ifix);
-
-	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
-			      0x1000ull);
+	status = pt_image_set_callback(&ifix->image, image_readmem_callback,
+				       memory);
 	ptu_int_eq(status, 0);
 
-	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[1],
-			      0x2000ull);
+	status = pt_image_init_copy(&copy, &ifix->image, "copy");
 	ptu_int_eq(status, 0);
+	ptu_str_eq(pt_image_name(&copy), "copy");
+	ptu_ptr_eq(copy.map, ifix->image.map);
 
-	return ptu_passed();
-}
+	status = pt_image_read(&copy, buffer, 2, &ifix->asid[0], 0x1001ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+	ptu_uint_eq(buffer[2], 0xcc);
 
-struct ptunit_result dfix_fini(struct image_fixture *ifix)
-{
-	pt_image_fini(&ifix->image);
+	status = pt_image_read(&copy, buffer, 2, &ifix->asid[1], 0x2003ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	status = pt_image_read(&copy, buffer, 2, &ifix->asid[0], 0x3001ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	pt_image_fini(&copy);
+
+	ptu_int_eq(ifix->section[0].deleted, 0);
+	ptu_int_eq(ifix->section[1].deleted, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x1009ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x09);
 
 	return ptu_passed();
 }
 
-int main(int argc, char **argv)
+static struct ptunit_result copy_add(struct image_fixture *ifix)
 {
-	struct image_fixture dfix, ifix, rfix;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_image copy;
+	int status;
+
+	status = pt_image_init_copy(&copy, &ifix->image, NULL);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&copy, &ifix->section[2], &ifix->asid[0],
+			      0x3000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[0], 0x3004ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x04);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x3005ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0x04);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[0], 0x1005ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x05);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	pt_image_fini(&copy);
+
+	ptu_int_eq(ifix->section[0].deleted, 0);
+	ptu_int_eq(ifix->section[1].deleted, 0);
+	ptu_int_ne(ifix->section[2].deleted, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result copy_remove(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_image copy;
+	int status;
+
+	status = pt_image_init_copy(&copy, &ifix->image, NULL);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_remove(&copy, &ifix->section[0], &ifix->asid[0],
+				 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	ptu_int_eq(ifix->section[0].deleted, 0);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[0], 0x1001ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[1], 0x2001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x1002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+
+	pt_image_fini(&ifix->image);
+
+	ptu_int_ne(ifix->section[0].deleted, 0);
+	ptu_int_eq(ifix->section[1].deleted, 0);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[1], 0x2003ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x03);
+
+	pt_image_fini(&copy);
+
+	ptu_int_ne(ifix->section[1].deleted, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result copy_remove_by_asid(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_image copy;
+	int status;
+
+	status = pt_image_init_copy(&copy, &ifix->image, NULL);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[1]);
+	ptu_int_eq(status, 1);
+
+	ptu_int_eq(ifix->section[1].deleted, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[1],
+			       0x2001ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	status = pt_image_read(&copy, buffer, 1, &ifix->asid[1], 0x2001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	pt_image_fini(&copy);
+
+	ptu_int_ne(ifix->section[1].deleted, 0);
+	ptu_int_eq(ifix->section[0].deleted, 0);
+
+	return ptu_passed();
+}
+
+/* The number of threads and iterations in the copy_threads test. */
+enum {
+	copy_threads_nthreads = 4,
+	copy_threads_niter = 10000
+};
+
+/* Copy, modify, read, and free @arg (an image fixture) repeatedly. */
+static int copy_threads_worker(void *arg)
+{
+	struct image_fixture *ifix;
+	int iter;
+
+	ifix = (struct image_fixture *) arg;
+	if (!ifix)
+		return -pte_internal;
+
+	for (iter = 0; iter < copy_threads_niter; ++iter) {
+		struct pt_image copy;
+		uint8_t buffer;
+		int status;
+
+		status = pt_image_init_copy(&copy, &ifix->image, NULL);
+		if (status < 0)
+			return status;
+
+		status = pt_image_remove_by_asid(&copy, &ifix->asid[1]);
+		if (status != 1)
+			status = -pte_internal;
+
+		/* The image takes over our reference on success. */
+		if (status >= 0)
+			status = pt_section_get(&ifix->section[2]);
+
+		if (status >= 0) {
+			status = pt_image_add(&copy, &ifix->section[2],
+					      &ifix->asid[0], 0x3000ull);
+			if (status < 0)
+				(void) pt_section_put(&ifix->section[2]);
+		}
+
+		if (status >= 0)
+			status = pt_image_read(&copy, &buffer, 1,
+					       &ifix->asid[0], 0x3002ull);
+
+		if (status >= 0 && buffer != 0x02)
+			status = -pte_internal;
+
+		if (status >= 0)
+			status = pt_image_read(&copy, &buffer, 1,
+					       &ifix->asid[0], 0x1003ull);
+
+		if (status >= 0 && buffer != 0x03)
+			status = -pte_internal;
+
+		pt_image_fini(&copy);
+
+		if (status < 0)
+			return status;
+	}
+
+	return 0;
+}
+
+static struct ptunit_result copy_threads(struct image_fixture *ifix)
+{
+	struct ptunit_thread *thread[copy_threads_nthreads];
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	uint32_t ucount[4];
+	int idx, status;
+
+	ucount[0] = ifix->image.map->ucount;
+	ucount[1] = ifix->section[0].ucount;
+	ucount[2] = ifix->section[1].ucount;
+	ucount[3] = ifix->section[2].ucount;
+
+	for (idx = 0; idx < copy_threads_nthreads; ++idx) {
+		thread[idx] = ptunit_thread_create(copy_threads_worker, ifix);
+		ptu_ptr(thread[idx]);
+	}
+
+	for (idx = 0; idx < copy_threads_nthreads; ++idx) {
+		status = ptunit_thread_join(thread[idx]);
+		ptu_int_eq(status, 0);
+	}
+
+	/* All copies are gone and so are their references. */
+	ptu_uint_eq(ifix->image.map->ucount, ucount[0]);
+	ptu_uint_eq(ifix->section[0].ucount, ucount[1]);
+	ptu_uint_eq(ifix->section[1].ucount, ucount[2]);
+	ptu_uint_eq(ifix->section[2].ucount, ucount[3]);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[1],
+			       0x2001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_null(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	int status;
+
+	memset(&record, 0, sizeof(record));
+
+	status = pt_image_apply(NULL, &record);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_apply(&ifix->image, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_bad_file(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.type = ptir_add;
+	record.size = 0x10ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, -pte_invalid);
+	ptu_uint_eq(ifix->image.nversions, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_out_of_order(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x200ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x4ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	record.tsc = 0x100ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_remove(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x4ull;
+	record.vaddr = 0x1004ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	/* Before the record, the section is mapped completely. */
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1005ull, 0xffull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x05);
+	ptu_uint_eq(buffer[1], 0x06);
+
+	/* From the record onwards, the section has a hole. */
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1005ull, 0x100ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read(&ifix->image, buffer, 2, &ifix->asid[0],
+			       0x1005ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read_at(&ifix->image, buffer, 3, &ifix->asid[0],
+				  0x1002ull, 0x180ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_uint_eq(buffer[1], 0x03);
+
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1008ull, 0x180ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x08);
+	ptu_uint_eq(buffer[1], 0x09);
+
+	/* Other address spaces are not affected. */
+	status = pt_image_read_at(&ifix->image, buffer, 1, &ifix->asid[1],
+				  0x2005ull, 0x180ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x05);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_add(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_add;
+	record.asid = &ifix->asid[0];
+	record.filename = "file-a";
+	record.size = 0x10ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	record.tsc = 0x200ull;
+	record.filename = "file-b";
+	record.offset = 0x8ull;
+	record.size = 0x4ull;
+	record.vaddr = 0x1004ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read_at(&ifix->image, buffer, 1, &ifix->asid[0],
+				  0x1004ull, 0x80ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read_at(&ifix->image, buffer, 1, &ifix->asid[0],
+				  0x1004ull, 0x100ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x04);
+
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1004ull, 0x200ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x08);
+	ptu_uint_eq(buffer[1], 0x09);
+
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1008ull, 0x200ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x08);
+	ptu_uint_eq(buffer[1], 0x09);
+
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1003ull, 0x200ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x03);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_same_time(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x4ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	record.vaddr = 0x1008ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(ifix->image.nversions, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_fail(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	uint32_t generation, ucount;
+	int status;
+
+	status = pt_image_generation(&ifix->image, &generation);
+	ptu_int_eq(status, 0);
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x200ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x4ull;
+	record.vaddr = 0x1004ull;
+
+	/* We fail to trim the section after we began a new version. */
+	ucount = ifix->section[0].ucount;
+	ifix->section[0].ucount = UINT32_MAX;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, -pte_nomem);
+
+	ifix->section[0].ucount = ucount;
+
+	ptu_uint_eq(ifix->image.nversions, 0);
+	ptu_uint_eq(ifix->image.tsc, 0ull);
+	ptu_uint_eq(ifix->image.generation, generation);
+
+	/* We may still apply earlier records. */
+	record.tsc = 0x100ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(ifix->image.nversions, 1);
+
+	status = pt_image_read_at(&ifix->image, buffer, 2, &ifix->asid[0],
+				  0x1002ull, 0x180ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_uint_eq(buffer[1], 0x03);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result apply_copy(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	struct pt_image *copy;
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x10ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	copy = pt_image_copy(&ifix->image, NULL);
+	ptu_ptr(copy);
+
+	status = pt_image_read_at(copy, buffer, 1, &ifix->asid[0], 0x1001ull,
+				  0x80ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read_at(copy, buffer, 1, &ifix->asid[0], 0x1001ull,
+				  0x100ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	pt_image_free(copy);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result generation_null(struct image_fixture *ifix)
+{
+	uint32_t generation;
+	int status;
+
+	status = pt_image_generation(NULL, &generation);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_generation(&ifix->image, NULL);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result generation(struct image_fixture *ifix)
+{
+	struct pt_image_record record;
+	uint32_t first, second, third;
+	int status;
+
+	status = pt_image_generation(&ifix->image, &first);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_invalidate(&ifix->image, NULL, 0x1000ull, 0x10ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_generation(&ifix->image, &second);
+	ptu_int_eq(status, 0);
+	ptu_uint_ne(second, first);
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x4ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	/* Reads now depend on the time. */
+	status = pt_image_generation(&ifix->image, &third);
+	ptu_int_eq(status, 1);
+	ptu_uint_ne(third, second);
+
+	return ptu_passed();
+}
+
+static void release_buffer(const uint8_t *buffer, uint64_t size,
+			   void *context)
+{
+	int *released;
+
+	(void) buffer;
+	(void) size;
+
+	released = (int *) context;
+	*released += 1;
+}
+
+static struct ptunit_result add_buffer_null(void)
+{
+	struct pt_image image;
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	status = pt_image_add_buffer(NULL, buffer, sizeof(buffer), NULL,
+				     0x1000ull, 0, NULL, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_add_buffer(&image, NULL, sizeof(buffer), NULL,
+				     0x1000ull, 0, NULL, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_add_buffer(&image, buffer, 0ull, NULL, 0x1000ull, 0,
+				     NULL, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_add_buffer(&image, buffer, sizeof(buffer), NULL,
+				     UINT64_MAX, 0, NULL, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	pt_image_fini(&image);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_buffer(struct image_fixture *ifix)
+{
+	uint8_t code[] = { 0x90, 0xc3 }, buffer[] = { 0xcc, 0xcc };
+	int status, released;
+
+	released = 0;
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x1000ull, 0,
+				     release_buffer, &released);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, buffer, sizeof(buffer),
+			       &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x90);
+	ptu_uint_eq(buffer[1], 0xc3);
+
+	/* The buffer is used directly. */
+	code[1] = 0xcc;
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x1001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	ptu_int_eq(released, 0);
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[0]);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(released, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_buffer_overlap(struct image_fixture *ifix)
+{
+	uint8_t code[] = { 0x90, 0xc3 };
+	int status, released;
+
+	released = 0;
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x100full, 1,
+				     release_buffer, &released);
+	ptu_int_eq(status, -pte_bad_image);
+	ptu_int_eq(released, 0);
+
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[1], 0x100full, 1,
+				     release_buffer, &released);
+	ptu_int_eq(status, 0);
+	ptu_int_eq(released, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_buffer_fail(struct image_fixture *ifix)
+{
+	uint8_t old[] = { 0x01, 0x02, 0x03, 0x04 }, new[] = { 0x11, 0x12 };
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_section *section;
+	struct pt_image_map *map;
+	struct pt_asid asid;
+	uint32_t generation, ucount;
+	int status, released[2];
+
+	released[0] = 0;
+	released[1] = 0;
+
+	pt_asid_init(&asid);
+
+	status = pt_image_add_buffer(&ifix->image, old, sizeof(old), &asid,
+				     0x1000ull, 1, release_buffer,
+				     &released[0]);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_generation(&ifix->image, &generation);
+	ptu_int_eq(status, 0);
+
+	/* We fail to trim the old buffer section. */
+	map = ifix->image.map;
+	ptu_ptr(map);
+	ptu_ptr(map->partitions[map->mask + 1].sections);
+
+	section = map->partitions[map->mask + 1].sections->section.section;
+	ucount = section->ucount;
+	section->ucount = UINT32_MAX;
+
+	status = pt_image_add_buffer(&ifix->image, new, sizeof(new), &asid,
+				     0x1001ull, 2, release_buffer,
+				     &released[1]);
+	ptu_int_eq(status, -pte_nomem);
+
+	section->ucount = ucount;
+
+	ptu_uint_eq(ifix->image.generation, generation);
+	ptu_int_eq(released[0], 0);
+	ptu_int_eq(released[1], 0);
+
+	status = pt_image_read(&ifix->image, buffer, sizeof(buffer), &asid,
+			       0x1001ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_uint_eq(buffer[1], 0x03);
+
+	status = pt_image_remove_by_asid(&ifix->image, &asid);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(released[0], 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_buffer_generation(struct image_fixture *ifix)
+{
+	uint8_t old[] = { 0x01, 0x02, 0x03, 0x04 }, new[] = { 0x11, 0x12 };
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc, 0xcc };
+	int status, released[2];
+
+	released[0] = 0;
+	released[1] = 0;
+
+	status = pt_image_add_buffer(&ifix->image, old, sizeof(old),
+				     &ifix->asid[0], 0x1000ull, 1,
+				     release_buffer, &released[0]);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add_buffer(&ifix->image, new, sizeof(new),
+				     &ifix->asid[0], 0x1001ull, 1,
+				     release_buffer, &released[1]);
+	ptu_int_eq(status, -pte_bad_image);
+
+	status = pt_image_add_buffer(&ifix->image, new, sizeof(new),
+				     &ifix->asid[0], 0x1001ull, 2,
+				     release_buffer, &released[1]);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, &buffer[0], 1, &ifix->asid[0],
+			       0x1000ull);
+	ptu_int_eq(status, 1);
+
+	status = pt_image_read(&ifix->image, &buffer[1], 2, &ifix->asid[0],
+			       0x1001ull);
+	ptu_int_eq(status, 2);
+
+	status = pt_image_read(&ifix->image, &buffer[3], 1, &ifix->asid[0],
+			       0x1003ull);
+	ptu_int_eq(status, 1);
+
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x11);
+	ptu_uint_eq(buffer[2], 0x12);
+	ptu_uint_eq(buffer[3], 0x04);
+
+	/* The old buffer is still used for the remaining parts. */
+	ptu_int_eq(released[0], 0);
+	ptu_int_eq(released[1], 0);
+
+	status = pt_image_add_buffer(&ifix->image, new, sizeof(new),
+				     &ifix->asid[0], 0x1000ull, 3, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add_buffer(&ifix->image, new, sizeof(new),
+				     &ifix->asid[0], 0x1002ull, 3, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	ptu_int_eq(released[0], 1);
+	ptu_int_eq(released[1], 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_null(struct image_fixture *ifix)
+{
+	const uint8_t *begin;
+	int status;
+
+	status = pt_image_peek_at(NULL, &begin, NULL, 1, &ifix->asid[0],
+				  0x1000ull, 0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_peek_at(&ifix->image, NULL, NULL, 1, &ifix->asid[0],
+				  0x1000ull, 0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, NULL,
+				  0x1000ull, 0ull);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek(struct image_fixture *ifix)
+{
+	uint8_t code[] = { 0x90, 0x90, 0xc3 };
+	const uint8_t *begin;
+	int status;
+
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x3000ull, 0, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 2, &ifix->asid[0],
+				  0x3001ull, UINT64_MAX);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, &code[1]);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 4, &ifix->asid[0],
+				  0x3001ull, UINT64_MAX);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, &code[1]);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, &ifix->asid[1],
+				  0x3001ull, UINT64_MAX);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_unmapped(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xcc, 0xcc };
+	const uint8_t *begin;
+	int status;
+
+	/* Our test file sections can not be accessed in place. */
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, &ifix->asid[0],
+				  0x1001ull, UINT64_MAX);
+	ptu_int_eq(status, -pte_nomap);
+
+	/* Neither can memory provided by the read memory callback. */
+	status = pt_image_set_callback(&ifix->image, image_readmem_callback,
+				       memory);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, &ifix->asid[0],
+				  0x3000ull, UINT64_MAX);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_copy(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02, 0xdd };
+	uint8_t code[] = { 0x90, 0x90, 0xc3 };
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	const uint8_t *begin;
+	int status;
+
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x3000ull, 0, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	/* Memory that can be accessed in place is not copied. */
+	status = pt_image_peek_at(&ifix->image, &begin, buffer, 2,
+				  &ifix->asid[0], 0x3001ull, UINT64_MAX);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, &code[1]);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	/* Our test file sections are copied. */
+	status = pt_image_peek_at(&ifix->image, &begin, buffer, 2,
+				  &ifix->asid[0], 0x1001ull, UINT64_MAX);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, buffer);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	status = pt_image_peek_at(&ifix->image, &begin, buffer, 1,
+				  &ifix->asid[0], 0x4000ull, UINT64_MAX);
+	ptu_int_eq(status, -pte_nomap);
+
+	/* So is memory provided by the read memory callback. */
+	status = pt_image_set_callback(&ifix->image, image_readmem_callback,
+				       memory);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_peek_at(&ifix->image, &begin, buffer, 2,
+				  &ifix->asid[1], 0x3001ull, UINT64_MAX);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, buffer);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_version(struct image_fixture *ifix)
+{
+	uint8_t code[] = { 0x90, 0x90, 0xc3 };
+	struct pt_image_record record;
+	const uint8_t *begin;
+	int status;
+
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x3000ull, 0, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = sizeof(code);
+	record.vaddr = 0x3000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, &ifix->asid[0],
+				  0x3002ull, 0xffull);
+	ptu_int_eq(status, 1);
+	ptu_ptr_eq(begin, &code[2]);
+
+	status = pt_image_peek_at(&ifix->image, &begin, NULL, 1, &ifix->asid[0],
+				  0x3002ull, 0x100ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_null(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_save(NULL, "file");
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_save(&ifix->image, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_load(NULL, "file");
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_load(&ifix->image, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_load(struct image_fixture *ifix)
+{
+	struct pt_image image;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	char *name;
+	int status;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 2);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, 2);
+	ptu_ptr(image.snapshot);
+
+	status = pt_image_read(&image, buffer, 2, &ifix->asid[0], 0x1003ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+
+	status = pt_image_read(&image, buffer, 1, &ifix->asid[1], 0x2005ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x05);
+
+	status = pt_image_read(&image, buffer, 1, &ifix->asid[1], 0x1005ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	/* We only load into empty images. */
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, -pte_invalid);
+
+	pt_image_fini(&image);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_load_range(struct image_fixture *ifix)
+{
+	struct pt_image image;
+	uint8_t buffer[] = { 0xcc };
+	char *name;
+	int status;
+
+	status = pt_image_add_range(&ifix->image, &ifix->section[0],
+				    &ifix->asid[0], 0x1000ull, 0x4ull, 0x8ull);
+	ptu_int_eq(status, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 1);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, 1);
+
+	status = pt_image_read(&image, buffer, 1, &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x04);
+
+	status = pt_image_read(&image, buffer, 1, &ifix->asid[0], 0x1008ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	pt_image_fini(&image);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_load_stale(struct image_fixture *ifix)
+{
+	struct pt_image image;
+	char *name;
+	int status;
+
+	/* The file no longer matches the section we added. */
+	ifix->section[1].content[3] = 0xcc;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 2);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, -pte_bad_image);
+	ptu_null(image.map);
+	ptu_null(image.snapshot);
+
+	pt_image_fini(&image);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_load_vmcs(struct image_fixture *ifix)
+{
+	struct pt_image image;
+	struct pt_asid asid;
+	uint8_t buffer[] = { 0xcc };
+	char *name;
+	int status;
+
+	ifix->asid[2].vmcs = 0x23000ull;
+
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[2],
+			      0x3000ull);
+	ptu_int_eq(status, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 1);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, 1);
+
+	status = pt_image_read(&image, buffer, 1, &ifix->asid[2], 0x3001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	asid = ifix->asid[2];
+	asid.vmcs = 0x42000ull;
+
+	status = pt_image_read(&image, buffer, 1, &asid, 0x3001ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	pt_image_fini(&image);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_load_unchanged(struct image_fixture *ifix)
+{
+	struct pt_image image;
+	char *name, *fname;
+	FILE *file;
+	int status;
+
+	/* Let section 1 refer to an existing file so its identity is
+	 * recorded.
+	 */
+	fname = mktempname();
+	ptu_ptr(fname);
+
+	file = fopen(fname, "wb");
+	ptu_ptr(file);
+
+	status = fputc(0xcc, file);
+	ptu_int_eq(status, 0xcc);
+
+	status = fclose(file);
+	ptu_int_eq(status, 0);
+
+	ifix->section[1].name = fname;
+
+	/* The section's content does not match its file's content.  We
+	 * notice only if we hash it.
+	 */
+	ifix->section[1].content[3] = 0xcc;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 2);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, 2);
+
+	pt_image_fini(&image);
+
+	/* Once the file changes, we check the hash. */
+	file = fopen(fname, "ab");
+	ptu_ptr(file);
+
+	status = fputc(0xcc, file);
+	ptu_int_eq(status, 0xcc);
+
+	status = fclose(file);
+	ptu_int_eq(status, 0);
+
+	pt_image_init(&image, NULL);
+
+	status = pt_image_load(&image, name);
+	ptu_int_eq(status, -pte_bad_image);
+
+	pt_image_fini(&image);
+
+	remove(name);
+	free(name);
+
+	remove(fname);
+	free(fname);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_buffer(struct image_fixture *ifix)
+{
+	uint8_t code[] = { 0xc3 };
+	char *name;
+	int status;
+
+	status = pt_image_add_buffer(&ifix->image, code, sizeof(code),
+				     &ifix->asid[0], 0x3000ull, 0, NULL, NULL);
+	ptu_int_eq(status, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	status = pt_image_save(&ifix->image, name);
+	ptu_int_eq(status, 2);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+/* Find the partition for @cr3 in @map. */
+static const struct pt_image_partition *
+map_find(const struct pt_image_map *map, uint64_t cr3)
+{
+	uint32_t slot;
+
+	for (slot = 0; slot <= map->mask; ++slot) {
+		if (map->partitions[slot].cr3 == cr3)
+			return &map->partitions[slot];
+	}
+
+	return NULL;
+}
+
+static struct ptunit_result map_partition(struct image_fixture *ifix)
+{
+	const struct pt_image_partition *partition;
+	const struct pt_image_map *map;
+	uint32_t slot, npartitions;
+
+	map = ifix->image.map;
+	ptu_ptr(map);
+	ptu_uint_eq(map->nsections, 2);
+	ptu_null(map->partitions[map->mask + 1].sections);
+
+	npartitions = 0;
+	for (slot = 0; slot <= map->mask; ++slot) {
+		partition = &map->partitions[slot];
+		if (!partition->sections)
+			continue;
+
+		ptu_null(partition->sections->next);
+
+		if (partition->cr3 == ifix->asid[0].cr3) {
+			ptu_ptr_eq(partition->sections->section.section,
+				   &ifix->section[0]);
+		} else {
+			ptu_uint_eq(partition->cr3, ifix->asid[1].cr3);
+			ptu_ptr_eq(partition->sections->section.section,
+				   &ifix->section[1]);
+		}
+
+		npartitions += 1;
+	}
+
+	ptu_uint_eq(npartitions, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result map_wildcard(struct image_fixture *ifix)
+{
+	const struct pt_image_map *map;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_asid asid;
+	int status;
+
+	pt_asid_init(&asid);
+
+	status = pt_image_add(&ifix->image, &ifix->section[2], &asid,
+			      0x3000ull);
+	ptu_int_eq(status, 0);
+
+	map = ifix->image.map;
+	ptu_ptr(map->partitions[map->mask + 1].sections);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[0],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[2],
+			       0x3003ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x03);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[2],
+			       0x1003ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &asid, 0x2004ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x04);
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[2]);
+	ptu_int_eq(status, 1);
+	ptu_int_ne(ifix->section[2].deleted, 0);
+
+	status = pt_image_read(&ifix->image, buffer, 1, &ifix->asid[2],
+			       0x3003ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	map = ifix->image.map;
+	ptu_null(map->partitions[map->mask + 1].sections);
+	ptu_uint_eq(map->nsections, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result map_remove_none(struct image_fixture *ifix)
+{
+	struct pt_image_snapshot *snapshot;
+	struct pt_image_map *map;
+	int status;
+
+	snapshot = ifix->image.snapshot;
+	map = ifix->image.map;
+
+	status = pt_image_remove_by_asid(&ifix->image, &ifix->asid[2]);
+	ptu_int_eq(status, 0);
+	ptu_ptr_eq(ifix->image.snapshot, snapshot);
+	ptu_ptr_eq(ifix->image.map, map);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result map_version(struct image_fixture *ifix)
+{
+	const struct pt_image_partition *old, *new;
+	struct pt_image_record record;
+	struct pt_image_map *map;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	map = ifix->image.map;
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.asid = &ifix->asid[0];
+	record.size = 0x10ull;
+	record.vaddr = 0x1000ull;
+
+	status = pt_image_apply(&ifix->image, &record);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(ifix->image.nversions, 1);
+	ptu_ptr_eq(ifix->image.versions[0].map, map);
+	ptu_ptr_ne(ifix->image.map, map);
+	ptu_ptr_eq(ifix->image.snapshot->map, ifix->image.map);
+
+	/* The other address space's partition is still shared. */
+	old = map_find(map, ifix->asid[1].cr3);
+	new = map_find(ifix->image.map, ifix->asid[1].cr3);
+	ptu_ptr(old);
+	ptu_ptr(new);
+	ptu_ptr_eq(new->sections, old->sections);
+
+	status = pt_image_read_at(&ifix->image, buffer, 1, &ifix->asid[0],
+				  0x1001ull, 0xffull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read_at(&ifix->image, buffer, 1, &ifix->asid[0],
+				  0x1001ull, 0x100ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result map_grow(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	struct pt_asid asid;
+	uint64_t cr3;
+	int status;
+
+	pt_asid_init(&asid);
+
+	for (cr3 = 0x1000ull; cr3 <= 0x40000ull; cr3 += 0x1000ull) {
+		asid.cr3 = cr3;
+
+		status = pt_image_add(&ifix->image, &ifix->section[0], &asid,
+				      cr3);
+		ptu_int_eq(status, 0);
+
+		ifix->section[0].ucount += 1;
+	}
+
+	ptu_uint_eq(ifix->image.map->nsections, 0x40);
+	ptu_uint_ge(ifix->image.map->mask, 0x7f);
+
+	for (cr3 = 0x1000ull; cr3 <= 0x40000ull; cr3 += 0x1000ull) {
+		asid.cr3 = cr3;
+
+		status = pt_image_read(&ifix->image, buffer, 1, &asid,
+				       cr3 + 2ull);
+		ptu_int_eq(status, 1);
+		ptu_uint_eq(buffer[0], 0x02);
+
+		status = pt_image_read(&ifix->image, buffer, 1, &asid,
+				       cr3 + 0x1000ull);
+		ptu_int_eq(status, -pte_nomap);
+	}
+
+	for (cr3 = 0x1000ull; cr3 <= 0x40000ull; cr3 += 0x1000ull) {
+		asid.cr3 = cr3;
+
+		status = pt_image_remove_by_asid(&ifix->image, &asid);
+		ptu_int_eq(status, 1);
+	}
+
+	ptu_null(ifix->image.map);
+	ptu_uint_eq(ifix->section[0].ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result snapshot(struct image_fixture *ifix)
+{
+	struct pt_image_snapshot *snapshot;
+	int status;
+
+	snapshot = ifix->image.snapshot;
+	ptu_ptr(snapshot);
+	ptu_ptr_eq(snapshot->map, ifix->image.map);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	ptu_ptr_ne(ifix->image.snapshot, snapshot);
+	ptu_ptr_eq(ifix->image.snapshot->map, ifix->image.map);
+	ptu_null(ifix->image.retired);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result snapshot_reader(struct image_fixture *ifix)
+{
+	uint32_t parity;
+	int status;
+
+	/* Pretend that a reader is using the current snapshot. */
+	parity = ifix->image.epoch & 1;
+	ifix->image.readers[parity] += 1;
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+	ptu_ptr(ifix->image.retired);
+	ptu_int_eq(ifix->section[0].deleted, 0);
+
+	ifix->image.readers[parity] -= 1;
+
+	status = pt_image_remove(&ifix->image, &ifix->section[1],
+				 &ifix->asid[1], 0x2000ull);
+	ptu_int_eq(status, 0);
+	ptu_null(ifix->image.retired);
+	ptu_int_ne(ifix->section[0].deleted, 0);
+	ptu_int_ne(ifix->section[1].deleted, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result snapshot_late_reader(struct image_fixture *ifix)
+{
+	uint32_t parity;
+	int status;
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+
+	/* Pretend that a reader entered in the current epoch. */
+	parity = ifix->image.epoch & 1;
+	ifix->image.readers[parity] += 1;
+
+	status = pt_image_remove(&ifix->image, &ifix->section[1],
+				 &ifix->asid[1], 0x2000ull);
+	ptu_int_eq(status, 0);
+	ptu_ptr(ifix->image.retired);
+	ptu_int_eq(ifix->section[1].deleted, 0);
+
+	ifix->image.readers[parity] -= 1;
+
+	return ptu_passed();
+}
+
+/* The number of reader threads in the snapshot_threads test and the number
+ * of times each reader wants to find the changing section mapped and not
+ * mapped.
+ */
+enum {
+	snapshot_threads_nreaders = 4,
+	snapshot_threads_nseen = 16
+};
+
+/* The state shared by the threads of the snapshot_threads test. */
+struct snapshot_threads_state {
+	/* The image fixture. */
+	struct image_fixture *ifix;
+
+	/* The number of readers that are done.
+	 *
+	 * This is accessed atomically.
+	 */
+	uint32_t done;
+};
+
+/* Read from @arg's image while another thread adds and removes sections. */
+static int snapshot_threads_reader(void *arg)
+{
+	struct snapshot_threads_state *state;
+	struct image_fixture *ifix;
+	int mapped, unmapped, errcode;
+
+	state = (struct snapshot_threads_state *) arg;
+	if (!state)
+		return -pte_internal;
+
+	ifix = state->ifix;
+	errcode = 0;
+	mapped = 0;
+	unmapped = 0;
+
+	while (mapped < snapshot_threads_nseen ||
+	       unmapped < snapshot_threads_nseen) {
+		uint8_t buffer;
+		int status;
+
+		/* Section 0 is never removed. */
+		status = pt_image_read(&ifix->image, &buffer, 1,
+				       &ifix->asid[0], 0x1003ull);
+		if (status != 1 || buffer != 0x03) {
+			errcode = -pte_internal;
+			break;
+		}
+
+		/* Section 2 comes and goes. */
+		status = pt_image_read(&ifix->image, &buffer, 1,
+				       &ifix->asid[0], 0x3002ull);
+		if (status == -pte_nomap) {
+			unmapped += 1;
+			continue;
+		}
+
+		if (status != 1 || buffer != 0x02) {
+			errcode = -pte_internal;
+			break;
+		}
+
+		mapped += 1;
+	}
+
+	(void) pt_atomic_inc32(&state->done);
+
+	return errcode;
+}
+
+static struct ptunit_result snapshot_threads(struct image_fixture *ifix)
+{
+	struct ptunit_thread *thread[snapshot_threads_nreaders];
+	struct snapshot_threads_state state;
+	uint32_t ucount;
+	int idx, status;
+
+	state.ifix = ifix;
+	state.done = 0;
+
+	ucount = ifix->section[2].ucount;
+
+	for (idx = 0; idx < snapshot_threads_nreaders; ++idx) {
+		thread[idx] = ptunit_thread_create(snapshot_threads_reader,
+						   &state);
+		ptu_ptr(thread[idx]);
+	}
+
+	while (pt_atomic_load32(&state.done) < snapshot_threads_nreaders) {
+		status = pt_section_get(&ifix->section[2]);
+		ptu_int_eq(status, 0);
+
+		status = pt_image_add(&ifix->image, &ifix->section[2],
+				      &ifix->asid[0], 0x3000ull);
+		ptu_int_eq(status, 0);
+
+		status = pt_image_remove(&ifix->image, &ifix->section[2],
+					 &ifix->asid[0], 0x3000ull);
+		ptu_int_eq(status, 0);
+	}
+
+	for (idx = 0; idx < snapshot_threads_nreaders; ++idx) {
+		status = ptunit_thread_join(thread[idx]);
+		ptu_int_eq(status, 0);
+	}
+
+	ptu_uint_eq(ifix->image.readers[0], 0);
+	ptu_uint_eq(ifix->image.readers[1], 0);
+
+	/* Retired snapshots are freed with the image.  Then all references
+	 * taken above are gone.
+	 */
+	pt_image_fini(&ifix->image);
+	pt_image_init(&ifix->image, NULL);
+
+	ptu_uint_eq(ifix->section[2].ucount, ucount);
+	ptu_int_eq(ifix->section[2].deleted, 0);
+
+	return ptu_passed();
+}
+
+struct ptunit_result ifix_init(struct image_fixture *ifix)
+{
+	pt_image_init(&ifix->image, NULL);
+
+	pt_init_section(&ifix->section[0], "file-0");
+	pt_init_section(&ifix->section[1], "file-1");
+	pt_init_section(&ifix->section[2], "file-2");
+
+	pt_asid_init(&ifix->asid[0]);
+	ifix->asid[0].cr3 = 0xa000;
+
+	pt_asid_init(&ifix->asid[1]);
+	ifix->asid[1].cr3 = 0xb000;
+
+	pt_asid_init(&ifix->asid[2]);
+	ifix->asid[2].cr3 = 0xc000;
+
+	return ptu_passed();
+}
+
+struct ptunit_result rfix_init(struct image_fixture *ifix)
+{
+	int status;
+
+	ptu_check(ifix_init, ifix);
+
+	status = pt_image_add(&ifix->image, &ifix->section[0], &ifix->asid[0],
+			      0x1000ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->image, &ifix->section[1], &ifix->asid[1],
+			      0x2000ull);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+struct ptunit_result dfix_fini(struct image_fixture *ifix)
+{
+	pt_image_fini(&ifix->image);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct image_fixture dfix, ifix, rfix;
 	struct ptunit_suite suite;
 
 	/* Dfix provides image destruction. */
@@ -844,12 +2807,17 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_empty, ifix);
 	ptu_run_f(suite, overlap, ifix);
 	ptu_run_f(suite, adjacent, ifix);
+	ptu_run_f(suite, add_range, ifix);
+	ptu_run_f(suite, add_range_overlap, ifix);
+	ptu_run_f(suite, add_range_bad_size, ifix);
 
 	ptu_run_f(suite, read, rfix);
 	ptu_run_f(suite, read_asid, ifix);
 	ptu_run_f(suite, read_bad_asid, rfix);
 	ptu_run_f(suite, read_null_asid, rfix);
 	ptu_run_f(suite, read_callback, rfix);
+	ptu_run_f(suite, read_callback_cache, rfix);
+	ptu_run_f(suite, callback_cache_bad_size, rfix);
 	ptu_run_f(suite, read_nomem, rfix);
 	ptu_run_f(suite, read_truncated, rfix);
 
@@ -860,8 +2828,59 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, remove_by_filename_bad_asid, rfix);
 	ptu_run_f(suite, remove_none_by_filename, rfix);
 	ptu_run_f(suite, remove_all_by_filename, ifix);
+	ptu_run_f(suite, remove_by_filename_fail, rfix);
 	ptu_run_f(suite, remove_by_asid, rfix);
 
+	ptu_run(suite, copy_null);
+	ptu_run_f(suite, copy, rfix);
+	ptu_run_f(suite, copy_add, rfix);
+	ptu_run_f(suite, copy_remove, rfix);
+	ptu_run_f(suite, copy_remove_by_asid, rfix);
+	ptu_run_f(suite, copy_threads, rfix);
+
+	ptu_run_f(suite, apply_null, ifix);
+	ptu_run_f(suite, apply_bad_file, ifix);
+	ptu_run_f(suite, apply_out_of_order, rfix);
+	ptu_run_f(suite, apply_remove, rfix);
+	ptu_run_f(suite, apply_add, ifix);
+	ptu_run_f(suite, apply_same_time, rfix);
+	ptu_run_f(suite, apply_fail, rfix);
+	ptu_run_f(suite, apply_copy, rfix);
+
+	ptu_run_f(suite, generation_null, ifix);
+	ptu_run_f(suite, generation, rfix);
+
+	ptu_run(suite, add_buffer_null);
+	ptu_run_f(suite, add_buffer, ifix);
+	ptu_run_f(suite, add_buffer_overlap, rfix);
+	ptu_run_f(suite, add_buffer_fail, ifix);
+	ptu_run_f(suite, add_buffer_generation, ifix);
+
+	ptu_run_f(suite, peek_null, rfix);
+	ptu_run_f(suite, peek, rfix);
+	ptu_run_f(suite, peek_unmapped, rfix);
+	ptu_run_f(suite, peek_copy, rfix);
+	ptu_run_f(suite, peek_version, rfix);
+
+	ptu_run_f(suite, save_null, ifix);
+	ptu_run_f(suite, save_load, rfix);
+	ptu_run_f(suite, save_load_range, ifix);
+	ptu_run_f(suite, save_load_stale, rfix);
+	ptu_run_f(suite, save_load_vmcs, ifix);
+	ptu_run_f(suite, save_load_unchanged, rfix);
+	ptu_run_f(suite, save_buffer, rfix);
+
+	ptu_run_f(suite, map_partition, rfix);
+	ptu_run_f(suite, map_wildcard, rfix);
+	ptu_run_f(suite, map_remove_none, rfix);
+	ptu_run_f(suite, map_version, rfix);
+	ptu_run_f(suite, map_grow, ifix);
+
+	ptu_run_f(suite, snapshot, rfix);
+	ptu_run_f(suite, snapshot_reader, rfix);
+	ptu_run_f(suite, snapshot_late_reader, rfix);
+	ptu_run_f(suite, snapshot_threads, rfix);
+
 	ptunit_report(&suite);
 	return suite.nr_fails;
 }
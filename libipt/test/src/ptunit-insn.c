@@ -0,0 +1,2002 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ptunit.h"
+
+#include "pt_insn_decoder.h"
+#include "pt_encoder.h"
+#include "pt_block_profile.h"
+#include "pt_block_sample.h"
+
+#include "intel-pt.h"
+
+#include <stddef.h>
+#include <string.h>
+
+
+/* The address at which the test code is mapped. */
+static const uint64_t ifix_code_ip = 0x1000ull;
+
+/* An instruction flow decoder testing fixture. */
+struct insn_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[1024];
+
+	/* The code - four nops followed by jmp *%rax. */
+	uint8_t code[0x40];
+
+	/* The configuration under test. */
+	struct pt_config config;
+
+	/* An encoder and instruction flow decoder for the above
+	 * configuration.
+	 */
+	struct pt_encoder encoder;
+	struct pt_insn_decoder decoder;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct insn_fixture *);
+	struct ptunit_result (*fini)(struct insn_fixture *);
+};
+
+/* Encode a trace that enables tracing at the beginning of the code and
+ * disables it at the indirect jump.
+ */
+static struct ptunit_result ifix_encode(struct insn_fixture *ifix)
+{
+	struct pt_encoder *encoder;
+
+	encoder = &ifix->encoder;
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	return ptu_passed();
+}
+
+/* Initialize and synchronize the decoder on the encoded trace. */
+static struct ptunit_result ifix_decoder(struct insn_fixture *ifix)
+{
+	struct pt_image *image;
+	int errcode;
+
+	ifix->config.end = ifix->encoder.pos;
+
+	errcode = pt_insn_decoder_init(&ifix->decoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	image = pt_insn_get_image(&ifix->decoder);
+	ptu_ptr(image);
+
+	errcode = pt_image_add_buffer(image, ifix->code, sizeof(ifix->code),
+				      NULL, ifix_code_ip, 0, NULL, NULL);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sync_forward(&ifix->decoder);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bytes_mode_null(struct insn_fixture *ifix)
+{
+	int errcode;
+
+	errcode = pt_insn_set_bytes_mode(NULL, ptib_ref);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_set_bytes_mode(&ifix->decoder,
+					 (enum pt_insn_bytes_mode) 42);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bytes_mode(struct insn_fixture *ifix,
+				       enum pt_insn_bytes_mode mode)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_insn_set_bytes_mode(&ifix->decoder, mode);
+	ptu_int_eq(errcode, 0);
+
+	memset(&insn, 0xcd, sizeof(insn));
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip);
+	ptu_uint_eq(insn.size, 1);
+	ptu_int_eq(insn.iclass, ptic_other);
+	ptu_int_eq(insn.mode, ptem_64bit);
+
+	switch (mode) {
+	case ptib_copy:
+		ptu_null(insn.bytes);
+		ptu_uint_eq(insn.raw[0], 0x90);
+		break;
+
+	case ptib_ref:
+		ptu_ptr_eq(insn.bytes, ifix->code);
+		ptu_uint_eq(insn.raw[0], 0xcd);
+		break;
+
+	case ptib_none:
+		ptu_null(insn.bytes);
+		ptu_uint_eq(insn.raw[0], 0xcd);
+		break;
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next(struct insn_fixture *ifix)
+{
+	struct pt_insn insn;
+	uint64_t ip;
+	int errcode;
+
+	for (ip = ifix_code_ip; ip < ifix_code_ip + 4; ++ip) {
+		/* Flags from earlier calls must not leak through. */
+		memset(&insn, 0xcd, sizeof(insn));
+
+		errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(insn.ip, ip);
+		ptu_uint_eq(insn.enabled, ip == ifix_code_ip);
+		ptu_uint_eq(insn.disabled, 0);
+		ptu_uint_eq(insn.speculative, 0);
+		ptu_uint_eq(insn.resynced, 0);
+		ptu_uint_eq(insn.gap, 0);
+	}
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip + 4);
+	ptu_uint_eq(insn.size, 2);
+	ptu_int_eq(insn.iclass, ptic_jump);
+	ptu_uint_eq(insn.disabled, 1);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next_null(struct insn_fixture *ifix)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_insn_next(NULL, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_next(&ifix->decoder, NULL, sizeof(insn));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn,
+			       offsetof(struct pt_insn, bytes) - 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next_small(struct insn_fixture *ifix)
+{
+	struct pt_insn insn;
+	size_t size;
+	int errcode;
+
+	errcode = pt_insn_set_bytes_mode(&ifix->decoder, ptib_ref);
+	ptu_int_eq(errcode, 0);
+
+	memset(&insn, 0xcd, sizeof(insn));
+
+	/* Older users do not have the bytes pointer.  They get the bytes in
+	 * @insn->raw and nothing is written beyond @size.
+	 */
+	size = offsetof(struct pt_insn, bytes);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip);
+	ptu_uint_eq(insn.size, 1);
+	ptu_uint_eq(insn.raw[0], 0x90);
+	ptu_uint_eq(((const uint8_t *) &insn)[size], 0xcd);
+
+	return ptu_passed();
+}
+
+/* The columns of a batch of up to eight instructions. */
+struct batch_columns {
+	uint64_t ip[8];
+	uint8_t size[8];
+	uint8_t iclass[8];
+	uint16_t flags[8];
+	uint8_t raw[8][pt_max_insn_size];
+	struct pt_insn_batch_event events[8];
+};
+
+static void batch_init(struct pt_insn_batch *batch,
+		       struct batch_columns *columns, uint32_t nrows,
+		       uint32_t max_events)
+{
+	memset(columns, 0xcd, sizeof(*columns));
+	memset(batch, 0, sizeof(*batch));
+
+	batch->nrows = nrows;
+	batch->ip = columns->ip;
+	batch->size = columns->size;
+	batch->iclass = columns->iclass;
+	batch->flags = columns->flags;
+	batch->events = columns->events;
+	batch->max_events = max_events;
+}
+
+static struct ptunit_result batch_null(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents;
+	int status;
+
+	batch_init(&batch, &columns, 8, 8);
+
+	status = pt_insn_next_batch(NULL, &batch, &nevents);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_insn_next_batch(&ifix->decoder, NULL, &nevents);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	batch.flags = NULL;
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, -pte_invalid);
+
+	batch_init(&batch, &columns, 8, 8);
+	batch.events = NULL;
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result batch(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents, row;
+	int status;
+
+	batch_init(&batch, &columns, 8, 8);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 5);
+
+	for (row = 0; row < 5; ++row) {
+		ptu_uint_eq(columns.ip[row], ifix_code_ip + row);
+		ptu_int_eq(pt_insn_flags_mode(columns.flags[row]), ptem_64bit);
+	}
+
+	ptu_uint_eq(columns.size[0], 1);
+	ptu_uint_eq(columns.iclass[0], ptic_other);
+	ptu_uint_eq(columns.size[4], 2);
+	ptu_uint_eq(columns.iclass[4], ptic_jump);
+	ptu_uint_eq(columns.ip[5], 0xcdcdcdcdcdcdcdcdull);
+
+	ptu_uint_eq(nevents, 2);
+	ptu_uint_eq(columns.events[0].row, 0);
+	ptu_uint_eq(columns.events[0].flags, ptif_enabled);
+	ptu_uint_eq(columns.events[1].row, 4);
+	ptu_uint_eq(columns.events[1].flags, ptif_disabled);
+
+	ptu_uint_eq(columns.flags[0] & ptif_events, ptif_enabled);
+	ptu_uint_eq(columns.flags[1] & ptif_events, 0);
+	ptu_uint_eq(columns.flags[4] & ptif_events, ptif_disabled);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result batch_rows(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents;
+	int status;
+
+	batch_init(&batch, &columns, 3, 8);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 3);
+	ptu_uint_eq(nevents, 1);
+	ptu_uint_eq(columns.ip[2], ifix_code_ip + 2);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(nevents, 1);
+	ptu_uint_eq(columns.ip[0], ifix_code_ip + 3);
+	ptu_uint_eq(columns.events[0].row, 1);
+
+	batch.nrows = 0;
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(nevents, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result batch_no_events(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents;
+	int status;
+
+	batch_init(&batch, &columns, 8, 0);
+	batch.events = NULL;
+
+	/* Without room for events, we stop after each event. */
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(nevents, 0);
+	ptu_uint_eq(columns.flags[0] & ptif_events, ptif_enabled);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 4);
+	ptu_uint_eq(nevents, 0);
+	ptu_uint_eq(columns.ip[3], ifix_code_ip + 4);
+	ptu_uint_eq(columns.flags[3] & ptif_events, ptif_disabled);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result batch_raw(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents;
+	int status;
+
+	batch_init(&batch, &columns, 8, 8);
+	batch.raw = columns.raw;
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 5);
+	ptu_uint_eq(columns.raw[0][0], 0x90);
+	ptu_uint_eq(columns.raw[0][1], 0xcd);
+	ptu_uint_eq(columns.raw[4][0], 0xff);
+	ptu_uint_eq(columns.raw[4][1], 0xe0);
+
+	/* The decoder's bytes mode is restored. */
+	ptu_int_eq(ifix->decoder.bytes_mode, ptib_copy);
+
+	return ptu_passed();
+}
+
+/* The address to which the test code jumps in the resilient tests.
+ *
+ * There is no code at that address.
+ */
+static const uint64_t ifix_bad_ip = 0x3000ull;
+
+/* Encode a trace that jumps from the test code to unmapped memory and
+ * continues with trace we can't decode.
+ *
+ * If @resync is non-zero, the trace continues with a PSB+ at the beginning
+ * of the code.  If @resync is bigger than one, there is another PSB+ in
+ * unmapped memory before that.
+ *
+ * Provides the offset of the PSB at the beginning of the code in @sync.
+ */
+static struct ptunit_result ifix_encode_gap(struct insn_fixture *ifix,
+					    int resync, uint64_t *sync)
+{
+	struct pt_encoder *encoder;
+	int errcode;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	encoder = &ifix->encoder;
+
+	pt_encode_psb(encoder);
+	pt_encode_tsc(encoder, 0x1000ull);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+	pt_encode_tip(encoder, ifix_bad_ip, pt_ipc_sext_48);
+	pt_encode_tnt_8(encoder, 0, 1);
+	pt_encode_tsc(encoder, 0x1400ull);
+
+	if (1 < resync) {
+		pt_encode_psb(encoder);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_fup(encoder, ifix_bad_ip, pt_ipc_sext_48);
+		pt_encode_psbend(encoder);
+		pt_encode_tnt_8(encoder, 0, 1);
+	}
+
+	*sync = (uint64_t) (encoder->pos - ifix->buffer);
+
+	if (resync) {
+		pt_encode_psb(encoder);
+		pt_encode_tsc(encoder, 0x1800ull);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_fup(encoder, ifix_code_ip, pt_ipc_sext_48);
+		pt_encode_psbend(encoder);
+		pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+	}
+
+	ptu_check(ifix_decoder, ifix);
+
+	return ptu_passed();
+}
+
+/* Decode the five instructions of the test code. */
+static struct ptunit_result ifix_next_code(struct insn_fixture *ifix, int gap)
+{
+	struct pt_insn insn;
+	uint64_t ip;
+	int errcode;
+
+	for (ip = ifix_code_ip; ip <= ifix_code_ip + 4; ++ip) {
+		errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(insn.ip, ip);
+		ptu_uint_eq(insn.gap, gap && (ip == ifix_code_ip));
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_null(struct insn_fixture *ifix)
+{
+	struct pt_insn_gap_stats stats;
+	struct pt_insn_gap gap;
+	int errcode;
+
+	errcode = pt_insn_set_resilient(NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_gap(NULL, &gap);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_gap(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_gap_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_gap_stats(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_no_gap(struct insn_fixture *ifix)
+{
+	struct pt_insn_gap_stats stats;
+	struct pt_insn_gap gap;
+	int errcode;
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+
+	errcode = pt_insn_get_gap(&ifix->decoder, &gap);
+	ptu_int_eq(errcode, -pte_nosync);
+
+	errcode = pt_insn_get_gap_stats(&ifix->decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.ngaps, 0);
+	ptu_uint_eq(stats.bytes, 0);
+	ptu_uint_eq(stats.time, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_off(struct insn_fixture *ifix)
+{
+	struct pt_insn insn;
+	uint64_t sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+	ptu_check(ifix_next_code, ifix, 0);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_nomap);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient(struct insn_fixture *ifix)
+{
+	struct pt_insn_gap_stats stats;
+	struct pt_insn_gap gap;
+	struct pt_insn insn;
+	uint64_t sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+	ptu_check(ifix_next_code, ifix, 1);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_get_gap(&ifix->decoder, &gap);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_lt(gap.begin, sync);
+	ptu_uint_eq(gap.end, sync);
+	ptu_uint_eq(gap.ip, ifix_code_ip + 4);
+	ptu_uint_eq(gap.time, 0x800ull);
+	ptu_int_eq(gap.errcode, -pte_nomap);
+
+	errcode = pt_insn_get_gap_stats(&ifix->decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.ngaps, 1);
+	ptu_uint_eq(stats.bytes, gap.end - gap.begin);
+	ptu_uint_eq(stats.time, 0x800ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_eos(struct insn_fixture *ifix)
+{
+	struct pt_insn_gap_stats stats;
+	struct pt_insn_gap gap;
+	struct pt_insn insn;
+	uint64_t sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 0, &sync);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_get_gap(&ifix->decoder, &gap);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_lt(gap.begin, sync);
+	ptu_uint_eq(gap.end, sync);
+	ptu_uint_eq(gap.ip, ifix_code_ip + 4);
+	ptu_uint_eq(gap.time, 0ull);
+	ptu_int_eq(gap.errcode, -pte_nomap);
+
+	errcode = pt_insn_get_gap_stats(&ifix->decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.ngaps, 1);
+	ptu_uint_eq(stats.bytes, gap.end - gap.begin);
+	ptu_uint_eq(stats.time, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_merge(struct insn_fixture *ifix)
+{
+	struct pt_insn_gap_stats stats;
+	struct pt_insn_gap gap;
+	uint64_t sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 2, &sync);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+	ptu_check(ifix_next_code, ifix, 1);
+
+	errcode = pt_insn_get_gap(&ifix->decoder, &gap);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(gap.end, sync);
+	ptu_uint_eq(gap.ip, ifix_code_ip + 4);
+	ptu_uint_eq(gap.time, 0x800ull);
+	ptu_int_eq(gap.errcode, -pte_nomap);
+
+	errcode = pt_insn_get_gap_stats(&ifix->decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.ngaps, 1);
+	ptu_uint_eq(stats.bytes, gap.end - gap.begin);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result resilient_batch(struct insn_fixture *ifix)
+{
+	struct batch_columns columns;
+	struct pt_insn_batch batch;
+	uint32_t nevents;
+	uint64_t sync;
+	int status;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+
+	status = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(status, 0);
+
+	batch_init(&batch, &columns, 8, 8);
+
+	status = pt_insn_next_batch(&ifix->decoder, &batch, &nevents);
+	ptu_int_eq(status, 8);
+	ptu_uint_eq(nevents, 2);
+	ptu_uint_eq(columns.ip[4], ifix_code_ip + 4);
+	ptu_uint_eq(columns.ip[5], ifix_code_ip);
+	ptu_uint_eq(columns.events[1].row, 5);
+	ptu_uint_eq(columns.events[1].flags, ptif_gap);
+	ptu_uint_eq(columns.flags[4] & ptif_gap, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result block_profile_null(void)
+{
+	struct pt_block_profile profile;
+	int errcode;
+
+	errcode = pt_insn_set_block_profile(NULL, &profile);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result block_profile(struct insn_fixture *ifix)
+{
+	struct pt_block_profile profile;
+	struct pt_insn insn;
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_block_profile_init(&profile);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_block_profile(&ifix->decoder, &profile);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	ptu_uint_eq(profile.nblocks, 1);
+	ptu_uint_eq(profile.nedges, 0);
+
+	errcode = pt_block_profile_block(&profile, NULL, ifix_code_ip, &count);
+	pt_block_profile_fini(&profile);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result block_profile_gap(struct insn_fixture *ifix)
+{
+	struct pt_block_profile profile;
+	uint64_t sync, count;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+
+	errcode = pt_block_profile_init(&profile);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_block_profile(&ifix->decoder, &profile);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+	ptu_check(ifix_next_code, ifix, 1);
+
+	/* We don't know where we came from after the gap. */
+	ptu_uint_eq(profile.nblocks, 1);
+	ptu_uint_eq(profile.nedges, 0);
+
+	errcode = pt_block_profile_block(&profile, NULL, ifix_code_ip, &count);
+	pt_block_profile_fini(&profile);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coverage_null(struct insn_fixture *ifix)
+{
+	uint8_t bitmap[0x100];
+	int errcode;
+
+	errcode = pt_insn_coverage(NULL, bitmap, sizeof(bitmap));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_coverage(&ifix->decoder, NULL, sizeof(bitmap));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_coverage(&ifix->decoder, bitmap, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_coverage(&ifix->decoder, bitmap, 0x30);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+/* Check that @bitmap of @size counters holds @count at @index and zero
+ * everywhere else.
+ */
+static struct ptunit_result ifix_bitmap(const uint8_t *bitmap, uint32_t size,
+					uint32_t index, uint8_t count)
+{
+	uint32_t pos;
+
+	for (pos = 0; pos < size; ++pos) {
+		if (pos == index)
+			ptu_uint_eq(bitmap[pos], count);
+		else
+			ptu_uint_eq(bitmap[pos], 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coverage(struct insn_fixture *ifix)
+{
+	uint8_t bitmap[0x100];
+	uint32_t index;
+	int errcode;
+
+	memset(bitmap, 0, sizeof(bitmap));
+
+	errcode = pt_insn_coverage(&ifix->decoder, bitmap, sizeof(bitmap));
+	ptu_int_eq(errcode, 0);
+
+	index = pt_insn_cov_loc(ifix_code_ip) & (sizeof(bitmap) - 1);
+	ptu_check(ifix_bitmap, bitmap, sizeof(bitmap), index, 1);
+
+	/* The bytes mode is restored. */
+	ptu_int_eq(ifix->decoder.bytes_mode, ptib_copy);
+
+	return ptu_passed();
+}
+
+/* Encode a trace that loops over the conditional branch at the beginning
+ * of the code @nloops times before it reaches the indirect jump.
+ *
+ * The code is two nops followed by jne to the beginning of the code and
+ * jmp *%rax.
+ */
+static struct ptunit_result ifix_encode_loop(struct insn_fixture *ifix,
+					     int nloops)
+{
+	struct pt_encoder *encoder;
+	int errcode;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+	ifix->code[2] = 0x75;
+	ifix->code[3] = 0xfc;
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	encoder = &ifix->encoder;
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+	pt_encode_tnt_8(encoder, (uint8_t) (((1 << nloops) - 1) << 1),
+			nloops + 1);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	ptu_check(ifix_decoder, ifix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coverage_loop(struct insn_fixture *ifix)
+{
+	const struct pt_insn_cov_block *block;
+	uint8_t bitmap[0x10000];
+	uint32_t loop, exit, begin, index;
+	int errcode, run;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	memset(bitmap, 0, sizeof(bitmap));
+
+	/* The second run uses the cached blocks. */
+	for (run = 1; run <= 2; ++run) {
+		errcode = pt_insn_sync_set(&ifix->decoder, 0ull);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_insn_coverage(&ifix->decoder, bitmap,
+					   sizeof(bitmap));
+		ptu_int_eq(errcode, 0);
+	}
+
+	loop = pt_insn_cov_loc(ifix_code_ip);
+	exit = pt_insn_cov_loc(ifix_code_ip + 4);
+
+	begin = loop & (sizeof(bitmap) - 1);
+	ptu_uint_eq(bitmap[begin], 2);
+
+	index = (loop ^ (loop >> 1)) & (sizeof(bitmap) - 1);
+	ptu_uint_eq(bitmap[index], 8);
+
+	index = (exit ^ (loop >> 1)) & (sizeof(bitmap) - 1);
+	ptu_uint_eq(bitmap[index], 2);
+
+	/* The loop has been cached. */
+	block = ifix->decoder.cov_cache;
+	for (index = 0; index < pt_insn_cov_cache_size; ++index) {
+		if (block[index].mode != ptem_unknown &&
+		    block[index].ip == ifix_code_ip)
+			break;
+	}
+
+	ptu_uint_lt(index, pt_insn_cov_cache_size);
+	ptu_uint_eq(block[index].ip, ifix_code_ip);
+	ptu_uint_eq(block[index].end, ifix_code_ip + 2);
+	ptu_uint_eq(block[index].target, ifix_code_ip);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coverage_saturate(struct insn_fixture *ifix)
+{
+	uint8_t bitmap[0x100];
+	uint32_t index;
+	int errcode, run;
+
+	memset(bitmap, 0, sizeof(bitmap));
+
+	for (run = 0; run < 300; ++run) {
+		errcode = pt_insn_sync_set(&ifix->decoder, 0ull);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_insn_coverage(&ifix->decoder, bitmap,
+					   sizeof(bitmap));
+		ptu_int_eq(errcode, 0);
+	}
+
+	index = pt_insn_cov_loc(ifix_code_ip) & (sizeof(bitmap) - 1);
+	ptu_check(ifix_bitmap, bitmap, sizeof(bitmap), index, UINT8_MAX);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result coverage_gap(struct insn_fixture *ifix)
+{
+	uint8_t bitmap[0x100];
+	uint32_t index;
+	uint64_t sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+
+	memset(bitmap, 0, sizeof(bitmap));
+
+	errcode = pt_insn_coverage(&ifix->decoder, bitmap, sizeof(bitmap));
+	ptu_int_eq(errcode, -pte_nomap);
+
+	errcode = pt_insn_sync_set(&ifix->decoder, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	memset(bitmap, 0, sizeof(bitmap));
+
+	errcode = pt_insn_coverage(&ifix->decoder, bitmap, sizeof(bitmap));
+	ptu_int_eq(errcode, 0);
+
+	/* We start over after the gap. */
+	index = pt_insn_cov_loc(ifix_code_ip) & (sizeof(bitmap) - 1);
+	ptu_check(ifix_bitmap, bitmap, sizeof(bitmap), index, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result breakpoint_null(struct insn_fixture *ifix)
+{
+	uint64_t ip, tsc;
+	int errcode;
+
+	ip = ifix_code_ip;
+
+	errcode = pt_insn_set_breakpoints(NULL, &ip, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_next_breakpoint(NULL, &ip, &tsc);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, NULL, &tsc);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, &ip, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result breakpoint_set(struct insn_fixture *ifix)
+{
+	uint64_t ips[] = { 0x3000ull, 0x1000ull, 0x2000ull, 0x1000ull };
+	int errcode;
+
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, ips, 4);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(ifix->decoder.nbreakpoints, 3);
+	ptu_uint_eq(ifix->decoder.breakpoints[0], 0x1000ull);
+	ptu_uint_eq(ifix->decoder.breakpoints[1], 0x2000ull);
+	ptu_uint_eq(ifix->decoder.breakpoints[2], 0x3000ull);
+
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, NULL, 0);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(ifix->decoder.nbreakpoints, 0);
+	ptu_null(ifix->decoder.breakpoints);
+
+	return ptu_passed();
+}
+
+/* Check that the next breakpoint is at @expected. */
+static struct ptunit_result ifix_next_bp(struct insn_fixture *ifix,
+					 uint64_t expected,
+					 uint64_t expected_tsc)
+{
+	uint64_t ip, tsc;
+	int errcode;
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, &ip, &tsc);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(ip, expected);
+	ptu_uint_eq(tsc, expected_tsc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result breakpoint_loop(struct insn_fixture *ifix)
+{
+	uint64_t ips[] = { ifix_code_ip + 4, ifix_code_ip + 1 };
+	uint64_t ip, tsc;
+	int errcode, loop;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, ips, 2);
+	ptu_int_eq(errcode, 0);
+
+	for (loop = 0; loop <= 4; ++loop)
+		ptu_check(ifix_next_bp, ifix, ifix_code_ip + 1, 0ull);
+
+	ptu_check(ifix_next_bp, ifix, ifix_code_ip + 4, 0ull);
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, &ip, &tsc);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result breakpoint_none(struct insn_fixture *ifix)
+{
+	uint64_t ip, tsc;
+	int errcode;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	ip = 0x2000ull;
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, &ip, 1);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, &ip, &tsc);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result breakpoint_gap(struct insn_fixture *ifix)
+{
+	uint64_t ip, tsc, sync;
+	int errcode;
+
+	ptu_check(ifix_encode_gap, ifix, 1, &sync);
+
+	errcode = pt_insn_set_resilient(&ifix->decoder, 1);
+	ptu_int_eq(errcode, 0);
+
+	ip = ifix_code_ip + 4;
+	errcode = pt_insn_set_breakpoints(&ifix->decoder, &ip, 1);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_bp, ifix, ifix_code_ip + 4, 0x1000ull);
+	ptu_check(ifix_next_bp, ifix, ifix_code_ip + 4, 0x1800ull);
+
+	errcode = pt_insn_next_breakpoint(&ifix->decoder, &ip, &tsc);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter_null(struct insn_fixture *ifix)
+{
+	uint64_t skipped;
+	int errcode;
+
+	errcode = pt_insn_set_filter(NULL, ptfm_call);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_filtered(NULL, &skipped);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_filtered(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+/* Check that the next instruction is at @ip and of class @iclass. */
+static struct ptunit_result ifix_next_insn(struct insn_fixture *ifix,
+					   uint64_t ip,
+					   enum pt_insn_class iclass)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ip);
+	ptu_int_eq(insn.iclass, iclass);
+
+	return ptu_passed();
+}
+
+/* Check that we reached the end of the trace having skipped @expected
+ * instructions.
+ */
+static struct ptunit_result ifix_filter_eos(struct insn_fixture *ifix,
+					    uint64_t expected)
+{
+	struct pt_insn insn;
+	uint64_t skipped;
+	int errcode;
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_get_filtered(&ifix->decoder, &skipped);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(skipped, expected);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter(struct insn_fixture *ifix, int profile)
+{
+	struct pt_block_profile bprofile;
+	uint64_t count;
+	int errcode, loop;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	errcode = pt_insn_set_filter(&ifix->decoder, ptfm_cond_jump);
+	ptu_int_eq(errcode, 0);
+
+	/* Blocks are not skipped while we profile them. */
+	if (profile) {
+		errcode = pt_block_profile_init(&bprofile);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_insn_set_block_profile(&ifix->decoder, &bprofile);
+		ptu_int_eq(errcode, 0);
+	}
+
+	for (loop = 0; loop <= 4; ++loop)
+		ptu_check(ifix_next_insn, ifix, ifix_code_ip + 2,
+			  ptic_cond_jump);
+
+	ptu_check(ifix_filter_eos, ifix, 11);
+
+	if (profile) {
+		errcode = pt_block_profile_block(&bprofile, NULL, ifix_code_ip,
+						 &count);
+		pt_block_profile_fini(&bprofile);
+		ptu_int_eq(errcode, 0);
+		ptu_uint_eq(count, 5ull);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter_events(struct insn_fixture *ifix)
+{
+	int errcode, loop;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	errcode = pt_insn_set_filter(&ifix->decoder,
+				     ptfm_cond_jump | ptfm_events);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_insn, ifix, ifix_code_ip, ptic_other);
+
+	for (loop = 0; loop <= 4; ++loop)
+		ptu_check(ifix_next_insn, ifix, ifix_code_ip + 2,
+			  ptic_cond_jump);
+
+	ptu_check(ifix_next_insn, ifix, ifix_code_ip + 4, ptic_jump);
+	ptu_check(ifix_filter_eos, ifix, 9);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter_off(struct insn_fixture *ifix)
+{
+	int errcode;
+
+	errcode = pt_insn_set_filter(&ifix->decoder, ptfm_jump);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_filter(&ifix->decoder, 0);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_code, ifix, 0);
+	ptu_check(ifix_filter_eos, ifix, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter_replace(struct insn_fixture *ifix)
+{
+	static const uint8_t code[] = { 0x66, 0x90 };
+	struct pt_image *image;
+	int errcode;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	errcode = pt_insn_set_filter(&ifix->decoder, ptfm_jump);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_insn, ifix, ifix_code_ip + 4, ptic_jump);
+	ptu_check(ifix_filter_eos, ifix, 15);
+
+	/* Replace the two nops in the loop with a single two-byte nop. */
+	image = pt_insn_get_image(&ifix->decoder);
+	ptu_ptr(image);
+
+	errcode = pt_image_add_buffer(image, code, sizeof(code), NULL,
+				      ifix_code_ip, 1, NULL, NULL);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sync_set(&ifix->decoder, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_filter(&ifix->decoder, ptfm_jump);
+	ptu_int_eq(errcode, 0);
+
+	/* We must not skip the loop using the stale cached block. */
+	ptu_check(ifix_next_insn, ifix, ifix_code_ip + 4, ptic_jump);
+	ptu_check(ifix_filter_eos, ifix, 10);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result filter_versioned(struct insn_fixture *ifix)
+{
+	const struct pt_insn_cov_block *block;
+	struct pt_image_record record;
+	uint32_t index;
+	int errcode;
+
+	ptu_check(ifix_encode_loop, ifix, 4);
+
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x100ull;
+	record.type = ptir_remove;
+	record.size = 0x10ull;
+	record.vaddr = 0x8000ull;
+
+	errcode = pt_image_apply(pt_insn_get_image(&ifix->decoder), &record);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_filter(&ifix->decoder, ptfm_jump);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_next_insn, ifix, ifix_code_ip + 4, ptic_jump);
+	ptu_check(ifix_filter_eos, ifix, 15);
+
+	/* We don't cache blocks if reads depend on the time. */
+	block = ifix->decoder.cov_cache;
+	for (index = 0; index < pt_insn_cov_cache_size; ++index)
+		ptu_uint_eq(block[index].mode, ptem_unknown);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result asid_null(struct insn_fixture *ifix)
+{
+	struct pt_skip_stats stats;
+	uint64_t cr3;
+	int errcode;
+
+	cr3 = 0x1000ull;
+
+	errcode = pt_insn_set_asid_filter(NULL, &cr3, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_set_asid_filter(&ifix->decoder, NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_skip_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_get_skip_stats(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+/* The cr3 values for address space filter tests. */
+static const uint64_t ifix_cr3 = 0x1000ull;
+static const uint64_t ifix_bad_cr3 = 0x2000ull;
+
+/* The ways in which decoding resumes after skipping trace. */
+enum ifix_resume {
+	ifix_resume_tip,
+	ifix_resume_pge,
+	ifix_resume_psb
+};
+
+/* Encode a trace that switches to a filtered address space and back.
+ *
+ * If @sync is zero, tracing is enabled at the beginning of the code and the
+ * mov %rax, %cr3 at the second instruction switches to the filtered address
+ * space.  Otherwise, the trace starts in the filtered address space.
+ *
+ * The trace for the filtered address space is not valid for our code.  We
+ * resume as specified in @resume at a second jmp *%rax, which disables
+ * tracing.
+ *
+ * Provides the number of trace bytes that should be skipped in @skipped.
+ */
+static struct ptunit_result ifix_encode_asid(struct insn_fixture *ifix,
+					     int sync,
+					     enum ifix_resume resume,
+					     uint64_t *skipped)
+{
+	struct pt_encoder *encoder;
+	uint8_t *begin;
+	uint64_t cr3;
+	int errcode;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+	ifix->code[1] = 0x0f;
+	ifix->code[2] = 0x22;
+	ifix->code[3] = 0xd8;
+	ifix->code[8] = 0xff;
+	ifix->code[9] = 0xe0;
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	encoder = &ifix->encoder;
+
+	if (sync) {
+		begin = encoder->pos;
+		pt_encode_psb(encoder);
+		pt_encode_pip(encoder, ifix_bad_cr3);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_fup(encoder, ifix_bad_ip, pt_ipc_sext_48);
+		pt_encode_psbend(encoder);
+	} else {
+		pt_encode_psb(encoder);
+		pt_encode_pip(encoder, ifix_cr3);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_psbend(encoder);
+		pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+
+		begin = encoder->pos;
+		pt_encode_pip(encoder, ifix_bad_cr3);
+	}
+
+	pt_encode_tnt_8(encoder, 1, 1);
+	pt_encode_tip(encoder, ifix_bad_ip, pt_ipc_sext_48);
+
+	switch (resume) {
+	case ifix_resume_tip:
+		pt_encode_pip(encoder, ifix_cr3);
+		*skipped = (uint64_t) (encoder->pos - begin);
+		pt_encode_tip(encoder, ifix_code_ip + 8, pt_ipc_sext_48);
+		break;
+
+	case ifix_resume_pge:
+		pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+		pt_encode_pip(encoder, ifix_cr3);
+		*skipped = (uint64_t) (encoder->pos - begin);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_tip_pge(encoder, ifix_code_ip + 8, pt_ipc_sext_48);
+		break;
+
+	case ifix_resume_psb:
+		*skipped = (uint64_t) (encoder->pos - begin);
+		pt_encode_psb(encoder);
+		pt_encode_pip(encoder, ifix_cr3);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_fup(encoder, ifix_code_ip + 8, pt_ipc_sext_48);
+		pt_encode_psbend(encoder);
+		break;
+	}
+
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	ptu_check(ifix_decoder, ifix);
+
+	cr3 = ifix_cr3;
+	errcode = pt_insn_set_asid_filter(&ifix->decoder, &cr3, 1);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sync_set(&ifix->decoder, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Check that we resume at the second jmp *%rax and run out of trace after
+ * having skipped @expected bytes.
+ */
+static struct ptunit_result ifix_asid_resume(struct insn_fixture *ifix,
+					     uint64_t expected)
+{
+	struct pt_skip_stats stats;
+	struct pt_insn insn;
+	int errcode;
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip + 8);
+	ptu_int_eq(insn.iclass, ptic_jump);
+	ptu_uint_eq(insn.enabled, 1);
+	ptu_uint_eq(insn.disabled, 1);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_get_skip_stats(&ifix->decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.bytes, expected);
+	ptu_uint_ne(stats.packets, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result asid(struct insn_fixture *ifix,
+				 enum ifix_resume resume)
+{
+	struct pt_insn insn;
+	uint64_t skipped;
+	int errcode;
+
+	ptu_check(ifix_encode_asid, ifix, 0, resume, &skipped);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip);
+	ptu_uint_eq(insn.enabled, 1);
+	ptu_uint_eq(insn.disabled, 0);
+
+	errcode = pt_insn_next(&ifix->decoder, &insn, sizeof(insn));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.ip, ifix_code_ip + 1);
+	ptu_uint_eq(insn.size, 3);
+	ptu_uint_eq(insn.disabled, 1);
+
+	ptu_check(ifix_asid_resume, ifix, skipped);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result asid_sync(struct insn_fixture *ifix,
+				      enum ifix_resume resume)
+{
+	uint64_t skipped;
+
+	ptu_check(ifix_encode_asid, ifix, 1, resume, &skipped);
+	ptu_check(ifix_asid_resume, ifix, skipped);
+
+	return ptu_passed();
+}
+
+/* Encode @nsegments PSB segments that each execute the code once. */
+static struct ptunit_result ifix_encode_segments(struct insn_fixture *ifix,
+						 int nsegments)
+{
+	int errcode;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	while (nsegments--)
+		ptu_check(ifix_encode, ifix);
+
+	ptu_check(ifix_decoder, ifix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_null(struct insn_fixture *ifix)
+{
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	int errcode;
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_insn_sample(NULL, &sample, &config);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_sample(&ifix->decoder, NULL, &config);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample(struct insn_fixture *ifix,
+				   uint32_t stride, uint64_t sampled,
+				   uint64_t error)
+{
+	struct pt_block_profile profile;
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_estimate estimate;
+	int errcode;
+
+	ptu_check(ifix_encode_segments, ifix, 4);
+
+	errcode = pt_block_profile_init(&profile);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_set_block_profile(&ifix->decoder, &profile);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.stride = stride;
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	/* The decoder's profile is not used. */
+	ptu_ptr_eq(ifix->decoder.block_profile, &profile);
+	ptu_uint_eq(profile.nblocks, 0);
+	pt_block_profile_fini(&profile);
+
+	ptu_uint_eq(sample.stats.segments, 4ull);
+	ptu_uint_eq(sample.stats.sampled, sampled);
+	ptu_uint_eq(sample.stats.errors, 0ull);
+	ptu_uint_eq(sample.stats.exhausted, 0ull);
+
+	errcode = pt_block_sample_block(&sample, NULL, ifix_code_ip,
+					&estimate);
+	pt_block_sample_fini(&sample);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(estimate.count, 4ull);
+	ptu_uint_eq(estimate.error, error);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_seed(struct insn_fixture *ifix)
+{
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	uint64_t first;
+	int errcode;
+
+	ptu_check(ifix_encode_segments, ifix, 8);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.stride = 2;
+	config.seed = 1;
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	first = sample.stats.sampled;
+	pt_block_sample_fini(&sample);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_le(first, 8ull);
+
+	/* The same seed selects the same segments. */
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_uint_eq(sample.stats.segments, 8ull);
+	ptu_uint_eq(sample.stats.sampled, first);
+	pt_block_sample_fini(&sample);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_budget(struct insn_fixture *ifix)
+{
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_encoder *encoder;
+	int errcode, tnt;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+	ifix->code[2] = 0x75;
+	ifix->code[3] = 0xfc;
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	encoder = &ifix->encoder;
+
+	/* A single segment that is too long to fit into a tiny budget. */
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+	for (tnt = 0; tnt < 24; ++tnt)
+		pt_encode_tnt_64(encoder, (1ull << 47) - 1ull, 47);
+	pt_encode_tnt_8(encoder, 0, 1);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	ptu_check(ifix_decoder, ifix);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.budget = 1ull;
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	/* The truncated segment is dropped. */
+	ptu_uint_eq(sample.stats.segments, 1ull);
+	ptu_uint_eq(sample.stats.sampled, 0ull);
+	ptu_uint_eq(sample.stats.exhausted, 1ull);
+	ptu_uint_eq(sample.sum.nblocks, 0);
+	ptu_uint_eq(sample.segment.nblocks, 0);
+
+	pt_block_sample_fini(&sample);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_error(struct insn_fixture *ifix)
+{
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_image *image;
+	int errcode;
+
+	ptu_check(ifix_encode_segments, ifix, 2);
+
+	/* The code is not mapped in an empty image. */
+	image = pt_image_alloc(NULL);
+	ptu_ptr(image);
+
+	errcode = pt_insn_set_image(&ifix->decoder, image);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	pt_image_free(image);
+	ptu_uint_eq(sample.stats.segments, 2ull);
+	ptu_uint_eq(sample.stats.sampled, 2ull);
+	ptu_uint_eq(sample.stats.errors, 2ull);
+	pt_block_sample_fini(&sample);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_cache(struct insn_fixture *ifix)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_cache *cache;
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_estimate estimate;
+	uint64_t cr3;
+	int errcode;
+
+	ptu_check(ifix_encode_segments, ifix, 4);
+
+	errcode = pt_insn_set_segment_cache(NULL, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	cache = pt_segment_cache_alloc(1ull << 20);
+	ptu_ptr(cache);
+
+	errcode = pt_insn_set_segment_cache(&ifix->decoder, cache);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	/* The segments are identical.  Only the first one is decoded. */
+	errcode = pt_segment_cache_get_stats(cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 4ull);
+	ptu_uint_eq(stats.hits, 3ull);
+	ptu_uint_eq(stats.segments, 1ull);
+	ptu_uint_eq(stats.flushes, 0ull);
+
+	ptu_uint_eq(sample.stats.sampled, 4ull);
+	ptu_uint_eq(sample.stats.errors, 0ull);
+
+	errcode = pt_block_sample_block(&sample, NULL, ifix_code_ip,
+					&estimate);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(estimate.count, 4ull);
+	ptu_uint_eq(estimate.error, 0ull);
+
+	/* A different address space filter clears the cache. */
+	cr3 = 0xa000ull;
+	errcode = pt_insn_set_asid_filter(&ifix->decoder, &cr3, 1);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_get_stats(cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 8ull);
+	ptu_uint_eq(stats.hits, 6ull);
+	ptu_uint_eq(stats.flushes, 1ull);
+
+	pt_block_sample_fini(&sample);
+
+	errcode = pt_insn_set_segment_cache(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, 0);
+
+	pt_segment_cache_free(cache);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_cache_error(struct insn_fixture *ifix)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_cache *cache;
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_image *image;
+	int errcode;
+
+	ptu_check(ifix_encode_segments, ifix, 2);
+
+	cache = pt_segment_cache_alloc(1ull << 20);
+	ptu_ptr(cache);
+
+	errcode = pt_insn_set_segment_cache(&ifix->decoder, cache);
+	ptu_int_eq(errcode, 0);
+
+	/* The code is not mapped in an empty image. */
+	image = pt_image_alloc(NULL);
+	ptu_ptr(image);
+
+	errcode = pt_insn_set_image(&ifix->decoder, image);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	/* The decode error is remembered. */
+	ptu_uint_eq(sample.stats.errors, 2ull);
+
+	/* A different image clears the cache. */
+	errcode = pt_insn_set_image(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(sample.stats.errors, 2ull);
+	ptu_uint_eq(sample.stats.sampled, 4ull);
+
+	errcode = pt_segment_cache_get_stats(cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 4ull);
+	ptu_uint_eq(stats.hits, 2ull);
+	ptu_uint_eq(stats.flushes, 1ull);
+
+	pt_block_sample_fini(&sample);
+	pt_image_free(image);
+	pt_segment_cache_free(cache);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sample_cache_versions(struct insn_fixture *ifix)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_cache *cache;
+	struct pt_image_record record;
+	struct pt_sample_config config;
+	struct pt_block_sample sample;
+	struct pt_encoder *encoder;
+	uint64_t tsc;
+	int errcode;
+
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	encoder = &ifix->encoder;
+
+	/* Two segments that only differ in their time. */
+	for (tsc = 0x100ull; tsc <= 0x300ull; tsc += 0x200ull) {
+		pt_encode_psb(encoder);
+		pt_encode_tsc(encoder, tsc);
+		pt_encode_mode_exec(encoder, ptem_64bit);
+		pt_encode_psbend(encoder);
+		pt_encode_tip_pge(encoder, ifix_code_ip, pt_ipc_sext_48);
+		pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+	}
+
+	ptu_check(ifix_decoder, ifix);
+
+	/* The code is unmapped between the two segments. */
+	memset(&record, 0, sizeof(record));
+	record.tsc = 0x200ull;
+	record.type = ptir_remove;
+	record.size = sizeof(ifix->code);
+	record.vaddr = ifix_code_ip;
+
+	errcode = pt_image_apply(pt_insn_get_image(&ifix->decoder), &record);
+	ptu_int_eq(errcode, 0);
+
+	cache = pt_segment_cache_alloc(1ull << 20);
+	ptu_ptr(cache);
+
+	errcode = pt_insn_set_segment_cache(&ifix->decoder, cache);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_block_sample_init(&sample);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_sample(&ifix->decoder, &sample, &config);
+	ptu_int_eq(errcode, 0);
+
+	/* The second segment is decoded using the second version. */
+	ptu_uint_eq(sample.stats.sampled, 2ull);
+	ptu_uint_eq(sample.stats.errors, 1ull);
+
+	errcode = pt_segment_cache_get_stats(cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 0ull);
+	ptu_uint_eq(stats.segments, 0ull);
+
+	pt_block_sample_fini(&sample);
+
+	errcode = pt_insn_set_segment_cache(&ifix->decoder, NULL);
+	ptu_int_eq(errcode, 0);
+
+	pt_segment_cache_free(cache);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ifix_init(struct insn_fixture *ifix)
+{
+	int errcode;
+
+	memset(ifix->buffer, 0, sizeof(ifix->buffer));
+	memset(ifix->code, 0x90, sizeof(ifix->code));
+	ifix->code[4] = 0xff;
+	ifix->code[5] = 0xe0;
+
+	memset(&ifix->config, 0, sizeof(ifix->config));
+	ifix->config.size = sizeof(ifix->config);
+	ifix->config.begin = ifix->buffer;
+	ifix->config.end = ifix->buffer + sizeof(ifix->buffer);
+
+	errcode = pt_encoder_init(&ifix->encoder, &ifix->config);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(ifix_encode, ifix);
+	ptu_check(ifix_decoder, ifix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ifix_fini(struct insn_fixture *ifix)
+{
+	pt_insn_decoder_fini(&ifix->decoder);
+	pt_encoder_fini(&ifix->encoder);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct insn_fixture ifix;
+	struct ptunit_suite suite;
+
+	ifix.init = ifix_init;
+	ifix.fini = ifix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, bytes_mode_null, ifix);
+	ptu_run_fp(suite, bytes_mode, ifix, ptib_copy);
+	ptu_run_fp(suite, bytes_mode, ifix, ptib_ref);
+	ptu_run_fp(suite, bytes_mode, ifix, ptib_none);
+
+	ptu_run_f(suite, next_null, ifix);
+	ptu_run_f(suite, next, ifix);
+	ptu_run_f(suite, next_small, ifix);
+
+	ptu_run_f(suite, batch_null, ifix);
+	ptu_run_f(suite, batch, ifix);
+	ptu_run_f(suite, batch_rows, ifix);
+	ptu_run_f(suite, batch_no_events, ifix);
+	ptu_run_f(suite, batch_raw, ifix);
+
+	ptu_run_f(suite, resilient_null, ifix);
+	ptu_run_f(suite, resilient_no_gap, ifix);
+	ptu_run_f(suite, resilient_off, ifix);
+	ptu_run_f(suite, resilient, ifix);
+	ptu_run_f(suite, resilient_eos, ifix);
+	ptu_run_f(suite, resilient_merge, ifix);
+	ptu_run_f(suite, resilient_batch, ifix);
+
+	ptu_run(suite, block_profile_null);
+	ptu_run_f(suite, block_profile, ifix);
+	ptu_run_f(suite, block_profile_gap, ifix);
+
+	ptu_run_f(suite, coverage_null, ifix);
+	ptu_run_f(suite, coverage, ifix);
+	ptu_run_f(suite, coverage_loop, ifix);
+	ptu_run_f(suite, coverage_saturate, ifix);
+	ptu_run_f(suite, coverage_gap, ifix);
+
+	ptu_run_f(suite, breakpoint_null, ifix);
+	ptu_run_f(suite, breakpoint_set, ifix);
+	ptu_run_f(suite, breakpoint_loop, ifix);
+	ptu_run_f(suite, breakpoint_none, ifix);
+	ptu_run_f(suite, breakpoint_gap, ifix);
+
+	ptu_run_f(suite, filter_null, ifix);
+	ptu_run_fp(suite, filter, ifix, 0);
+	ptu_run_fp(suite, filter, ifix, 1);
+	ptu_run_f(suite, filter_events, ifix);
+	ptu_run_f(suite, filter_off, ifix);
+	ptu_run_f(suite, filter_replace, ifix);
+	ptu_run_f(suite, filter_versioned, ifix);
+
+	ptu_run_f(suite, asid_null, ifix);
+	ptu_run_fp(suite, asid, ifix, ifix_resume_tip);
+	ptu_run_fp(suite, asid, ifix, ifix_resume_pge);
+	ptu_run_fp(suite, asid, ifix, ifix_resume_psb);
+	ptu_run_fp(suite, asid_sync, ifix, ifix_resume_tip);
+	ptu_run_fp(suite, asid_sync, ifix, ifix_resume_pge);
+	ptu_run_fp(suite, asid_sync, ifix, ifix_resume_psb);
+
+	ptu_run_f(suite, sample_null, ifix);
+	ptu_run_fp(suite, sample, ifix, 0, 4ull, 0ull);
+	ptu_run_fp(suite, sample, ifix, 1, 4ull, 0ull);
+	ptu_run_fp(suite, sample, ifix, 2, 2ull, 0ull);
+	ptu_run_fp(suite, sample, ifix, 4, 1ull, UINT64_MAX);
+	ptu_run_f(suite, sample_seed, ifix);
+	ptu_run_f(suite, sample_budget, ifix);
+	ptu_run_f(suite, sample_error, ifix);
+	ptu_run_f(suite, sample_cache, ifix);
+	ptu_run_f(suite, sample_cache_error, ifix);
+	ptu_run_f(suite, sample_cache_versions, ifix);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_threads.h"
+
+#include "pt_insn_merge.h"
+#include "pt_encoder.h"
+#include "pt_atomic.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* The address at which the test code is mapped. */
+static const uint64_t mfix_code_ip = 0x1000ull;
+
+/* The number of processors in the test fixture. */
+enum {
+	mfix_ncpus	= 2
+};
+
+/* A test fixture providing one trace per processor and a merge. */
+struct merge_fixture {
+	/* The trace buffers. */
+	uint8_t buffer[mfix_ncpus][1024];
+
+	/* The code - four nops followed by jmp *%rax. */
+	uint8_t code[0x40];
+
+	/* The image containing @code. */
+	struct pt_image *image;
+
+	/* The configurations describing @buffer. */
+	struct pt_config config[mfix_ncpus];
+
+	/* The encoders writing to @buffer. */
+	struct pt_encoder encoder[mfix_ncpus];
+
+	/* The merge. */
+	struct pt_insn_merge merge;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct merge_fixture *);
+	struct ptunit_result (*fini)(struct merge_fixture *);
+};
+
+/* Encode a segment at @tsc on @cpu that executes the code once. */
+static struct ptunit_result mfix_encode(struct merge_fixture *mfix,
+					uint32_t cpu, uint64_t tsc)
+{
+	struct pt_encoder *encoder;
+
+	encoder = &mfix->encoder[cpu];
+
+	pt_encode_psb(encoder);
+	pt_encode_tsc(encoder, tsc);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, mfix_code_ip, pt_ipc_sext_48);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	return ptu_passed();
+}
+
+/* Add all processors to the merge using @image. */
+static struct ptunit_result mfix_add(struct merge_fixture *mfix,
+				     struct pt_image *image)
+{
+	uint32_t cpu;
+
+	for (cpu = 0; cpu < mfix_ncpus; ++cpu) {
+		int index;
+
+		mfix->config[cpu].end = mfix->encoder[cpu].pos;
+
+		index = pt_insn_merge_add(&mfix->merge, &mfix->config[cpu],
+					  image, 0x10 + cpu);
+		ptu_int_eq(index, (int) cpu);
+	}
+
+	return ptu_passed();
+}
+
+/* Check the next instruction. */
+static struct ptunit_result mfix_next(struct merge_fixture *mfix,
+				      uint32_t cpu, uint64_t ip, uint64_t tsc)
+{
+	struct pt_merge_insn insn;
+	int errcode;
+
+	errcode = pt_insn_merge_next(&mfix->merge, &insn);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.cpu, cpu);
+	ptu_uint_eq(insn.insn.ip, ip);
+	ptu_uint_eq(insn.tsc, tsc);
+
+	return ptu_passed();
+}
+
+/* Check the execution of the code on @cpu at @tsc. */
+static struct ptunit_result mfix_next_code(struct merge_fixture *mfix,
+					   uint32_t cpu, uint64_t tsc)
+{
+	uint64_t ip;
+
+	for (ip = mfix_code_ip; ip <= mfix_code_ip + 4; ++ip)
+		ptu_test(mfix_next, mfix, cpu, ip, tsc);
+
+	return ptu_passed();
+}
+
+/* Check that all traces have ended. */
+static struct ptunit_result mfix_eos(struct merge_fixture *mfix)
+{
+	struct pt_merge_insn insn;
+	int errcode;
+
+	errcode = pt_insn_merge_next(&mfix->merge, &insn);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_insn_merge_next(&mfix->merge, &insn);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_insn_merge_init(NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_insn_merge_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result api_null(struct merge_fixture *mfix)
+{
+	struct pt_merge_stats stats;
+	struct pt_merge_insn insn;
+	int errcode;
+
+	errcode = pt_insn_merge_add(NULL, &mfix->config[0], NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_add(&mfix->merge, NULL, NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	ptu_null(pt_insn_merge_decoder(NULL, 0));
+	ptu_null(pt_insn_merge_decoder(&mfix->merge, 0));
+
+	errcode = pt_insn_merge_fill(NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_next(NULL, &insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_next(&mfix->merge, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_get_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct merge_fixture *mfix)
+{
+	ptu_test(mfix_eos, mfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct merge_fixture *mfix)
+{
+	struct pt_merge_insn insn;
+	int errcode;
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 1, 0x200ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	ptu_ptr(pt_insn_merge_decoder(&mfix->merge, 1));
+	ptu_null(pt_insn_merge_decoder(&mfix->merge, 2));
+
+	errcode = pt_insn_merge_next(&mfix->merge, &insn);
+	ptu_int_eq(errcode, 0);
+
+	/* Processors can't be added after merging started. */
+	errcode = pt_insn_merge_add(&mfix->merge, &mfix->config[0], NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge(struct merge_fixture *mfix,
+				  uint32_t lookahead)
+{
+	struct pt_merge_stats stats;
+	int errcode;
+
+	pt_insn_merge_fini(&mfix->merge);
+
+	errcode = pt_insn_merge_init(&mfix->merge, lookahead);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 0, 0x300ull);
+	ptu_test(mfix_encode, mfix, 0, 0x500ull);
+	ptu_test(mfix_encode, mfix, 1, 0x200ull);
+	ptu_test(mfix_encode, mfix, 1, 0x400ull);
+	ptu_test(mfix_encode, mfix, 1, 0x600ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	/* The decoder reads ahead to the next segment's time stamp once
+	 * tracing is disabled.
+	 */
+	ptu_test(mfix_next_code, mfix, 0x10, 0x300ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x400ull);
+	ptu_test(mfix_next_code, mfix, 0x10, 0x500ull);
+	ptu_test(mfix_next_code, mfix, 0x10, 0x500ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x600ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x600ull);
+	ptu_test(mfix_eos, mfix);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.insns, 30ull);
+	ptu_uint_eq(stats.errors, 0ull);
+	ptu_uint_eq(stats.fills, stats.stalls);
+	ptu_uint_ge(stats.fills, (30ull / lookahead) + mfix_ncpus);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_ties(struct merge_fixture *mfix)
+{
+	/* Instructions with the same time are ordered by processor. */
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 1, 0x100ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	ptu_test(mfix_next_code, mfix, 0x10, 0x100ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x100ull);
+	ptu_test(mfix_eos, mfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_no_trace(struct merge_fixture *mfix)
+{
+	struct pt_merge_stats stats;
+	int errcode;
+
+	/* The first processor's trace has no synchronization point. */
+	pt_encode_pad(&mfix->encoder[0]);
+	ptu_test(mfix_encode, mfix, 1, 0x100ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	ptu_test(mfix_next_code, mfix, 0x11, 0x100ull);
+	ptu_test(mfix_eos, mfix);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.insns, 5ull);
+	ptu_uint_eq(stats.errors, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_error(struct merge_fixture *mfix)
+{
+	struct pt_merge_stats stats;
+	struct pt_insn_decoder *decoder;
+	struct pt_image *image;
+	int errcode;
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 1, 0x200ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	/* The code is not mapped in an empty image. */
+	image = pt_image_alloc(NULL);
+	ptu_ptr(image);
+
+	decoder = pt_insn_merge_decoder(&mfix->merge, 0);
+	ptu_ptr(decoder);
+
+	errcode = pt_insn_set_image(decoder, image);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(mfix_next_code, mfix, 0x11, 0x200ull);
+	ptu_test(mfix_eos, mfix);
+
+	pt_image_free(image);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.insns, 5ull);
+	ptu_uint_eq(stats.errors, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fill(struct merge_fixture *mfix)
+{
+	struct pt_merge_stats stats;
+	int errcode;
+
+	pt_insn_merge_fini(&mfix->merge);
+
+	errcode = pt_insn_merge_init(&mfix->merge, 4);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 1, 0x200ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 0);
+	ptu_int_eq(errcode, 4);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 1);
+	ptu_int_eq(errcode, 4);
+
+	/* The free buffer has already been decoded. */
+	errcode = pt_insn_merge_fill(&mfix->merge, 0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 2);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* Merging starts with the decoded buffers.  We decode ahead while
+	 * the merge is reading from them.
+	 */
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip, 0x100ull);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 0);
+	ptu_int_eq(errcode, 1);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 1);
+	ptu_int_eq(errcode, 1);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.fills, 4ull);
+	ptu_uint_eq(stats.stalls, 0ull);
+
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 1, 0x100ull);
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 2, 0x100ull);
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 3, 0x100ull);
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 4, 0x100ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x200ull);
+	ptu_test(mfix_eos, mfix);
+
+	/* The end of both traces had to be decoded when needed. */
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.fills, 6ull);
+	ptu_uint_eq(stats.stalls, 2ull);
+
+	errcode = pt_insn_merge_fill(&mfix->merge, 0);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Pretend to finish decoding the first processor's free buffer on another
+ * thread once the second processor's free buffer has been decoded.
+ */
+static int fill_wait_worker(void *arg)
+{
+	struct pt_insn_merge *merge;
+
+	merge = (struct pt_insn_merge *) arg;
+	if (!merge)
+		return -pte_internal;
+
+	while (pt_atomic_load32(&merge->cpus[1].state) != pt_merge_full)
+		;
+
+	pt_atomic_store32(&merge->cpus[0].state, pt_merge_empty);
+
+	return 0;
+}
+
+static struct ptunit_result fill_wait(struct merge_fixture *mfix)
+{
+	struct pt_merge_stats stats;
+	struct ptunit_thread *thread;
+	int errcode;
+
+	pt_insn_merge_fini(&mfix->merge);
+
+	errcode = pt_insn_merge_init(&mfix->merge, 4);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	ptu_test(mfix_encode, mfix, 1, 0x200ull);
+	ptu_test(mfix_add, mfix, mfix->image);
+
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip, 0x100ull);
+
+	/* The first processor's free buffer is busy.  While we wait for it,
+	 * we decode the second processor's free buffer.  Otherwise, we would
+	 * wait forever.
+	 */
+	pt_atomic_store32(&mfix->merge.cpus[0].state, pt_merge_busy);
+
+	thread = ptunit_thread_create(fill_wait_worker, &mfix->merge);
+	ptu_ptr(thread);
+
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 1, 0x100ull);
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 2, 0x100ull);
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 3, 0x100ull);
+
+	errcode = ptunit_thread_join(thread);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(mfix_next, mfix, 0x10, mfix_code_ip + 4, 0x100ull);
+	ptu_test(mfix_next_code, mfix, 0x11, 0x200ull);
+	ptu_test(mfix_eos, mfix);
+
+	errcode = pt_insn_merge_get_stats(&mfix->merge, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.insns, 10ull);
+	ptu_uint_eq(stats.fills, 6ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(struct merge_fixture *mfix)
+{
+	struct pt_insn_merge *merge;
+	struct pt_merge_insn insn;
+	int errcode;
+
+	ptu_test(mfix_encode, mfix, 0, 0x100ull);
+	mfix->config[0].end = mfix->encoder[0].pos;
+
+	merge = pt_insn_merge_alloc(0);
+	ptu_ptr(merge);
+
+	errcode = pt_insn_merge_add(merge, &mfix->config[0], mfix->image, 0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_insn_merge_next(merge, &insn);
+	pt_insn_merge_free(merge);
+	pt_insn_merge_free(NULL);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(insn.insn.ip, mfix_code_ip);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_init(struct merge_fixture *mfix)
+{
+	uint32_t cpu;
+	int errcode;
+
+	memset(mfix->code, 0x90, sizeof(mfix->code));
+	mfix->code[4] = 0xff;
+	mfix->code[5] = 0xe0;
+
+	mfix->image = pt_image_alloc(NULL);
+	ptu_ptr(mfix->image);
+
+	errcode = pt_image_add_buffer(mfix->image, mfix->code,
+				      sizeof(mfix->code), NULL, mfix_code_ip,
+				      0, NULL, NULL);
+	ptu_int_eq(errcode, 0);
+
+	for (cpu = 0; cpu < mfix_ncpus; ++cpu) {
+		struct pt_config *config;
+
+		memset(mfix->buffer[cpu], 0, sizeof(mfix->buffer[cpu]));
+
+		config = &mfix->config[cpu];
+		memset(config, 0, sizeof(*config));
+		config->size = sizeof(*config);
+		config->begin = mfix->buffer[cpu];
+		config->end = mfix->buffer[cpu] + sizeof(mfix->buffer[cpu]);
+
+		errcode = pt_encoder_init(&mfix->encoder[cpu], config);
+		ptu_int_eq(errcode, 0);
+	}
+
+	errcode = pt_insn_merge_init(&mfix->merge, 2);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_fini(struct merge_fixture *mfix)
+{
+	uint32_t cpu;
+
+	pt_insn_merge_fini(&mfix->merge);
+
+	for (cpu = 0; cpu < mfix_ncpus; ++cpu)
+		pt_encoder_fini(&mfix->encoder[cpu]);
+
+	pt_image_free(mfix->image);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct merge_fixture mfix;
+	struct ptunit_suite suite;
+
+	mfix.init = mfix_init;
+	mfix.fini = mfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run_f(suite, api_null, mfix);
+
+	ptu_run_f(suite, empty, mfix);
+	ptu_run_f(suite, add, mfix);
+	ptu_run_fp(suite, merge, mfix, 1);
+	ptu_run_fp(suite, merge, mfix, 2);
+	ptu_run_fp(suite, merge, mfix, 5);
+	ptu_run_fp(suite, merge, mfix, 64);
+	ptu_run_f(suite, merge_ties, mfix);
+	ptu_run_f(suite, merge_no_trace, mfix);
+	ptu_run_f(suite, merge_error, mfix);
+	ptu_run_f(suite, fill, mfix);
+	ptu_run_f(suite, fill_wait, mfix);
+	ptu_run_f(suite, alloc, mfix);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
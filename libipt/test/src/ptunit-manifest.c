@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_manifest.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test section. */
+struct pt_section {
+	/* The contents. */
+	const uint8_t *content;
+
+	/* The size of @content. */
+	uint64_t size;
+};
+
+int pt_section_read(const struct pt_section *section, uint8_t *buffer,
+		    uint16_t size, uint64_t offset)
+{
+	if (!section || !buffer)
+		return -pte_invalid;
+
+	if (section->size <= offset)
+		return -pte_nomap;
+
+	if (section->size - offset < size)
+		size = (uint16_t) (section->size - offset);
+
+	memcpy(buffer, &section->content[offset], size);
+
+	return size;
+}
+
+/* A test fixture providing a manifest and a temporary file. */
+struct manifest_fixture {
+	/* The manifest. */
+	struct pt_manifest manifest;
+
+	/* The temporary file. */
+	FILE *file;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct manifest_fixture *);
+	struct ptunit_result (*fini)(struct manifest_fixture *);
+};
+
+static struct ptunit_result add_file_null(struct manifest_fixture *mfix)
+{
+	int errcode;
+
+	errcode = pt_manifest_add_file(NULL, "file");
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_add_file(&mfix->manifest, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_file(struct manifest_fixture *mfix)
+{
+	int index;
+
+	index = pt_manifest_add_file(&mfix->manifest, "file-0");
+	ptu_int_eq(index, 0);
+
+	index = pt_manifest_add_file(&mfix->manifest, "file-1");
+	ptu_int_eq(index, 1);
+
+	index = pt_manifest_add_file(&mfix->manifest, "file-0");
+	ptu_int_eq(index, 0);
+
+	ptu_uint_eq(mfix->manifest.nfiles, 2);
+	ptu_str_eq(mfix->manifest.files[0].name, "file-0");
+	ptu_str_eq(mfix->manifest.files[1].name, "file-1");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_section_bad_file(struct manifest_fixture *mfix)
+{
+	struct pt_manifest_section section;
+	int errcode;
+
+	memset(&section, 0, sizeof(section));
+
+	errcode = pt_manifest_add_section(NULL, &section);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_add_section(&mfix->manifest, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_add_section(&mfix->manifest, &section);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_read(struct manifest_fixture *mfix)
+{
+	struct pt_manifest_section section;
+	struct pt_manifest copy;
+	uint32_t index;
+	int errcode;
+
+	for (index = 0; index < 20; ++index) {
+		errcode = pt_manifest_add_file(&mfix->manifest,
+					       (index & 1) ? "/b" : "/a/b");
+		ptu_int_ge(errcode, 0);
+
+		section.file = (uint32_t) errcode;
+		section.offset = 0x1000ull * index;
+		section.size = 0x100ull + index;
+		section.vaddr = 0xffffffff80000000ull + index;
+		section.cr3 = (index & 2) ? pt_asid_no_cr3 : 0x4200ull;
+		section.vmcs = (index & 4) ? pt_asid_no_vmcs : 0x23000ull;
+		section.hash = 0x0123456789abcdefull ^ index;
+
+		errcode = pt_manifest_add_section(&mfix->manifest, &section);
+		ptu_int_eq(errcode, 0);
+	}
+
+	mfix->manifest.files[0].size = 0x1234ull;
+	mfix->manifest.files[0].mtime = 0x56789abcull;
+
+	errcode = pt_manifest_write(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, 0);
+
+	rewind(mfix->file);
+
+	pt_manifest_init(&copy);
+
+	errcode = pt_manifest_read(&copy, mfix->file);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(copy.nfiles, 2);
+	ptu_str_eq(copy.files[0].name, "/a/b");
+	ptu_uint_eq(copy.files[0].size, 0x1234ull);
+	ptu_uint_eq(copy.files[0].mtime, 0x56789abcull);
+	ptu_str_eq(copy.files[1].name, "/b");
+	ptu_uint_eq(copy.files[1].size, 0ull);
+	ptu_uint_eq(copy.files[1].mtime, 0ull);
+
+	ptu_uint_eq(copy.nsections, 20);
+	for (index = 0; index < copy.nsections; ++index) {
+		const struct pt_manifest_section *lhs, *rhs;
+
+		lhs = &copy.sections[index];
+		rhs = &mfix->manifest.sections[index];
+
+		ptu_uint_eq(lhs->file, rhs->file);
+		ptu_uint_eq(lhs->offset, rhs->offset);
+		ptu_uint_eq(lhs->size, rhs->size);
+		ptu_uint_eq(lhs->vaddr, rhs->vaddr);
+		ptu_uint_eq(lhs->cr3, rhs->cr3);
+		ptu_uint_eq(lhs->vmcs, rhs->vmcs);
+		ptu_uint_eq(lhs->hash, rhs->hash);
+	}
+
+	pt_manifest_fini(&copy);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_null(struct manifest_fixture *mfix)
+{
+	int errcode;
+
+	errcode = pt_manifest_read(NULL, mfix->file);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_read(&mfix->manifest, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_write(NULL, mfix->file);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_write(&mfix->manifest, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_empty(struct manifest_fixture *mfix)
+{
+	int errcode;
+
+	errcode = pt_manifest_read(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+/* Write a manifest with one file and one section and modify byte @index. */
+static struct ptunit_result read_bad(struct manifest_fixture *mfix,
+				     long index, uint8_t byte)
+{
+	struct pt_manifest_section section;
+	int errcode;
+
+	errcode = pt_manifest_add_file(&mfix->manifest, "file");
+	ptu_int_eq(errcode, 0);
+
+	memset(&section, 0, sizeof(section));
+
+	errcode = pt_manifest_add_section(&mfix->manifest, &section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_manifest_write(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, 0);
+
+	pt_manifest_fini(&mfix->manifest);
+
+	errcode = fseek(mfix->file, index, SEEK_SET);
+	ptu_int_eq(errcode, 0);
+
+	errcode = fputc(byte, mfix->file);
+	ptu_int_eq(errcode, byte);
+
+	rewind(mfix->file);
+
+	errcode = pt_manifest_read(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, -pte_invalid);
+	ptu_uint_eq(mfix->manifest.nfiles, 0);
+	ptu_uint_eq(mfix->manifest.nsections, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_truncated(struct manifest_fixture *mfix)
+{
+	struct pt_manifest_section section;
+	uint8_t buffer[0x80];
+	size_t size;
+	int errcode;
+
+	errcode = pt_manifest_add_file(&mfix->manifest, "file");
+	ptu_int_eq(errcode, 0);
+
+	memset(&section, 0, sizeof(section));
+
+	errcode = pt_manifest_add_section(&mfix->manifest, &section);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_manifest_write(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, 0);
+
+	pt_manifest_fini(&mfix->manifest);
+
+	/* Copy all but the last byte into a new file. */
+	rewind(mfix->file);
+
+	size = fread(buffer, 1, sizeof(buffer), mfix->file);
+	ptu_uint_gt(size, 1);
+
+	fclose(mfix->file);
+	mfix->file = tmpfile();
+	ptu_ptr(mfix->file);
+
+	size = fwrite(buffer, 1, size - 1, mfix->file);
+	ptu_uint_gt(size, 0);
+
+	rewind(mfix->file);
+
+	errcode = pt_manifest_read(&mfix->manifest, mfix->file);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_unchanged(struct manifest_fixture *mfix)
+{
+	FILE *file;
+	char *name;
+	int errcode;
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	file = fopen(name, "wb");
+	ptu_ptr(file);
+
+	errcode = fputc(0xcc, file);
+	ptu_int_eq(errcode, 0xcc);
+
+	errcode = fclose(file);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_manifest_add_file(&mfix->manifest, name);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(mfix->manifest.files[0].size, 1ull);
+
+	errcode = pt_manifest_file_unchanged(&mfix->manifest.files[0]);
+	ptu_int_gt(errcode, 0);
+
+	file = fopen(name, "ab");
+	ptu_ptr(file);
+
+	errcode = fputc(0xcc, file);
+	ptu_int_eq(errcode, 0xcc);
+
+	errcode = fclose(file);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_manifest_file_unchanged(&mfix->manifest.files[0]);
+	ptu_int_eq(errcode, 0);
+
+	remove(name);
+	free(name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_unknown(struct manifest_fixture *mfix)
+{
+	int errcode;
+
+	errcode = pt_manifest_file_unchanged(NULL);
+	ptu_int_eq(errcode, 0);
+
+	/* We do not know the identity of a file that does not exist. */
+	errcode = pt_manifest_add_file(&mfix->manifest, "/no/such/file");
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(mfix->manifest.files[0].size, 0ull);
+	ptu_uint_eq(mfix->manifest.files[0].mtime, 0ull);
+
+	errcode = pt_manifest_file_unchanged(&mfix->manifest.files[0]);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result hash_null(void)
+{
+	struct pt_section section;
+	uint64_t hash;
+	int errcode;
+
+	memset(&section, 0, sizeof(section));
+
+	errcode = pt_manifest_hash(NULL, &section, 0ull, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_manifest_hash(&hash, NULL, 0ull, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result hash(void)
+{
+	struct pt_section section;
+	uint8_t content[] = { 'x', 'a', 'y' };
+	uint64_t hash;
+	int errcode;
+
+	section.content = content;
+	section.size = sizeof(content);
+
+	errcode = pt_manifest_hash(&hash, &section, 0ull, 0ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(hash, 0xcbf29ce484222325ull);
+
+	errcode = pt_manifest_hash(&hash, &section, 1ull, 1ull);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(hash, 0xaf63dc4c8601ec8cull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result hash_chunks(void)
+{
+	struct pt_section section;
+	uint8_t content[0x2345];
+	uint64_t hash, expected;
+	size_t index;
+	int errcode;
+
+	expected = 0xcbf29ce484222325ull;
+	for (index = 0; index < sizeof(content); ++index) {
+		content[index] = (uint8_t) (index * 7);
+
+		expected ^= content[index];
+		expected *= 0x100000001b3ull;
+	}
+
+	section.content = content;
+	section.size = sizeof(content);
+
+	errcode = pt_manifest_hash(&hash, &section, 0ull, sizeof(content));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(hash, expected);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result hash_nomap(void)
+{
+	struct pt_section section;
+	uint8_t content[] = { 'x', 'a', 'y' };
+	uint64_t hash;
+	int errcode;
+
+	section.content = content;
+	section.size = sizeof(content);
+
+	errcode = pt_manifest_hash(&hash, &section, 1ull, 3ull);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	errcode = pt_manifest_hash(&hash, &section, 3ull, 1ull);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_init(struct manifest_fixture *mfix)
+{
+	pt_manifest_init(&mfix->manifest);
+
+	mfix->file = tmpfile();
+	ptu_ptr(mfix->file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_fini(struct manifest_fixture *mfix)
+{
+	pt_manifest_fini(&mfix->manifest);
+
+	if (mfix->file) {
+		fclose(mfix->file);
+		mfix->file = NULL;
+	}
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct manifest_fixture mfix;
+	struct ptunit_suite suite;
+
+	mfix.init = mfix_init;
+	mfix.fini = mfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, add_file_null, mfix);
+	ptu_run_f(suite, add_file, mfix);
+	ptu_run_f(suite, add_section_bad_file, mfix);
+
+	ptu_run_f(suite, write_read, mfix);
+	ptu_run_f(suite, read_null, mfix);
+	ptu_run_f(suite, read_empty, mfix);
+	ptu_run_fp(suite, read_bad, mfix, 0l, 'P');
+	ptu_run_fp(suite, read_bad, mfix, 8l, 1);
+	ptu_run_fp(suite, read_bad, mfix, 12l, 0);
+	ptu_run_fp(suite, read_bad, mfix, 24l, 0);
+	ptu_run_fp(suite, read_bad, mfix, 29l, 0);
+	ptu_run_fp(suite, read_bad, mfix, 48l, 1);
+	ptu_run_fp(suite, read_bad, mfix, 15l, 0x7f);
+	ptu_run_fp(suite, read_bad, mfix, 19l, 0x7f);
+	ptu_run_fp(suite, read_bad, mfix, 15l, 0xff);
+	ptu_run_fp(suite, read_bad, mfix, 19l, 0xff);
+	ptu_run_f(suite, read_truncated, mfix);
+
+	ptu_run_f(suite, file_unchanged, mfix);
+	ptu_run_f(suite, file_unknown, mfix);
+
+	ptu_run(suite, hash_null);
+	ptu_run(suite, hash);
+	ptu_run(suite, hash_chunks);
+	ptu_run(suite, hash_nomap);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -75,6 +75,23 @@ int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 	return size;
 }
 
+int pt_section_peek(const struct pt_section *section, const uint8_t **begin,
+		    uint16_t size, uint64_t offset)
+{
+	if (!section || !begin)
+		return -pte_invalid;
+
+	if (section->size <= offset)
+		return -pte_nomap;
+
+	if (section->size - offset < size)
+		size = (uint16_t) (section->size - offset);
+
+	*begin = &section->content[offset];
+
+	return size;
+}
+
 /* A test fixture providing a test sections. */
 struct section_fixture {
 	/* The test section. */
@@ -130,7 +147,7 @@ static struct ptunit_result end_bad(void)
 	struct pt_mapped_section msec;
 	uint64_t end;
 
-	pt_msec_init(&msec, NULL, NULL, 0x1000);
+	pt_msec_init(&msec, NULL, NULL, 0x1000, 0ull, 0ull);
 
 	end = pt_msec_end(&msec);
 	ptu_uint_eq(end, 0ull);
@@ -177,7 +194,7 @@ static struct ptunit_result asid(void)
 	pt_asid_init(&asid);
 	asid.cr3 = 0xa00;
 
-	pt_msec_init(&msec, NULL, &asid, 0ull);
+	pt_msec_init(&msec, NULL, &asid, 0ull, 0ull, 0ull);
 
 	pasid = pt_msec_asid(&msec);
 	ptu_uint_eq(pasid->size, asid.size);
@@ -246,6 +263,44 @@ static struct ptunit_result read_truncated(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result window(struct section_fixture *sfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	uint64_t end;
+	int status;
+
+	pt_msec_init(&sfix->msec, &sfix->section, &sfix->asid, sfix->vaddr,
+		     0x4ull, 0x2ull);
+
+	end = pt_msec_end(&sfix->msec);
+	ptu_uint_eq(end, sfix->vaddr + 0x2ull);
+
+	status = pt_msec_read(&sfix->msec, buffer, 3, &sfix->asid,
+			      sfix->vaddr);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], sfix->section.content[4]);
+	ptu_uint_eq(buffer[1], sfix->section.content[5]);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result window_nomem(struct section_fixture *sfix)
+{
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	pt_msec_init(&sfix->msec, &sfix->section, &sfix->asid, sfix->vaddr,
+		     0x4ull, 0x2ull);
+
+	status = pt_msec_read(&sfix->msec, buffer, 1, &sfix->asid,
+			      sfix->vaddr + 0x2ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read_nomem_vaddr(struct section_fixture *sfix)
 {
 	uint8_t buffer[] = { 0xcc };
@@ -275,6 +330,60 @@ static struct ptunit_result read_nomem_asid(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result peek(struct section_fixture *sfix)
+{
+	const uint8_t *begin;
+	int status;
+
+	status = pt_msec_peek(&sfix->msec, &begin, 2, &sfix->asid,
+			      sfix->vaddr + 3);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, &sfix->section.content[3]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_truncated(struct section_fixture *sfix)
+{
+	const uint8_t *begin;
+	int status;
+
+	pt_msec_init(&sfix->msec, &sfix->section, &sfix->asid, sfix->vaddr,
+		     0x4ull, 0x2ull);
+
+	status = pt_msec_peek(&sfix->msec, &begin, 3, &sfix->asid,
+			      sfix->vaddr + 1);
+	ptu_int_eq(status, 1);
+	ptu_ptr_eq(begin, &sfix->section.content[5]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_nomem(struct section_fixture *sfix)
+{
+	const uint8_t *begin;
+	struct pt_asid asid;
+	int status;
+
+	begin = NULL;
+
+	status = pt_msec_peek(&sfix->msec, &begin, 1, &sfix->asid,
+			      sfix->vaddr + sfix->section.size);
+	ptu_int_eq(status, -pte_nomap);
+
+	pt_asid_init(&asid);
+	asid.cr3 = 0xcece00ull;
+
+	status = pt_msec_peek(&sfix->msec, &begin, 1, &asid, sfix->vaddr);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_null(begin);
+
+	status = pt_msec_peek(&sfix->msec, &begin, 1, NULL, sfix->vaddr);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result sfix_init(struct section_fixture *sfix)
 {
 	uint8_t i;
@@ -288,7 +397,8 @@ static struct ptunit_result sfix_init(struct section_fixture *sfix)
 	pt_asid_init(&sfix->asid);
 	sfix->asid.cr3 = 0x4200ull;
 
-	pt_msec_init(&sfix->msec, &sfix->section, &sfix->asid, sfix->vaddr);
+	pt_msec_init(&sfix->msec, &sfix->section, &sfix->asid, sfix->vaddr,
+		     0ull, sfix->section.size);
 
 	return ptu_passed();
 }
@@ -328,6 +438,11 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_truncated, sfix);
 	ptu_run_f(suite, read_nomem_vaddr, sfix);
 	ptu_run_f(suite, read_nomem_asid, sfix);
+	ptu_run_f(suite, window, sfix);
+	ptu_run_f(suite, window_nomem, sfix);
+	ptu_run_f(suite, peek, sfix);
+	ptu_run_f(suite, peek_truncated, sfix);
+	ptu_run_f(suite, peek_nomem, sfix);
 
 	ptunit_report(&suite);
 	return suite.nr_fails;
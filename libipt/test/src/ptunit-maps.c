@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_maps.h"
+#include "pt_image.h"
+#include "pt_section.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test section.
+ *
+ * Each byte of a test file contains the low byte of its offset.
+ */
+struct pt_section {
+	/* The file name. */
+	const char *name;
+
+	/* The size of the file. */
+	uint64_t size;
+
+	/* The number of users. */
+	uint16_t ucount;
+
+	/* The number of times the file was opened. */
+	int opened;
+};
+
+/* The test files. */
+static struct pt_section files[] = {
+	{ "/lib/libfoo.so", 0x3000ull, 0, 0 },
+	{ "/usr/bin/bar", 0x1800ull, 0, 0 },
+	{ "/tmp/a file", 0x1000ull, 0, 0 }
+};
+
+enum {
+	nfiles = sizeof(files) / sizeof(files[0])
+};
+
+struct pt_section *pt_mk_section(const char *file, uint64_t offset,
+				 uint64_t size)
+{
+	int index;
+
+	if (!file || offset || size != UINT64_MAX)
+		return NULL;
+
+	for (index = 0; index < nfiles; ++index) {
+		struct pt_section *section;
+
+		section = &files[index];
+		if (strcmp(section->name, file) != 0)
+			continue;
+
+		section->ucount += 1;
+		section->opened += 1;
+
+		return section;
+	}
+
+	return NULL;
+}
+
+struct pt_section *pt_mk_section_buffer(const uint8_t *buffer,
+					uint64_t size, uint32_t generation)
+{
+	/* This function is not used by our tests. */
+	return NULL;
+}
+
+void pt_section_free(struct pt_section *section)
+{
+	(void) section;
+}
+
+int pt_section_get(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	section->ucount += 1;
+
+	return 0;
+}
+
+int pt_section_put(struct pt_section *section)
+{
+	if (!section || !section->ucount)
+		return -pte_internal;
+
+	section->ucount -= 1;
+
+	return 0;
+}
+
+int pt_section_set_release(struct pt_section *section,
+			   release_memory_callback_t *release, void *context)
+{
+	/* This function is not used by our tests. */
+	return -pte_internal;
+}
+
+const char *pt_section_filename(const struct pt_section *section)
+{
+	if (!section)
+		return NULL;
+
+	return section->name;
+}
+
+uint32_t pt_section_generation(const struct pt_section *section)
+{
+	(void) section;
+
+	return 0;
+}
+
+uint64_t pt_section_offset(const struct pt_section *section)
+{
+	(void) section;
+
+	return 0ull;
+}
+
+uint64_t pt_section_size(const struct pt_section *section)
+{
+	if (!section)
+		return 0ull;
+
+	return section->size;
+}
+
+int pt_section_read(const struct pt_section *section, uint8_t *buffer,
+		    uint16_t size, uint64_t offset)
+{
+	uint16_t index;
+
+	if (!section || !buffer)
+		return -pte_invalid;
+
+	if (section->size <= offset)
+		return -pte_nomap;
+
+	if (section->size - offset < size)
+		size = (uint16_t) (section->size - offset);
+
+	for (index = 0; index < size; ++index)
+		buffer[index] = (uint8_t) (offset + index);
+
+	return size;
+}
+
+int pt_section_peek(const struct pt_section *section, const uint8_t **begin,
+		    uint16_t size, uint64_t offset)
+{
+	(void) size;
+	(void) offset;
+
+	if (!section || !begin)
+		return -pte_invalid;
+
+	return -pte_nomap;
+}
+
+/* A test fixture providing an image and an address space. */
+struct maps_fixture {
+	/* The image. */
+	struct pt_image image;
+
+	/* The address space. */
+	struct pt_asid asid;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct maps_fixture *);
+	struct ptunit_result (*fini)(struct maps_fixture *);
+};
+
+/* Read one byte at @vaddr into @byte. */
+static struct ptunit_result mfix_read(struct maps_fixture *mfix,
+				      uint8_t *byte, uint64_t vaddr)
+{
+	int status;
+
+	status = pt_image_read(&mfix->image, byte, 1, &mfix->asid, vaddr);
+	ptu_int_eq(status, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result parse_null(void)
+{
+	struct pt_maps_entry entry;
+	char line[] = "00400000-00401000 r-xp 00000000 08:01 42 /usr/bin/bar";
+	int errcode;
+
+	errcode = pt_maps_parse_line(NULL, line);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_maps_parse_line(&entry, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result parse(void)
+{
+	struct pt_maps_entry entry;
+	char line[] = "7f00a000-7f00c000 r-xp 0001f000 fd:01 1234567    "
+		"/lib/libfoo.so";
+	int errcode;
+
+	errcode = pt_maps_parse_line(&entry, line);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(entry.begin, 0x7f00a000ull);
+	ptu_uint_eq(entry.end, 0x7f00c000ull);
+	ptu_uint_eq(entry.offset, 0x1f000ull);
+	ptu_uint_eq(entry.perms, pt_maps_read | pt_maps_exec);
+	ptu_str_eq(entry.filename, "/lib/libfoo.so");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result parse_anon(void)
+{
+	struct pt_maps_entry entry;
+	char line[] = "00601000-00602000 rw-s 00000000 00:00 0 \n";
+	int errcode;
+
+	errcode = pt_maps_parse_line(&entry, line);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(entry.begin, 0x601000ull);
+	ptu_uint_eq(entry.end, 0x602000ull);
+	ptu_uint_eq(entry.offset, 0ull);
+	ptu_uint_eq(entry.perms, pt_maps_read | pt_maps_write);
+	ptu_null(entry.filename);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result parse_spaces(void)
+{
+	struct pt_maps_entry entry;
+	char line[] = "ffffffffff600000-ffffffffff601000 --xp 00000000 00:00 0\t"
+		"  /tmp/a file (deleted) \r\n";
+	int errcode;
+
+	errcode = pt_maps_parse_line(&entry, line);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(entry.begin, 0xffffffffff600000ull);
+	ptu_uint_eq(entry.end, 0xffffffffff601000ull);
+	ptu_uint_eq(entry.perms, pt_maps_exec);
+	ptu_str_eq(entry.filename, "/tmp/a file (deleted)");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result parse_bad(const char *text)
+{
+	struct pt_maps_entry entry;
+	char line[128];
+	int errcode;
+
+	ptu_uint_lt(strlen(text), sizeof(line));
+	strcpy(line, text);
+
+	errcode = pt_maps_parse_line(&entry, line);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct maps_fixture *mfix)
+{
+	char text[] = "";
+	int errcode;
+
+	errcode = pt_maps_add(NULL, text, &mfix->asid);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_maps_add(&mfix->image, NULL, &mfix->asid);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_maps_add(&mfix->image, text, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_image_add_maps(NULL, text, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_image_add_maps(&mfix->image, NULL, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_empty(struct maps_fixture *mfix)
+{
+	char text[] = "\n\n";
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, 0);
+	ptu_null(mfix->image.map);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct maps_fixture *mfix)
+{
+	char text[] =
+		"00400000-00401000 r-xp 00000000 08:01 42 /usr/bin/bar\n"
+		"00600000-00601000 rw-p 00000000 08:01 42 /usr/bin/bar\n"
+		"00601000-00602000 rw-p 00000000 00:00 0 [heap]\n"
+		"7f000000-7f001000 r--p 00000000 08:01 7 /lib/libfoo.so\n"
+		"7f001000-7f002000 r-xp 00001000 08:01 7 /lib/libfoo.so\n"
+		"7f002000-7f003000 r-xp 00002000 08:01 7 /lib/libfoo.so\n"
+		"7f100000-7f101000 r-xp 00000000 08:01 9 /lib/libgone.so\n"
+		"7fff0000-7fff2000 r-xp 00000000 00:00 0 [vdso]\n";
+	uint8_t byte;
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, 3);
+
+	ptu_int_eq(files[0].opened, 1);
+	ptu_int_eq(files[1].opened, 1);
+	ptu_int_eq(files[2].opened, 0);
+
+	/* The file references are held by the image's sections. */
+	ptu_uint_eq(files[0].ucount, 2);
+	ptu_uint_eq(files[1].ucount, 1);
+
+	ptu_check(mfix_read, mfix, &byte, 0x400010ull);
+	ptu_uint_eq(byte, 0x10);
+
+	ptu_check(mfix_read, mfix, &byte, 0x7f001020ull);
+	ptu_uint_eq(byte, 0x20);
+
+	ptu_check(mfix_read, mfix, &byte, 0x7f002fffull);
+	ptu_uint_eq(byte, 0xff);
+
+	errcode = pt_image_read(&mfix->image, &byte, 1, &mfix->asid,
+				0x7f000000ull);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	errcode = pt_image_read(&mfix->image, &byte, 1, &mfix->asid,
+				0x600000ull);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_truncated(struct maps_fixture *mfix)
+{
+	char text[] =
+		"00400000-00402000 r-xp 00000000 08:01 42 /usr/bin/bar\n"
+		"00500000-00501000 r-xp 00002000 08:01 42 /usr/bin/bar\n";
+	uint8_t byte;
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, 1);
+	ptu_uint_eq(files[1].ucount, 1);
+
+	ptu_check(mfix_read, mfix, &byte, 0x4017ffull);
+	ptu_uint_eq(byte, 0xff);
+
+	errcode = pt_image_read(&mfix->image, &byte, 1, &mfix->asid,
+				0x401800ull);
+	ptu_int_eq(errcode, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_overlap(struct maps_fixture *mfix)
+{
+	char text[] =
+		"00400000-00402000 r-xp 00000000 08:01 42 /usr/bin/bar\n"
+		"7f000000-7f001000 r-xp 00000000 08:01 7 /lib/libfoo.so\n"
+		"00401000-00402000 r-xp 00000000 08:01 7 /lib/libfoo.so\n";
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, -pte_bad_image);
+	ptu_null(mfix->image.map);
+
+	ptu_uint_eq(files[0].ucount, 0);
+	ptu_uint_eq(files[1].ucount, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_overlap_image(struct maps_fixture *mfix)
+{
+	char first[] =
+		"00400000-00401000 r-xp 00000000 08:01 42 /usr/bin/bar\n"
+		"7f000000-7f001000 r-xp 00000000 08:01 7 /lib/libfoo.so\n";
+	char second[] =
+		"00300000-00301000 r-xp 00000000 08:01 7 /lib/libfoo.so\n"
+		"7f000800-7f001000 r-xp 00000000 08:01 42 /usr/bin/bar\n";
+	char third[] =
+		"00300000-00301000 r-xp 00000000 08:01 7 /lib/libfoo.so\n"
+		"7f001000-7f002000 r-xp 00000000 08:01 42 /usr/bin/bar\n";
+	struct pt_image_map *map;
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, first, &mfix->asid);
+	ptu_int_eq(errcode, 2);
+
+	map = mfix->image.map;
+
+	errcode = pt_maps_add(&mfix->image, second, &mfix->asid);
+	ptu_int_eq(errcode, -pte_bad_image);
+	ptu_ptr_eq(mfix->image.map, map);
+	ptu_uint_eq(files[0].ucount, 1);
+	ptu_uint_eq(files[1].ucount, 1);
+
+	errcode = pt_maps_add(&mfix->image, third, &mfix->asid);
+	ptu_int_eq(errcode, 2);
+	ptu_uint_eq(files[0].ucount, 2);
+	ptu_uint_eq(files[1].ucount, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_bad(struct maps_fixture *mfix)
+{
+	char text[] =
+		"00400000-00401000 r-xp 00000000 08:01 42 /usr/bin/bar\n"
+		"garbage\n";
+	int errcode;
+
+	errcode = pt_maps_add(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, -pte_invalid);
+	ptu_null(mfix->image.map);
+	ptu_int_eq(files[1].opened, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_maps(struct maps_fixture *mfix)
+{
+	const char *text =
+		"00400000-00401000 r-xp 00000000 08:01 42 /usr/bin/bar\n";
+	uint8_t byte;
+	int errcode;
+
+	errcode = pt_image_add_maps(&mfix->image, text, &mfix->asid);
+	ptu_int_eq(errcode, 1);
+
+	ptu_check(mfix_read, mfix, &byte, 0x400042ull);
+	ptu_uint_eq(byte, 0x42);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_init(struct maps_fixture *mfix)
+{
+	int index;
+
+	for (index = 0; index < nfiles; ++index) {
+		files[index].ucount = 0;
+		files[index].opened = 0;
+	}
+
+	pt_asid_init(&mfix->asid);
+	mfix->asid.cr3 = 0x4200ull;
+
+	pt_image_init(&mfix->image, NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mfix_fini(struct maps_fixture *mfix)
+{
+	pt_image_fini(&mfix->image);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct maps_fixture mfix;
+	struct ptunit_suite suite;
+
+	mfix.init = mfix_init;
+	mfix.fini = mfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, parse_null);
+	ptu_run(suite, parse);
+	ptu_run(suite, parse_anon);
+	ptu_run(suite, parse_spaces);
+	ptu_run_p(suite, parse_bad, "");
+	ptu_run_p(suite, parse_bad, "00400000 r-xp 00000000 08:01 42");
+	ptu_run_p(suite, parse_bad, "00401000-00400000 r-xp 0 08:01 42");
+	ptu_run_p(suite, parse_bad, "00400000-00401000 rxp 0 08:01 42");
+	ptu_run_p(suite, parse_bad, "00400000-00401000 r-xq 0 08:01 42");
+	ptu_run_p(suite, parse_bad, "00400000-00401000 r-xp 0 0801 42");
+	ptu_run_p(suite, parse_bad, "00400000-00401000 r-xp 0 08:01 x");
+	ptu_run_p(suite, parse_bad, "00400000-00401000 r-xp 0 08:01 42/a");
+	ptu_run_p(suite, parse_bad, "10000000000000000-0 r-xp 0 08:01 42");
+
+	ptu_run_f(suite, add_null, mfix);
+	ptu_run_f(suite, add_empty, mfix);
+	ptu_run_f(suite, add, mfix);
+	ptu_run_f(suite, add_truncated, mfix);
+	ptu_run_f(suite, add_overlap, mfix);
+	ptu_run_f(suite, add_overlap_image, mfix);
+	ptu_run_f(suite, add_bad, mfix);
+	ptu_run_f(suite, add_maps, mfix);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_profile.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test fixture providing a call-tree profile. */
+struct profile_fixture {
+	/* The profile. */
+	struct pt_profile profile;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct profile_fixture *);
+	struct ptunit_result (*fini)(struct profile_fixture *);
+};
+
+/* Initialize @insn as an instruction of class @iclass at @ip. */
+static void mk_insn(struct pt_insn *insn, uint64_t ip, uint8_t size,
+		    enum pt_insn_class iclass)
+{
+	memset(insn, 0, sizeof(*insn));
+
+	insn->ip = ip;
+	insn->size = size;
+	insn->iclass = iclass;
+	insn->mode = ptem_64bit;
+}
+
+/* Add an instruction of class @iclass at @ip. */
+static struct ptunit_result pfix_add(struct profile_fixture *pfix,
+				     uint64_t ip, uint8_t size,
+				     enum pt_insn_class iclass)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, ip, size, iclass);
+
+	errcode = pt_profile_add_insn(&pfix->profile, &insn);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Check the node at @index. */
+static struct ptunit_result pfix_node(struct profile_fixture *pfix,
+				      uint32_t index, uint64_t entry,
+				      uint32_t parent, uint64_t self,
+				      uint64_t total)
+{
+	struct pt_profile_node node;
+	int errcode;
+
+	errcode = pt_profile_get_node(&pfix->profile, index, &node);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(node.entry, entry);
+	ptu_uint_eq(node.parent, parent);
+	ptu_uint_eq(node.self, self);
+	ptu_uint_eq(node.total, total);
+
+	return ptu_passed();
+}
+
+/* Check the number of nodes. */
+static struct ptunit_result pfix_nnodes(struct profile_fixture *pfix,
+					uint32_t nnodes)
+{
+	struct pt_profile_node node;
+	int errcode;
+
+	errcode = pt_profile_get_node(&pfix->profile, nnodes - 1, &node);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_profile_get_node(&pfix->profile, nnodes, &node);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+/* Add a call at @ip to @entry followed by @ninsn instructions and a return
+ * from @entry.
+ */
+static struct ptunit_result pfix_call(struct profile_fixture *pfix,
+				      uint64_t ip, uint64_t entry,
+				      uint64_t ninsn)
+{
+	uint64_t insn;
+
+	ptu_test(pfix_add, pfix, ip, 5, ptic_call);
+
+	for (insn = 0; insn < ninsn; ++insn)
+		ptu_test(pfix_add, pfix, entry + insn, 1, ptic_other);
+
+	ptu_test(pfix_add, pfix, entry + ninsn, 1, ptic_return);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_profile_init(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_profile_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct profile_fixture *pfix)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+
+	errcode = pt_profile_add_insn(NULL, &insn);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_profile_add_insn(&pfix->profile, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_node_null(struct profile_fixture *pfix)
+{
+	struct pt_profile_node node;
+	int errcode;
+
+	errcode = pt_profile_get_node(NULL, 0, &node);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_profile_get_node(&pfix->profile, 0, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_null(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = pt_profile_write_folded(NULL, "name");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_profile_write_folded(&pfix->profile, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct profile_fixture *pfix)
+{
+	ptu_test(pfix_nnodes, pfix, 1);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 0ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result call(struct profile_fixture *pfix)
+{
+	ptu_test(pfix_add, pfix, 0x1000ull, 1, ptic_other);
+	ptu_test(pfix_call, pfix, 0x1001ull, 0x2000ull, 2);
+	ptu_test(pfix_add, pfix, 0x1006ull, 1, ptic_other);
+
+	ptu_test(pfix_nnodes, pfix, 2);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 3ull, 6ull);
+	ptu_test(pfix_node, pfix, 1, 0x2000ull, 0, 3ull, 3ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result call_again(struct profile_fixture *pfix)
+{
+	ptu_test(pfix_call, pfix, 0x1000ull, 0x2000ull, 1);
+	ptu_test(pfix_call, pfix, 0x1005ull, 0x3000ull, 1);
+	ptu_test(pfix_call, pfix, 0x1000ull, 0x2000ull, 1);
+	ptu_test(pfix_add, pfix, 0x1005ull, 1, ptic_other);
+
+	ptu_test(pfix_nnodes, pfix, 3);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 4ull, 10ull);
+	ptu_test(pfix_node, pfix, 1, 0x2000ull, 0, 4ull, 4ull);
+	ptu_test(pfix_node, pfix, 2, 0x3000ull, 0, 2ull, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result nested(struct profile_fixture *pfix)
+{
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_call, pfix, 0x2000ull, 0x3000ull, 1);
+	ptu_test(pfix_add, pfix, 0x2005ull, 1, ptic_return);
+	ptu_test(pfix_add, pfix, 0x1005ull, 1, ptic_other);
+
+	/* The same function called from a different caller. */
+	ptu_test(pfix_call, pfix, 0x1006ull, 0x3000ull, 1);
+
+	ptu_test(pfix_nnodes, pfix, 4);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 3ull, 9ull);
+	ptu_test(pfix_node, pfix, 1, 0x2000ull, 0, 2ull, 4ull);
+	ptu_test(pfix_node, pfix, 2, 0x3000ull, 1, 2ull, 2ull);
+	ptu_test(pfix_node, pfix, 3, 0x3000ull, 0, 2ull, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result deep(struct profile_fixture *pfix)
+{
+	struct pt_profile_node node;
+	uint64_t ip;
+	int errcode;
+
+	/* Recurse beyond the initial stack size. */
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	for (ip = 0; ip < 1000; ++ip)
+		ptu_test(pfix_add, pfix, 0x2000ull, 5, ptic_call);
+
+	for (ip = 0; ip < 1000; ++ip)
+		ptu_test(pfix_add, pfix, 0x2005ull, 1, ptic_return);
+
+	ptu_test(pfix_add, pfix, 0x1005ull, 1, ptic_other);
+
+	ptu_test(pfix_nnodes, pfix, 1002);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 2ull, 2002ull);
+	ptu_test(pfix_node, pfix, 1001, 0x2005ull, 1000, 1ull, 1ull);
+
+	errcode = pt_profile_get_node(&pfix->profile, 1001, &node);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(node.depth, 1001);
+
+	/* We're back at the outermost node. */
+	ptu_uint_eq(pfix->profile.nframes, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result wide(struct profile_fixture *pfix)
+{
+	uint64_t entry;
+
+	/* Call more functions than fit into the initial table. */
+	for (entry = 0; entry < 1000; ++entry)
+		ptu_test(pfix_call, pfix, 0x1000ull, 0x100000ull + entry * 0x10,
+			 0);
+
+	for (entry = 0; entry < 1000; ++entry)
+		ptu_test(pfix_call, pfix, 0x1000ull, 0x100000ull + entry * 0x10,
+			 0);
+
+	ptu_test(pfix_nnodes, pfix, 1001);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 2000ull, 4000ull);
+	ptu_test(pfix_node, pfix, 1, 0x100000ull, 0, 2ull, 2ull);
+	ptu_test(pfix_node, pfix, 1000, 0x100000ull + 999 * 0x10, 0, 2ull,
+		 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result unwind(struct profile_fixture *pfix)
+{
+	/* Call 0x2000 and 0x3000 and return from 0x3000 directly to the
+	 * outermost function.
+	 */
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x2000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x3000ull, 1, ptic_return);
+	ptu_test(pfix_add, pfix, 0x1005ull, 1, ptic_other);
+
+	ptu_uint_eq(pfix->profile.nframes, 1);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 2ull, 4ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result longjmp_unwind(struct profile_fixture *pfix)
+{
+	/* Call 0x2000 and 0x3000 and jump back into 0x2000.  We notice when
+	 * 0x2000 returns.
+	 */
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x2000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x3000ull, 2, ptic_jump);
+	ptu_test(pfix_add, pfix, 0x2010ull, 1, ptic_return);
+	ptu_uint_eq(pfix->profile.nframes, 3);
+
+	ptu_test(pfix_add, pfix, 0x1005ull, 1, ptic_other);
+	ptu_uint_eq(pfix->profile.nframes, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result return_unmatched(struct profile_fixture *pfix)
+{
+	/* A return to an unexpected address pops the top frame. */
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x2000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x3000ull, 1, ptic_return);
+	ptu_test(pfix_add, pfix, 0x4000ull, 1, ptic_return);
+	ptu_uint_eq(pfix->profile.nframes, 2);
+
+	/* Returns never pop the bottom frame. */
+	ptu_test(pfix_add, pfix, 0x5000ull, 1, ptic_return);
+	ptu_test(pfix_add, pfix, 0x6000ull, 1, ptic_return);
+	ptu_test(pfix_add, pfix, 0x7000ull, 1, ptic_other);
+	ptu_uint_eq(pfix->profile.nframes, 1);
+
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 4ull, 7ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result interrupt(struct profile_fixture *pfix)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+	insn.interrupted = 1;
+
+	errcode = pt_profile_add_insn(&pfix->profile, &insn);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(pfix_add, pfix, 0x8000ull, 2, ptic_far_return);
+	ptu_test(pfix_add, pfix, 0x1001ull, 1, ptic_other);
+
+	ptu_uint_eq(pfix->profile.nframes, 1);
+	ptu_test(pfix_node, pfix, 0, 0ull, 0, 2ull, 3ull);
+	ptu_test(pfix_node, pfix, 1, 0x8000ull, 0, 1ull, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result reset(struct profile_fixture *pfix,
+				  int enabled, int resumed, int gap)
+{
+	struct pt_insn insn;
+	int errcode;
+
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_add, pfix, 0x2000ull, 5, ptic_call);
+
+	mk_insn(&insn, 0x3000ull, 1, ptic_other);
+	insn.enabled = enabled;
+	insn.resumed = resumed;
+	insn.gap = gap;
+
+	errcode = pt_profile_add_insn(&pfix->profile, &insn);
+	ptu_int_eq(errcode, 0);
+
+	if (resumed && !gap) {
+		ptu_uint_eq(pfix->profile.nframes, 3);
+		ptu_test(pfix_node, pfix, 2, 0x3000ull, 1, 1ull, 1ull);
+	} else {
+		ptu_uint_eq(pfix->profile.nframes, 1);
+		ptu_test(pfix_node, pfix, 0, 0ull, 0, 2ull, 3ull);
+	}
+
+	return ptu_passed();
+}
+
+/* Read the content of @name into @buffer of @size bytes. */
+static struct ptunit_result read_file(char *buffer, size_t size,
+				      const char *name)
+{
+	FILE *file;
+	size_t read;
+
+	file = fopen(name, "r");
+	ptu_ptr(file);
+
+	read = fread(buffer, 1, size - 1, file);
+	fclose(file);
+
+	buffer[read] = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result folded(struct profile_fixture *pfix)
+{
+	char buffer[256], *name;
+	int errcode;
+
+	ptu_test(pfix_add, pfix, 0x1000ull, 5, ptic_call);
+	ptu_test(pfix_call, pfix, 0x2000ull, 0x3000ull, 1);
+	ptu_test(pfix_add, pfix, 0x2005ull, 1, ptic_return);
+	ptu_test(pfix_call, pfix, 0x1005ull, 0x4000ull, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	errcode = pt_profile_write_folded(&pfix->profile, name);
+	if (errcode < 0)
+		free(name);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(read_file, buffer, sizeof(buffer), name);
+
+	remove(name);
+	free(name);
+
+	ptu_str_eq(buffer,
+		   "[unknown] 2\n"
+		   "[unknown];0x2000 2\n"
+		   "[unknown];0x2000;0x3000 2\n"
+		   "[unknown];0x4000 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result folded_bad_file(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = pt_profile_write_folded(&pfix->profile,
+					  "no-such-dir/profile.folded");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(void)
+{
+	struct pt_profile *profile;
+	struct pt_profile_node node;
+	struct pt_insn insn;
+	int errcode;
+
+	profile = pt_profile_alloc();
+	ptu_ptr(profile);
+
+	mk_insn(&insn, 0x1000ull, 1, ptic_other);
+
+	errcode = pt_profile_add_insn(profile, &insn);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_profile_get_node(profile, 0, &node);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(node.self, 1ull);
+
+	pt_profile_free(profile);
+	pt_profile_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pfix_init(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = pt_profile_init(&pfix->profile);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pfix_fini(struct profile_fixture *pfix)
+{
+	pt_profile_fini(&pfix->profile);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct profile_fixture pfix;
+	struct ptunit_suite suite;
+
+	pfix.init = pfix_init;
+	pfix.fini = pfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run_f(suite, add_null, pfix);
+	ptu_run_f(suite, get_node_null, pfix);
+	ptu_run_f(suite, write_null, pfix);
+
+	ptu_run_f(suite, empty, pfix);
+	ptu_run_f(suite, call, pfix);
+	ptu_run_f(suite, call_again, pfix);
+	ptu_run_f(suite, nested, pfix);
+	ptu_run_f(suite, deep, pfix);
+	ptu_run_f(suite, wide, pfix);
+	ptu_run_f(suite, unwind, pfix);
+	ptu_run_f(suite, longjmp_unwind, pfix);
+	ptu_run_f(suite, return_unmatched, pfix);
+	ptu_run_f(suite, interrupt, pfix);
+	ptu_run_fp(suite, reset, pfix, 1, 0, 0);
+	ptu_run_fp(suite, reset, pfix, 1, 1, 0);
+	ptu_run_fp(suite, reset, pfix, 0, 0, 1);
+	ptu_run_f(suite, folded, pfix);
+	ptu_run_f(suite, folded_bad_file, pfix);
+
+	ptu_run(suite, alloc);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
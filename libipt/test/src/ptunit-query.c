@@ -943,6 +943,84 @@ event_paging_cutoff_fail(struct ptu_decoder_fixture *dfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result
+asid_filter_null_fail(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_skip_stats stats;
+	int errcode;
+
+	errcode = pt_qry_set_asid_filter(NULL, NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_set_asid_filter(decoder, NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_get_skip_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_qry_get_skip_stats(decoder, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+event_paging_filtered(struct ptu_decoder_fixture *dfix)
+{
+	struct pt_query_decoder *decoder = &dfix->decoder;
+	struct pt_encoder *encoder = &dfix->encoder;
+	struct pt_skip_stats stats;
+	struct pt_event event;
+	uint64_t cr3[] = { 0x2000ull, pt_dfix_max_cr3, 0x2000ull };
+	uint64_t ip = pt_dfix_sext_ip;
+	uint8_t *begin, *end;
+	int errcode;
+
+	errcode = pt_qry_set_asid_filter(decoder, cr3, 3);
+	ptu_int_eq(errcode, 0);
+
+	begin = encoder->pos;
+	pt_encode_pip(encoder, 0x1000ull);
+	pt_encode_tnt_8(encoder, 0, 1);
+	pt_encode_tip(encoder, pt_dfix_bad_ip, pt_ipc_sext_48);
+	pt_encode_tip_pgd(encoder, 0, pt_ipc_suppressed);
+	pt_encode_pip(encoder, pt_dfix_max_cr3);
+	end = encoder->pos;
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_tip_pge(encoder, ip, pt_ipc_sext_48);
+
+	ptu_check(ptu_sync_decoder, decoder);
+
+	errcode = pt_qry_event(decoder, &event, sizeof(event));
+	ptu_int_eq(errcode, pts_event_pending);
+	ptu_int_eq(event.type, ptev_disabled);
+	ptu_uint_eq(event.ip_suppressed, 1);
+
+	errcode = pt_qry_event(decoder, &event, sizeof(event));
+	ptu_int_eq(errcode, pts_event_pending);
+	ptu_int_eq(event.type, ptev_enabled);
+	ptu_uint_eq(event.variant.enabled.ip, ip);
+
+	errcode = pt_qry_event(decoder, &event, sizeof(event));
+	ptu_int_eq(errcode, pts_event_pending);
+	ptu_int_eq(event.type, ptev_async_paging);
+	ptu_uint_eq(event.variant.async_paging.cr3, pt_dfix_max_cr3);
+	ptu_uint_eq(event.variant.async_paging.ip, ip);
+
+	errcode = pt_qry_event(decoder, &event, sizeof(event));
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(event.type, ptev_exec_mode);
+	ptu_int_eq(event.variant.exec_mode.mode, ptem_64bit);
+
+	errcode = pt_qry_get_skip_stats(decoder, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.bytes, (uint64_t) (end - begin));
+	ptu_uint_eq(stats.packets, 5ull);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result
 event_async_paging(struct ptu_decoder_fixture *dfix)
 {
@@ -2023,6 +2101,8 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, event_async_branch_cutoff_fail_b, dfix_empty);
 	ptu_run_f(suite, event_paging, dfix_empty);
 	ptu_run_f(suite, event_paging_cutoff_fail, dfix_empty);
+	ptu_run_f(suite, asid_filter_null_fail, dfix_empty);
+	ptu_run_f(suite, event_paging_filtered, dfix_empty);
 	ptu_run_f(suite, event_async_paging, dfix_empty);
 	ptu_run_f(suite, event_async_paging_suppressed, dfix_empty);
 	ptu_run_f(suite, event_async_paging_cutoff_fail, dfix_empty);
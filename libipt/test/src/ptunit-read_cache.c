@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_read_cache.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture providing a read cache and a read memory callback. */
+struct read_cache_fixture {
+	/* The read cache. */
+	struct pt_read_cache cache;
+
+	/* Two address spaces. */
+	struct pt_asid asid[2];
+
+	/* The memory region the callback can read from. */
+	uint64_t begin, end;
+
+	/* The number of callback invocations. */
+	int calls;
+
+	/* The address and size of the last callback request. */
+	uint64_t last_addr;
+	size_t last_size;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct read_cache_fixture *);
+	struct ptunit_result (*fini)(struct read_cache_fixture *);
+};
+
+/* The memory content at @addr in @asid. */
+static uint8_t rcfix_memory(const struct pt_asid *asid, uint64_t addr)
+{
+	return (uint8_t) (addr ^ (asid->cr3 >> 12) ^ (asid->vmcs >> 12));
+}
+
+static int rcfix_read(uint8_t *buffer, size_t size,
+		      const struct pt_asid *asid, uint64_t addr,
+		      void *context)
+{
+	struct read_cache_fixture *rcfix;
+	size_t idx;
+
+	rcfix = (struct read_cache_fixture *) context;
+	if (!rcfix || !buffer || !asid)
+		return -pte_internal;
+
+	rcfix->calls += 1;
+	rcfix->last_addr = addr;
+	rcfix->last_size = size;
+
+	if (addr < rcfix->begin || rcfix->end <= addr)
+		return -pte_nomap;
+
+	for (idx = 0; idx < size && addr + idx < rcfix->end; ++idx)
+		buffer[idx] = rcfix_memory(asid, addr + idx);
+
+	return (int) idx;
+}
+
+static struct ptunit_result init(void)
+{
+	struct pt_read_cache cache;
+
+	memset(&cache, 0xcd, sizeof(cache));
+
+	pt_read_cache_init(&cache);
+	ptu_null(cache.entries);
+	ptu_null(cache.data);
+	ptu_uint_eq(cache.page_size, 0);
+	ptu_uint_eq(cache.nentries, 0);
+	ptu_int_eq(pt_read_cache_enabled(&cache), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	pt_read_cache_init(NULL);
+	pt_read_cache_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result configure_null(void)
+{
+	int errcode;
+
+	errcode = pt_read_cache_configure(NULL, 0x20, 4);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result configure_bad_size(struct read_cache_fixture *rcfix)
+{
+	int errcode;
+
+	errcode = pt_read_cache_configure(&rcfix->cache, 0x18, 4);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_read_cache_configure(&rcfix->cache, 0x8, 4);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	ptu_int_ne(pt_read_cache_enabled(&rcfix->cache), 0);
+	ptu_uint_eq(rcfix->cache.page_size, 0x20);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result configure_disable(struct read_cache_fixture *rcfix)
+{
+	int errcode;
+
+	errcode = pt_read_cache_configure(&rcfix->cache, 0x20, 0);
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(pt_read_cache_enabled(&rcfix->cache), 0);
+	ptu_null(rcfix->cache.entries);
+	ptu_null(rcfix->cache.data);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_null(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc };
+	int status;
+
+	status = pt_read_cache_read(NULL, buffer, 1, &rcfix->asid[0],
+				    0x1000ull, rcfix_read, rcfix);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_read_cache_read(&rcfix->cache, NULL, 1, &rcfix->asid[0],
+				    0x1000ull, rcfix_read, rcfix);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, NULL, 0x1000ull,
+				    rcfix_read, rcfix);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1000ull, NULL, rcfix);
+	ptu_int_eq(status, -pte_internal);
+
+	ptu_int_eq(rcfix->calls, 0);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_disabled(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	status = pt_read_cache_configure(&rcfix->cache, 0, 0);
+	ptu_int_eq(status, 0);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 2, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(rcfix->calls, 1);
+	ptu_uint_eq(rcfix->last_addr, 0x1003ull);
+	ptu_uint_eq(rcfix->last_size, 2);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1003ull));
+	ptu_uint_eq(buffer[1], rcfix_memory(&rcfix->asid[0], 0x1004ull));
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 2, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(rcfix->calls, 1);
+	ptu_uint_eq(rcfix->last_addr, 0x1000ull);
+	ptu_uint_eq(rcfix->last_size, 0x20);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1003ull));
+	ptu_uint_eq(buffer[1], rcfix_memory(&rcfix->asid[0], 0x1004ull));
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 2, &rcfix->asid[0],
+				    0x101eull, rcfix_read, rcfix);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(rcfix->calls, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x101eull));
+	ptu_uint_eq(buffer[1], rcfix_memory(&rcfix->asid[0], 0x101full));
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_across(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[pt_max_insn_size];
+	int status, idx;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, sizeof(buffer),
+				    &rcfix->asid[0], 0x101aull, rcfix_read,
+				    rcfix);
+	ptu_int_eq(status, (int) sizeof(buffer));
+	ptu_int_eq(rcfix->calls, 2);
+	ptu_uint_eq(rcfix->last_addr, 0x1020ull);
+
+	for (idx = 0; idx < (int) sizeof(buffer); ++idx)
+		ptu_uint_eq(buffer[idx],
+			    rcfix_memory(&rcfix->asid[0], 0x101aull + idx));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_partial(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[pt_max_insn_size];
+	int status;
+
+	rcfix->end = 0x1070ull;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, sizeof(buffer),
+				    &rcfix->asid[0], 0x1068ull, rcfix_read,
+				    rcfix);
+	ptu_int_eq(status, 8);
+	ptu_int_eq(rcfix->calls, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1068ull));
+	ptu_uint_eq(buffer[7], rcfix_memory(&rcfix->asid[0], 0x106full));
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1070ull, rcfix_read, rcfix);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_int_eq(rcfix->calls, 2);
+	ptu_uint_eq(rcfix->last_addr, 0x1070ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_fallback(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	rcfix->begin = 0x1004ull;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1006ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 2);
+	ptu_uint_eq(rcfix->last_addr, 0x1006ull);
+	ptu_uint_eq(rcfix->last_size, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1006ull));
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	/* We remember that we could not read the window. */
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1007ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 3);
+	ptu_uint_eq(rcfix->last_addr, 0x1007ull);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1007ull));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_asid(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[0], 0x1003ull));
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[1],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&rcfix->asid[1], 0x1003ull));
+	ptu_int_eq(rcfix->calls, 2);
+
+	ptu_uint_ne(rcfix_memory(&rcfix->asid[0], 0x1003ull),
+		    rcfix_memory(&rcfix->asid[1], 0x1003ull));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_vmcs(struct read_cache_fixture *rcfix)
+{
+	struct pt_asid asid[2];
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	asid[0] = rcfix->asid[0];
+	asid[0].vmcs = 0x1000ull;
+
+	asid[1] = rcfix->asid[0];
+	asid[1].vmcs = 0x2000ull;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&asid[0], 0x1003ull));
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &asid[1],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], rcfix_memory(&asid[1], 0x1003ull));
+	ptu_int_eq(rcfix->calls, 2);
+
+	ptu_uint_ne(rcfix_memory(&asid[0], 0x1003ull),
+		    rcfix_memory(&asid[1], 0x1003ull));
+
+	status = pt_read_cache_invalidate(&rcfix->cache, &asid[1], 0x1000ull,
+					  0x20ull);
+	ptu_int_eq(status, 1);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result invalidate(struct read_cache_fixture *rcfix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 1);
+
+	status = pt_read_cache_invalidate(&rcfix->cache, &rcfix->asid[1],
+					  0x1000ull, 0x20ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_read_cache_invalidate(&rcfix->cache, &rcfix->asid[0],
+					  0x1020ull, 0x20ull);
+	ptu_int_eq(status, 0);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 1);
+
+	status = pt_read_cache_invalidate(&rcfix->cache, &rcfix->asid[0],
+					  0x101full, 0x1ull);
+	ptu_int_eq(status, 1);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(rcfix->calls, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result invalidate_all(struct read_cache_fixture *rcfix)
+{
+	struct pt_asid asid;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status;
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[0],
+				    0x1003ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+
+	status = pt_read_cache_read(&rcfix->cache, buffer, 1, &rcfix->asid[1],
+				    0x1043ull, rcfix_read, rcfix);
+	ptu_int_eq(status, 1);
+
+	pt_asid_init(&asid);
+
+	status = pt_read_cache_invalidate(&rcfix->cache, &asid, 0ull,
+					  UINT64_MAX);
+	ptu_int_eq(status, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result invalidate_null(void)
+{
+	struct pt_read_cache cache;
+	struct pt_asid asid;
+	int status;
+
+	pt_read_cache_init(&cache);
+	pt_asid_init(&asid);
+
+	status = pt_read_cache_invalidate(NULL, &asid, 0ull, 1ull);
+	ptu_int_eq(status, -pte_internal);
+
+	status = pt_read_cache_invalidate(&cache, NULL, 0ull, 1ull);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result rcfix_init(struct read_cache_fixture *rcfix)
+{
+	int errcode;
+
+	pt_read_cache_init(&rcfix->cache);
+
+	errcode = pt_read_cache_configure(&rcfix->cache, 0x20, 4);
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&rcfix->asid[0]);
+	rcfix->asid[0].cr3 = 0xa000;
+
+	pt_asid_init(&rcfix->asid[1]);
+	rcfix->asid[1].cr3 = 0xb000;
+
+	rcfix->begin = 0x1000ull;
+	rcfix->end = 0x1100ull;
+	rcfix->calls = 0;
+	rcfix->last_addr = 0ull;
+	rcfix->last_size = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result rcfix_fini(struct read_cache_fixture *rcfix)
+{
+	pt_read_cache_fini(&rcfix->cache);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct read_cache_fixture rcfix;
+	struct ptunit_suite suite;
+
+	rcfix.init = rcfix_init;
+	rcfix.fini = rcfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init);
+	ptu_run(suite, init_null);
+	ptu_run(suite, configure_null);
+	ptu_run_f(suite, configure_bad_size, rcfix);
+	ptu_run_f(suite, configure_disable, rcfix);
+	ptu_run_f(suite, read_null, rcfix);
+	ptu_run_f(suite, read_disabled, rcfix);
+	ptu_run_f(suite, read, rcfix);
+	ptu_run_f(suite, read_across, rcfix);
+	ptu_run_f(suite, read_partial, rcfix);
+	ptu_run_f(suite, read_fallback, rcfix);
+	ptu_run_f(suite, read_asid, rcfix);
+	ptu_run_f(suite, read_vmcs, rcfix);
+	ptu_run_f(suite, invalidate, rcfix);
+	ptu_run_f(suite, invalidate_all, rcfix);
+	ptu_run(suite, invalidate_null);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -28,6 +28,7 @@
 
 #include "ptunit.h"
 #include "ptunit_mktempname.h"
+#include "ptunit_threads.h"
 
 #include "pt_section.h"
 
@@ -74,7 +75,7 @@ static struct ptunit_result create(struct section_fixture *sfix)
 {
 	const char *name;
 	uint8_t bytes[] = { 0xcc, 0xcc, 0xcc, 0xcc, 0xcc };
-	uint64_t size;
+	uint64_t offset, size;
 
 	sfix_write(sfix, bytes);
 
@@ -87,6 +88,9 @@ static struct ptunit_result create(struct section_fixture *sfix)
 	size = pt_section_size(sfix->section);
 	ptu_uint_eq(size, 0x3ull);
 
+	offset = pt_section_offset(sfix->section);
+	ptu_uint_eq(offset, 0x1ull);
+
 	return ptu_passed();
 }
 
@@ -264,6 +268,261 @@ static struct ptunit_result read_overflow(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result set_release_file(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x1ull, 0x3ull);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_set_release(sfix->section, NULL, NULL);
+	ptu_int_eq(status, -pte_internal);
+
+	return ptu_passed();
+}
+
+/* The number of threads and iterations in the read_threads test. */
+enum {
+	read_threads_nthreads = 4,
+	read_threads_niter = 10000
+};
+
+/* Read from @arg (a section fixture) at different offsets repeatedly.
+ *
+ * The section's content at each offset is the offset's low byte.
+ */
+static int read_threads_worker(void *arg)
+{
+	struct section_fixture *sfix;
+	int iter;
+
+	sfix = (struct section_fixture *) arg;
+	if (!sfix)
+		return -pte_internal;
+
+	for (iter = 0; iter < read_threads_niter; ++iter) {
+		uint8_t buffer[2];
+		uint64_t offset;
+		int status;
+
+		offset = (uint64_t) ((iter * 7) & 0xfe);
+
+		status = pt_section_read(sfix->section, buffer, 2, offset);
+		if (status != 2)
+			return -pte_internal;
+
+		if (buffer[0] != (uint8_t) offset ||
+		    buffer[1] != (uint8_t) (offset + 1))
+			return -pte_internal;
+	}
+
+	return 0;
+}
+
+static struct ptunit_result read_threads(struct section_fixture *sfix)
+{
+	struct ptunit_thread *thread[read_threads_nthreads];
+	uint8_t bytes[0x100];
+	int idx, status;
+
+	for (idx = 0; idx < (int) sizeof(bytes); ++idx)
+		bytes[idx] = (uint8_t) idx;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x0ull, sizeof(bytes));
+	ptu_ptr(sfix->section);
+
+	for (idx = 0; idx < read_threads_nthreads; ++idx) {
+		thread[idx] = ptunit_thread_create(read_threads_worker, sfix);
+		ptu_ptr(thread[idx]);
+	}
+
+	for (idx = 0; idx < read_threads_nthreads; ++idx) {
+		status = ptunit_thread_join(thread[idx]);
+		ptu_int_eq(status, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result create_buffer(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const char *name;
+	uint64_t size;
+	uint32_t generation;
+
+	sfix->section = pt_mk_section_buffer(bytes, sizeof(bytes), 3);
+	ptu_ptr(sfix->section);
+
+	name = pt_section_filename(sfix->section);
+	ptu_null(name);
+
+	size = pt_section_size(sfix->section);
+	ptu_uint_eq(size, sizeof(bytes));
+
+	generation = pt_section_generation(sfix->section);
+	ptu_uint_eq(generation, 3);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result create_buffer_null(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc };
+
+	sfix->section = pt_mk_section_buffer(NULL, 0x1ull, 0);
+	ptu_null(sfix->section);
+
+	sfix->section = pt_mk_section_buffer(bytes, 0x0ull, 0);
+	ptu_null(sfix->section);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_buffer(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status;
+
+	sfix->section = pt_mk_section_buffer(&bytes[1], 0x3ull, 0);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_read(sfix->section, buffer, 3, 0x1ull);
+	ptu_int_eq(status, 2);
+	ptu_uint_eq(buffer[0], bytes[2]);
+	ptu_uint_eq(buffer[1], bytes[3]);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	status = pt_section_read(sfix->section, buffer, 1, 0x3ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	/* The buffer is not copied. */
+	bytes[1] = 0x8;
+
+	status = pt_section_read(sfix->section, buffer, 1, 0x0ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x8);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_null(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	status = pt_section_peek(NULL, &begin, 1, 0x0ull);
+	ptu_int_eq(status, -pte_invalid);
+
+	sfix->section = pt_mk_section_buffer(bytes, sizeof(bytes), 0);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_peek(sfix->section, NULL, 1, 0x0ull);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	sfix->section = pt_mk_section(sfix->name, 0x1ull, 0x3ull);
+	ptu_ptr(sfix->section);
+
+	/* Not all implementations map the file.  If they do, we must see the
+	 * file's contents.
+	 */
+	begin = NULL;
+	status = pt_section_peek(sfix->section, &begin, 3, 0x1ull);
+	if (status == -pte_nomap)
+		return ptu_passed();
+
+	ptu_int_eq(status, 2);
+	ptu_ptr(begin);
+	ptu_uint_eq(begin[0], bytes[2]);
+	ptu_uint_eq(begin[1], bytes[3]);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x3ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result peek_buffer(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	const uint8_t *begin;
+	int status;
+
+	sfix->section = pt_mk_section_buffer(&bytes[1], 0x3ull, 0);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_peek(sfix->section, &begin, 3, 0x1ull);
+	ptu_int_eq(status, 2);
+	ptu_ptr_eq(begin, &bytes[2]);
+
+	status = pt_section_peek(sfix->section, &begin, 1, 0x3ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_section_peek(sfix->section, &begin, 1, UINT64_MAX);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static void release_buffer(const uint8_t *buffer, uint64_t size,
+			   void *context)
+{
+	const uint8_t **released;
+
+	(void) size;
+
+	released = (const uint8_t **) context;
+	*released = buffer;
+}
+
+static struct ptunit_result release_buffer_free(struct section_fixture *sfix)
+{
+	const uint8_t *released;
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	int status;
+
+	sfix->section = pt_mk_section_buffer(bytes, sizeof(bytes), 0);
+	ptu_ptr(sfix->section);
+
+	released = NULL;
+	status = pt_section_set_release(sfix->section, release_buffer,
+					&released);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_get(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_put(sfix->section);
+	ptu_int_eq(status, 0);
+	ptu_null(released);
+
+	status = pt_section_put(sfix->section);
+	ptu_int_eq(status, 0);
+	ptu_ptr_eq(released, bytes);
+
+	sfix->section = NULL;
+
+	return ptu_passed();
+}
+
 static struct ptunit_result sfix_init(struct section_fixture *sfix)
 {
 	sfix->section = NULL;
@@ -322,6 +581,15 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_from_truncated, sfix);
 	ptu_run_f(suite, read_nomem, sfix);
 	ptu_run_f(suite, read_overflow, sfix);
+	ptu_run_f(suite, read_threads, sfix);
+	ptu_run_f(suite, set_release_file, sfix);
+	ptu_run_f(suite, create_buffer, sfix);
+	ptu_run_f(suite, create_buffer_null, sfix);
+	ptu_run_f(suite, read_buffer, sfix);
+	ptu_run_f(suite, release_buffer_free, sfix);
+	ptu_run_f(suite, peek_null, sfix);
+	ptu_run_f(suite, peek, sfix);
+	ptu_run_f(suite, peek_buffer, sfix);
 
 	ptunit_report(&suite);
 	return suite.nr_fails;
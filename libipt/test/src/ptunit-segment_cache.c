@@ -0,0 +1,582 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_segment_cache.h"
+#include "pt_block_profile.h"
+#include "pt_encoder.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture providing a trace, a segment cache, and a profile. */
+struct segment_cache_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[1024];
+
+	/* The configuration describing @buffer. */
+	struct pt_config config;
+
+	/* The encoder writing to @buffer. */
+	struct pt_encoder encoder;
+
+	/* The segment cache. */
+	struct pt_segment_cache cache;
+
+	/* A block profile. */
+	struct pt_block_profile profile;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct segment_cache_fixture *);
+	struct ptunit_result (*fini)(struct segment_cache_fixture *);
+};
+
+/* Encode a segment with an indirect branch to @ip.
+ *
+ * Timing packets are added if @timing is non-zero.
+ */
+static struct ptunit_result scfix_encode(struct segment_cache_fixture *scfix,
+					 uint64_t ip, int timing)
+{
+	struct pt_encoder *encoder;
+
+	encoder = &scfix->encoder;
+
+	pt_encode_psb(encoder);
+	if (timing)
+		pt_encode_tsc(encoder, 0x1000ull);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_fup(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_psbend(encoder);
+	if (timing) {
+		pt_encode_pad(encoder);
+		pt_encode_cbr(encoder, 0x2);
+	}
+	pt_encode_tip(encoder, ip, pt_ipc_sext_48);
+
+	return ptu_passed();
+}
+
+/* Compute the key of the segment from @begin to the current position. */
+static struct ptunit_result scfix_key(struct segment_cache_fixture *scfix,
+				      struct pt_segment_key *key,
+				      const uint8_t *begin)
+{
+	int errcode;
+
+	errcode = pt_segment_key(key, &scfix->config, begin,
+				 scfix->encoder.pos);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Make a key from @value. */
+static void scfix_mkkey(struct pt_segment_key *key, uint64_t value)
+{
+	key->hash[0] = value * 0x9e3779b97f4a7c15ull;
+	key->hash[1] = value;
+	key->size = 16ull;
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_segment_cache_init(NULL, 1ull << 20);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_limit(void)
+{
+	struct pt_segment_cache cache;
+	int errcode;
+
+	errcode = pt_segment_cache_init(&cache, 0ull);
+	ptu_int_eq(errcode, -pte_nomem);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_segment_cache_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bind_null(void)
+{
+	int errcode;
+
+	errcode = pt_segment_cache_bind(NULL, NULL, 0, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result api_null(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_key key;
+	const struct pt_segment_entry *entry;
+	int errcode;
+
+	scfix_mkkey(&key, 1ull);
+
+	errcode = pt_segment_key(NULL, &scfix->config, scfix->buffer,
+				 scfix->buffer);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_segment_key(&key, NULL, scfix->buffer, scfix->buffer);
+	ptu_int_eq(errcode, -pte_internal);
+
+	entry = pt_segment_cache_lookup(NULL, &key);
+	ptu_null(entry);
+
+	entry = pt_segment_cache_lookup(&scfix->cache, NULL);
+	ptu_null(entry);
+
+	errcode = pt_segment_cache_add(NULL, &key, &scfix->profile, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_segment_cache_add(&scfix->cache, NULL, &scfix->profile,
+				       0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &key, NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_segment_cache_get_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_segment_cache_get_stats(&scfix->cache, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result key(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_key first, second, third;
+	const uint8_t *begin;
+
+	begin = scfix->encoder.pos;
+	ptu_test(scfix_encode, scfix, 0x2000ull, 0);
+	ptu_test(scfix_key, scfix, &first, begin);
+
+	begin = scfix->encoder.pos;
+	ptu_test(scfix_encode, scfix, 0x2000ull, 1);
+	ptu_test(scfix_key, scfix, &second, begin);
+
+	begin = scfix->encoder.pos;
+	ptu_test(scfix_encode, scfix, 0x3000ull, 0);
+	ptu_test(scfix_key, scfix, &third, begin);
+
+	/* Timing packets are ignored. */
+	ptu_uint_ne(first.size, 0ull);
+	ptu_uint_eq(first.size, second.size);
+	ptu_uint_eq(first.hash[0], second.hash[0]);
+	ptu_uint_eq(first.hash[1], second.hash[1]);
+
+	ptu_uint_eq(first.size, third.size);
+	ptu_uint_ne(first.hash[0], third.hash[0]);
+	ptu_uint_ne(first.hash[1], third.hash[1]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result key_error(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_key key;
+	struct pt_encoder *encoder;
+	int errcode;
+
+	encoder = &scfix->encoder;
+
+	pt_encode_psb(encoder);
+	pt_encode_psbend(encoder);
+
+	/* An unknown extended opcode. */
+	*encoder->pos++ = pt_opc_ext;
+	*encoder->pos++ = 0xff;
+
+	errcode = pt_segment_key(&key, &scfix->config, scfix->buffer,
+				 encoder->pos);
+	ptu_int_eq(errcode, -pte_bad_opc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct segment_cache_fixture *scfix)
+{
+	const struct pt_segment_entry *entry;
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_key key;
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x1000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_edge(&scfix->profile, 0xa000ull,
+					    0x1004ull, 0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	scfix_mkkey(&key, 1ull);
+
+	entry = pt_segment_cache_lookup(&scfix->cache, &key);
+	ptu_null(entry);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &key, &scfix->profile,
+				       1);
+	ptu_int_eq(errcode, 0);
+
+	/* Adding the same segment again has no effect. */
+	errcode = pt_segment_cache_add(&scfix->cache, &key, &scfix->profile,
+				       0);
+	ptu_int_eq(errcode, 0);
+
+	entry = pt_segment_cache_lookup(&scfix->cache, &key);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->nblocks, 2);
+	ptu_uint_eq(entry->nedges, 1);
+	ptu_uint_eq(entry->errors, 1);
+	ptu_uint_eq(entry->edges[0].from, 0x1004ull);
+	ptu_uint_eq(entry->edges[0].to, 0x2000ull);
+	ptu_uint_eq(entry->edges[0].count, 1ull);
+	ptu_uint_eq(entry->blocks[0].count + entry->blocks[1].count, 3ull);
+
+	errcode = pt_segment_cache_get_stats(&scfix->cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 2ull);
+	ptu_uint_eq(stats.hits, 1ull);
+	ptu_uint_eq(stats.segments, 1ull);
+	ptu_uint_eq(stats.flushes, 0ull);
+	ptu_uint_eq(stats.memory, (scfix->cache.size *
+				   sizeof(struct pt_segment_entry)) +
+		    (2 * sizeof(struct pt_block_count)) +
+		    sizeof(struct pt_edge_count));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_empty(struct segment_cache_fixture *scfix)
+{
+	const struct pt_segment_entry *entry;
+	struct pt_segment_key key;
+	int errcode;
+
+	scfix_mkkey(&key, 1ull);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &key, &scfix->profile,
+				       0);
+	ptu_int_eq(errcode, 0);
+
+	entry = pt_segment_cache_lookup(&scfix->cache, &key);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->nblocks, 0);
+	ptu_uint_eq(entry->nedges, 0);
+	ptu_null(entry->blocks);
+	ptu_null(entry->edges);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result grow(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_key key;
+	uint64_t value;
+	int errcode;
+
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	for (value = 1ull; value <= 0x100ull; ++value) {
+		scfix_mkkey(&key, value);
+
+		errcode = pt_segment_cache_add(&scfix->cache, &key,
+					       &scfix->profile, 0);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(scfix->cache.stats.segments, 0x100ull);
+	ptu_uint_le(scfix->cache.stats.segments << 1, scfix->cache.size);
+	ptu_uint_eq(scfix->cache.stats.flushes, 0ull);
+	ptu_uint_eq(scfix->cache.stats.memory, (scfix->cache.size *
+						sizeof(struct pt_segment_entry))
+		    + (0x100 * sizeof(struct pt_block_count)));
+
+	for (value = 1ull; value <= 0x100ull; ++value) {
+		scfix_mkkey(&key, value);
+
+		ptu_ptr(pt_segment_cache_lookup(&scfix->cache, &key));
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result limit(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_key first, second, third;
+	uint64_t memory;
+	int errcode;
+
+	pt_segment_cache_fini(&scfix->cache);
+
+	memory = scfix->cache.size * sizeof(struct pt_segment_entry);
+	errcode = pt_segment_cache_init(&scfix->cache, memory +
+					(2 * sizeof(struct pt_block_count)));
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	scfix_mkkey(&first, 1ull);
+	scfix_mkkey(&second, 2ull);
+	scfix_mkkey(&third, 3ull);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &first,
+				       &scfix->profile, 0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &second,
+				       &scfix->profile, 0);
+	ptu_int_eq(errcode, 0);
+
+	/* The third segment does not fit.  We make room. */
+	errcode = pt_segment_cache_add(&scfix->cache, &third,
+				       &scfix->profile, 0);
+	ptu_int_eq(errcode, 0);
+
+	ptu_null(pt_segment_cache_lookup(&scfix->cache, &first));
+	ptu_null(pt_segment_cache_lookup(&scfix->cache, &second));
+	ptu_ptr(pt_segment_cache_lookup(&scfix->cache, &third));
+
+	errcode = pt_segment_cache_get_stats(&scfix->cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.segments, 1ull);
+	ptu_uint_eq(stats.flushes, 1ull);
+	ptu_uint_eq(stats.memory, memory + sizeof(struct pt_block_count));
+
+	/* A segment that alone exceeds the limit is not added. */
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x2000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_add_block(&scfix->profile, 0xa000ull,
+					     0x3000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &first,
+				       &scfix->profile, 0);
+	ptu_int_eq(errcode, 0);
+
+	ptu_null(pt_segment_cache_lookup(&scfix->cache, &first));
+	ptu_ptr(pt_segment_cache_lookup(&scfix->cache, &third));
+	ptu_uint_eq(scfix->cache.stats.flushes, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result limit_grow(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_key key;
+	uint64_t memory, value;
+	uint32_t size;
+	int errcode;
+
+	pt_segment_cache_fini(&scfix->cache);
+
+	/* There is room for more segments but not for a larger table. */
+	size = scfix->cache.size;
+	memory = size * sizeof(struct pt_segment_entry);
+	errcode = pt_segment_cache_init(&scfix->cache, memory + (memory >> 1));
+	ptu_int_eq(errcode, 0);
+
+	for (value = 1ull; value <= (size >> 1) + 1; ++value) {
+		scfix_mkkey(&key, value);
+
+		errcode = pt_segment_cache_add(&scfix->cache, &key,
+					       &scfix->profile, 0);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(scfix->cache.size, size);
+	ptu_uint_eq(scfix->cache.stats.segments, 1ull);
+	ptu_uint_eq(scfix->cache.stats.flushes, 1ull);
+	ptu_ptr(pt_segment_cache_lookup(&scfix->cache, &key));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bind(struct segment_cache_fixture *scfix)
+{
+	struct pt_segment_key key;
+	int image, errcode;
+
+	scfix_mkkey(&key, 1ull);
+
+	errcode = pt_segment_cache_bind(&scfix->cache, &image, 1, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &key, &scfix->profile,
+				       0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_bind(&scfix->cache, &image, 1, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_ptr(pt_segment_cache_lookup(&scfix->cache, &key));
+	ptu_uint_eq(scfix->cache.stats.flushes, 0ull);
+
+	/* A new generation of the image clears the cache. */
+	errcode = pt_segment_cache_bind(&scfix->cache, &image, 2, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_null(pt_segment_cache_lookup(&scfix->cache, &key));
+	ptu_uint_eq(scfix->cache.stats.flushes, 1ull);
+	ptu_uint_eq(scfix->cache.stats.segments, 0ull);
+
+	errcode = pt_segment_cache_add(&scfix->cache, &key, &scfix->profile,
+				       0);
+	ptu_int_eq(errcode, 0);
+
+	/* So does a different configuration. */
+	errcode = pt_segment_cache_bind(&scfix->cache, &image, 2, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_null(pt_segment_cache_lookup(&scfix->cache, &key));
+	ptu_uint_eq(scfix->cache.stats.flushes, 2ull);
+
+	/* An empty cache is not flushed. */
+	errcode = pt_segment_cache_bind(&scfix->cache, NULL, 2, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(scfix->cache.stats.flushes, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(void)
+{
+	struct pt_segment_cache_stats stats;
+	struct pt_segment_cache *cache;
+	int errcode;
+
+	cache = pt_segment_cache_alloc(0ull);
+	ptu_null(cache);
+
+	cache = pt_segment_cache_alloc(1ull << 20);
+	ptu_ptr(cache);
+
+	errcode = pt_segment_cache_get_stats(cache, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.lookups, 0ull);
+	ptu_uint_eq(stats.segments, 0ull);
+	ptu_uint_ne(stats.memory, 0ull);
+
+	pt_segment_cache_free(cache);
+	pt_segment_cache_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scfix_init(struct segment_cache_fixture *scfix)
+{
+	int errcode;
+
+	memset(scfix->buffer, 0, sizeof(scfix->buffer));
+	memset(&scfix->config, 0, sizeof(scfix->config));
+	scfix->config.size = sizeof(scfix->config);
+	scfix->config.begin = scfix->buffer;
+	scfix->config.end = scfix->buffer + sizeof(scfix->buffer);
+
+	errcode = pt_encoder_init(&scfix->encoder, &scfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_segment_cache_init(&scfix->cache, 1ull << 24);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_block_profile_init(&scfix->profile);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scfix_fini(struct segment_cache_fixture *scfix)
+{
+	pt_block_profile_fini(&scfix->profile);
+	pt_segment_cache_fini(&scfix->cache);
+	pt_encoder_fini(&scfix->encoder);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct segment_cache_fixture scfix;
+	struct ptunit_suite suite;
+
+	scfix.init = scfix_init;
+	scfix.fini = scfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, init_limit);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, bind_null);
+	ptu_run_f(suite, api_null, scfix);
+
+	ptu_run_f(suite, key, scfix);
+	ptu_run_f(suite, key_error, scfix);
+	ptu_run_f(suite, add, scfix);
+	ptu_run_f(suite, add_empty, scfix);
+	ptu_run_f(suite, grow, scfix);
+	ptu_run_f(suite, limit, scfix);
+	ptu_run_f(suite, limit_grow, scfix);
+	ptu_run_f(suite, bind, scfix);
+
+	ptu_run(suite, alloc);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
@@ -0,0 +1,649 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mktempname.h"
+
+#include "pt_tip_histogram.h"
+#include "pt_encoder.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A test fixture providing a trace and a histogram. */
+struct tip_histogram_fixture {
+	/* The trace buffer. */
+	uint8_t buffer[1024];
+
+	/* The configuration describing @buffer. */
+	struct pt_config config;
+
+	/* The encoder writing to @buffer. */
+	struct pt_encoder encoder;
+
+	/* The histogram. */
+	struct pt_tip_histogram hist;
+
+	/* An address space. */
+	struct pt_asid asid;
+
+	/* The offset of the second PSB segment in the default trace. */
+	uint64_t second;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct tip_histogram_fixture *);
+	struct ptunit_result (*fini)(struct tip_histogram_fixture *);
+};
+
+/* Check the count of the branch from @from to @to in @asid in @hist. */
+static struct ptunit_result tfix_count(const struct pt_tip_histogram *hist,
+				       const struct pt_asid *asid,
+				       uint64_t from, uint64_t to,
+				       uint64_t expected)
+{
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_tip_histogram_count(hist, asid, from, to, &count);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, expected);
+
+	return ptu_passed();
+}
+
+/* Encode the default trace.
+ *
+ * The first segment traces in 0xa000.  It contains two indirect branches to
+ * 0x2000 and an interrupt from 0x1100 that switches to 0xb000.  The second
+ * segment does not provide CR3.  It contains an indirect branch to 0x2000
+ * and one with suppressed IP.
+ */
+static struct ptunit_result tfix_encode(struct tip_histogram_fixture *tfix)
+{
+	struct pt_encoder *encoder;
+
+	encoder = &tfix->encoder;
+
+	pt_encode_psb(encoder);
+	pt_encode_pip(encoder, 0xa000ull);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_fup(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_psbend(encoder);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_update_16);
+	pt_encode_tnt_8(encoder, 0, 1);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_update_16);
+	pt_encode_fup(encoder, 0x1100ull, pt_ipc_update_16);
+	pt_encode_pip(encoder, 0xb000ull);
+	pt_encode_tip(encoder, 0x3000ull, pt_ipc_update_16);
+	pt_encode_tip_pgd(encoder, 0ull, pt_ipc_suppressed);
+
+	tfix->second = (uint64_t) (encoder->pos - tfix->buffer);
+
+	pt_encode_psb(encoder);
+	pt_encode_mode_exec(encoder, ptem_64bit);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_update_16);
+	pt_encode_tip(encoder, 0ull, pt_ipc_suppressed);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_tip_histogram_init(NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_tip_histogram_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(void)
+{
+	int errcode;
+
+	errcode = pt_tip_histogram_add(NULL, 0ull, 0ull, 0x1000ull, 1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result api_null(struct tip_histogram_fixture *tfix)
+{
+	struct pt_tip_histogram_stats stats;
+	struct pt_tip_count top;
+	uint64_t count;
+	int errcode;
+
+	errcode = pt_tip_histogram_decode(NULL, &tfix->config, 0ull, 1ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, NULL, 0ull, 1ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_merge(NULL, &tfix->hist);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_merge(&tfix->hist, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_count(NULL, NULL, 0ull, 0x1000ull, &count);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_count(&tfix->hist, NULL, 0ull, 0x1000ull,
+					 NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_top(NULL, &top, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_top(&tfix->hist, NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_get_stats(NULL, &stats);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_get_stats(&tfix->hist, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_write_csv(NULL, "name");
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_tip_histogram_write_csv(&tfix->hist, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct tip_histogram_fixture *tfix)
+{
+	int errcode;
+
+	errcode = pt_tip_histogram_add(&tfix->hist, pt_asid_no_cr3, 0ull,
+				       0x1000ull, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_add(&tfix->hist, pt_asid_no_cr3, 0ull,
+				       0x1000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_add(&tfix->hist, tfix->asid.cr3,
+				       0x2000ull, 0x1000ull, 4ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_add(&tfix->hist, tfix->asid.cr3, 0ull,
+				       0x1000ull, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tfix->hist.ncounts, 2);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x1000ull, 3ull);
+	ptu_test(tfix_count, &tfix->hist, &tfix->asid, 0x2000ull, 0x1000ull,
+		 4ull);
+	ptu_test(tfix_count, &tfix->hist, &tfix->asid, 0ull, 0x1000ull, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result grow(struct tip_histogram_fixture *tfix)
+{
+	uint64_t ip;
+	int errcode;
+
+	for (ip = 0x1000ull; ip < 0x3000ull; ip += 2) {
+		errcode = pt_tip_histogram_add(&tfix->hist, pt_asid_no_cr3,
+					       0ull, ip, ip - 0xfffull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(tfix->hist.ncounts, 0x1000);
+	ptu_uint_le(tfix->hist.ncounts << 1, tfix->hist.size);
+
+	for (ip = 0x1000ull; ip < 0x3000ull; ip += 2)
+		ptu_test(tfix_count, &tfix->hist, NULL, 0ull, ip,
+			 ip - 0xfffull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode(struct tip_histogram_fixture *tfix)
+{
+	struct pt_tip_histogram_stats stats;
+	int errcode;
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tfix->hist.ncounts, 2);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 3ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x3000ull, 1ull);
+
+	errcode = pt_tip_histogram_get_stats(&tfix->hist, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.segments, 2ull);
+	ptu_uint_eq(stats.tips, 4ull);
+	ptu_uint_eq(stats.suppressed, 1ull);
+	ptu_uint_eq(stats.errors, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_context(struct tip_histogram_fixture *tfix)
+{
+	struct pt_asid asid;
+	int errcode;
+
+	tfix->hist.context = pttc_fup | pttc_cr3;
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&asid);
+	asid.cr3 = 0xb000ull;
+
+	ptu_uint_eq(tfix->hist.ncounts, 3);
+	ptu_test(tfix_count, &tfix->hist, &tfix->asid, 0ull, 0x2000ull, 2ull);
+	ptu_test(tfix_count, &tfix->hist, &asid, 0x1100ull, 0x3000ull, 1ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_range(struct tip_histogram_fixture *tfix)
+{
+	struct pt_tip_histogram_stats stats;
+	int errcode;
+
+	/* The first segment is decoded to its end. */
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  1ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 2ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x3000ull, 1ull);
+
+	/* The second segment is found from within the first. */
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 1ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 3ull);
+
+	errcode = pt_tip_histogram_get_stats(&tfix->hist, &stats);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(stats.segments, 2ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_empty(struct tip_histogram_fixture *tfix)
+{
+	int errcode;
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config,
+					  tfix->second, tfix->second);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config,
+					  tfix->second + 1,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tfix->hist.ncounts, 0);
+	ptu_uint_eq(tfix->hist.stats.segments, 0ull);
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config,
+					  sizeof(tfix->buffer) + 1,
+					  sizeof(tfix->buffer) + 2);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_tsx(struct tip_histogram_fixture *tfix)
+{
+	struct pt_encoder *encoder;
+	int errcode;
+
+	memset(tfix->buffer, 0, sizeof(tfix->buffer));
+
+	encoder = &tfix->encoder;
+	encoder->pos = tfix->buffer;
+
+	pt_encode_psb(encoder);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_mode_tsx(encoder, pt_mob_tsx_intx);
+	pt_encode_fup(encoder, 0x1004ull, pt_ipc_update_16);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_update_16);
+	pt_encode_mode_tsx(encoder, pt_mob_tsx_abrt);
+	pt_encode_fup(encoder, 0x2004ull, pt_ipc_update_16);
+	pt_encode_tip(encoder, 0x3000ull, pt_ipc_update_16);
+	pt_encode_ovf(encoder);
+	pt_encode_fup(encoder, 0x3004ull, pt_ipc_update_16);
+	pt_encode_tip(encoder, 0x4000ull, pt_ipc_update_16);
+
+	tfix->hist.context = pttc_fup;
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tfix->hist.ncounts, 3);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 1ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0x2004ull, 0x3000ull, 1ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x4000ull, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decode_error(struct tip_histogram_fixture *tfix)
+{
+	struct pt_encoder *encoder;
+	int errcode;
+
+	memset(tfix->buffer, 0, sizeof(tfix->buffer));
+
+	encoder = &tfix->encoder;
+	encoder->pos = tfix->buffer;
+
+	pt_encode_psb(encoder);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_tip(encoder, 0x2000ull, pt_ipc_update_16);
+
+	/* An unknown extended opcode. */
+	*encoder->pos++ = pt_opc_ext;
+	*encoder->pos++ = 0xff;
+
+	pt_encode_tip(encoder, 0x5000ull, pt_ipc_update_16);
+	pt_encode_psb(encoder);
+	pt_encode_psbend(encoder);
+	pt_encode_tip_pge(encoder, 0x1000ull, pt_ipc_sext_48);
+	pt_encode_tip(encoder, 0x3000ull, pt_ipc_update_16);
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	ptu_uint_eq(tfix->hist.ncounts, 2);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 1ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x3000ull, 1ull);
+	ptu_uint_eq(tfix->hist.stats.segments, 2ull);
+	ptu_uint_eq(tfix->hist.stats.errors, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge(struct tip_histogram_fixture *tfix)
+{
+	struct pt_tip_histogram other;
+	struct pt_asid asid;
+	int errcode;
+
+	errcode = pt_tip_histogram_init(&other, pttc_fup | pttc_cr3);
+	ptu_int_eq(errcode, 0);
+
+	tfix->hist.context = pttc_fup | pttc_cr3;
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  tfix->second);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_decode(&other, &tfix->config, tfix->second,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_merge(&tfix->hist, &other);
+	pt_tip_histogram_fini(&other);
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&asid);
+	asid.cr3 = 0xb000ull;
+
+	ptu_uint_eq(tfix->hist.ncounts, 3);
+	ptu_test(tfix_count, &tfix->hist, &tfix->asid, 0ull, 0x2000ull, 2ull);
+	ptu_test(tfix_count, &tfix->hist, &asid, 0x1100ull, 0x3000ull, 1ull);
+	ptu_test(tfix_count, &tfix->hist, NULL, 0ull, 0x2000ull, 1ull);
+	ptu_uint_eq(tfix->hist.stats.segments, 2ull);
+	ptu_uint_eq(tfix->hist.stats.tips, 4ull);
+	ptu_uint_eq(tfix->hist.stats.suppressed, 1ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result top(struct tip_histogram_fixture *tfix)
+{
+	struct pt_tip_count top[3];
+	int errcode;
+
+	errcode = pt_tip_histogram_top(&tfix->hist, top, 3);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_decode(&tfix->hist, &tfix->config, 0ull,
+					  sizeof(tfix->buffer));
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_top(&tfix->hist, top, 0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_top(&tfix->hist, top, 1);
+	ptu_int_eq(errcode, 1);
+	ptu_uint_eq(top[0].to, 0x2000ull);
+	ptu_uint_eq(top[0].count, 3ull);
+
+	errcode = pt_tip_histogram_top(&tfix->hist, top, 3);
+	ptu_int_eq(errcode, 2);
+	ptu_uint_eq(top[0].to, 0x2000ull);
+	ptu_uint_eq(top[0].count, 3ull);
+	ptu_uint_eq(top[1].cr3, pt_asid_no_cr3);
+	ptu_uint_eq(top[1].from, 0ull);
+	ptu_uint_eq(top[1].to, 0x3000ull);
+	ptu_uint_eq(top[1].count, 1ull);
+
+	return ptu_passed();
+}
+
+/* Read the content of @name into @buffer of @size bytes. */
+static struct ptunit_result read_file(char *buffer, size_t size,
+				      const char *name)
+{
+	FILE *file;
+	size_t read;
+
+	file = fopen(name, "r");
+	ptu_ptr(file);
+
+	read = fread(buffer, 1, size - 1, file);
+	fclose(file);
+
+	buffer[read] = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result csv(struct tip_histogram_fixture *tfix)
+{
+	char buffer[256], *name;
+	int errcode;
+
+	errcode = pt_tip_histogram_add(&tfix->hist, tfix->asid.cr3,
+				       0x1004ull, 0x2000ull, 2ull);
+	ptu_int_eq(errcode, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	errcode = pt_tip_histogram_write_csv(&tfix->hist, name);
+	if (errcode < 0)
+		free(name);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(read_file, buffer, sizeof(buffer), name);
+
+	remove(name);
+	free(name);
+
+	ptu_str_eq(buffer,
+		   "cr3,from,to,count\n"
+		   "0xa000,0x1004,0x2000,2\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result csv_unknown(struct tip_histogram_fixture *tfix)
+{
+	char buffer[256], *name;
+	int errcode;
+
+	errcode = pt_tip_histogram_add(&tfix->hist, pt_asid_no_cr3, 0ull,
+				       0x2000ull, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	name = mktempname();
+	ptu_ptr(name);
+
+	errcode = pt_tip_histogram_write_csv(&tfix->hist, name);
+	if (errcode < 0)
+		free(name);
+	ptu_int_eq(errcode, 0);
+
+	ptu_test(read_file, buffer, sizeof(buffer), name);
+
+	remove(name);
+	free(name);
+
+	ptu_str_eq(buffer,
+		   "cr3,from,to,count\n"
+		   ",,0x2000,3\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc(void)
+{
+	struct pt_tip_histogram *hist;
+	uint64_t count;
+	int errcode;
+
+	hist = pt_tip_histogram_alloc(pttc_cr3);
+	ptu_ptr(hist);
+	ptu_uint_eq(hist->context, pttc_cr3);
+
+	errcode = pt_tip_histogram_add(hist, pt_asid_no_cr3, 0ull, 0x1000ull,
+				       1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_count(hist, NULL, 0ull, 0x1000ull, &count);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(count, 1ull);
+
+	pt_tip_histogram_free(hist);
+	pt_tip_histogram_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tfix_init(struct tip_histogram_fixture *tfix)
+{
+	int errcode;
+
+	memset(tfix->buffer, 0, sizeof(tfix->buffer));
+	memset(&tfix->config, 0, sizeof(tfix->config));
+	tfix->config.size = sizeof(tfix->config);
+	tfix->config.begin = tfix->buffer;
+	tfix->config.end = tfix->buffer + sizeof(tfix->buffer);
+
+	errcode = pt_encoder_init(&tfix->encoder, &tfix->config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_tip_histogram_init(&tfix->hist, 0);
+	ptu_int_eq(errcode, 0);
+
+	pt_asid_init(&tfix->asid);
+	tfix->asid.cr3 = 0xa000ull;
+
+	ptu_test(tfix_encode, tfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tfix_fini(struct tip_histogram_fixture *tfix)
+{
+	pt_tip_histogram_fini(&tfix->hist);
+	pt_encoder_fini(&tfix->encoder);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct tip_histogram_fixture tfix;
+	struct ptunit_suite suite;
+
+	tfix.init = tfix_init;
+	tfix.fini = tfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, add_null);
+	ptu_run_f(suite, api_null, tfix);
+
+	ptu_run_f(suite, add, tfix);
+	ptu_run_f(suite, grow, tfix);
+	ptu_run_f(suite, decode, tfix);
+	ptu_run_f(suite, decode_context, tfix);
+	ptu_run_f(suite, decode_range, tfix);
+	ptu_run_f(suite, decode_empty, tfix);
+	ptu_run_f(suite, decode_tsx, tfix);
+	ptu_run_f(suite, decode_error, tfix);
+	ptu_run_f(suite, merge, tfix);
+	ptu_run_f(suite, top, tfix);
+	ptu_run_f(suite, csv, tfix);
+	ptu_run_f(suite, csv_unknown, tfix);
+
+	ptu_run(suite, alloc);
+
+	ptunit_report(&suite);
+	return suite.nr_fails;
+}
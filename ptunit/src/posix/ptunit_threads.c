@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013-2015, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit_threads.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+
+struct ptunit_thread {
+	/* The thread. */
+	pthread_t thread;
+
+	/* The start function and its argument. */
+	int (*start)(void *);
+	void *arg;
+
+	/* The result of @start. */
+	int result;
+};
+
+static void *ptunit_thread_start(void *arg)
+{
+	struct ptunit_thread *thread;
+
+	thread = (struct ptunit_thread *) arg;
+	thread->result = thread->start(thread->arg);
+
+	return NULL;
+}
+
+struct ptunit_thread *ptunit_thread_create(int (*start)(void *), void *arg)
+{
+	struct ptunit_thread *thread;
+	int errcode;
+
+	if (!start)
+		return NULL;
+
+	thread = malloc(sizeof(*thread));
+	if (!thread)
+		return NULL;
+
+	thread->start = start;
+	thread->arg = arg;
+	thread->result = 0;
+
+	errcode = pthread_create(&thread->thread, NULL, ptunit_thread_start,
+				 thread);
+	if (errcode) {
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int ptunit_thread_join(struct ptunit_thread *thread)
+{
+	int result;
+
+	if (!thread)
+		return -1;
+
+	(void) pthread_join(thread->thread, NULL);
+
+	result = thread->result;
+	free(thread);
+
+	return result;
+}